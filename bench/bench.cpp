@@ -0,0 +1,300 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <game/cgrid_generator.h>
+#include <game/gen_pipeline.h>
+#include <game/height_map.h>
+#include <game/id.h>
+#include <game/thread_pool.h>
+#include <game/work_queue.h>
+#include <iostream>
+#include <kernel/brownian_grow.h>
+#include <kernel/mandelbulb.h>
+#include <kernel/mandelbulb_asym.h>
+#include <kernel/mandelbulb_exp.h>
+#include <kernel/mandelbulb_sym.h>
+#include <kernel/terrain_base.h>
+#include <kernel/terrain_height.h>
+#include <min/vec3.h>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Timings of one kernel at one grid size and thread count
+class bench_result
+{
+  private:
+    std::string _kernel;
+    size_t _scale;
+    unsigned _threads;
+    double _best;
+    double _mean;
+    size_t _cells;
+
+  public:
+    bench_result(const std::string &kernel, const size_t scale, const unsigned threads, const double best, const double mean, const size_t cells)
+        : _kernel(kernel), _scale(scale), _threads(threads), _best(best), _mean(mean), _cells(cells) {}
+
+    inline const std::string &get_kernel() const
+    {
+        return _kernel;
+    }
+    inline size_t get_scale() const
+    {
+        return _scale;
+    }
+    inline unsigned get_threads() const
+    {
+        return _threads;
+    }
+    inline double get_best() const
+    {
+        return _best;
+    }
+    inline double get_mean() const
+    {
+        return _mean;
+    }
+    inline size_t get_cells() const
+    {
+        return _cells;
+    }
+};
+
+// Benchmark settings, same seed and parameters every run
+static constexpr size_t bench_runs = 3;
+static constexpr size_t bench_chunk = 8;
+static constexpr uint64_t bench_seed = 42;
+
+std::function<min::vec3<float>(const size_t)> bench_cell_center(const size_t scale)
+{
+    const float half = scale / 2;
+    return [scale, half](const size_t i) {
+        const float x = i / (scale * scale);
+        const float y = (i / scale) % scale;
+        const float z = i % scale;
+        return min::vec3<float>(x - half + 0.5, y - half + 0.5, z - half + 0.5);
+    };
+}
+template <typename F>
+bench_result measure(const std::string &kernel, const size_t scale, const unsigned threads, std::vector<game::block_id> &grid, const F &f)
+{
+    double best = 0.0;
+    double total = 0.0;
+    for (size_t i = 0; i < bench_runs; i++)
+    {
+        // Start every run from an empty grid
+        std::fill(grid.begin(), grid.end(), game::block_id::EMPTY);
+
+        // Time the kernel only
+        const auto begin = std::chrono::high_resolution_clock::now();
+        f(grid);
+        const auto end = std::chrono::high_resolution_clock::now();
+        const double ms = std::chrono::duration<double, std::milli>(end - begin).count();
+
+        best = (i == 0) ? ms : std::min(best, ms);
+        total += ms;
+    }
+
+    // Solid cells written, a quick check that runs did the same work
+    const size_t cells = grid.size() - std::count(grid.begin(), grid.end(), game::block_id::EMPTY);
+
+    std::cout << "bench: " << kernel << ": grid " << scale << ": " << threads << " threads: "
+              << best << " ms best, " << total / bench_runs << " ms mean" << std::endl;
+
+    return bench_result(kernel, scale, threads, best, total / bench_runs, cells);
+}
+template <typename K>
+void bench_mandelbulb(std::vector<bench_result> &out, game::thread_pool &pool, std::vector<game::block_id> &grid, const size_t scale, K &k, const std::string &name)
+{
+    // Adaptive kernel with the settings used for portals
+    const auto f = bench_cell_center(scale);
+    out.push_back(measure(name, scale, pool.get_threads(), grid, [&pool, &k, scale, &f](std::vector<game::block_id> &grid) {
+        k.generate(pool, grid, scale, f);
+    }));
+}
+void bench_kernels(std::vector<bench_result> &out, const size_t scale, const unsigned threads)
+{
+    // Pool and grid for this run
+    game::thread_pool pool(threads);
+    std::vector<game::block_id> grid(scale * scale * scale, game::block_id::EMPTY);
+
+    out.push_back(measure("terrain_base", scale, threads, grid, [&pool, scale](std::vector<game::block_id> &grid) {
+        const kernel::terrain_base base(scale, bench_chunk, 0, scale / 2, bench_seed);
+        base.generate(pool, grid);
+    }));
+    out.push_back(measure("terrain_height", scale, threads, grid, [&pool, scale](std::vector<game::block_id> &grid) {
+        const kernel::terrain_height height(pool, scale, scale / 2, scale - 1, bench_seed);
+        height.generate(pool, grid);
+    }));
+    out.push_back(measure("height_map", scale, threads, grid, [&pool, scale](std::vector<game::block_id> &grid) {
+        const game::height_map<float, float> map(pool, std::ceil(std::log2(scale)), 4.0, 8.0, bench_seed);
+    }));
+    out.push_back(measure("brownian_grow", scale, threads, grid, [&pool, scale](std::vector<game::block_id> &grid) {
+        std::mt19937 gen(bench_seed);
+        kernel::brownian_grow grow(gen, grid, scale, 8, 4);
+        grow.generate(pool, grid, grid, 1 << 16, 32);
+    }));
+
+    // Same coefficients as the kernel tests
+    kernel::mandelbulb base;
+    kernel::mandelbulb_sym sym(36, 126, 84, 9);
+    kernel::mandelbulb_asym asym(36, 126, 84, 9, 20, 60, 50, 4, 12, 40, 30, 6);
+    kernel::mandelbulb_exp exp(8, 6, 15, 5);
+    bench_mandelbulb(out, pool, grid, scale, base, "mandelbulb");
+    bench_mandelbulb(out, pool, grid, scale, sym, "mandelbulb_sym");
+    bench_mandelbulb(out, pool, grid, scale, asym, "mandelbulb_asym");
+    bench_mandelbulb(out, pool, grid, scale, exp, "mandelbulb_exp");
+}
+void bench_world(std::vector<bench_result> &out, const size_t scale)
+{
+    // The generator runs on the global work queue, no cache so every run generates
+    std::vector<game::block_id> grid(scale * scale * scale, game::block_id::EMPTY);
+    game::cgrid_generator gen(grid, bench_seed, false);
+    gen.create_world(grid, scale, bench_chunk);
+
+    // Every chunk of the world, as generated on demand
+    std::vector<game::gen_tile> tiles;
+    for (size_t x = 0; x < scale; x += bench_chunk)
+    {
+        for (size_t y = 0; y < scale; y += bench_chunk)
+        {
+            for (size_t z = 0; z < scale; z += bench_chunk)
+            {
+                tiles.emplace_back(x, x + bench_chunk, y, y + bench_chunk, z, z + bench_chunk);
+            }
+        }
+    }
+
+    out.push_back(measure("world", scale, game::work_queue::worker.get_threads(), grid, [&gen, &tiles](std::vector<game::block_id> &grid) {
+        gen.generate_chunks(grid, tiles);
+    }));
+
+    // Time per stage summed over all runs and threads
+    const game::gen_pipeline &pipeline = *gen.get_pipeline();
+    for (size_t i = 0; i < pipeline.get_stages(); i++)
+    {
+        std::cout << "bench: world: grid " << scale << ": stage '" << pipeline.get_name(i) << "': "
+                  << pipeline.get_time(i) / bench_runs << " ms mean" << std::endl;
+    }
+}
+void write_csv(std::ostream &s, const std::vector<bench_result> &results)
+{
+    s << "kernel,scale,threads,best_ms,mean_ms,cells" << std::endl;
+    for (const bench_result &r : results)
+    {
+        s << r.get_kernel() << "," << r.get_scale() << "," << r.get_threads() << ","
+          << r.get_best() << "," << r.get_mean() << "," << r.get_cells() << std::endl;
+    }
+}
+void write_json(std::ostream &s, const std::vector<bench_result> &results)
+{
+    s << "{" << std::endl;
+    s << "  \"runs\": " << bench_runs << "," << std::endl;
+    s << "  \"seed\": " << bench_seed << "," << std::endl;
+    s << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << "," << std::endl;
+    s << "  \"results\": [" << std::endl;
+    const size_t size = results.size();
+    for (size_t i = 0; i < size; i++)
+    {
+        const bench_result &r = results[i];
+        s << "    {\"kernel\": \"" << r.get_kernel() << "\", \"scale\": " << r.get_scale() << ", \"threads\": " << r.get_threads()
+          << ", \"best_ms\": " << r.get_best() << ", \"mean_ms\": " << r.get_mean() << ", \"cells\": " << r.get_cells() << "}"
+          << ((i + 1 < size) ? "," : "") << std::endl;
+    }
+    s << "  ]" << std::endl;
+    s << "}" << std::endl;
+}
+
+// Times the generation kernels without a window, writes a json or csv report
+int main(int argc, char *argv[])
+{
+    // Check arguments
+    if (argc < 2)
+    {
+        std::cout << "usage: bench <report.json | report.csv> [grid sizes]" << std::endl;
+        return -1;
+    }
+
+    try
+    {
+        // Grid sizes to run, powers of two
+        std::vector<size_t> scales;
+        for (int i = 2; i < argc; i++)
+        {
+            scales.push_back(std::stoul(argv[i]));
+        }
+        if (scales.empty())
+        {
+            scales = {64, 128};
+        }
+
+        // Powers of two threads up to all cores
+        const unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+        std::vector<unsigned> threads;
+        for (unsigned t = 1; t < cores; t *= 2)
+        {
+            threads.push_back(t);
+        }
+        threads.push_back(cores);
+
+        // Run every kernel at every size and thread count
+        std::vector<bench_result> results;
+        for (const size_t scale : scales)
+        {
+            for (const unsigned t : threads)
+            {
+                bench_kernels(results, scale, t);
+            }
+
+            // Fused world pipeline through the generator
+            bench_world(results, scale);
+        }
+
+        // Write the report, format from the file extension
+        const std::string file = argv[1];
+        std::ofstream report(file);
+        if (!report.is_open())
+        {
+            std::cout << "bench: could not open report '" << file << "'" << std::endl;
+            return -1;
+        }
+        const bool csv = file.size() >= 4 && file.compare(file.size() - 4, 4, ".csv") == 0;
+        if (csv)
+        {
+            write_csv(report, results);
+        }
+        else
+        {
+            write_json(report, results);
+        }
+        std::cout << "bench: wrote " << results.size() << " results to '" << file << "'" << std::endl;
+    }
+    catch (std::exception &ex)
+    {
+        std::cout << ex.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
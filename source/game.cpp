@@ -231,6 +231,42 @@ int main(int argc, char *argv[])
                 parse_uint(argv[i], parse);
                 opt.set_mode(static_cast<uint_fast8_t>(parse));
             }
+            else if (input.compare("-seed") == 0)
+            {
+                // Parse uint
+                parse_uint(argv[i], parse);
+                opt.set_seed(parse);
+            }
+            else if (input.compare("-chests") == 0)
+            {
+                // Parse uint
+                parse_uint(argv[i], parse);
+                opt.set_chests(parse);
+            }
+            else if (input.compare("-drones") == 0)
+            {
+                // Parse uint
+                parse_uint(argv[i], parse);
+                opt.set_drones(parse);
+            }
+            else if (input.compare("-drops") == 0)
+            {
+                // Parse uint
+                parse_uint(argv[i], parse);
+                opt.set_drops(parse);
+            }
+            else if (input.compare("-explosives") == 0)
+            {
+                // Parse uint
+                parse_uint(argv[i], parse);
+                opt.set_explosives(parse);
+            }
+            else if (input.compare("-missiles") == 0)
+            {
+                // Parse uint
+                parse_uint(argv[i], parse);
+                opt.set_missiles(parse);
+            }
             else
             {
                 std::cout << "bds: unknown flag '"
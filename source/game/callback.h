@@ -20,6 +20,7 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <functional>
 #include <game/id.h>
+#include <min/aabbox.h>
 #include <min/physics_nt.h>
 #include <min/vec3.h>
 
@@ -31,6 +32,7 @@ static constexpr float _grav_mag = 10.0;
 static constexpr size_t _physics_frames = 180;
 
 // Callbacks
+typedef std::function<min::aabbox<float, min::vec3>(const min::body<float, min::vec3> &)> box_call;
 typedef std::function<void(min::body<float, min::vec3> &, min::body<float, min::vec3> &)> coll_call;
 typedef std::function<std::pair<float, float>(const float, const float, const block_id)> dmg_call;
 typedef std::function<void(const min::vec3<float> &, const bool, const block_id)> sound_call;
@@ -18,12 +18,18 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef __CHUNK_GRID__
 #define __CHUNK_GRID__
 
+#include <algorithm>
+#include <array>
 #include <chrono>
 #include <game/callback.h>
 #include <game/cgrid_generator.h>
 #include <game/file.h>
+#include <game/flow_field.h>
+#include <game/gen_pipeline.h>
 #include <game/id.h>
+#include <game/path_queue.h>
 #include <game/swatch.h>
+#include <game/voxel_contact.h>
 #include <min/aabbox.h>
 #include <min/camera.h>
 #include <min/intersect.h>
@@ -31,6 +37,7 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #include <min/ray.h>
 #include <min/serial.h>
 #include <min/utility.h>
+#include <limits>
 #include <stdexcept>
 
 namespace game
@@ -66,25 +73,72 @@ class view_chunk
     }
 };
 
+class trace_hit
+{
+  private:
+    bool _valid;
+    size_t _prev_key;
+    size_t _key;
+    block_id _value;
+    min::vec3<float> _point;
+
+  public:
+    trace_hit(const bool valid, const size_t prev_key, const size_t key, const block_id value, const min::vec3<float> &point)
+        : _valid(valid), _prev_key(prev_key), _key(key), _value(value), _point(point) {}
+
+    const min::vec3<float> &get_point() const
+    {
+        return _point;
+    }
+    size_t get_key() const
+    {
+        return _key;
+    }
+    size_t get_prev_key() const
+    {
+        return _prev_key;
+    }
+    block_id get_value() const
+    {
+        return _value;
+    }
+    bool is_valid() const
+    {
+        return _valid;
+    }
+};
+
 class cgrid
 {
   private:
-    constexpr static size_t _search_limit = 20;
+    constexpr static size_t _brick_size = 4;
+    constexpr static size_t _flow_radius = 2;
+    constexpr static size_t _flow_budget = 8192;
+    constexpr static size_t _stale_budget = 4;
+    constexpr static size_t _gen_budget = 8;
     const size_t _grid_scale;
     std::vector<block_id> _grid;
-    std::vector<int_fast8_t> _visit;
-    std::vector<std::pair<size_t, float>> _neighbors;
-    std::vector<size_t> _path;
-    std::vector<size_t> _stack;
+    path_queue _path_queue;
+    flow_field _flow;
     const size_t _chunk_cells;
     const size_t _chunk_size;
     const size_t _chunk_scale;
+    const size_t _brick_scale;
+    std::vector<uint8_t> _brick_fill;
+    std::vector<uint32_t> _chunk_fill;
     std::vector<min::mesh<float, uint32_t>> _chunks;
-    std::vector<bool> _chunk_update;
+    std::vector<size_t> _chunk_changed;
     std::vector<size_t> _chunk_update_keys;
+    std::vector<bool> _chunk_stale;
+    size_t _stale_next;
+    std::vector<bool> _chunk_gen;
+    std::vector<size_t> _gen_keys;
+    std::vector<gen_tile> _gen_tiles;
+    size_t _gen_prev;
+    min::vec3<float> _gen_dir;
     std::vector<size_t> _sort_chunk;
     std::vector<view_chunk> _view_chunks;
-    mutable std::vector<size_t> _overlap;
+    std::vector<min::vec3<float>> _path_points;
     size_t _recent_chunk;
     min::vec3<float> _recent_p;
     const size_t _view_chunk_size;
@@ -92,7 +146,9 @@ class cgrid
     const float _view_dist;
     const min::aabbox<float, min::vec3> _world;
     const min::vec3<float> _cell_extent;
+    const voxel_contact _contact;
     cgrid_generator _generator;
+    bool _portal;
 
     static inline bool in_x(const min::vec3<float> &p, const min::vec3<float> &min, const min::vec3<float> &max)
     {
@@ -130,30 +186,6 @@ class cgrid
         // Return world size
         return min::aabbox<float, min::vec3>(minv, maxv);
     }
-    inline void collision_cells(std::vector<std::pair<min::aabbox<float, min::vec3>, block_id>> &out,
-                                const min::aabbox<float, min::vec3> &box, const min::vec3<float> &center) const
-    {
-        // Get all overlapping cells
-        min::vec3<float>::grid_overlap(_overlap, _world.get_min(), _cell_extent, _grid_scale, box.get_min(), box.get_max());
-
-        // Create boxes of all overlapping cells
-        const size_t size = _overlap.size();
-        for (size_t i = 0; i < size; i++)
-        {
-            // Get the cell key
-            const size_t key = _overlap[i];
-
-            // Check if valid and if the cell is not empty
-            if (_grid[key] != block_id::EMPTY)
-            {
-                // Create box at this point
-                const min::aabbox<float, min::vec3> grid = grid_box(grid_cell_center(key));
-
-                // Add box and grid value to
-                out.emplace_back(grid, _grid[key]);
-            }
-        }
-    }
     inline void cubic(const min::vec3<float> &start, const min::vec3<unsigned> &length, const min::vec3<int> &offset,
                       const std::function<void(const min::vec3<float> &)> &f) const
     {
@@ -341,10 +373,267 @@ class cgrid
     {
         return grid_cell(key) + 0.5;
     }
+    inline size_t brick_key(const std::array<size_t, 3> &index) const
+    {
+        // Convert grid components to brick components
+        const size_t bx = index[0] / _brick_size;
+        const size_t by = index[1] / _brick_size;
+        const size_t bz = index[2] / _brick_size;
+
+        // Return the brick key
+        return (bx * _brick_scale * _brick_scale) + (by * _brick_scale) + bz;
+    }
+    inline size_t chunk_key_index(const std::array<size_t, 3> &index) const
+    {
+        // Convert grid components to chunk components
+        const size_t cx = index[0] / _chunk_size;
+        const size_t cy = index[1] / _chunk_size;
+        const size_t cz = index[2] / _chunk_size;
+
+        // Return the chunk key
+        return (cx * _chunk_scale * _chunk_scale) + (cy * _chunk_scale) + cz;
+    }
+    inline std::array<size_t, 3> grid_index_unpack(const size_t key) const
+    {
+        const std::tuple<size_t, size_t, size_t> comp = grid_key_unpack(key);
+
+        // Convert tuple to array for indexing by axis
+        return {std::get<0>(comp), std::get<1>(comp), std::get<2>(comp)};
+    }
+    inline size_t grid_index_pack(const std::array<size_t, 3> &index) const
+    {
+        return grid_key_pack(std::make_tuple(index[0], index[1], index[2]));
+    }
+    inline void occupancy_build()
+    {
+        // Clear all occupancy counts
+        std::fill(_brick_fill.begin(), _brick_fill.end(), 0);
+        std::fill(_chunk_fill.begin(), _chunk_fill.end(), 0);
+
+        // Count all populated cells in each brick and chunk
+        const size_t size = _grid.size();
+        for (size_t i = 0; i < size; i++)
+        {
+            if (_grid[i] != block_id::EMPTY)
+            {
+                const std::array<size_t, 3> index = grid_index_unpack(i);
+                _brick_fill[brick_key(index)]++;
+                _chunk_fill[chunk_key_index(index)]++;
+            }
+        }
+    }
+    inline void occupancy_chunk(const size_t chunk_key)
+    {
+        // Count populated cells in a freshly generated chunk
+        const auto f = [this](const size_t i, const size_t j, const size_t k, const size_t key) {
+            if (_grid[key] != block_id::EMPTY)
+            {
+                const std::array<size_t, 3> index = grid_index_unpack(key);
+                _brick_fill[brick_key(index)]++;
+                _chunk_fill[chunk_key_index(index)]++;
+            }
+        };
+
+        // Run the function over the chunk cells
+        const min::vec3<float> start = chunk_start(chunk_key);
+        const min::vec3<unsigned> length(_chunk_size, _chunk_size, _chunk_size);
+        const min::vec3<int> offset(1, 1, 1);
+        cubic_grid(start, length, offset, f);
+    }
+    inline void occupancy_update(const size_t key, const block_id old_value, const block_id value)
+    {
+        // Only track changes between empty and populated
+        const bool was_empty = (old_value == block_id::EMPTY);
+        const bool is_empty = (value == block_id::EMPTY);
+        if (was_empty != is_empty)
+        {
+            const std::array<size_t, 3> index = grid_index_unpack(key);
+            const size_t bkey = brick_key(index);
+            const size_t ckey = chunk_key_index(index);
+
+            // Update the brick and chunk counts
+            if (is_empty)
+            {
+                _brick_fill[bkey]--;
+                _chunk_fill[ckey]--;
+            }
+            else
+            {
+                _brick_fill[bkey]++;
+                _chunk_fill[ckey]++;
+            }
+        }
+    }
+    inline void chunk_stale_flush()
+    {
+        // Remesh stale chunks as soon as they come into view
+        for (const view_chunk &vc : _view_chunks)
+        {
+            if (_chunk_stale[vc.get_key()])
+            {
+                chunk_update(vc.get_key());
+            }
+        }
+
+        // Remesh a few more stale chunks each frame
+        const size_t chunks = _chunks.size();
+        for (size_t i = 0; i < _stale_budget && _stale_next < chunks; _stale_next++)
+        {
+            if (_chunk_stale[_stale_next])
+            {
+                chunk_update(_stale_next);
+                i++;
+            }
+        }
+    }
+    inline gen_tile chunk_tile(const size_t chunk_key) const
+    {
+        // Box of grid cells inside this chunk
+        const std::tuple<size_t, size_t, size_t> comp = chunk_key_unpack(chunk_key);
+        const size_t x = std::get<0>(comp) * _chunk_size;
+        const size_t y = std::get<1>(comp) * _chunk_size;
+        const size_t z = std::get<2>(comp) * _chunk_size;
+
+        return gen_tile(x, x + _chunk_size, y, y + _chunk_size, z, z + _chunk_size);
+    }
+    inline void chunk_generate(const std::vector<size_t> &keys)
+    {
+        if (keys.size() == 0)
+        {
+            return;
+        }
+
+        // Generate the chunk cells in parallel
+        _gen_tiles.clear();
+        for (const size_t k : keys)
+        {
+            _gen_tiles.push_back(chunk_tile(k));
+        }
+        _generator.generate_chunks(_grid, _gen_tiles);
+
+        // Chunk neighbor steps along each axis
+        const size_t steps[3] = {_chunk_scale * _chunk_scale, _chunk_scale, 1};
+        for (const size_t k : keys)
+        {
+            _chunk_gen[k] = true;
+
+            // Count occupied cells for ray skipping
+            occupancy_chunk(k);
+
+            // Rebuild path regions and the flow field over this chunk
+            _path_queue.update(k);
+            _flow.update(k, _chunk_scale);
+
+            // Remesh this chunk and its generated neighbors, their faces may now be hidden
+            _chunk_stale[k] = true;
+            const std::tuple<size_t, size_t, size_t> comp = chunk_key_unpack(k);
+            const size_t c[3] = {std::get<0>(comp), std::get<1>(comp), std::get<2>(comp)};
+            for (size_t i = 0; i < 3; i++)
+            {
+                if (c[i] > 0 && _chunk_gen[k - steps[i]])
+                {
+                    _chunk_stale[k - steps[i]] = true;
+                }
+                if (c[i] < _chunk_scale - 1 && _chunk_gen[k + steps[i]])
+                {
+                    _chunk_stale[k + steps[i]] = true;
+                }
+            }
+        }
+    }
+    inline void chunk_generate_ahead()
+    {
+        // Track the direction of motion between chunks
+        if (_gen_prev != _recent_chunk)
+        {
+            _gen_dir = chunk_center(_recent_chunk) - chunk_center(_gen_prev);
+            _gen_prev = _recent_chunk;
+        }
+
+        // Chunks within one chunk past the view must exist before they are seen
+        const std::tuple<size_t, size_t, size_t> comp = chunk_key_unpack(_recent_chunk);
+        const size_t c[3] = {std::get<0>(comp), std::get<1>(comp), std::get<2>(comp)};
+        const size_t radius = _view_half_width + 1;
+        size_t lo[3];
+        size_t hi[3];
+        for (size_t i = 0; i < 3; i++)
+        {
+            lo[i] = (c[i] > radius) ? c[i] - radius : 0;
+            hi[i] = std::min(c[i] + radius + 1, _chunk_scale);
+        }
+
+        // Find all missing chunks
+        _gen_keys.clear();
+        for (size_t x = lo[0]; x < hi[0]; x++)
+        {
+            for (size_t y = lo[1]; y < hi[1]; y++)
+            {
+                for (size_t z = lo[2]; z < hi[2]; z++)
+                {
+                    const size_t key = (x * _chunk_scale * _chunk_scale) + (y * _chunk_scale) + z;
+                    if (!_chunk_gen[key])
+                    {
+                        _gen_keys.push_back(key);
+                    }
+                }
+            }
+        }
+
+        // Is this chunk inside the view cube
+        const auto in_view = [this, &c](const size_t key) -> bool {
+            const std::tuple<size_t, size_t, size_t> k = chunk_key_unpack(key);
+            const size_t kc[3] = {std::get<0>(k), std::get<1>(k), std::get<2>(k)};
+            for (size_t i = 0; i < 3; i++)
+            {
+                const size_t d = (kc[i] > c[i]) ? kc[i] - c[i] : c[i] - kc[i];
+                if (d > _view_half_width)
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        };
+
+        // Visible chunks first, then by distance to a point ahead of the player
+        const min::vec3<float> ahead = chunk_center(_recent_chunk) + _gen_dir * _view_half_width;
+        const auto dist = [this, &ahead](const size_t key) -> float {
+            const min::vec3<float> d = chunk_center(key) - ahead;
+            return d.dot(d);
+        };
+        const auto first = std::partition(_gen_keys.begin(), _gen_keys.end(), in_view);
+        std::sort(first, _gen_keys.end(), [&dist](const size_t a, const size_t b) {
+            return dist(a) < dist(b);
+        });
+
+        // Visible chunks always generate, the outer ring is budgeted per frame
+        const size_t required = first - _gen_keys.begin();
+        _gen_keys.resize(std::min(_gen_keys.size(), required + _gen_budget));
+        chunk_generate(_gen_keys);
+    }
+    inline void chunk_ensure(const min::vec3<float> &start, const min::vec3<unsigned> &length, const min::vec3<int> &offset)
+    {
+        // Find chunks an edit touches that are not generated yet
+        _gen_keys.clear();
+        const auto f = [this](const size_t i, const size_t j, const size_t k, const size_t key) {
+            const size_t ckey = chunk_key_index(grid_index_unpack(key));
+            if (!_chunk_gen[ckey])
+            {
+                _gen_keys.push_back(ckey);
+            }
+        };
+        cubic_grid(start, length, offset, f);
+
+        // Generate them before any cell is read, so the edit isn't overwritten
+        std::sort(_gen_keys.begin(), _gen_keys.end());
+        _gen_keys.erase(std::unique(_gen_keys.begin(), _gen_keys.end()), _gen_keys.end());
+        chunk_generate(_gen_keys);
+    }
     inline void chunk_update(const size_t chunk_key)
     {
         // Clear this chunk
         _chunks[chunk_key].clear();
+        _chunk_stale[chunk_key] = false;
 
         // Create cubic function, for each cell in cubic space
         const auto f = [this, chunk_key](const size_t i, const size_t j, const size_t k, const size_t key) {
@@ -392,8 +681,8 @@ class cgrid
             }
         };
 
-        // Flag that the chunk needs to be updated
-        _chunk_update[chunk_key] = true;
+        // Queue the chunk for upload on the render thread
+        _chunk_changed.push_back(chunk_key);
 
         // Get cubic function properties
         const min::vec3<float> start = chunk_start(chunk_key);
@@ -426,7 +715,8 @@ class cgrid
             }
         };
 
-        // Run the function
+        // Run the function on generated chunks
+        chunk_ensure(start, length, offset);
         cubic_grid(start, length, offset, f);
 
         // Return count
@@ -456,7 +746,8 @@ class cgrid
             }
         };
 
-        // Run the function
+        // Run the function on generated chunks
+        chunk_ensure(start, length, offset);
         cubic_grid(start, length, offset, f);
 
         // Return count
@@ -492,7 +783,8 @@ class cgrid
             }
         };
 
-        // Run the function
+        // Run the function on generated chunks
+        chunk_ensure(start, length, offset);
         cubic_grid(start, length, offset, f);
 
         // Return count
@@ -505,49 +797,33 @@ class cgrid
         const size_t ckey = chunk_key_unsafe(p);
         _chunk_update_keys.push_back(ckey);
 
+        // Update the occupancy counts for ray skipping
+        occupancy_update(key, _grid[key], value);
+
         // Set the cell with value
         _grid[key] = value;
 
         // Return position
         return p;
     }
-    inline void generate_portal()
+    inline bool generate_portal()
     {
-        // Function for finding grid key index
-        const auto f = [this](const std::tuple<size_t, size_t, size_t> &t) -> size_t {
-            return grid_key_pack(t);
-        };
-
-        // Function for finding grid center
+        // Function for finding grid center, only reads constant members
         const auto g = [this](const size_t key) -> min::vec3<float> {
             return grid_cell_center(key);
         };
 
-        // Generate the cgrid data
-        _generator.generate_portal(_grid, _grid_scale, _chunk_size, f, g);
+        // Generate the cgrid data in the background
+        return _generator.launch_portal(_grid_scale, g);
     }
     inline void generate_world()
     {
-        // Function for finding grid key index
-        const auto f = [this](const std::tuple<size_t, size_t, size_t> &t) -> size_t {
-            return grid_key_pack(t);
-        };
-
-        // Function for finding grid center
-        const auto g = [this](const size_t key) -> min::vec3<float> {
-            return grid_cell_center(key);
-        };
+        // Load a cached world whole, or generate chunks as they come near
+        const bool cached = _generator.create_world(_grid, _grid_scale, _chunk_size);
+        std::fill(_chunk_gen.begin(), _chunk_gen.end(), cached);
 
-        // Generate the cgrid data
-        _generator.generate_world(_grid, _grid_scale, _chunk_size, f, g);
-    }
-    inline float grid_center_square_dist(const size_t key, const min::vec3<float> &point) const
-    {
-        // Calculate vector between points
-        const min::vec3<float> dv = grid_cell_center(key) - point;
-
-        // Calculate the square distance to this point
-        return dv.dot(dv);
+        // Keep the untouched world for the next reset, in the background
+        _generator.cache_world();
     }
     inline bool inside(const min::vec3<float> &p) const
     {
@@ -556,217 +832,200 @@ class cgrid
 
         return in_x(p, min, max) && in_y(p, min, max) && in_z(p, min, max);
     }
-    inline bool ray_trace(const min::ray<float, min::vec3> &r, const size_t length, size_t &prev_key, size_t &key, block_id &value) const
+    inline size_t ray_skip(std::array<size_t, 3> &index, std::array<float, 3> &t_max, const std::array<int, 3> &step,
+                           const std::array<float, 3> &t_delta, const size_t region, const size_t remain, size_t &prev_key, bool &bad_flag) const
     {
-        // Calculate the ray trajectory for tracing in grid
-        auto grid_ray = min::vec3<float>::grid_ray(_cell_extent, r.get_origin(), r.get_direction(), r.get_inverse());
-
-        // Calculate start point in grid index format
-        auto index = min::vec3<float>::grid_index(_world.get_min(), _cell_extent, r.get_origin());
+        // Cells on the world edge are never skipped to preserve the bad flag
+        const size_t edge = _grid_scale - 1;
 
-        // Trace a ray from origin and stop at first populated cell
-        bool is_valid = true;
-        prev_key = key = grid_key_safe(r.get_origin(), is_valid);
-        if (is_valid)
+        // Find the axis where the ray leaves the empty region first
+        std::array<size_t, 3> cross;
+        size_t axis = 0;
+        float t_exit = std::numeric_limits<float>::max();
+        for (size_t i = 0; i < 3; i++)
         {
-            // bad flag signals that we have hit the last valid cell
-            bool bad_flag = false;
-            unsigned count = 0;
-            while (_grid[key] == block_id::EMPTY && !bad_flag && count < length)
+            // Region bounds on this axis, clamped inside the world edge
+            const size_t start = (index[i] / region) * region;
+            const size_t low = std::max<size_t>(start, 1);
+            const size_t high = std::min<size_t>(start + region - 1, edge - 1);
+            if (index[i] < low || index[i] > high)
             {
-                // Update the previous key
-                prev_key = key;
-
-                // Increment the current key
-                key = min::vec3<float>::grid_ray_next(index, grid_ray, bad_flag, _grid_scale);
-                count++;
+                return 0;
             }
 
-            // return the stopping cell value
-            value = _grid[key];
-        }
-
-        return is_valid;
-    }
-    inline void reserve_memory()
-    {
-        _path.reserve(20);
-        _neighbors.reserve(6);
-        _stack.reserve(100);
-        _sort_chunk.reserve(27);
-        _view_chunks.reserve(27);
-    }
-    inline void search(const min::vec3<float> &start, const min::vec3<float> &stop)
-    {
-        // Get grid keys
-        bool is_valid = true;
-        const size_t start_key = grid_key_safe(start, is_valid);
-        const size_t stop_key = grid_key_safe(stop, is_valid);
-
-        // If points are not in grid
-        if (!is_valid)
-        {
-            return;
-        }
-
-        // Clear the old neighbors
-        _neighbors.clear();
-
-        // Clear the old path
-        _path.clear();
-
-        // Clear the old stack
-        _stack.clear();
-
-        // If the start key is inside terrain
-        if (_grid[start_key] != block_id::EMPTY)
-        {
-            return;
-        }
-
-        // Reset the visited flag
-        std::fill(_visit.begin(), _visit.end(), -1);
-
-        // If we need to search
-        if (start_key != stop_key)
-        {
-            // Push the start_key on the stack
-            _stack.push_back(start_key);
-
-            // Flag that we pushed this key
-            _visit[start_key] = 1;
-
-            // Iteratively Search for a path
-            while (!_stack.empty())
+            // Number of cell crossings to leave region on this axis
+            cross[i] = (step[i] > 0) ? high - index[i] + 1 : index[i] - low + 1;
+            if (step[i] != 0)
             {
-                const bool found = search_next(stop, stop_key);
-                if (found)
+                const float t = t_max[i] + (cross[i] - 1) * t_delta[i];
+                if (t < t_exit)
                 {
-                    break;
+                    t_exit = t;
+                    axis = i;
                 }
             }
         }
-    }
-    inline void search_neighbors(const std::tuple<size_t, size_t, size_t> &comp, const min::vec3<float> &stop)
-    {
-        // Clear neighbors buffer
-        _neighbors.clear();
 
-        // Unpack start_key to components
-        const size_t x = std::get<0>(comp);
-        const size_t y = std::get<1>(comp);
-        const size_t z = std::get<2>(comp);
-
-        // Check against lower x grid dimensions
-        const size_t edge = _grid_scale - 1;
-        if (x != 0)
+        // Count crossings on other axes before leaving the region
+        size_t steps = 0;
+        for (size_t i = 0; i < 3; i++)
         {
-            const size_t nxk = min::vec3<float>::grid_key(std::make_tuple(x - 1, y, z), _grid_scale);
-            _neighbors.push_back({nxk, grid_center_square_dist(nxk, stop)});
-        }
+            if (i != axis)
+            {
+                if (step[i] == 0 || t_max[i] >= t_exit)
+                {
+                    cross[i] = 0;
+                }
+                else
+                {
+                    const size_t n = static_cast<size_t>((t_exit - t_max[i]) / t_delta[i]) + 1;
+                    cross[i] = std::min(n, cross[i] - 1);
+                }
+            }
 
-        // Check against upper x grid dimensions
-        if (x != edge)
-        {
-            const size_t pxk = min::vec3<float>::grid_key(std::make_tuple(x + 1, y, z), _grid_scale);
-            _neighbors.push_back({pxk, grid_center_square_dist(pxk, stop)});
+            steps += cross[i];
         }
 
-        // Check against lower y grid dimensions
-        if (y != 0)
+        // Single steps are not worth skipping, and we can't exceed the ray length
+        if (steps < 2 || steps > remain)
         {
-            const size_t nyk = min::vec3<float>::grid_key(std::make_tuple(x, y - 1, z), _grid_scale);
-            _neighbors.push_back({nyk, grid_center_square_dist(nyk, stop)});
+            return 0;
         }
 
-        // Check against upper y grid dimensions
-        if (y != edge)
+        // Jump to the first cell outside the region
+        for (size_t i = 0; i < 3; i++)
         {
-            const size_t pyk = min::vec3<float>::grid_key(std::make_tuple(x, y + 1, z), _grid_scale);
-            _neighbors.push_back({pyk, grid_center_square_dist(pyk, stop)});
+            index[i] = (step[i] > 0) ? index[i] + cross[i] : index[i] - cross[i];
+            t_max[i] += cross[i] * t_delta[i];
         }
 
-        // Check against lower z grid dimensions
-        if (z != 0)
-        {
-            const size_t nzk = min::vec3<float>::grid_key(std::make_tuple(x, y, z - 1), _grid_scale);
-            _neighbors.push_back({nzk, grid_center_square_dist(nzk, stop)});
-        }
+        // The previous cell is one step back along the exit axis
+        std::array<size_t, 3> prev = index;
+        prev[axis] = (step[axis] > 0) ? prev[axis] - 1 : prev[axis] + 1;
+        prev_key = grid_index_pack(prev);
 
-        // Check against upper z grid dimensions
-        if (z != edge)
-        {
-            const size_t pzk = min::vec3<float>::grid_key(std::make_tuple(x, y, z + 1), _grid_scale);
-            _neighbors.push_back({pzk, grid_center_square_dist(pzk, stop)});
-        }
+        // Check if we landed on the world edge
+        bad_flag = (index[axis] == 0 || index[axis] == edge);
 
-        // lambda function to create sorted array indices based on distance
-        std::sort(_neighbors.begin(), _neighbors.end(), [](const std::pair<size_t, float> &a, const std::pair<size_t, float> &b) {
-            return a.second > b.second;
-        });
+        // Return number of cells skipped
+        return steps;
     }
-    inline bool search_next(const min::vec3<float> &stop, const size_t stop_key)
+    inline bool ray_trace(const min::ray<float, min::vec3> &r, const size_t length, size_t &prev_key, size_t &key, block_id &value) const
     {
-        // Check if stack is empty to avoid stomping the stack
-        if (_stack.size() == 0)
-        {
-            return true;
-        }
-        else if (_path.size() > _search_limit)
+        // Trace a ray from origin and stop at first populated cell
+        bool is_valid = true;
+        prev_key = key = grid_key_safe(r.get_origin(), is_valid);
+        if (is_valid)
         {
-            return true;
-        }
-
-        // Get element on top of stack
-        const size_t key = _stack.back();
+            // Calculate start point in grid index format
+            std::array<size_t, 3> index = grid_index_unpack(key);
+
+            // Calculate the ray trajectory for tracing in grid
+            const min::vec3<float> &o = r.get_origin();
+            const min::vec3<float> &dir = r.get_direction();
+            const min::vec3<float> cell = grid_cell(key);
+            const std::array<float, 3> origin = {o.x(), o.y(), o.z()};
+            const std::array<float, 3> d = {dir.x(), dir.y(), dir.z()};
+            const std::array<float, 3> low = {cell.x(), cell.y(), cell.z()};
+            std::array<int, 3> step;
+            std::array<float, 3> t_max;
+            std::array<float, 3> t_delta;
+            for (size_t i = 0; i < 3; i++)
+            {
+                // Parallel axes never cross a cell boundary
+                if (std::abs(d[i]) < 1E-7)
+                {
+                    step[i] = 0;
+                    t_max[i] = std::numeric_limits<float>::max();
+                    t_delta[i] = std::numeric_limits<float>::max();
+                }
+                else
+                {
+                    // Distance to the next cell boundary along this axis
+                    step[i] = (d[i] > 0.0) ? 1 : -1;
+                    const float boundary = (d[i] > 0.0) ? low[i] + 1.0 : low[i];
+                    t_max[i] = (boundary - origin[i]) / d[i];
+                    t_delta[i] = std::abs(1.0 / d[i]);
+                }
+            }
 
-        // Check if we made it to the mother lands!
-        if (key == stop_key)
-        {
-            // Store end point of path
-            _path.push_back(key);
+            // bad flag signals that we have hit the last valid cell
+            const size_t edge = _grid_scale - 1;
+            bool bad_flag = (step[0] == 0 && step[1] == 0 && step[2] == 0);
+            bool new_brick = true;
+            size_t count = 0;
+            while (_grid[key] == block_id::EMPTY && !bad_flag && count < length)
+            {
+                // Try to skip an empty chunk, then an empty brick, when entering a brick
+                if (new_brick)
+                {
+                    const size_t remain = length - count;
+                    size_t skip = 0;
+                    if (_chunk_fill[chunk_key_index(index)] == 0)
+                    {
+                        skip = ray_skip(index, t_max, step, t_delta, _chunk_size, remain, prev_key, bad_flag);
+                    }
+                    if (skip == 0 && _brick_fill[brick_key(index)] == 0)
+                    {
+                        skip = ray_skip(index, t_max, step, t_delta, _brick_size, remain, prev_key, bad_flag);
+                    }
 
-            // Stop searching
-            return true;
-        }
-        else if (_visit[key] == 1)
-        {
-            // If we haven't seen this node yet, we are traversing
-            _path.push_back(key);
+                    // If we skipped cells, continue from the landing cell
+                    new_brick = (skip > 0);
+                    if (new_brick)
+                    {
+                        key = grid_index_pack(index);
+                        count += skip;
+                        continue;
+                    }
+                }
 
-            // Visit this node
-            _visit[key] = 0;
+                // Choose the axis with the nearest cell boundary
+                const size_t axis = (t_max[0] <= t_max[1] && t_max[0] <= t_max[2]) ? 0 : (t_max[1] <= t_max[2]) ? 1 : 2;
 
-            // Search along the gradient until we hit a wall
-            const std::tuple<size_t, size_t, size_t> comp = grid_key_unpack(key);
+                // Stop if we would step outside the grid
+                if ((step[axis] < 0 && index[axis] == 0) || (step[axis] > 0 && index[axis] == edge))
+                {
+                    bad_flag = true;
+                    continue;
+                }
 
-            // Search all neighboring cells
-            search_neighbors(comp, stop);
+                // Update the previous key
+                prev_key = key;
 
-            for (const auto &n : _neighbors)
-            {
-                // If we haven't visited the neighbor cell, and it isn't a wall
-                if (_visit[n.first] == -1 && _grid[n.first] == block_id::EMPTY)
-                {
-                    // Flag that we pushed this key to prevent duplicates on stack
-                    _visit[n.first] = 1;
+                // Increment the current key
+                index[axis] += step[axis];
+                t_max[axis] += t_delta[axis];
+                key = grid_index_pack(index);
+                bad_flag = (index[axis] == 0 || index[axis] == edge);
+                count++;
 
-                    // Calculate distance to destination
-                    _stack.push_back(n.first);
-                }
+                // Check if we crossed into a new brick
+                const size_t brick_cell = index[axis] % _brick_size;
+                new_brick = (step[axis] > 0) ? brick_cell == 0 : brick_cell == _brick_size - 1;
             }
-        }
-        else if (_visit[key] == 0)
-        {
-            // If we already visited this node, we must be unwinding so pop stack
-            _stack.pop_back();
 
-            // Every time we visit we push so we must pop here
-            _path.pop_back();
+            // return the stopping cell value
+            value = _grid[key];
         }
 
-        // Keepp looking for a path
-        return false;
+        return is_valid;
+    }
+    inline void reserve_memory()
+    {
+        _sort_chunk.reserve(27);
+        _view_chunks.reserve(27);
+        _path_points.reserve(100);
+    }
+    inline bool search_keys(const min::vec3<float> &start, const min::vec3<float> &stop, size_t &start_key, size_t &stop_key) const
+    {
+        // Get grid keys
+        bool is_valid = true;
+        start_key = grid_key_safe(start, is_valid);
+        stop_key = grid_key_safe(stop, is_valid);
+
+        // If points are not in grid
+        return is_valid;
     }
     inline void world_load()
     {
@@ -783,12 +1042,33 @@ class cgrid
             size_t next = 0;
             const std::vector<block_id> grid = min::read_le_vector<block_id>(stream, next);
 
+            // Chunk flags follow the grid, older saves without them are fully generated
+            std::vector<uint8_t> gen;
+            if (next < stream.size())
+            {
+                gen = min::read_le_vector<uint8_t>(stream, next);
+            }
+
             // Check that grid load correctly
             const size_t cubic_size = _grid_scale * _grid_scale * _grid_scale;
-            if (grid.size() == cubic_size)
+            const size_t chunks = _chunks.size();
+            if (grid.size() == cubic_size && (gen.size() == 0 || gen.size() == chunks))
             {
                 // Copy grid from file
                 _grid = grid;
+                bool all = true;
+                for (size_t i = 0; i < chunks; i++)
+                {
+                    _chunk_gen[i] = (gen.size() == 0) || (gen[i] != 0);
+                    all &= _chunk_gen[i];
+                }
+
+                // Chunks never visited are generated on demand again
+                if (!all)
+                {
+                    _generator.resume_world(_grid_scale, _chunk_size);
+                    _generator.cache_world();
+                }
             }
             else
             {
@@ -802,12 +1082,32 @@ class cgrid
             generate_world();
         }
 
-        // Reserve and update all chunks
+        // Count occupied cells for ray skipping
+        occupancy_build();
+
+        // Invalidate all path regions and the flow field
+        _path_queue.clear();
+        _flow.clear();
+
+        // Drop any pending portal, the loaded world replaces it
+        _portal = false;
+        _stale_next = _chunks.size();
+
+        // Reserve and update all generated chunks, empty the rest
         const size_t chunks = _chunks.size();
         for (size_t i = 0; i < chunks; i++)
         {
             chunk_warm(i);
-            chunk_update(i);
+            if (_chunk_gen[i])
+            {
+                chunk_update(i);
+            }
+            else
+            {
+                _chunks[i].clear();
+                _chunk_stale[i] = false;
+                _chunk_changed.push_back(i);
+            }
         }
     }
 
@@ -815,22 +1115,32 @@ class cgrid
     constexpr static float _player_dx = 0.45;
     constexpr static float _player_dy = 0.95;
     constexpr static float _player_dz = 0.45;
-    cgrid(const size_t chunk_size, const size_t grid_scale, const size_t view_chunk_size)
+    cgrid(const size_t chunk_size, const size_t grid_scale, const size_t view_chunk_size, const uint64_t seed, const bool seeded)
         : _grid_scale(grid_scale * 2),
           _grid(_grid_scale * _grid_scale * _grid_scale, block_id::EMPTY),
-          _visit(_grid.size(), -1),
+          _path_queue(_grid, _grid_scale, chunk_size),
+          _flow(_grid_scale, chunk_size, _flow_radius, _flow_budget),
           _chunk_cells(chunk_size * chunk_size * chunk_size),
           _chunk_size(chunk_size),
           _chunk_scale(_grid_scale / _chunk_size),
+          _brick_scale((_grid_scale + _brick_size - 1) / _brick_size),
+          _brick_fill(_brick_scale * _brick_scale * _brick_scale, 0),
+          _chunk_fill(_chunk_scale * _chunk_scale * _chunk_scale, 0),
           _chunks(_chunk_scale * _chunk_scale * _chunk_scale, min::mesh<float, uint32_t>("chunk")),
-          _chunk_update(_chunks.size(), true),
+          _chunk_stale(_chunks.size(), false),
+          _stale_next(_chunks.size()),
+          _chunk_gen(_chunks.size(), false),
+          _gen_prev(0),
+          _gen_dir(0.0, 0.0, 0.0),
           _recent_chunk(0),
           _view_chunk_size(view_chunk_size),
           _view_half_width(_view_chunk_size / 2),
           _view_dist(calculate_view_distance()),
           _world(calculate_world_size(grid_scale)),
           _cell_extent(1.0, 1.0, 1.0),
-          _generator(_grid)
+          _contact(_grid, _grid_scale, _world.get_min()),
+          _generator(_grid, seed, seeded),
+          _portal(false)
     {
         // Check chunk size
         if (grid_scale % chunk_size != 0)
@@ -859,11 +1169,7 @@ class cgrid
     inline void reset()
     {
         // Clear out all vectors
-        _visit.clear();
-        _neighbors.clear();
-        _path.clear();
-        _stack.clear();
-        _chunk_update.clear();
+        _chunk_changed.clear();
         _chunk_update_keys.clear();
         _sort_chunk.clear();
         _view_chunks.clear();
@@ -935,88 +1241,73 @@ class cgrid
 
         return min::vec3<float>(std::floor(x) + 0.5, std::round(y), std::floor(z) + 0.5);
     }
-    inline void drone_collision_cells(std::vector<std::pair<min::aabbox<float, min::vec3>, block_id>> &out, const min::vec3<float> &center) const
+    template <typename F>
+    inline void drone_contacts(const min::vec3<float> &center, const F &f) const
     {
-        // Surrounding cells
-        out.clear();
-
         // Check if position is valid
-        const bool valid = inside(center);
-        if (valid)
+        if (inside(center))
         {
-            // Create box at this point
-            const min::aabbox<float, min::vec3> box = drone_box(center);
-
-            // Calculate collision cells around this box
-            collision_cells(out, box, center);
+            // Stream solid cells touching the drone box
+            _contact.query(drone_box(center), f);
         }
     }
-    inline void drop_collision_cells(std::vector<std::pair<min::aabbox<float, min::vec3>, block_id>> &out, const min::vec3<float> &center) const
+    template <typename F>
+    inline void drop_contacts(const min::vec3<float> &center, const F &f) const
     {
-        // Surrounding cells
-        out.clear();
-
         // Check if position is valid
-        const bool valid = inside(center);
-        if (valid)
+        if (inside(center))
         {
-            // Create box at this point
-            const min::aabbox<float, min::vec3> box = drop_box(center);
-
-            // Calculate collision cells around this box
-            collision_cells(out, box, center);
+            // Stream solid cells touching the drop box
+            _contact.query(drop_box(center), f);
         }
     }
-    inline void explosive_collision_cells(std::vector<std::pair<min::aabbox<float, min::vec3>, block_id>> &out, const min::vec3<float> &center) const
+    template <typename F>
+    inline void explosive_contacts(const min::vec3<float> &center, const F &f) const
     {
-        // Surrounding cells
-        out.clear();
-
         // Check if position is valid
-        const bool valid = inside(center);
-        if (valid)
+        if (inside(center))
         {
-            // Create box at this point
-            const min::aabbox<float, min::vec3> box = explode_box(center);
-
-            // Calculate collision cells around this box
-            collision_cells(out, box, center);
+            // Stream solid cells touching the explosive box
+            _contact.query(explode_box(center), f);
         }
     }
-    inline void missile_collision_cells(std::vector<std::pair<min::aabbox<float, min::vec3>, block_id>> &out, const min::vec3<float> &center) const
+    template <typename F>
+    inline void missile_contacts(const min::vec3<float> &center, const F &f) const
     {
-        // Surrounding cells
-        out.clear();
-
         // Check if position is valid
-        const bool valid = inside(center);
-        if (valid)
+        if (inside(center))
         {
-            // Create box at this point
-            const min::aabbox<float, min::vec3> box = missile_box(center);
-
-            // Calculate collision cells around this box
-            collision_cells(out, box, center);
+            // Stream solid cells touching the missile box
+            _contact.query(missile_box(center), f);
         }
     }
-    inline void player_collision_cells(std::vector<std::pair<min::aabbox<float, min::vec3>, block_id>> &out, const min::vec3<float> &center) const
+    template <typename F>
+    inline void player_contacts(const min::vec3<float> &center, const F &f) const
     {
-        // Surrounding cells
-        out.clear();
-
         // Check if position is valid
-        const bool valid = inside(center);
-        if (valid)
+        if (inside(center))
         {
-            // Create box at this point
-            const min::aabbox<float, min::vec3> box = player_box(center);
-
-            // Calculate collision cells around this box
-            collision_cells(out, box, center);
+            // Stream solid cells touching the player box
+            _contact.query(player_box(center), f);
+        }
+    }
+    template <typename F>
+    inline void valid_contacts(const std::vector<cell_contact> &cells, const F &f) const
+    {
+        // Skip cached cells changed since the read phase, stop if callback returns true
+        for (const cell_contact &c : cells)
+        {
+            if (_grid[c.get_key()] == c.get_value() && f(c))
+            {
+                break;
+            }
         }
     }
     inline void flush_chunk_updates()
     {
+        // Generate chunks coming into range
+        chunk_generate_ahead();
+
         // Sort chunk keys using a radix sort
         min::uint_sort<size_t>(_chunk_update_keys, _sort_chunk, [](const size_t i) {
             return i;
@@ -1032,10 +1323,19 @@ class cgrid
         for (const auto k : _chunk_update_keys)
         {
             chunk_update(k);
+
+            // Rebuild path regions for this chunk on next search
+            _path_queue.update(k);
+
+            // Rebuild the flow field if it covers this chunk
+            _flow.update(k, _chunk_scale);
         }
 
         // Clear out chunk update keys
         _chunk_update_keys.clear();
+
+        // Catch up on chunks left over from a portal swap
+        chunk_stale_flush();
     }
     inline min::mesh<float, uint32_t> &get_chunk(const size_t key)
     {
@@ -1190,30 +1490,152 @@ class cgrid
         // return ray start point since it is not in the grid
         return r.get_origin();
     }
+    inline void ray_trace_packet(const std::vector<min::ray<float, min::vec3>> &rays, const size_t length, std::vector<trace_hit> &out) const
+    {
+        // Clear the output hits
+        out.clear();
+
+        // Trace each ray, empty regions are skipped per ray
+        for (const auto &r : rays)
+        {
+            size_t prev_key, key;
+            block_id value = block_id::INVALID;
+            const bool is_valid = ray_trace(r, length, prev_key, key, value);
+            if (is_valid)
+            {
+                out.emplace_back(true, prev_key, key, value, grid_cell_center(key));
+            }
+            else
+            {
+                out.emplace_back(false, prev_key, key, value, min::vec3<float>());
+            }
+        }
+    }
+    inline void flow_goal(const min::vec3<float> &goal)
+    {
+        // Grow the shared flow field toward the goal cell by one slice per frame
+        bool is_valid = true;
+        const size_t key = grid_key_safe(goal, is_valid);
+        if (is_valid)
+        {
+            _flow.update_goal(_grid, key);
+        }
+    }
+    inline bool flow_step(const min::vec3<float> &p, min::vec3<float> &out) const
+    {
+        // Is this point in the grid?
+        bool is_valid = true;
+        const size_t key = grid_key_safe(p, is_valid);
+        if (!is_valid)
+        {
+            return false;
+        }
+
+        // Look up the next cell toward the goal
+        size_t next;
+        if (_flow.step(key, next))
+        {
+            out = grid_cell_center(next);
+            return true;
+        }
+
+        return false;
+    }
     inline void path(std::vector<min::vec3<float>> &out, const min::vec3<float> &start, const min::vec3<float> &stop)
     {
         // Convert keys to points
         out.clear();
 
         // Try to find a path between points
-        search(start, stop);
+        size_t start_key;
+        size_t stop_key;
+        if (search_keys(start, stop, start_key, stop_key))
+        {
+            // For all keys in path
+            for (const size_t key : _path_queue.search(start_key, stop_key))
+            {
+                out.push_back(grid_cell_center(key));
+            }
+        }
+    }
+    inline void path_collect(const std::function<void(const size_t, const std::vector<min::vec3<float>> &)> &f)
+    {
+        // Hand back paths of the last launch if finished, else drones keep their routes until next frame
+        _path_queue.collect([this, &f](const size_t id, const size_t *const keys, const size_t size) {
+            // Convert keys to points
+            _path_points.clear();
+            for (size_t i = 0; i < size; i++)
+            {
+                _path_points.push_back(grid_cell_center(keys[i]));
+            }
 
-        // For all keys in path
-        const size_t size = _path.size();
-        for (size_t i = 0; i < size; i++)
+            f(id, _path_points);
+        });
+    }
+    inline void path_launch()
+    {
+        // Search posted paths in the background on a snapshot of the grid
+        _path_queue.launch();
+    }
+    inline bool path_request(const size_t id, const min::vec3<float> &start, const min::vec3<float> &stop)
+    {
+        // Post a path search if points are in the grid
+        size_t start_key;
+        size_t stop_key;
+        if (search_keys(start, stop, start_key, stop_key))
         {
-            out.push_back(grid_cell_center(_path[i]));
+            _path_queue.post(id, start_key, stop_key);
+            return true;
         }
+
+        return false;
     }
-    inline void portal()
+    inline bool is_portal_pending() const
     {
-        generate_portal();
+        return _portal;
+    }
+    inline bool is_portal_ready() const
+    {
+        return _portal && !_generator.is_portal_busy();
+    }
+    inline float portal_progress() const
+    {
+        return _generator.get_portal_progress();
+    }
+    inline bool portal()
+    {
+        // Start generating a new world, play continues on the old one
+        if (!_portal && generate_portal())
+        {
+            _portal = true;
+            return true;
+        }
 
-        // Update all chunks
-        const size_t chunks = _chunks.size();
-        for (size_t i = 0; i < chunks; i++)
+        return false;
+    }
+    inline void portal_swap()
+    {
+        // Swap in the generated world, portals are generated whole
+        _generator.swap(_grid);
+        std::fill(_chunk_gen.begin(), _chunk_gen.end(), true);
+        _portal = false;
+
+        // Count occupied cells for ray skipping
+        occupancy_build();
+
+        // Invalidate all path regions and the flow field
+        _path_queue.clear();
+        _flow.clear();
+
+        // Pending edits were made on the old world
+        _chunk_update_keys.clear();
+
+        // Mark all chunks stale and remesh the view chunks first
+        std::fill(_chunk_stale.begin(), _chunk_stale.end(), true);
+        _stale_next = 0;
+        for (const view_chunk &vc : _view_chunks)
         {
-            chunk_update(i);
+            chunk_update(vc.get_key());
         }
     }
     inline void set_boundary_chunk(const size_t key)
@@ -1385,27 +1807,56 @@ class cgrid
         // Return snapped point
         return snapped;
     }
-    inline bool is_update_chunk(const size_t chunk_key) const
+    inline void generate_near(const min::vec3<float> &p)
     {
-        return _chunk_update[chunk_key];
+        bool is_valid = true;
+        const size_t key = chunk_key_safe(p, is_valid);
+        if (!is_valid)
+        {
+            return;
+        }
+
+        // Generate the column of chunks under this point, for tracing down onto the terrain
+        const std::tuple<size_t, size_t, size_t> comp = chunk_key_unpack(key);
+        const size_t x = std::get<0>(comp);
+        const size_t z = std::get<2>(comp);
+        _gen_keys.clear();
+        for (size_t y = 0; y < _chunk_scale; y++)
+        {
+            const size_t k = (x * _chunk_scale * _chunk_scale) + (y * _chunk_scale) + z;
+            if (!_chunk_gen[k])
+            {
+                _gen_keys.push_back(k);
+            }
+        }
+        chunk_generate(_gen_keys);
     }
     inline void save()
     {
         // Create output stream for saving world
         std::vector<uint8_t> stream;
 
-        // Reserve space for grid
-        stream.reserve(_grid.size() * sizeof(block_id));
+        // Reserve space for grid and chunk flags
+        const size_t chunks = _chunks.size();
+        stream.reserve(_grid.size() * sizeof(block_id) + chunks + sizeof(uint32_t) * 2);
 
-        // Write data into stream
+        // Write data into stream, chunks not generated yet stay empty and are flagged
         min::write_le_vector<block_id>(stream, _grid);
+        std::vector<uint8_t> gen(chunks);
+        for (size_t i = 0; i < chunks; i++)
+        {
+            gen[i] = _chunk_gen[i];
+        }
+        min::write_le_vector<uint8_t>(stream, gen);
 
         // Write data to file
         save_file("bin/world.bmesh", stream);
     }
-    inline void update_chunk(const size_t chunk_key)
+    inline void take_chunk_changes(std::vector<size_t> &out)
     {
-        _chunk_update[chunk_key] = false;
+        // Hand over remeshed chunk keys, may repeat a key
+        out.insert(out.end(), _chunk_changed.begin(), _chunk_changed.end());
+        _chunk_changed.clear();
     }
     inline void update_current_chunk(const min::vec3<float> &p)
     {
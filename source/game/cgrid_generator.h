@@ -18,21 +18,28 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef __CGRID_GENERATOR__
 #define __CGRID_GENERATOR__
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <fstream>
+#include <game/gen_pipeline.h>
 #include <game/id.h>
 #include <game/memory_map.h>
+#include <game/portal_table.h>
+#include <game/rng.h>
 #include <game/work_queue.h>
+#include <game/world_cache.h>
 #include <kernel/mandelbulb_asym.h>
 #include <kernel/mandelbulb_exp.h>
 #include <kernel/mandelbulb_sym.h>
 #include <kernel/terrain_base.h>
 #include <kernel/terrain_height.h>
+#include <memory>
 #include <min/serial.h>
-#include <min/strtoken.h>
 #include <min/vec3.h>
 #include <random>
-#include <sstream>
+#include <string>
+#include <thread>
 
 namespace game
 {
@@ -40,18 +47,35 @@ namespace game
 class cgrid_generator
 {
   private:
-    std::string _asym;
-    std::vector<std::pair<size_t, size_t>> _asym_lines;
-    std::string _exp;
-    std::vector<std::pair<size_t, size_t>> _exp_lines;
-    std::string _sym;
-    std::vector<std::pair<size_t, size_t>> _sym_lines;
+    static constexpr size_t _lattice = 8;
+    std::vector<uint8_t> _asym_packed;
+    std::vector<uint8_t> _exp_packed;
+    std::vector<uint8_t> _sym_packed;
+    const portal_table _asym;
+    const portal_table _exp;
+    const portal_table _sym;
     std::vector<block_id> _back;
-    std::istringstream _ss;
-    std::string _line;
-    std::mt19937 _gen;
-
-    inline void clear_grid(std::vector<block_id> &grid)
+    const uint64_t _seed;
+    size_t _portals;
+    const world_cache _cache;
+    const bool _seeded;
+    std::string _world_key;
+    bool _world_cached;
+    bool _caching;
+    size_t _scale;
+    size_t _chunk_size;
+    thread_pool _pool;
+    std::thread _thread;
+    std::atomic<bool> _busy;
+    std::atomic<bool> _stop;
+    std::atomic<size_t> _progress;
+    size_t _total;
+    std::unique_ptr<kernel::terrain_base> _base;
+    std::unique_ptr<kernel::terrain_height> _height;
+    std::unique_ptr<gen_pipeline> _pipeline;
+    std::unique_ptr<gen_pipeline> _cache_pipeline;
+
+    inline void clear_grid(thread_pool &pool, std::vector<block_id> &grid)
     {
         // Parallelize on copying buffers
         const auto work = [&grid](std::mt19937 &gen, const size_t i) {
@@ -59,12 +83,7 @@ class cgrid_generator
         };
 
         // Convert cells to mesh in parallel
-        work_queue::worker.run(work, 0, grid.size());
-    }
-    inline void clear_stream(const std::string &str)
-    {
-        _ss.clear();
-        _ss.str(str);
+        pool.run(work, 0, grid.size());
     }
     inline size_t count_grid(std::vector<block_id> &grid)
     {
@@ -84,177 +103,306 @@ class cgrid_generator
         // Return count;
         return count;
     }
-    inline kernel::mandelbulb_asym load_mandelbulb_asym(std::mt19937 &gen)
+    inline static const min::mem_file *find_file(const std::string &file)
     {
-        // Load uniform distribution for sym
-        std::uniform_int_distribution<unsigned> dist(0, _asym_lines.size() - 1);
-        const unsigned index = dist(gen);
-
-        // Get the line index and get the line string
-        const auto &p = _asym_lines[index];
-        _line = _asym.substr(p.first, p.second);
-
-        // Clear and reset the stream with line data
-        clear_stream(_line);
-
-        // Parse the string into four ints
-        int a, b, c, d, e, f, g, h, i, j, k, l;
-        _ss >> a >> b >> c >> d >> e >> f >> g >> h >> i >> j >> k >> l;
-
-        // Check for errors
-        if (_ss.fail())
+        // The memory map throws on missing files
+        try
         {
-            throw std::runtime_error("cgrid_generator: Invalid man_asym line '" + _line + "'");
+            const min::mem_file &f = memory_map::memory.get_file(file);
+            return (f.size() > 0) ? &f : nullptr;
+        }
+        catch (const std::exception &e)
+        {
+            return nullptr;
         }
-
-        // Load the asymmetrical mandelbulb
-        return kernel::mandelbulb_asym(a, b, c, d, e, f, g, h, i, j, k, l);
     }
-    inline kernel::mandelbulb_exp load_mandelbulb_exp(std::mt19937 &gen)
+    inline static portal_table load_portal_table(const std::string &name, const size_t cols, std::vector<uint8_t> &packed)
     {
-        // Load uniform distribution for exp
-        std::uniform_int_distribution<unsigned> dist(0, _exp_lines.size() - 1);
-        const unsigned index = dist(gen);
+        // Use the packed parameters in place if data.sky has them
+        const std::string file = "data/portals/" + name;
+        const min::mem_file *const table = find_file(file + ".bportal");
+        if (table)
+        {
+            return portal_table(&(*table)[0], table->size(), cols);
+        }
 
-        // Get the line index and get the line string
-        const auto &p = _exp_lines[index];
-        _line = _exp.substr(p.first, p.second);
+        // Otherwise pack the text parameters once at load
+        packed = portal_table::pack(memory_map::memory.get_file(file + ".portal").to_string(), cols);
 
-        // Clear and reset the stream with line data
-        clear_stream(_line);
+        return portal_table(packed.data(), packed.size(), cols);
+    }
+    inline kernel::mandelbulb_asym load_mandelbulb_asym(const size_t i) const
+    {
+        // Load the asymmetrical mandelbulb
+        return kernel::mandelbulb_asym(_asym.get(i, 0), _asym.get(i, 1), _asym.get(i, 2), _asym.get(i, 3),
+                                       _asym.get(i, 4), _asym.get(i, 5), _asym.get(i, 6), _asym.get(i, 7),
+                                       _asym.get(i, 8), _asym.get(i, 9), _asym.get(i, 10), _asym.get(i, 11));
+    }
+    inline kernel::mandelbulb_exp load_mandelbulb_exp(const size_t i) const
+    {
+        // Load the exponential mandelbulb
+        return kernel::mandelbulb_exp(_exp.get(i, 0), _exp.get(i, 1), _exp.get(i, 2), _exp.get(i, 3));
+    }
+    inline kernel::mandelbulb_sym load_mandelbulb_sym(const size_t i) const
+    {
+        // Load the symmetrical mandelbulb
+        return kernel::mandelbulb_sym(_sym.get(i, 0), _sym.get(i, 1), _sym.get(i, 2), _sym.get(i, 3));
+    }
+    inline std::unique_ptr<gen_pipeline> make_pipeline(const size_t scale, const size_t chunk_size) const
+    {
+        // Fuse all stages on each chunk, writing straight into the grid
+        const kernel::terrain_base &base = *_base;
+        const kernel::terrain_height &height = *_height;
+        std::unique_ptr<gen_pipeline> out(new gen_pipeline(scale, chunk_size));
+        out->add_tile("clear", [scale](std::mt19937 &gen, std::vector<block_id> &write, const gen_tile &t) {
+            for (size_t i = t.x_begin(); i < t.x_end(); i++)
+            {
+                for (size_t j = t.y_begin(); j < t.y_end(); j++)
+                {
+                    const size_t row = (i * scale + j) * scale;
+                    std::fill(write.begin() + row + t.z_begin(), write.begin() + row + t.z_end(), block_id::EMPTY);
+                }
+            }
+        });
+        out->add_tile("base", [&base](std::mt19937 &gen, std::vector<block_id> &write, const gen_tile &t) {
+            base.tile(write, t);
+        });
+        out->add_tile("height", [&height](std::mt19937 &gen, std::vector<block_id> &write, const gen_tile &t) {
+            height.tile(write, t);
+        });
+        out->add_tile("vegetation", [&height](std::mt19937 &gen, std::vector<block_id> &write, const gen_tile &t) {
+            height.tile_vegetation(write, t);
+        });
+
+        return out;
+    }
+    inline void create_pipeline(const size_t scale, const size_t chunk_size)
+    {
+        // Wake up the threads for processing
+        work_queue::worker.wake();
 
-        // Parse the string into four ints
-        int a, b, c, d;
-        _ss >> a >> b >> c >> d;
+        // Perlin noise base and a height map on top, every cell only depends on the seed and its position
+        _base.reset(new kernel::terrain_base(scale, chunk_size, 0, scale / 2, _seed));
+        _height.reset(new kernel::terrain_height(work_queue::worker, scale, scale / 2, scale - 1, _seed));
 
-        // Check for errors
-        if (_ss.fail())
-        {
-            throw std::runtime_error("cgrid_generator: Invalid man_exp line '" + _line + "'");
-        }
+        // Chunks are made on the main thread, the cached copy on the portal thread, each pipeline keeps its own timings
+        _pipeline = make_pipeline(scale, chunk_size);
+        _cache_pipeline = make_pipeline(scale, chunk_size);
 
-        // Load the exponential mandelbulb
-        return kernel::mandelbulb_exp(a, b, c, d);
+        // Put the threads back to sleep
+        work_queue::worker.sleep();
     }
-    inline kernel::mandelbulb_sym load_mandelbulb_sym(std::mt19937 &gen)
+    template <typename K>
+    inline void launch(K k, const size_t scale, const std::function<min::vec3<float>(const size_t)> &grid_cell_center, const std::string &key)
     {
-        // Load uniform distribution for sym
-        std::uniform_int_distribution<unsigned> dist(0, _sym_lines.size() - 1);
-        const unsigned index = dist(gen);
+        // Reset progress for this portal
+        _progress = 0;
+        _total = kernel::mandelbulb8::blocks(scale, _lattice);
+        _busy = true;
+
+        // Generate into the back buffer on a worker, the grid stays live until swapped
+        _thread = std::thread([this, k, scale, grid_cell_center, key]() mutable {
+            // Load this portal if it was generated before
+            if (_cache.load(key, _back))
+            {
+                _progress = _total;
+            }
+            else
+            {
+                // Clear out the old grid
+                clear_grid(_pool, _back);
 
-        // Get the line index and get the line string
-        const auto &p = _sym_lines[index];
-        _line = _sym.substr(p.first, p.second);
+                // Generate mandelbulb world using mandelbulb generator
+                k.generate(_pool, _back, scale, grid_cell_center, 0, _lattice, &_progress);
 
-        // Clear and reset the stream with line data
-        clear_stream(_line);
+                // Keep it for the next visit
+                _cache.save(key, _back);
+            }
 
-        // Parse the string into four ints
-        int a, b, c, d;
-        _ss >> a >> b >> c >> d;
+            // ATOMIC: Signal finished
+            _busy = false;
+        });
+    }
 
-        // Check for errors
-        if (_ss.fail())
+  public:
+    cgrid_generator(const std::vector<block_id> &grid, const uint64_t seed, const bool seeded)
+        : _asym(load_portal_table("man_asym", 12, _asym_packed)),
+          _exp(load_portal_table("man_exp", 4, _exp_packed)),
+          _sym(load_portal_table("man_sym", 4, _sym_packed)),
+          _back(grid.size(), block_id::EMPTY),
+          _seed(seed), _portals(0), _cache("bin/cache_"), _seeded(seeded), _world_cached(false),
+          _caching(false), _scale(0), _chunk_size(0), _busy(false), _stop(false), _progress(0), _total(1) {}
+    ~cgrid_generator()
+    {
+        // Drop a world still caching, finish any portal still generating
+        cancel_cache();
+        wait();
+    }
+    inline void cache_world()
+    {
+        // Skip unseeded worlds, if already cached or the back buffer is in use
+        if (!_seeded || _world_cached || !_cache_pipeline || _busy)
         {
-            throw std::runtime_error("cgrid_generator: Invalid man_sym line '" + _line + "'");
+            return;
         }
 
-        // Load the symmetrical mandelbulb
-        return kernel::mandelbulb_sym(a, b, c, d);
+        // Join the last finished portal
+        wait();
+
+        // Generate the untouched world in the back buffer on the portal thread and store it
+        _busy = true;
+        _stop = false;
+        _caching = true;
+        _world_cached = true;
+        _thread = std::thread([this]() {
+            // One row of chunk columns at a time, so a cancel returns quickly
+            const size_t scale = _scale;
+            const size_t rows = (scale + _chunk_size - 1) / _chunk_size;
+            std::vector<gen_tile> tiles;
+            for (size_t x = 0; x < rows && !_stop; x++)
+            {
+                const size_t x0 = x * _chunk_size;
+                tiles.clear();
+                for (size_t y0 = 0; y0 < scale; y0 += _chunk_size)
+                {
+                    tiles.emplace_back(x0, std::min(x0 + _chunk_size, scale), y0, std::min(y0 + _chunk_size, scale), 0, scale);
+                }
+                _cache_pipeline->run(_pool, _back, tiles);
+            }
+
+            // Only store a whole world
+            if (!_stop)
+            {
+                _cache.save(_world_key, _back);
+            }
+
+            // ATOMIC: Signal finished
+            _busy = false;
+        });
     }
-    inline void load_portal_strings()
+    inline void cancel_cache()
     {
-        // Load the portal files
-        _asym = memory_map::memory.get_file("data/portals/man_asym.portal").to_string();
-        _asym_lines = tools::read_lines(_asym, 1001);
-        _exp = memory_map::memory.get_file("data/portals/man_exp.portal").to_string();
-        _exp_lines = tools::read_lines(_exp, 738);
-        _sym = memory_map::memory.get_file("data/portals/man_sym.portal").to_string();
-        _sym_lines = tools::read_lines(_sym, 1001);
+        // Stop caching the world after the current row, it is cached again on the next create
+        if (_caching)
+        {
+            _stop = true;
+            wait();
+        }
     }
+    inline bool create_world(std::vector<block_id> &grid, const size_t scale, const size_t chunk_size)
+    {
+        // Stop caching the last world, wait for any portal writing the back buffer
+        cancel_cache();
+        wait();
+
+        // Load the whole world if it was generated before
+        _scale = scale;
+        _chunk_size = chunk_size;
+        _world_key = world_cache::key("world", {_seed, scale, chunk_size});
+        _world_cached = _seeded && _cache.load(_world_key, grid);
+        if (_world_cached)
+        {
+            return true;
+        }
 
-  public:
-    cgrid_generator(const std::vector<block_id> &grid)
-        : _back(grid.size(), block_id::EMPTY),
-          _gen(std::chrono::high_resolution_clock::now().time_since_epoch().count())
+        // Chunks are generated on demand, until then they are empty
+        create_pipeline(scale, chunk_size);
+        std::fill(grid.begin(), grid.end(), block_id::EMPTY);
+
+        return false;
+    }
+    inline void resume_world(const size_t scale, const size_t chunk_size)
     {
-        // Load the portal strings
-        load_portal_strings();
+        // Stop caching the last world, wait for any portal writing the back buffer
+        cancel_cache();
+        wait();
+
+        // A loaded world keeps its cells, only the chunks it never generated are made on demand
+        _scale = scale;
+        _chunk_size = chunk_size;
+        _world_key = world_cache::key("world", {_seed, scale, chunk_size});
+        _world_cached = _seeded && _cache.exists(_world_key);
+        create_pipeline(scale, chunk_size);
     }
-    inline void copy(std::vector<block_id> &grid) const
+    inline void generate_chunks(std::vector<block_id> &grid, const std::vector<gen_tile> &chunks)
     {
-        // Parallelize on copying buffers
-        const auto work = [this, &grid](std::mt19937 &gen, const size_t i) {
-            grid[i] = _back[i];
-        };
-
-        // Convert cells to mesh in parallel
-        work_queue::worker.run(work, 0, grid.size());
+        // Generate these chunks in parallel, same cells as a full pass
+        _pipeline->run(work_queue::worker, grid, chunks);
     }
-    void generate_world(std::vector<block_id> &grid, const size_t scale, const size_t chunk_size,
-                        const std::function<size_t(const std::tuple<size_t, size_t, size_t> &)> &grid_key_unpack,
-                        const std::function<min::vec3<float>(const size_t)> &grid_cell_center)
+    inline const gen_pipeline *get_pipeline() const
     {
-        // Wake up the threads for processing
-        work_queue::worker.wake();
-
-        // Calculates perlin noise
-        kernel::terrain_base base(scale, chunk_size, 0, scale / 2);
-        base.generate(work_queue::worker, _back);
+        // Stage timings of on demand chunks, null before the first generated world
+        return _pipeline.get();
+    }
+    inline float get_portal_progress() const
+    {
+        // Fraction of lattice blocks generated
+        return std::min(static_cast<float>(_progress) / _total, 1.0f);
+    }
+    inline bool is_portal_busy() const
+    {
+        return _busy;
+    }
+    bool launch_portal(const size_t scale, const std::function<min::vec3<float>(const size_t)> &grid_cell_center)
+    {
+        // A portal replaces this world, stop caching it
+        cancel_cache();
 
-        // Calculates a height map
-        kernel::terrain_height height(scale, scale / 2, scale - 1);
-        height.generate(work_queue::worker, _gen, _back);
+        // Only generate one portal at a time
+        if (_busy)
+        {
+            return false;
+        }
 
-        // Copy data from back to front buffer
-        copy(grid);
+        // Join the last finished portal
+        wait();
 
-        // Put the threads back to sleep
-        work_queue::worker.sleep();
-    }
-    void generate_portal(std::vector<block_id> &grid, const size_t scale, const size_t chunk_size,
-                         const std::function<size_t(const std::tuple<size_t, size_t, size_t> &)> &grid_key_unpack,
-                         const std::function<min::vec3<float>(const size_t)> &grid_cell_center)
-    {
-        // Wake up the threads for processing
-        work_queue::worker.wake();
+        // Each portal in a world draws from its own stream
+        const uint32_t stream = rng::hash(rng::key(_seed, 8), _portals++);
+        const uint32_t type = 1 + rng::hash(stream, 0) % 3;
+        const uint32_t draw = rng::hash(stream, 1);
 
-        // Choose between terrain generators
-        std::uniform_int_distribution<int> choose(1, 3);
-        const int type = choose(_gen);
+        // Choose between terrain generators, parse the kernel on this thread
         if (type == 1)
         {
-            // Clear out the old grid
-            clear_grid(grid);
-
-            // Generate mandelbulb world using mandelbulb generator
-            load_mandelbulb_sym(_gen).generate(work_queue::worker, grid, scale, [grid_cell_center](const size_t i) {
-                return grid_cell_center(i);
-            });
+            const size_t i = draw % _sym.size();
+            launch(load_mandelbulb_sym(i), scale, grid_cell_center, world_cache::key("sym", {i, _sym.hash(i), scale, _lattice}));
         }
-        if (type == 2)
+        else if (type == 2)
         {
-            // Clear out the old grid
-            clear_grid(grid);
-
-            // Generate mandelbulb world using mandelbulb generator
-            load_mandelbulb_asym(_gen).generate(work_queue::worker, grid, scale, [grid_cell_center](const size_t i) {
-                return grid_cell_center(i);
-            });
+            const size_t i = draw % _asym.size();
+            launch(load_mandelbulb_asym(i), scale, grid_cell_center, world_cache::key("asym", {i, _asym.hash(i), scale, _lattice}));
         }
         else
         {
-            // Clear out the old grid
-            clear_grid(grid);
+            const size_t i = draw % _exp.size();
+            launch(load_mandelbulb_exp(i), scale, grid_cell_center, world_cache::key("exp", {i, _exp.hash(i), scale, _lattice}));
+        }
+
+        return true;
+    }
+    inline void swap(std::vector<block_id> &grid)
+    {
+        // Wait for the generator to finish
+        wait();
 
-            // Generate mandelbulb world using mandelbulb generator
-            load_mandelbulb_exp(_gen).generate(work_queue::worker, grid, scale, [grid_cell_center](const size_t i) {
-                return grid_cell_center(i);
-            });
+        // Swap buffers, keeps references to the grid valid
+        grid.swap(_back);
+    }
+    inline void wait()
+    {
+        // Block until the back buffer is no longer written
+        if (_thread.joinable())
+        {
+            _thread.join();
         }
 
-        // Put the threads back to sleep
-        work_queue::worker.sleep();
+        // A cancelled world was not stored
+        if (_caching)
+        {
+            _caching = false;
+            _world_cached = !_stop;
+        }
     }
 };
 }
@@ -18,6 +18,7 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef __CHESTS__
 #define __CHESTS__
 
+#include <game/entity_store.h>
 #include <game/static_instance.h>
 #include <min/aabbox.h>
 #include <min/grid.h>
@@ -42,10 +43,6 @@ class chest
     {
         return _body_id;
     }
-    inline void dec_inst()
-    {
-        _inst_id--;
-    }
     const min::vec3<float> &get_position() const
     {
         return _p;
@@ -63,6 +60,7 @@ class chests
     physics *const _sim;
     static_instance *const _inst;
     std::vector<chest> _chests;
+    std::vector<size_t> _row;
     const std::string _str;
 
     inline min::body<float, min::vec3> &body(const size_t index)
@@ -76,7 +74,7 @@ class chests
     inline void reserve_memory()
     {
         // Reserve space for collision cells
-        _chests.reserve(static_instance::max_chests());
+        _chests.reserve(_inst->max_chests());
     }
     inline void set_position(const size_t index, const min::vec3<float> &g)
     {
@@ -95,15 +93,15 @@ class chests
 
   public:
     chests(physics &sim, static_instance &inst)
-        : _sim(&sim), _inst(&inst), _str("Chest")
+        : _sim(&sim), _inst(&inst), _row(inst.max_chests()), _str("Chest")
     {
         reserve_memory();
     }
     inline void reset()
     {
-        // Remove all the chests backwards to preserve chest-instance id mapping
+        // Remove all the chests
         const size_t size = _chests.size();
-        for (size_t i = size; i-- != 0;)
+        for (size_t i = 0; i < size; i++)
         {
             // Get the chest
             const chest &c = _chests[i];
@@ -130,13 +128,11 @@ class chests
         // Create a box for the chest
         const min::aabbox<float, min::vec3> box = _inst->get_chest().get_box(inst_id);
 
-        // Store the chest index as body data
-        const size_t index = _chests.size();
-
-        // Add to physics simulation
-        const size_t body_id = _sim->add_body(box, 10.0, id_value(static_id::CHEST), index);
+        // Add to physics simulation, the instance handle is the body data
+        const size_t body_id = _sim->add_body(box, 10.0, id_value(static_id::CHEST), inst_id);
 
         // Create a new chest
+        _row[slot_map::slot(inst_id)] = _chests.size();
         _chests.emplace_back(body_id, inst_id, p);
 
         // Return chest added
@@ -146,22 +142,24 @@ class chests
     {
         return _str;
     }
-    inline void remove(const size_t index)
+    inline void remove(const size_t inst_id)
     {
+        // Ignore stale handles
+        const size_t index = _row[slot_map::slot(inst_id)];
+        if (index >= _chests.size() || _chests[index].inst_id() != inst_id)
+        {
+            return;
+        }
+
         // Clear chest at index
-        _inst->get_chest().clear(_chests[index].inst_id());
+        _inst->get_chest().clear(inst_id);
         _sim->clear_body(_chests[index].body_id());
-        _chests.erase(_chests.begin() + index);
 
-        // Adjust the remaining chest indices
-        const size_t size = _chests.size();
-        for (size_t i = index; i < size; i++)
+        // Move the last chest into the hole
+        swap_erase(_chests, index);
+        if (index < _chests.size())
         {
-            // Adjust the instance id
-            _chests[i].dec_inst();
-
-            // Adjust the body data index
-            body(i).set_data(min::body_data(i));
+            _row[slot_map::slot(_chests[index].inst_id())] = index;
         }
     }
     inline void update_frame()
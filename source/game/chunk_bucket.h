@@ -0,0 +1,115 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __CHUNK_BUCKET__
+#define __CHUNK_BUCKET__
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace game
+{
+
+// Items grouped by the chunk they are in, an item only moves when it changes chunk
+class chunk_bucket
+{
+  private:
+    static constexpr size_t _none = static_cast<size_t>(-1);
+    std::vector<std::vector<uint16_t>> _bucket;
+    std::vector<size_t> _key;
+    std::vector<size_t> _at;
+
+  public:
+    inline size_t chunks() const
+    {
+        return _bucket.size();
+    }
+    inline void clear()
+    {
+        // Only empty the buckets that hold items
+        const size_t size = _key.size();
+        for (size_t i = 0; i < size; i++)
+        {
+            if (_key[i] != _none)
+            {
+                _bucket[_key[i]].clear();
+                _key[i] = _none;
+            }
+        }
+    }
+    inline const std::vector<uint16_t> &get(const size_t key) const
+    {
+        return _bucket[key];
+    }
+    inline void insert(const size_t item, const size_t key)
+    {
+        // Nothing to do unless the item changed chunk
+        if (_key[item] == key)
+        {
+            return;
+        }
+
+        // Move the item into the new bucket
+        remove(item);
+        _key[item] = key;
+        _at[item] = _bucket[key].size();
+        _bucket[key].push_back(static_cast<uint16_t>(item));
+    }
+    inline size_t key(const size_t item) const
+    {
+        return _key[item];
+    }
+    inline static constexpr size_t none()
+    {
+        return _none;
+    }
+    inline void remove(const size_t item)
+    {
+        // Skip items that are not in a bucket
+        const size_t key = _key[item];
+        if (key == _none)
+        {
+            return;
+        }
+
+        // Move the last item into the hole
+        std::vector<uint16_t> &b = _bucket[key];
+        const size_t at = _at[item];
+        b[at] = b.back();
+        _at[b[at]] = at;
+        b.pop_back();
+        _key[item] = _none;
+    }
+    inline void resize(const size_t chunks, const size_t items)
+    {
+        // Items are stored in 16 bits
+        if (items > 0x10000)
+        {
+            throw std::runtime_error("chunk_bucket: too many items");
+        }
+
+        // Start over with empty buckets
+        _bucket.clear();
+        _bucket.resize(chunks);
+        _key.assign(items, none());
+        _at.assign(items, 0);
+    }
+};
+}
+
+#endif
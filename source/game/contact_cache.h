@@ -0,0 +1,76 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __CONTACT_CACHE__
+#define __CONTACT_CACHE__
+
+#include <game/voxel_contact.h>
+#include <utility>
+#include <vector>
+
+namespace game
+{
+
+// Grid contacts found in the read phase, rows match the entity_store rows
+class contact_cache
+{
+  private:
+    std::vector<std::vector<cell_contact>> _rows;
+    size_t _size;
+
+  public:
+    contact_cache(const size_t limit) : _rows(limit), _size(0) {}
+
+    inline void add()
+    {
+        // New entities have no contacts until the next read phase
+        if (_size == _rows.size())
+        {
+            _rows.emplace_back();
+        }
+        _rows[_size++].clear();
+    }
+    inline void clear()
+    {
+        _size = 0;
+    }
+    inline void erase(const size_t index)
+    {
+        // Move the last row into the hole like entity_store, the removed buffer is recycled
+        std::swap(_rows[index], _rows[_size - 1]);
+        _size--;
+    }
+    inline std::vector<cell_contact> &fill(const size_t index)
+    {
+        // Hand out an empty row, rows are independent so this is safe across threads
+        std::vector<cell_contact> &row = _rows[index];
+        row.clear();
+
+        return row;
+    }
+    inline const std::vector<cell_contact> &get(const size_t index) const
+    {
+        return _rows[index];
+    }
+    inline size_t size() const
+    {
+        return _size;
+    }
+};
+}
+
+#endif
@@ -20,9 +20,12 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <game/callback.h>
 #include <game/cgrid.h>
+#include <game/contact_cache.h>
+#include <game/entity_store.h>
 #include <game/id.h>
 #include <game/path.h>
 #include <game/static_instance.h>
+#include <game/world_snapshot.h>
 #include <min/aabbox.h>
 #include <min/grid.h>
 #include <min/physics_nt.h>
@@ -31,112 +34,13 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 
 namespace game
 {
-class drone
-{
-  private:
-    size_t _body_id;
-    size_t _inst_id;
-    size_t _path_id;
-    size_t _sound_id;
-    std::vector<path> *_paths;
-    float _max_health;
-    float _health;
-    size_t _idle;
-    size_t _launch;
-
-  public:
-    drone(const size_t body_id, const size_t inst_id,
-          const size_t path_id, const size_t sound_id, std::vector<path> *const vp,
-          const min::vec3<float> &p, const min::vec3<float> &dest, const float health)
-        : _body_id(body_id), _inst_id(inst_id), _path_id(path_id),
-          _sound_id(sound_id), _paths(vp), _max_health(health), _health(health), _idle(0), _launch(0)
-    {
-        // Reset path and update with new info
-        get_path().set_dead(false);
-        get_path().update(p, dest);
-    }
-    inline size_t body_id() const
-    {
-        return _body_id;
-    }
-    inline bool damage(const float d)
-    {
-        // Decriment health
-        _health -= d;
-
-        // Return if dead
-        return _health <= 0.0;
-    }
-    inline void dec_idle()
-    {
-        _idle--;
-    }
-    inline void dec_inst()
-    {
-        _inst_id--;
-    }
-    inline void dec_launch()
-    {
-        _launch--;
-    }
-    inline float get_health() const
-    {
-        return _health;
-    }
-    inline float get_max_health() const
-    {
-        return _max_health;
-    }
-    inline float get_health_percent() const
-    {
-        return _health / _max_health;
-    }
-    inline path &get_path()
-    {
-        return (*_paths)[_path_id];
-    }
-    inline const path &get_path() const
-    {
-        return (*_paths)[_path_id];
-    }
-    inline size_t inst_id() const
-    {
-        return _inst_id;
-    }
-    inline bool is_idle() const
-    {
-        return _idle != 0;
-    }
-    inline bool is_launching() const
-    {
-        return _launch == 0;
-    }
-    inline size_t path_id() const
-    {
-        return _path_id;
-    }
-    inline void set_idle(const size_t frames)
-    {
-        _idle = frames;
-    }
-    inline size_t sound_id() const
-    {
-        return _sound_id;
-    }
-    inline void set_launch(const size_t frames)
-    {
-        _launch = frames;
-    }
-    inline min::vec3<float> step(cgrid &grid, const float speed)
-    {
-        return get_path().step(grid) * speed;
-    }
-};
 
 class drones
 {
   private:
     static constexpr size_t _drone_cooldown = _physics_frames * 10;
+    static constexpr size_t _idle_timer = 0;
+    static constexpr size_t _launch_timer = 1;
     static constexpr uint_fast16_t _missile_level = 5;
     static constexpr uint_fast16_t _splash_level = 10;
     static constexpr uint_fast16_t _tunnel_level = 15;
@@ -144,47 +48,37 @@ class drones
     physics *const _sim;
     static_instance *const _inst;
     sound *const _sound;
-    std::vector<std::pair<min::aabbox<float, min::vec3>, block_id>> _col_cells;
     min::vec3<float> _dest;
     std::vector<path> _paths;
-    std::vector<drone> _drones;
-    size_t _path_old;
+    entity_store<2> _store;
+    contact_cache _contacts;
+    std::vector<min::vec3<float>> _flow_step;
+    std::vector<uint8_t> _on_flow;
+    std::vector<size_t> _path_id;
+    std::vector<size_t> _sound_id;
+    std::vector<size_t> _sound_stop;
+    std::vector<float> _health;
+    std::vector<float> _max_health;
     coll_call _f;
     bool _disable;
     const std::string _str;
 
     inline min::body<float, min::vec3> &body(const size_t index)
     {
-        return _sim->get_body(_drones[index].body_id());
+        return _sim->get_body(_store.body_id(index));
     }
     inline const min::body<float, min::vec3> &body(const size_t index) const
     {
-        return _sim->get_body(_drones[index].body_id());
+        return _sim->get_body(_store.body_id(index));
     }
-    inline size_t get_idle_path_id()
+    inline void find_contacts(const cgrid &grid, const size_t index)
     {
-        // Output id
-        size_t id = 0;
-
-        // Scan for unused path
-        const size_t size = _paths.size();
-        for (size_t i = 0; i < size; i++)
-        {
-            // Start at the oldest index
-            const size_t index = (_path_old %= size)++;
-
-            // If index is unused
-            if (_paths[index].is_dead())
-            {
-                // Assign id for use
-                id = index;
-
-                // Break out since found
-                break;
-            }
-        }
-
-        return id;
+        // Cache the cells touching the drone for update_frame
+        std::vector<cell_contact> &row = _contacts.fill(index);
+        grid.drone_contacts(body(index).get_position(), [&row](const cell_contact &c) {
+            row.push_back(c);
+            return false;
+        });
     }
     inline void force(const size_t index, const min::vec3<float> &f)
     {
@@ -194,6 +88,20 @@ class drones
         // Apply force to the body per mass
         b.add_force(f * b.get_mass());
     }
+    inline void release(const size_t index)
+    {
+        // Get path id to set dead flag
+        const size_t path_id = _path_id[index];
+        _paths[path_id].clear();
+        _paths[path_id].set_dead(true);
+
+        // Clear drone at index
+        _inst->get_drone().clear(_store.inst_id(index));
+        _sim->clear_body(_store.body_id(index));
+
+        // Drones die on the simulation thread, stop the sound on the render thread
+        _sound_stop.push_back(_sound_id[index]);
+    }
     inline static float path_speed(const float remain)
     {
         // Calculate speed slowing down as approaching goal
@@ -201,85 +109,88 @@ class drones
     }
     inline void remove(const size_t index)
     {
-        // Get path id to set dead flag
-        const size_t path_id = _drones[index].path_id();
-        _paths[path_id].clear();
-        _paths[path_id].set_dead(true);
-
         // Clear drone at index
-        _inst->get_drone().clear(_drones[index].inst_id());
-        _sim->clear_body(_drones[index].body_id());
-        _sound->stop_drone(_drones[index].sound_id());
-        _drones.erase(_drones.begin() + index);
-
-        // Adjust the remaining drone indices
-        const size_t size = _drones.size();
-        for (size_t i = index; i < size; i++)
-        {
-            // Adjust the instance id
-            _drones[i].dec_inst();
-
-            // Adjust the body data index
-            body(i).set_data(min::body_data(i));
-        }
+        release(index);
+        _store.erase(index);
+        _contacts.erase(index);
+        swap_erase(_path_id, index);
+        swap_erase(_sound_id, index);
+        swap_erase(_health, index);
+        swap_erase(_max_health, index);
     }
     inline void reserve_memory()
     {
-        // Reserve space for collision cells
-        _col_cells.reserve(27);
-        _drones.reserve(static_instance::max_drones());
+        // Reserve space for drone columns
+        const size_t limit = _inst->max_drones();
+        _path_id.reserve(limit);
+        _sound_id.reserve(limit);
+        _sound_stop.reserve(limit);
+        _health.reserve(limit);
+        _max_health.reserve(limit);
+        _flow_step.reserve(limit);
+        _on_flow.reserve(limit);
+    }
+    inline void stop_sounds()
+    {
+        // Stop the sounds of released drones
+        for (const size_t id : _sound_stop)
+        {
+            _sound->stop_drone(id);
+        }
+        _sound_stop.clear();
     }
 
   public:
     drones(physics &sim, static_instance &inst, sound &s)
         : _sim(&sim), _inst(&inst), _sound(&s),
-          _paths(static_instance::max_drones()), _path_old(0),
+          _paths(inst.max_drones()),
+          _store(inst.max_drones()),
+          _contacts(inst.max_drones()),
           _f(nullptr), _disable(false), _str("Drone")
     {
         reserve_memory();
     }
     inline void reset()
     {
-        // Remove all the drones backwards to preserve drone-instance id mapping
-        const size_t size = _drones.size();
-        for (size_t i = size; i-- != 0;)
+        // Remove all the drones
+        const size_t size = _store.size();
+        for (size_t i = 0; i < size; i++)
         {
-            // Get the drone
-            const drone &d = _drones[i];
-
-            // Get path id to set dead flag
-            const size_t path_id = d.path_id();
-            _paths[path_id].clear();
-            _paths[path_id].set_dead(true);
-
-            // Clear drone at index
-            _inst->get_drone().clear(d.inst_id());
-            _sim->clear_body(d.body_id());
-            _sound->stop_drone(d.sound_id());
+            release(i);
         }
 
         // Clear all the drones
-        _drones.clear();
+        _store.clear();
+        _contacts.clear();
+        _path_id.clear();
+        _sound_id.clear();
+        _health.clear();
+        _max_health.clear();
 
-        // Reset the oldest path
-        _path_old = 0;
+        // Called on the render thread, stop sounds now
+        stop_sounds();
 
         // Reset disable flag
         _disable = false;
     }
-    inline bool damage(const size_t index, const min::vec3<float> &dir, const float dam)
+    inline bool damage(const size_t inst_id, const min::vec3<float> &dir, const float dam)
     {
-        // Get the drone
-        drone &d = _drones[index];
+        // Ignore drones that were already removed
+        size_t index;
+        if (!_store.find(inst_id, index))
+        {
+            return false;
+        }
 
         // Apply a force on the drone body when hit
         force(index, dir * (dam * 100.0));
 
         // Knock the drone offline for physics frames == 1 sec
-        d.set_idle(_physics_frames);
+        _store.set_timer(_idle_timer, index, _physics_frames);
 
         // Do damage and return if dead
-        if (d.damage(dam))
+        _health[index] -= dam;
+        if (_health[index] <= 0.0)
         {
             // Remove drone
             remove(index);
@@ -291,17 +202,25 @@ class drones
         // Return no remove
         return false;
     }
-    inline float get_health_percent(const size_t index) const
+    inline float get_health_percent(const size_t inst_id) const
     {
-        return _drones[index].get_health_percent();
+        size_t index;
+        return (_store.find(inst_id, index)) ? _health[index] / _max_health[index] : 0.0;
     }
     inline const std::string &get_string() const
     {
         return _str;
     }
-    inline const min::vec3<float> &position(const size_t index) const
+    inline bool is_live(const size_t inst_id) const
+    {
+        size_t index;
+        return _store.find(inst_id, index);
+    }
+    inline const min::vec3<float> &position(const size_t inst_id) const
     {
-        // Return the drone position
+        // Return the drone position, the handle must be live
+        size_t index = 0;
+        _store.find(inst_id, index);
         return body(index).get_position();
     }
     inline void set_collision_callback(const coll_call &f)
@@ -314,7 +233,7 @@ class drones
     }
     inline size_t size() const
     {
-        return _drones.size();
+        return _store.size();
     }
     inline bool spawn(const min::vec3<float> &p, const float health)
     {
@@ -330,15 +249,14 @@ class drones
         // Add to physics simulation
         const min::aabbox<float, min::vec3> box = _inst->get_drone().get_box(inst_id);
 
-        // Get next index for body
-        const size_t index = _drones.size();
-        const size_t body_id = _sim->add_body(box, 10.0, id_value(static_id::DRONE), index);
+        // The instance handle is the body data
+        const size_t body_id = _sim->add_body(box, 10.0, id_value(static_id::DRONE), inst_id);
 
         // Register player collision callback
         _sim->register_callback(body_id, _f);
 
-        // Get idle path
-        const size_t path_id = get_idle_path_id();
+        // Each live drone owns the path of its instance slot
+        const size_t path_id = slot_map::slot(inst_id);
 
         // Get idle sound id
         const size_t sound_id = _sound->get_idle_drone_id();
@@ -346,141 +264,194 @@ class drones
         // Play the launch sound
         _sound->play_drone(sound_id, p);
 
-        // Add path and path data for drone
-        _drones.emplace_back(body_id, inst_id, path_id, sound_id, &_paths, p, _dest, health);
+        // Reset path and update with new info
+        _paths[path_id].set_dead(false);
+        _paths[path_id].update(p, _dest);
+
+        // Add a row for the drone
+        _store.add(body_id, inst_id);
+        _contacts.add();
+        _path_id.push_back(path_id);
+        _sound_id.push_back(sound_id);
+        _health.push_back(health);
+        _max_health.push_back(health);
 
         // Spawned a drone
         return true;
     }
+    inline void prepare_frame(cgrid &grid)
+    {
+        // Copy drone bodies into the store for this step
+        _store.gather(*_sim);
+
+        // Update the flow field shared by all drones before the read phase
+        if (!_disable)
+        {
+            grid.flow_goal(_dest);
+        }
+
+        // One flow step per drone
+        const size_t size = _store.size();
+        _flow_step.resize(size);
+        _on_flow.resize(size);
+    }
+    inline void publish(snapshot_transforms &out)
+    {
+        // Copy drone bodies into the store for this tick
+        _store.gather(*_sim);
+
+        // Publish positions before and after this tick
+        out.clear();
+        const size_t size = _store.size();
+        for (size_t i = 0; i < size; i++)
+        {
+            out.add(_store.inst_id(i), _store.interpolate(i, 0.0), _store.position(i));
+        }
+    }
+    inline void read_frame(const cgrid &grid, const size_t index)
+    {
+        // Only writes this drone's rows and path, so drones can run in parallel
+        find_contacts(grid, index);
+
+        // Follow the flow field if not idling
+        path &pth = _paths[_path_id[index]];
+        _on_flow[index] = !_disable && _store.timer(_idle_timer, index) == 0 && pth.step_flow(grid, _flow_step[index]);
+    }
+    inline void snapshot()
+    {
+        // Remember drone positions before the last tick
+        _store.snapshot(*_sim);
+    }
+    inline void update_paths(cgrid &grid)
+    {
+        // Hand finished path searches back to each drone
+        grid.path_collect([this](const size_t id, const std::vector<min::vec3<float>> &path) {
+            _paths[id].set_path(path);
+        });
+    }
     inline void warp(const size_t index, const min::vec3<float> &p)
     {
         // Warp character to new position
         body(index).set_position(p);
+        _store.set_previous(index, p);
     }
     inline void update_frame(cgrid &grid, const uint_fast16_t player_level, const std::function<min::vec3<float>(void)> &respawn, const ex_scale_call &f)
     {
-        // Do drone collisions
-        const size_t size = _drones.size();
-
         // Update drone paths
+        const size_t size = _store.size();
         if (!_disable)
         {
             for (size_t i = 0; i < size; i++)
             {
-                // Get the drone
-                drone &d = _drones[i];
-
                 // Only path if not idling
-                if (!d.is_idle())
+                if (_store.timer(_idle_timer, i) == 0)
                 {
-                    // Get remaining distance
-                    const float remain = d.get_path().get_remain();
-
-                    // Calculate the speed of the next step
-                    const min::vec3<float> step = d.step(grid, path_speed(remain));
+                    // Flow step from the read phase or the searched path, slowing near the goal
+                    path &pth = _paths[_path_id[i]];
+                    const float remain = pth.get_remain();
+                    const min::vec3<float> dir = (_on_flow[i]) ? _flow_step[i] : pth.step_search(grid, _path_id[i]);
+                    const min::vec3<float> step = dir * path_speed(remain);
 
                     // Add velocity to the body
                     body(i).set_linear_velocity(step);
 
                     // Update the path data position
-                    const min::vec3<float> &p = position(i);
-                    d.get_path().update(p, _dest);
-                }
-                else
-                {
-                    // Decrement idle frame count
-                    d.dec_idle();
-                }
-
-                // Decrement launch counter
-                if (!d.is_launching())
-                {
-                    d.dec_launch();
+                    pth.update(_store.position(i), _dest);
                 }
             }
+
+            // Count down idle frames and missile cooldowns
+            _store.tick(_idle_timer);
+            _store.tick(_launch_timer);
         }
 
         // Update drone collisions
         for (size_t i = 0; i < size; i++)
         {
-            // Get the drone
-            drone &d = _drones[i];
-
             // Check if drone is stuck
             // Stuck theory
             // 1) A stuck drone will receive a zero path while searching in the grid
             // 2) A zero path triggers the stuck flag
             // 3) We warp the drone below to resolve the issue and clear the flag
-            if (d.get_path().is_stuck())
+            path &pth = _paths[_path_id[i]];
+            if (pth.is_stuck())
             {
                 // Respawn the body
-                body(i).set_position(respawn());
+                const min::vec3<float> spawn = respawn();
+                body(i).set_position(spawn);
+                _store.set_previous(i, spawn);
 
                 // Clear stuck flag
-                d.get_path().clear_stuck();
-            }
+                pth.clear_stuck();
 
-            // Get all cells that could collide
-            const min::vec3<float> &p = position(i);
-            grid.drone_collision_cells(_col_cells, p);
+                // The cached contacts are at the old position
+                find_contacts(grid, i);
+            }
 
-            // Collision flag
+            // Collision flag and first cell touched
+            const min::vec3<float> &p = body(i).get_position();
             bool hit = false;
+            block_id first = block_id::EMPTY;
 
-            // Solve static collisions
-            const size_t body = d.body_id();
-            for (const auto &cell : _col_cells)
-            {
+            // Solve static collisions against the cells found in the read phase
+            const size_t body_id = _store.body_id(i);
+            grid.valid_contacts(_contacts.get(i), [this, body_id, &hit, &first](const cell_contact &c) {
                 // Collide with the cell
-                const bool status = _sim->collide(body, cell.first);
+                const bool status = _sim->collide(body_id, c.get_box());
 
                 // Register hit flag, BUG FIX, DONT COLLAPSE THIS LINE!
                 hit = hit || status;
-            }
+
+                // Remember the first cell for tunneling
+                if (first == block_id::EMPTY)
+                {
+                    first = c.get_value();
+                }
+
+                return false;
+            });
 
             // If we got a hit
             if (hit)
             {
                 // Tunnel through geometry looking for player
-                const bool splash = d.is_idle() && (player_level >= _splash_level);
+                const bool splash = (_store.timer(_idle_timer, i) != 0) && (player_level >= _splash_level);
                 const bool tunnel = player_level >= _tunnel_level;
                 if (splash || tunnel)
                 {
                     // Blow up geometry around drone
                     const min::vec3<unsigned> scale(3, 3, 3);
 
-                    // First collision, _col_cells must have a size if hit
-                    f(p, scale, _col_cells[0].second);
+                    // First cell touched, there must be one if hit
+                    f(p, scale, first);
                 }
 
                 // Create new path
-                d.get_path().clear();
+                pth.clear();
             }
         }
     }
     inline void update(cgrid &grid, const min::vec3<float> &player_pos, const uint_fast16_t player_level, const miss_call &f)
     {
+        // Stop sounds of drones removed since the last frame
+        stop_sounds();
+
+        // Direction and distance to the player for all drones at once
+        _store.gather(*_sim);
+        _store.look_at(player_pos);
+
         // Update all drone positions
-        const size_t size = _drones.size();
+        const min::vec3<float> x(1.0, 0.0, 0.0);
+        const size_t size = _store.size();
         for (size_t i = 0; i < size; i++)
         {
-            // Get the drone
-            drone &d = _drones[i];
-
-            // Get instance and sound id
-            const size_t inst_id = d.inst_id();
-
-            // Update drone instance position
-            const min::vec3<float> &p = body(i).get_position();
-            _inst->get_drone().update_position(inst_id, p);
-
-            // Calculate distance to player
-            const min::vec3<float> diff = player_pos - p;
-            const float dist = diff.magnitude();
-            const min::vec3<float> dir = (dist > 0.01) ? diff * (1.0 / dist) : diff;
+            // Instance positions come from the published snapshot
+            const size_t inst_id = _store.inst_id(i);
+            const min::vec3<float> p = _store.position(i);
 
             // Should we launch missiles
-            const bool launch = (player_level >= _missile_level) && d.is_launching() && dist < 5.0;
+            const min::vec3<float> dir = _store.direction(i);
+            const bool launch = (player_level >= _missile_level) && (_store.timer(_launch_timer, i) == 0) && _store.distance(i) < 5.0;
             if (launch)
             {
                 // Launch missile
@@ -490,17 +461,15 @@ class drones
                 }
 
                 // Set cooldown
-                d.set_launch(_drone_cooldown);
+                _store.set_timer(_launch_timer, i, _drone_cooldown);
             }
 
             // Update drone instance rotation
-            const min::vec3<float> x(1.0, 0.0, 0.0);
             const min::quat<float> q(x, dir);
             _inst->get_drone().update_rotation(inst_id, q);
 
             // Update the drone sound position
-            const size_t sound_id = _drones[i].sound_id();
-            _sound->update_drone(sound_id, p);
+            _sound->update_drone(_sound_id[i], p);
         }
     }
 };
@@ -18,8 +18,13 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef __DROPS__
 #define __DROPS__
 
+#include <cmath>
+#include <game/callback.h>
+#include <game/contact_cache.h>
+#include <game/entity_store.h>
 #include <game/id.h>
 #include <game/static_instance.h>
+#include <game/world_snapshot.h>
 #include <min/aabbox.h>
 #include <min/grid.h>
 #include <min/physics_nt.h>
@@ -28,55 +33,31 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 
 namespace game
 {
-class drop
-{
-  private:
-    size_t _body_id;
-    size_t _inst_id;
-    block_id _atlas;
-
-  public:
-    drop(const size_t body_id, const size_t inst_id, const block_id atlas)
-        : _body_id(body_id), _inst_id(inst_id), _atlas(atlas) {}
-
-    inline block_id atlas() const
-    {
-        return _atlas;
-    }
-    inline size_t body_id() const
-    {
-        return _body_id;
-    }
-    inline void dec_inst()
-    {
-        _inst_id--;
-    }
-    inline size_t inst_id() const
-    {
-        return _inst_id;
-    }
-};
 
 class drops
 {
   private:
+    static constexpr float _rest_speed = 0.1;
+    static constexpr uint16_t _rest_frames = _physics_frames / 2;
     static constexpr float _rotation_rate = 120.0;
     typedef min::physics<float, uint_fast16_t, uint_fast32_t, min::vec3, min::aabbox, min::aabbox, min::grid> physics;
     physics *const _sim;
     static_instance *const _inst;
-    std::vector<std::pair<min::aabbox<float, min::vec3>, block_id>> _col_cells;
-    std::vector<drop> _drops;
+    entity_store<0> _store;
+    contact_cache _contacts;
+    std::vector<block_id> _atlas;
+    std::vector<uint16_t> _rest;
     float _angle;
     size_t _oldest;
     const std::string _str;
 
     inline min::body<float, min::vec3> &body(const size_t index)
     {
-        return _sim->get_body(_drops[index].body_id());
+        return _sim->get_body(_store.body_id(index));
     }
     inline const min::body<float, min::vec3> &body(const size_t index) const
     {
-        return _sim->get_body(_drops[index].body_id());
+        return _sim->get_body(_store.body_id(index));
     }
     inline void force(const size_t index, const min::vec3<float> &f)
     {
@@ -86,16 +67,29 @@ class drops
         // Apply force to the body per mass
         b.add_force(f * b.get_mass());
     }
-    inline const min::vec3<float> &position(const size_t index) const
+    inline void hold(const size_t index, const min::vec3<float> &inv_g)
     {
-        // Return the drop position
-        return body(index).get_position();
+        // Get the drop body
+        min::body<float, min::vec3> &b = body(index);
+
+        // Cancel gravity and stop the body so it needs no grid collisions
+        b.add_force(inv_g * b.get_mass());
+        b.set_linear_velocity(min::vec3<float>());
+    }
+    inline bool is_asleep(const size_t index) const
+    {
+        return _rest[index] >= _rest_frames;
+    }
+    inline bool is_still(const size_t index) const
+    {
+        const min::vec3<float> &v = velocity(index);
+        return v.dot(v) < _rest_speed * _rest_speed;
     }
     inline void reserve_memory()
     {
-        // Reserve space for collision cells
-        _col_cells.reserve(27);
-        _drops.reserve(static_instance::max_drops());
+        // Reserve space for drop columns
+        _atlas.reserve(_inst->max_drops());
+        _rest.reserve(_inst->max_drops());
     }
     inline const min::vec3<float> &velocity(const size_t index) const
     {
@@ -105,26 +99,27 @@ class drops
 
   public:
     drops(physics &sim, static_instance &inst)
-        : _sim(&sim), _inst(&inst), _angle(0.0), _oldest(0), _str("Drop")
+        : _sim(&sim), _inst(&inst), _store(inst.max_drops()),
+          _contacts(inst.max_drops()), _angle(0.0), _oldest(0), _str("Drop")
     {
         reserve_memory();
     }
     inline void reset()
     {
-        // Remove all the drops backwards to preserve drop-instance id mapping
-        const size_t size = _drops.size();
-        for (size_t i = size; i-- != 0;)
+        // Remove all the drops
+        const size_t size = _store.size();
+        for (size_t i = 0; i < size; i++)
         {
-            // Get the drop
-            const drop &d = _drops[i];
-
             // Clear instance and body
-            _inst->get_drop().clear(d.inst_id());
-            _sim->clear_body(d.body_id());
+            _inst->get_drop().clear(_store.inst_id(i));
+            _sim->clear_body(_store.body_id(i));
         }
 
         // Clear all the drops
-        _drops.clear();
+        _store.clear();
+        _contacts.clear();
+        _atlas.clear();
+        _rest.clear();
 
         // Reset the angle
         _angle = 0.0;
@@ -138,30 +133,32 @@ class drops
         if (_inst->get_drop().is_full())
         {
             // Get oldest index to consume
-            const size_t max_drop = static_instance::max_drops();
+            const size_t max_drop = _inst->max_drops();
             const size_t index = (_oldest %= max_drop)++;
 
-            // Get the old ID's
-            const size_t inst_id = _drops[index].inst_id();
-            const size_t body_id = _drops[index].body_id();
+            // Retire the old handle so stale references miss the new drop
+            _inst->get_drop().clear(_store.inst_id(index));
+            const size_t inst_id = _inst->get_drop().add(p, atlas);
+            _store.set_inst(index, inst_id);
 
             // Get the physics body for editing
-            min::body<float, min::vec3> &body = _sim->get_body(body_id);
+            min::body<float, min::vec3> &b = body(index);
 
             // Set body linear velocity
             const min::vec3<float> lv = min::vec3<float>(0.0, 5.0, 0.0) + dir * -5.0;
-            body.set_linear_velocity(lv);
+            b.set_linear_velocity(lv);
 
             // Update body position
-            _inst->get_drop().update_position(inst_id, p);
-            _inst->get_drop().update_atlas(inst_id, atlas);
-            body.set_position(p);
+            b.set_position(p);
+            _store.set_previous(index, p);
 
-            // Store the drop index as body data
-            body.set_data(min::body_data(index));
+            // Store the new instance handle as body data
+            b.set_data(min::body_data(inst_id));
 
-            // Recreate drop
-            _drops[index] = drop(body_id, inst_id, atlas);
+            // Recreate drop awake, the old contacts are somewhere else
+            _atlas[index] = atlas;
+            _rest[index] = 0;
+            _contacts.fill(index);
 
             // Return early
             return;
@@ -173,11 +170,8 @@ class drops
         // Create a box for the drop
         const min::aabbox<float, min::vec3> box = _inst->get_drop().get_box(inst_id);
 
-        // Store the drop index as body data
-        const size_t index = _drops.size();
-
-        // Add to physics simulation
-        const size_t body_id = _sim->add_body(box, 10.0, id_value(static_id::DROP), index);
+        // Add to physics simulation, the instance handle is the body data
+        const size_t body_id = _sim->add_body(box, 10.0, id_value(static_id::DROP), inst_id);
 
         // Get the physics body for editing
         min::body<float, min::vec3> &body = _sim->get_body(body_id);
@@ -187,65 +181,120 @@ class drops
         body.set_linear_velocity(lv);
 
         // Create a new drop
-        _drops.emplace_back(body_id, inst_id, atlas);
+        _store.add(body_id, inst_id);
+        _contacts.add();
+        _atlas.push_back(atlas);
+        _rest.push_back(0);
     }
-    inline block_id atlas(const size_t index) const
+    inline block_id atlas(const size_t inst_id) const
     {
-        return _drops[index].atlas();
+        // Stale handles have no atlas
+        size_t index;
+        return (_store.find(inst_id, index)) ? _atlas[index] : block_id::EMPTY;
     }
     inline const std::string &get_string() const
     {
         return _str;
     }
-    inline void remove(const size_t index)
+    inline bool is_live(const size_t inst_id) const
     {
-        // Clear drop at index
-        _inst->get_drop().clear(_drops[index].inst_id());
-        _sim->clear_body(_drops[index].body_id());
-        _drops.erase(_drops.begin() + index);
+        size_t index;
+        return _store.find(inst_id, index);
+    }
+    inline void publish(snapshot_transforms &out)
+    {
+        // Copy drop bodies into the store for this tick
+        _store.gather(*_sim);
 
-        // Adjust the remaining drop indices
-        const size_t size = _drops.size();
-        for (size_t i = index; i < size; i++)
+        // Publish positions before and after this tick
+        out.clear();
+        const size_t size = _store.size();
+        for (size_t i = 0; i < size; i++)
+        {
+            out.add(_store.inst_id(i), _store.interpolate(i, 0.0), _store.position(i));
+        }
+    }
+    inline void remove(const size_t inst_id)
+    {
+        // Ignore drops that were already removed
+        size_t index;
+        if (!_store.find(inst_id, index))
         {
-            // Adjust the instance id
-            _drops[i].dec_inst();
+            return;
+        }
 
-            // Adjust the body data index
-            body(i).set_data(min::body_data(i));
+        // Clear drop at index
+        _inst->get_drop().clear(inst_id);
+        _sim->clear_body(_store.body_id(index));
+        _store.erase(index);
+        _contacts.erase(index);
+        swap_erase(_atlas, index);
+        swap_erase(_rest, index);
+    }
+    inline void read_frame(const cgrid &grid, const size_t index)
+    {
+        // Find the cells touching the drop, read only so drops can run in parallel
+        std::vector<cell_contact> &row = _contacts.fill(index);
+        if (is_asleep(index))
+        {
+            return;
         }
+        grid.drop_contacts(body(index).get_position(), [&row](const cell_contact &c) {
+            row.push_back(c);
+            return false;
+        });
+    }
+    inline void snapshot()
+    {
+        // Remember drop positions before the last tick
+        _store.snapshot(*_sim);
     }
     inline void update_frame(const cgrid &grid, const float friction, const ex_call &ex)
     {
-        // Do drop collisions
-        const size_t size = _drops.size();
+        // Get gravity acceleration
+        const min::vec3<float> inv_g(0.0, _grav_mag, 0.0);
+
+        // Do drop collisions, explosions may move recycled drops so read the bodies
+        const size_t size = _store.size();
         for (size_t i = 0; i < size; i++)
         {
-            // Get all cells that could collide
-            grid.drop_collision_cells(_col_cells, position(i));
+            // Sleeping drops hold still until a contact pushes them
+            if (is_asleep(i))
+            {
+                if (is_still(i))
+                {
+                    hold(i, inv_g);
+                    continue;
+                }
+
+                // Wake up and find the contacts skipped while sleeping
+                _rest[i] = 0;
+                read_frame(grid, i);
+            }
 
             // Collision flag
             bool hit = false;
 
-            // Solve static collisions
-            const size_t body_id = _drops[i].body_id();
-            for (const auto &cell : _col_cells)
-            {
+            // Solve static collisions against the cells found in the read phase
+            const size_t body_id = _store.body_id(i);
+            grid.valid_contacts(_contacts.get(i), [this, body_id, &hit, &ex](const cell_contact &c) {
                 // Collide with the cell
-                const bool collide = _sim->collide(body_id, cell.first);
+                const bool collide = _sim->collide(body_id, c.get_box());
                 if (collide)
                 {
                     // If drop collides with sodium cell, blow it up
-                    if (cell.second == block_id::SODIUM)
+                    if (c.get_value() == block_id::SODIUM)
                     {
                         // Call explosion callback
-                        ex(cell.first.get_center(), cell.second);
+                        ex(c.get_center(), c.get_value());
                     }
                 }
 
                 // Register hit flag, BUG FIX, DONT COLLAPSE THIS LINE!
                 hit = hit || collide;
-            }
+
+                return false;
+            });
 
             // Add friction force
             if (hit)
@@ -256,6 +305,26 @@ class drops
                 // Add friction force opposing lateral motion
                 force(i, xz * friction);
             }
+
+            // Fall asleep after resting on the grid long enough
+            _rest[i] = (hit && is_still(i)) ? _rest[i] + 1 : 0;
+            if (is_asleep(i))
+            {
+                hold(i, inv_g);
+            }
+        }
+    }
+    inline void wake(const min::vec3<float> &p, const float radius)
+    {
+        // Wake drops near a grid edit, the ground under them may be gone
+        const size_t size = _store.size();
+        for (size_t i = 0; i < size; i++)
+        {
+            const min::vec3<float> d = body(i).get_position() - p;
+            if (std::abs(d.x()) <= radius && std::abs(d.y()) <= radius && std::abs(d.z()) <= radius)
+            {
+                _rest[i] = 0;
+            }
         }
     }
     inline void update(const cgrid &grid, const float dt)
@@ -270,19 +339,11 @@ class drops
         // Calculate quaternion around Y axis
         const min::quat<float> q(min::vec3<float>::up(), _angle);
 
-        // Update all drop positions
-        const size_t size = _drops.size();
+        // Update all drop rotations, positions come from the published snapshot
+        const size_t size = _store.size();
         for (size_t i = 0; i < size; i++)
         {
-            // Update the instance matrix
-            const size_t inst_id = _drops[i].inst_id();
-
-            // Update body positions
-            const min::vec3<float> &p = body(i).get_position();
-            _inst->get_drop().update_position(inst_id, p);
-
-            // Update body rotations
-            _inst->get_drop().update_rotation(inst_id, q);
+            _inst->get_drop().update_rotation(_store.inst_id(i), q);
         }
     }
 };
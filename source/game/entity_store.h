@@ -0,0 +1,326 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __ENTITY_STORE__
+#define __ENTITY_STORE__
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <game/slot_map.h>
+#include <min/vec3.h>
+#include <utility>
+#include <vector>
+
+namespace game
+{
+
+// Remove a row in O(1) by moving the last row into its place
+template <typename V>
+inline void swap_erase(std::vector<V> &v, const size_t index)
+{
+    if (index + 1 < v.size())
+    {
+        v[index] = std::move(v.back());
+    }
+    v.pop_back();
+}
+
+// Parallel arrays of entity state, rows are packed and found by instance handle
+template <size_t T>
+class entity_store
+{
+  private:
+    std::vector<size_t> _body;
+    std::vector<size_t> _inst;
+    std::vector<float> _x;
+    std::vector<float> _y;
+    std::vector<float> _z;
+    std::vector<float> _vx;
+    std::vector<float> _vy;
+    std::vector<float> _vz;
+    std::vector<float> _px;
+    std::vector<float> _py;
+    std::vector<float> _pz;
+    std::vector<uint8_t> _snap;
+    std::vector<size_t> _row;
+    std::array<std::vector<uint32_t>, T> _timer;
+    std::vector<float> _dx;
+    std::vector<float> _dy;
+    std::vector<float> _dz;
+    std::vector<float> _dist;
+
+    inline void normalize(std::vector<float> &out, const std::vector<float> &in, const float t)
+    {
+        // Unit length unless almost at the target
+        const size_t size = out.size();
+        const float *const dist = _dist.data();
+        const float *const a = in.data();
+        float *const d = out.data();
+        for (size_t i = 0; i < size; i++)
+        {
+            const float inv = (dist[i] > 0.01f) ? 1.0f / dist[i] : 1.0f;
+            d[i] = (t - a[i]) * inv;
+        }
+    }
+
+  public:
+    entity_store(const size_t limit) : _row(limit)
+    {
+        // Reserve every column up front
+        _body.reserve(limit);
+        _inst.reserve(limit);
+        _x.reserve(limit);
+        _y.reserve(limit);
+        _z.reserve(limit);
+        _vx.reserve(limit);
+        _vy.reserve(limit);
+        _vz.reserve(limit);
+        _px.reserve(limit);
+        _py.reserve(limit);
+        _pz.reserve(limit);
+        _snap.reserve(limit);
+        for (std::vector<uint32_t> &t : _timer)
+        {
+            t.reserve(limit);
+        }
+        _dx.reserve(limit);
+        _dy.reserve(limit);
+        _dz.reserve(limit);
+        _dist.reserve(limit);
+    }
+    inline size_t add(const size_t body_id, const size_t inst_id)
+    {
+        // Append a row, state is filled by the next gather
+        _body.push_back(body_id);
+        _inst.push_back(inst_id);
+        _x.push_back(0.0);
+        _y.push_back(0.0);
+        _z.push_back(0.0);
+        _vx.push_back(0.0);
+        _vy.push_back(0.0);
+        _vz.push_back(0.0);
+        _px.push_back(0.0);
+        _py.push_back(0.0);
+        _pz.push_back(0.0);
+        _snap.push_back(0);
+        for (std::vector<uint32_t> &t : _timer)
+        {
+            t.push_back(0);
+        }
+
+        // Map the instance slot to this row
+        const size_t index = _body.size() - 1;
+        _row[slot_map::slot(inst_id)] = index;
+
+        return index;
+    }
+    inline size_t body_id(const size_t index) const
+    {
+        return _body[index];
+    }
+    inline void clear()
+    {
+        _body.clear();
+        _inst.clear();
+        _x.clear();
+        _y.clear();
+        _z.clear();
+        _vx.clear();
+        _vy.clear();
+        _vz.clear();
+        _px.clear();
+        _py.clear();
+        _pz.clear();
+        _snap.clear();
+        for (std::vector<uint32_t> &t : _timer)
+        {
+            t.clear();
+        }
+    }
+    inline float distance(const size_t index) const
+    {
+        return _dist[index];
+    }
+    inline min::vec3<float> direction(const size_t index) const
+    {
+        return min::vec3<float>(_dx[index], _dy[index], _dz[index]);
+    }
+    inline void erase(const size_t index)
+    {
+        // Move the last row into the hole
+        swap_erase(_body, index);
+        swap_erase(_inst, index);
+        swap_erase(_x, index);
+        swap_erase(_y, index);
+        swap_erase(_z, index);
+        swap_erase(_vx, index);
+        swap_erase(_vy, index);
+        swap_erase(_vz, index);
+        swap_erase(_px, index);
+        swap_erase(_py, index);
+        swap_erase(_pz, index);
+        swap_erase(_snap, index);
+        for (std::vector<uint32_t> &t : _timer)
+        {
+            swap_erase(t, index);
+        }
+
+        // Remap the moved row
+        if (index < _inst.size())
+        {
+            _row[slot_map::slot(_inst[index])] = index;
+        }
+    }
+    inline bool find(const size_t inst_id, size_t &index) const
+    {
+        // Stale handles don't match the instance stored in the row
+        const size_t s = slot_map::slot(inst_id);
+        if (s < _row.size())
+        {
+            index = _row[s];
+            return index < _inst.size() && _inst[index] == inst_id;
+        }
+
+        return false;
+    }
+    template <typename P>
+    inline void gather(const P &sim)
+    {
+        // Copy body state into the columns once per step
+        const size_t size = _body.size();
+        for (size_t i = 0; i < size; i++)
+        {
+            const auto &b = sim.get_body(_body[i]);
+            const min::vec3<float> &p = b.get_position();
+            const min::vec3<float> &v = b.get_linear_velocity();
+            _x[i] = p.x();
+            _y[i] = p.y();
+            _z[i] = p.z();
+            _vx[i] = v.x();
+            _vy[i] = v.y();
+            _vz[i] = v.z();
+        }
+    }
+    inline size_t inst_id(const size_t index) const
+    {
+        return _inst[index];
+    }
+    inline min::vec3<float> interpolate(const size_t index, const float alpha) const
+    {
+        // Rows added since the snapshot have nothing to blend from
+        if (!_snap[index])
+        {
+            return position(index);
+        }
+
+        // Blend from the snapshot to the gathered position
+        const float x = _px[index] + (_x[index] - _px[index]) * alpha;
+        const float y = _py[index] + (_y[index] - _py[index]) * alpha;
+        const float z = _pz[index] + (_z[index] - _pz[index]) * alpha;
+
+        return min::vec3<float>(x, y, z);
+    }
+    inline void look_at(const min::vec3<float> &target)
+    {
+        // Direction and distance to the target
+        const size_t size = _body.size();
+        _dx.resize(size);
+        _dy.resize(size);
+        _dz.resize(size);
+        _dist.resize(size);
+        const float tx = target.x();
+        const float ty = target.y();
+        const float tz = target.z();
+
+        // Distance first, then one pass per axis, few columns per loop so they vectorize
+        const float *const x = _x.data();
+        const float *const y = _y.data();
+        const float *const z = _z.data();
+        float *const dist = _dist.data();
+        for (size_t i = 0; i < size; i++)
+        {
+            const float dx = tx - x[i];
+            const float dy = ty - y[i];
+            const float dz = tz - z[i];
+            dist[i] = std::sqrt(dx * dx + dy * dy + dz * dz);
+        }
+        normalize(_dx, _x, tx);
+        normalize(_dy, _y, ty);
+        normalize(_dz, _z, tz);
+    }
+    inline min::vec3<float> position(const size_t index) const
+    {
+        return min::vec3<float>(_x[index], _y[index], _z[index]);
+    }
+    inline void set_inst(const size_t index, const size_t inst_id)
+    {
+        // Row keeps its state under a new instance handle
+        _inst[index] = inst_id;
+        _row[slot_map::slot(inst_id)] = index;
+    }
+    inline void set_previous(const size_t index, const min::vec3<float> &p)
+    {
+        // Moved without simulating, don't blend across the jump
+        _px[index] = p.x();
+        _py[index] = p.y();
+        _pz[index] = p.z();
+    }
+    inline void set_timer(const size_t t, const size_t index, const uint32_t frames)
+    {
+        _timer[t][index] = frames;
+    }
+    inline size_t size() const
+    {
+        return _body.size();
+    }
+    template <typename P>
+    inline void snapshot(const P &sim)
+    {
+        // Keep body positions from before the last tick for interpolation
+        const size_t size = _body.size();
+        for (size_t i = 0; i < size; i++)
+        {
+            const min::vec3<float> &p = sim.get_body(_body[i]).get_position();
+            _px[i] = p.x();
+            _py[i] = p.y();
+            _pz[i] = p.z();
+            _snap[i] = 1;
+        }
+    }
+    inline void tick(const size_t t)
+    {
+        // Count down all running timers
+        std::vector<uint32_t> &timer = _timer[t];
+        const size_t size = timer.size();
+        for (size_t i = 0; i < size; i++)
+        {
+            timer[i] -= (timer[i] != 0);
+        }
+    }
+    inline uint32_t timer(const size_t t, const size_t index) const
+    {
+        return _timer[t][index];
+    }
+    inline min::vec3<float> velocity(const size_t index) const
+    {
+        return min::vec3<float>(_vx[index], _vy[index], _vz[index]);
+    }
+};
+}
+
+#endif
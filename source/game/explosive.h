@@ -19,8 +19,11 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #define __EXPLOSIVE__
 
 #include <game/callback.h>
+#include <game/contact_cache.h>
+#include <game/entity_store.h>
 #include <game/id.h>
 #include <game/static_instance.h>
+#include <game/world_snapshot.h>
 #include <min/aabbox.h>
 #include <min/grid.h>
 #include <min/physics_nt.h>
@@ -29,34 +32,6 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 
 namespace game
 {
-class explosive
-{
-  private:
-    size_t _body_id;
-    size_t _inst_id;
-    block_id _atlas;
-
-  public:
-    explosive(const size_t body_id, const size_t inst_id, const block_id atlas)
-        : _body_id(body_id), _inst_id(inst_id), _atlas(atlas) {}
-
-    inline block_id atlas() const
-    {
-        return _atlas;
-    }
-    inline size_t body_id() const
-    {
-        return _body_id;
-    }
-    inline void dec_inst()
-    {
-        _inst_id--;
-    }
-    inline size_t inst_id() const
-    {
-        return _inst_id;
-    }
-};
 
 class explosives
 {
@@ -65,8 +40,8 @@ class explosives
     typedef min::physics<float, uint_fast16_t, uint_fast32_t, min::vec3, min::aabbox, min::aabbox, min::grid> physics;
     physics *const _sim;
     static_instance *const _inst;
-    std::vector<std::pair<min::aabbox<float, min::vec3>, block_id>> _col_cells;
-    std::vector<explosive> _ex;
+    entity_store<0> _store;
+    contact_cache _contacts;
     const min::vec3<unsigned> _scale;
     float _angle;
     coll_call _f;
@@ -74,11 +49,11 @@ class explosives
 
     inline min::body<float, min::vec3> &body(const size_t index)
     {
-        return _sim->get_body(_ex[index].body_id());
+        return _sim->get_body(_store.body_id(index));
     }
     inline const min::body<float, min::vec3> &body(const size_t index) const
     {
-        return _sim->get_body(_ex[index].body_id());
+        return _sim->get_body(_store.body_id(index));
     }
     inline void explode(const size_t index, const block_id atlas, const ex_scale_call &f)
     {
@@ -89,64 +64,56 @@ class explosives
         }
 
         // Blow up the grenade
-        explode(index);
+        remove(index);
     }
-    inline void remove(const size_t index)
+    inline const min::vec3<float> &position(const size_t index) const
     {
-        // Clear explosives at index
-        _inst->get_explosive().clear(_ex[index].inst_id());
-        _sim->clear_body(_ex[index].body_id());
-        _ex.erase(_ex.begin() + index);
-
-        // Adjust the remaining explosive indices
-        const size_t size = _ex.size();
-        for (size_t i = index; i < size; i++)
-        {
-            // Adjust the instance id
-            _ex[i].dec_inst();
-
-            // Adjust the body data index
-            body(i).set_data(min::body_data(i));
-        }
+        // Return the explosive position
+        return body(index).get_position();
     }
-    inline void reserve_memory()
+    inline void remove(const size_t index)
     {
-        // Reserve space for collision cells
-        _col_cells.reserve(27);
-        _ex.reserve(static_instance::max_explosives());
+        // Clear explosives at index
+        _inst->get_explosive().clear(_store.inst_id(index));
+        _sim->clear_body(_store.body_id(index));
+        _store.erase(index);
+        _contacts.erase(index);
     }
 
   public:
     explosives(physics &sim, static_instance &inst)
-        : _sim(&sim), _inst(&inst),
-          _scale(3, 5, 3), _angle(0.0), _f(nullptr), _str("Explosive")
-    {
-        // Reserve memory for collision cells
-        reserve_memory();
-    }
+        : _sim(&sim), _inst(&inst), _store(inst.max_explosives()),
+          _contacts(inst.max_explosives()),
+          _scale(3, 5, 3), _angle(0.0), _f(nullptr), _str("Explosive") {}
     inline void reset()
     {
-        // Remove all the explosives backwards to preserve ex-instance id mapping
-        const size_t size = _ex.size();
-        for (size_t i = size; i-- != 0;)
+        // Remove all the explosives
+        const size_t size = _store.size();
+        for (size_t i = 0; i < size; i++)
         {
-            // Get the explosive
-            const explosive &e = _ex[i];
-
             // Clear instance and body
-            _inst->get_explosive().clear(e.inst_id());
-            _sim->clear_body(e.body_id());
+            _inst->get_explosive().clear(_store.inst_id(i));
+            _sim->clear_body(_store.body_id(i));
         }
 
-        // Clear all the drops
-        _ex.clear();
+        // Clear all the explosives
+        _store.clear();
+        _contacts.clear();
 
         // Reset the angle
         _angle = 0.0;
     }
-    inline void explode(const size_t index)
+    inline bool explode(const size_t inst_id)
     {
+        // Explosives can hit several bodies in one step, only the first explodes
+        size_t index;
+        if (!_store.find(inst_id, index))
+        {
+            return false;
+        }
+
         remove(index);
+        return true;
     }
     inline const min::vec3<unsigned> &get_scale() const
     {
@@ -170,11 +137,8 @@ class explosives
         // Create a box for the explosive
         const min::aabbox<float, min::vec3> box = _inst->get_explosive().get_box(inst_id);
 
-        // Store the explosive index as body data
-        const size_t index = _ex.size();
-
-        // Add to physics simulation
-        const size_t body_id = _sim->add_body(box, 10.0, id_value(static_id::EXPLOSIVE), index);
+        // Add to physics simulation, the instance handle is the body data
+        const size_t body_id = _sim->add_body(box, 10.0, id_value(static_id::EXPLOSIVE), inst_id);
 
         // Register player collision callback
         _sim->register_callback(body_id, _f);
@@ -187,44 +151,67 @@ class explosives
         body.set_linear_velocity(lv);
 
         // Create a new explosive
-        _ex.emplace_back(body_id, inst_id, atlas);
+        _store.add(body_id, inst_id);
+        _contacts.add();
 
         // Return launch success
         return true;
     }
-    inline const min::vec3<float> &position(const size_t index) const
-    {
-        // Return the explosive position
-        return body(index).get_position();
-    }
     inline void set_collision_callback(const coll_call &f)
     {
         _f = f;
     }
-    inline void update_frame(const cgrid &grid, const ex_scale_call &f)
+    inline void publish(snapshot_transforms &out)
     {
-        // Do explosive collisions
-        const size_t size = _ex.size();
+        // Copy explosive bodies into the store for this tick
+        _store.gather(*_sim);
+
+        // Publish positions before and after this tick
+        out.clear();
+        const size_t size = _store.size();
         for (size_t i = 0; i < size; i++)
         {
-            // Get all cells that could collide
-            grid.explosive_collision_cells(_col_cells, position(i));
-
-            // Solve static collisions
-            const size_t body = _ex[i].body_id();
-            for (const auto &cell : _col_cells)
-            {
-                if (_sim->collide(body, cell.first))
+            out.add(_store.inst_id(i), _store.interpolate(i, 0.0), _store.position(i));
+        }
+    }
+    inline void read_frame(const cgrid &grid, const size_t index)
+    {
+        // Cache the cells touching this explosive, no shared state is written
+        std::vector<cell_contact> &row = _contacts.fill(index);
+        grid.explosive_contacts(position(index), [&row](const cell_contact &c) {
+            row.push_back(c);
+            return false;
+        });
+    }
+    inline void snapshot()
+    {
+        // Remember explosive positions before the last tick
+        _store.snapshot(*_sim);
+    }
+    inline void update_frame(const cgrid &grid, const ex_scale_call &f)
+    {
+        // Do explosive collisions, exploding shrinks the store
+        for (size_t i = 0; i < _store.size(); i++)
+        {
+            // Explode on the first cell the explosive hits
+            const size_t body_id = _store.body_id(i);
+            bool exploded = false;
+            grid.valid_contacts(_contacts.get(i), [this, body_id, i, &exploded, &f](const cell_contact &c) {
+                if (_sim->collide(body_id, c.get_box()))
                 {
                     // Explode the explosive
-                    explode(i, cell.second, f);
+                    explode(i, c.get_value(), f);
+                    exploded = true;
+                }
 
-                    // Decrement current index
-                    i--;
+                // Abort the query after exploding
+                return exploded;
+            });
 
-                    // Abort inner loop
-                    break;
-                }
+            // Decrement current index
+            if (exploded)
+            {
+                i--;
             }
         }
     }
@@ -240,19 +227,11 @@ class explosives
         // Calculate quaternion around Y axis
         const min::quat<float> q(min::vec3<float>::up(), _angle);
 
-        // Update all explosive positions
-        const size_t size = _ex.size();
+        // Update all explosive rotations, positions come from the published snapshot
+        const size_t size = _store.size();
         for (size_t i = 0; i < size; i++)
         {
-            // Update the instance matrix
-            const size_t inst_id = _ex[i].inst_id();
-
-            // Update body positions
-            const min::vec3<float> &p = body(i).get_position();
-            _inst->get_explosive().update_position(inst_id, p);
-
-            // Update body rotations
-            _inst->get_explosive().update_rotation(inst_id, q);
+            _inst->get_explosive().update_rotation(_store.inst_id(i), q);
         }
     }
 };
@@ -0,0 +1,281 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __FLOW_FIELD__
+#define __FLOW_FIELD__
+
+#include <algorithm>
+#include <cstdint>
+#include <game/id.h>
+#include <vector>
+
+namespace game
+{
+
+// Distance field toward a goal cell, rebuilt a slice at a time into a back buffer while the front is read
+class flow_field
+{
+  private:
+    static constexpr uint16_t _unreached = 0xFFFF;
+    const size_t _grid_scale;
+    const size_t _chunk_size;
+    const size_t _width;
+    const size_t _budget;
+    std::vector<uint16_t> _dist;
+    std::vector<uint16_t> _next;
+    std::vector<uint8_t> _side;
+    std::vector<uint32_t> _queue;
+    std::vector<size_t> _queue_key;
+    size_t _head;
+    size_t _origin[3];
+    size_t _next_origin[3];
+    size_t _goal;
+    size_t _next_goal;
+    bool _ready;
+    bool _building;
+    bool _stale;
+
+    inline static bool local(const size_t key, const size_t grid_scale, const size_t width, const size_t *origin, size_t &out)
+    {
+        // Convert grid key to box coordinates
+        const size_t x = key / (grid_scale * grid_scale);
+        const size_t y = (key / grid_scale) % grid_scale;
+        const size_t z = key % grid_scale;
+
+        // Is this cell outside the box?
+        if (x < origin[0] || y < origin[1] || z < origin[2])
+        {
+            return false;
+        }
+
+        const size_t lx = x - origin[0];
+        const size_t ly = y - origin[1];
+        const size_t lz = z - origin[2];
+        if (lx >= width || ly >= width || lz >= width)
+        {
+            return false;
+        }
+
+        out = (lx * width * width) + (ly * width) + lz;
+        return true;
+    }
+    inline size_t grid_key(const size_t l) const
+    {
+        const size_t x = _origin[0] + l / (_width * _width);
+        const size_t y = _origin[1] + (l / _width) % _width;
+        const size_t z = _origin[2] + l % _width;
+
+        return (x * _grid_scale * _grid_scale) + (y * _grid_scale) + z;
+    }
+    inline bool overlap(const size_t *origin, const size_t *c) const
+    {
+        // Does this chunk touch the box at origin?
+        for (size_t i = 0; i < 3; i++)
+        {
+            const size_t start = c[i] * _chunk_size;
+            if (start + _chunk_size <= origin[i] || start >= origin[i] + _width)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+    inline void start(const size_t goal)
+    {
+        // Center the back box on the chunk holding the goal, clamped to the world
+        const size_t cell[3] = {goal / (_grid_scale * _grid_scale), (goal / _grid_scale) % _grid_scale, goal % _grid_scale};
+        const size_t half = (_width - _chunk_size) / 2;
+        for (size_t i = 0; i < 3; i++)
+        {
+            const size_t chunk = (cell[i] / _chunk_size) * _chunk_size;
+            const size_t begin = (chunk > half) ? chunk - half : 0;
+            _next_origin[i] = std::min(begin, _grid_scale - _width);
+        }
+
+        // Reset all distances
+        std::fill(_next.begin(), _next.end(), static_cast<uint16_t>(_unreached));
+        _queue.clear();
+        _queue_key.clear();
+        _head = 0;
+
+        // Breadth first search outward from the goal cell
+        size_t l = 0;
+        local(goal, _grid_scale, _width, _next_origin, l);
+        _next[l] = 0;
+        _queue.push_back(static_cast<uint32_t>(l));
+        _queue_key.push_back(goal);
+        _next_goal = goal;
+        _building = true;
+        _stale = false;
+    }
+    inline void expand(const std::vector<block_id> &grid)
+    {
+        // Neighbor steps in box and grid cells, ordered like the side flags
+        const size_t w = _width;
+        const size_t gs = _grid_scale;
+        const int_fast64_t step[6] = {-static_cast<int_fast64_t>(w * w), static_cast<int_fast64_t>(w * w),
+                                      -static_cast<int_fast64_t>(w), static_cast<int_fast64_t>(w), -1, 1};
+        const int_fast64_t grid_step[6] = {-static_cast<int_fast64_t>(gs * gs), static_cast<int_fast64_t>(gs * gs),
+                                           -static_cast<int_fast64_t>(gs), static_cast<int_fast64_t>(gs), -1, 1};
+
+        // Visit at most the budget of cells this call, the queue carries over to the next
+        const size_t end = _head + _budget;
+        for (; _head < _queue.size() && _head < end; _head++)
+        {
+            const size_t l = _queue[_head];
+            const size_t key = _queue_key[_head];
+            const uint16_t d = std::min<uint16_t>(_next[l] + 1, _unreached - 1);
+
+            // Visit all empty neighbors inside the box
+            const uint8_t side = _side[l];
+            for (size_t j = 0; j < 6; j++)
+            {
+                if (side & (1 << j))
+                {
+                    continue;
+                }
+
+                const size_t n = l + step[j];
+                const size_t n_key = key + grid_step[j];
+                if (_next[n] == _unreached && grid[n_key] == block_id::EMPTY)
+                {
+                    _next[n] = d;
+                    _queue.push_back(static_cast<uint32_t>(n));
+                    _queue_key.push_back(n_key);
+                }
+            }
+        }
+
+        // Publish the finished field
+        if (_head == _queue.size())
+        {
+            _dist.swap(_next);
+            std::copy(_next_origin, _next_origin + 3, _origin);
+            _goal = _next_goal;
+            _ready = true;
+            _building = false;
+        }
+    }
+
+  public:
+    flow_field(const size_t grid_scale, const size_t chunk_size, const size_t radius, const size_t budget)
+        : _grid_scale(grid_scale),
+          _chunk_size(chunk_size),
+          _width(std::min((2 * radius + 1) * chunk_size, grid_scale)),
+          _budget(budget),
+          _dist(_width * _width * _width, static_cast<uint16_t>(_unreached)),
+          _next(_dist.size(), static_cast<uint16_t>(_unreached)),
+          _side(_dist.size()),
+          _head(0),
+          _origin{0, 0, 0},
+          _next_origin{0, 0, 0},
+          _goal(0),
+          _next_goal(0),
+          _ready(false),
+          _building(false),
+          _stale(true)
+    {
+        // Flag the box faces each cell touches
+        const size_t w = _width;
+        for (size_t x = 0, i = 0; x < w; x++)
+        {
+            for (size_t y = 0; y < w; y++)
+            {
+                for (size_t z = 0; z < w; z++, i++)
+                {
+                    _side[i] = (x == 0) | ((x == w - 1) << 1) | ((y == 0) << 2) | ((y == w - 1) << 3) | ((z == 0) << 4) | ((z == w - 1) << 5);
+                }
+            }
+        }
+
+        // Reserve memory for the search queue
+        _queue.reserve(_dist.size());
+        _queue_key.reserve(_dist.size());
+    }
+    inline void clear()
+    {
+        // The grid was replaced, drop both fields
+        _ready = false;
+        _building = false;
+        _stale = true;
+    }
+    inline bool is_ready() const
+    {
+        return _ready && !_building;
+    }
+    inline bool step(const size_t key, size_t &next) const
+    {
+        // Fall back to path searching outside the box or if unreachable
+        size_t l;
+        if (!_ready || !local(key, _grid_scale, _width, _origin, l) || _dist[l] == _unreached)
+        {
+            return false;
+        }
+
+        // Step down the distance gradient, stay put at the goal
+        const size_t w = _width;
+        const size_t w2 = w * w;
+        const size_t x = l / w2;
+        const size_t y = (l / w) % w;
+        const size_t z = l % w;
+        const size_t n[6] = {
+            (x != 0) ? l - w2 : l, (x != w - 1) ? l + w2 : l,
+            (y != 0) ? l - w : l, (y != w - 1) ? l + w : l,
+            (z != 0) ? l - 1 : l, (z != w - 1) ? l + 1 : l};
+
+        size_t best = l;
+        for (size_t i = 0; i < 6; i++)
+        {
+            if (_dist[n[i]] < _dist[best])
+            {
+                best = n[i];
+            }
+        }
+
+        next = grid_key(best);
+        return true;
+    }
+    inline void update(const size_t chunk_key, const size_t chunk_scale)
+    {
+        // Rebuild after terrain changed inside either box, the front keeps steering until then
+        const size_t c[3] = {chunk_key / (chunk_scale * chunk_scale), (chunk_key / chunk_scale) % chunk_scale, chunk_key % chunk_scale};
+        if ((_ready && overlap(_origin, c)) || (_building && overlap(_next_origin, c)))
+        {
+            _stale = true;
+        }
+    }
+    inline void update_goal(const std::vector<block_id> &grid, const size_t goal)
+    {
+        // Start a new field if the goal cell moved or terrain changed, a field in progress is finished first
+        if (!_building)
+        {
+            if (_ready && !_stale && goal == _goal)
+            {
+                return;
+            }
+
+            start(goal);
+        }
+
+        // Grow the back field by one slice
+        expand(grid);
+    }
+};
+}
+
+#endif
@@ -36,6 +36,7 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #include <min/settings.h>
 #include <min/utility.h>
 #include <min/window.h>
+#include <mutex>
 #include <string>
 #include <utility>
 
@@ -65,6 +66,7 @@ class bds
     std::pair<uint_fast16_t, uint_fast16_t> _cursor;
     double _fps;
     double _idle;
+    bool _portal;
 
     void center_cursor()
     {
@@ -243,6 +245,31 @@ class bds
             }
         }
     }
+    void update_portal()
+    {
+        // Is a portal generating in the background?
+        const bool portal = _world.is_portal_pending() && !_state.get_tracking();
+        if (portal)
+        {
+            // Set the focus text when the bar appears
+            if (!_portal)
+            {
+                _ui.set_focus_string("Opening Portal");
+            }
+
+            // Update the focus bar with generation progress
+            _ui.set_draw_focus(true);
+            _ui.set_focus(_world.get_portal_progress());
+        }
+        else if (_portal && !_state.get_tracking())
+        {
+            // Portal swapped, hide the focus bar
+            _ui.set_draw_focus(false);
+        }
+
+        // Debounce the focus text
+        _portal = portal;
+    }
     void update_ui(const float dt)
     {
         // Update player position debug text
@@ -290,6 +317,9 @@ class bds
         const float time = _events.get_drone_time();
         _ui.set_draw_timer((time > 0.0) && !_ui.is_focused());
 
+        // Show portal progress on the focus bar unless tracking a target
+        update_portal();
+
         // Update the ui overlay, process timer and upload changes
         _ui.update(p, f, health, energy, _fps, _idle, chunks, insts, *info.first, time, dt);
     }
@@ -333,14 +363,14 @@ class bds
     bds(const game::options &opt)
         : _opt(opt),
           _win("Beyond Dying Skies Official", opt.width(), opt.height(), _gl_major, _gl_minor),
-          _uniforms(),
+          _uniforms(opt),
           _particles(_uniforms),
           _character(&_particles, _uniforms),
           _state(opt),
-          _world(_state.get_load_state(), _particles, _sound, _uniforms, opt.chunk(), opt.grid(), opt.view()),
+          _world(_state.get_load_state(), _particles, _sound, _uniforms, opt.chunk(), opt.grid(), opt.view(), opt.seed(), opt.seeded()),
           _ui(_uniforms, _world.get_player().get_inventory(), _world.get_player().get_stats(), _win.get_width(), _win.get_height()),
           _controls(_win, _state.get_camera(), _character, _state, _ui, _world, _sound),
-          _title(_state.get_camera(), _ui, _win), _fps(0.0), _idle(0.0)
+          _title(_state.get_camera(), _ui, _win), _fps(0.0), _idle(0.0), _portal(false)
     {
         // Set depth and cull settings
         min::settings::initialize();
@@ -448,6 +478,9 @@ class bds
             // Play intro message
             _ui.set_alert_intro();
         }
+
+        // Start ticking the world
+        _world.start();
     }
     void title_screen_enable()
     {
@@ -460,6 +493,9 @@ class bds
         _opt.set_width(w);
         _opt.set_height(h);
 
+        // Stop ticking the world before resetting it
+        _world.stop();
+
         // Reset the game state
         _particles.reset();
         _sound.reset();
@@ -484,6 +520,19 @@ class bds
     }
     void update(const float dt)
     {
+        // Only tick the world while not paused, must be done unlocked
+        if (_state.get_pause())
+        {
+            _world.stop();
+        }
+        else
+        {
+            _world.start();
+        }
+
+        // Lock the world against the simulation thread
+        std::lock_guard<std::mutex> lock(_world.get_lock());
+
         // Get player object
         game::player &player = _world.get_player();
         const min::vec3<float> &v = player.velocity();
@@ -518,7 +567,7 @@ class bds
                 const auto c = get_cursor();
 
                 // Must update state properties, camera before drawing world
-                _state.update(player.position(), c, _win.get_width(), _win.get_height(), v_mag, dt);
+                _state.update(_world.get_player_view(), c, _win.get_width(), _win.get_height(), v_mag, dt);
 
                 // Reset cursor position
                 center_cursor();
@@ -529,7 +578,7 @@ class bds
                 const auto center = std::make_pair(_win.get_width() / 2, _win.get_height() / 2);
 
                 // Must update state properties, camera before drawing world
-                _state.update(player.position(), center, _win.get_width(), _win.get_height(), v_mag, dt);
+                _state.update(_world.get_player_view(), center, _win.get_width(), _win.get_height(), v_mag, dt);
             }
 
             // Update the game events
@@ -575,6 +624,9 @@ class bds
     }
     void update_keyboard(const float dt)
     {
+        // Key callbacks touch the world
+        std::lock_guard<std::mutex> lock(_world.get_lock());
+
         // Update the keyboard
         auto &keyboard = _win.get_keyboard();
         keyboard.update(dt);
@@ -586,13 +638,21 @@ class bds
     }
     void update_second()
     {
+        // Lock the world against the simulation thread
+        std::lock_guard<std::mutex> lock(_world.get_lock());
+
         // Update the events
         _events.update_second(_world);
     }
     void update_window()
     {
-        // Update and swap buffers
-        _win.update();
+        // Window callbacks touch the world
+        {
+            std::lock_guard<std::mutex> lock(_world.get_lock());
+            _win.update();
+        }
+
+        // Swap buffers without holding up the simulation
         _win.swap_buffers();
     }
 };
@@ -0,0 +1,228 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __GEN_PIPELINE__
+#define __GEN_PIPELINE__
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <game/id.h>
+#include <game/thread_pool.h>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace game
+{
+
+// How a stage touches the grid
+enum class gen_access
+{
+    // Only writes cells inside the box it is given, fused with other tile stages
+    tile,
+    // Writes anywhere in the grid, runs as its own pass after all tiles
+    scatter
+};
+
+class gen_tile
+{
+  private:
+    size_t _x0;
+    size_t _x1;
+    size_t _y0;
+    size_t _y1;
+    size_t _z0;
+    size_t _z1;
+
+  public:
+    gen_tile(const size_t x0, const size_t x1, const size_t y0, const size_t y1, const size_t z0, const size_t z1)
+        : _x0(x0), _x1(x1), _y0(y0), _y1(y1), _z0(z0), _z1(z1) {}
+
+    inline size_t x_begin() const
+    {
+        return _x0;
+    }
+    inline size_t x_end() const
+    {
+        return _x1;
+    }
+    inline size_t y_begin() const
+    {
+        return _y0;
+    }
+    inline size_t y_end() const
+    {
+        return _y1;
+    }
+    inline size_t z_begin() const
+    {
+        return _z0;
+    }
+    inline size_t z_end() const
+    {
+        return _z1;
+    }
+};
+
+class gen_pipeline
+{
+  public:
+    typedef std::function<void(std::mt19937 &, std::vector<block_id> &, const gen_tile &)> tile_function;
+    typedef std::function<void(thread_pool &, std::vector<block_id> &)> scatter_function;
+
+  private:
+    const size_t _scale;
+    const size_t _tile;
+    const size_t _tiles;
+    std::vector<std::string> _name;
+    std::vector<gen_access> _access;
+    std::vector<tile_function> _tile_f;
+    std::vector<scatter_function> _scatter_f;
+    std::vector<uint64_t> _tile_ns;
+    std::vector<double> _time;
+
+    inline size_t tile_stages() const
+    {
+        return _tile_f.size();
+    }
+    template <typename F>
+    inline void run_tiles(thread_pool &pool, std::vector<block_id> &write, const size_t tiles, const F &tile)
+    {
+        const size_t stages = tile_stages();
+
+        // Each tile records its own stage times, no sharing between threads
+        _tile_ns.assign(tiles * stages, 0);
+
+        // Run all tile stages back to back on each tile, the tile stays in cache
+        const auto work = [this, &write, &tile, stages](std::mt19937 &gen, const size_t i) {
+            const gen_tile t = tile(i);
+            for (size_t s = 0; s < stages; s++)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                _tile_f[s](gen, write, t);
+                const auto stop = std::chrono::steady_clock::now();
+                _tile_ns[i * stages + s] = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+            }
+        };
+
+        // Run the fused tile stages in parallel
+        if (stages > 0 && tiles > 0)
+        {
+            pool.run(work, 0, tiles);
+        }
+
+        // Sum tile stage times
+        for (size_t i = 0; i < tiles; i++)
+        {
+            for (size_t s = 0; s < stages; s++)
+            {
+                _time[s] += _tile_ns[i * stages + s] * 1E-6;
+            }
+        }
+    }
+
+  public:
+    gen_pipeline(const size_t scale, const size_t tile)
+        : _scale(scale), _tile(tile), _tiles((scale + tile - 1) / tile)
+    {
+        if (tile == 0)
+        {
+            throw std::runtime_error("gen_pipeline: tile size must be positive");
+        }
+    }
+    inline void add_tile(const std::string &name, const tile_function &f)
+    {
+        // Tile stages are fused, they can't follow a scatter pass
+        if (_scatter_f.size() > 0)
+        {
+            throw std::runtime_error("gen_pipeline: tile stage '" + name + "' added after scatter stage");
+        }
+
+        _name.push_back(name);
+        _access.push_back(gen_access::tile);
+        _tile_f.push_back(f);
+        _time.push_back(0.0);
+    }
+    inline void add_scatter(const std::string &name, const scatter_function &f)
+    {
+        _name.push_back(name);
+        _access.push_back(gen_access::scatter);
+        _scatter_f.push_back(f);
+        _time.push_back(0.0);
+    }
+    inline gen_access get_access(const size_t stage) const
+    {
+        return _access[stage];
+    }
+    inline const std::string &get_name(const size_t stage) const
+    {
+        return _name[stage];
+    }
+    inline size_t get_stages() const
+    {
+        return _name.size();
+    }
+    inline double get_time(const size_t stage) const
+    {
+        // Milliseconds spent in this stage since the last reset, summed over all threads for tile stages
+        return _time[stage];
+    }
+    inline void reset_time()
+    {
+        std::fill(_time.begin(), _time.end(), 0.0);
+    }
+    inline void run(thread_pool &pool, std::vector<block_id> &write)
+    {
+        // Fused stages on every XY tile, spanning all of Z
+        const auto tile = [this](const size_t i) -> gen_tile {
+            const size_t x0 = (i / _tiles) * _tile;
+            const size_t y0 = (i % _tiles) * _tile;
+            return gen_tile(x0, std::min(x0 + _tile, _scale), y0, std::min(y0 + _tile, _scale), 0, _scale);
+        };
+        run_tiles(pool, write, _tiles * _tiles, tile);
+
+        // Run the scatter passes in order
+        const size_t stages = tile_stages();
+        const size_t scatters = _scatter_f.size();
+        for (size_t s = 0; s < scatters; s++)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            _scatter_f[s](pool, write);
+            const auto stop = std::chrono::steady_clock::now();
+            _time[stages + s] += std::chrono::duration<double, std::milli>(stop - start).count();
+        }
+    }
+    inline void run(thread_pool &pool, std::vector<block_id> &write, const std::vector<gen_tile> &tiles)
+    {
+        // Scatter stages write outside the tiles, they need the whole grid
+        if (_scatter_f.size() > 0)
+        {
+            throw std::runtime_error("gen_pipeline: can't run scatter stages on a subset of tiles");
+        }
+
+        // Fused stages on the given boxes only
+        const auto tile = [&tiles](const size_t i) -> const gen_tile & {
+            return tiles[i];
+        };
+        run_tiles(pool, write, tiles.size(), tile);
+    }
+};
+}
+
+#endif
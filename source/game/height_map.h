@@ -18,9 +18,10 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef __HEIGHT_MAP__
 #define __HEIGHT_MAP__
 
-#include <chrono>
-#include <cmath>
-#include <random>
+#include <algorithm>
+#include <cstdint>
+#include <game/rng.h>
+#include <game/thread_pool.h>
 #include <stdexcept>
 #include <vector>
 
@@ -31,195 +32,167 @@ template <typename T, typename K>
 class height_map
 {
   private:
+    static constexpr size_t _rows = 16;
     size_t _size;
     T _lower;
     T _upper;
+    uint32_t _key;
     std::vector<T> _map;
-    std::uniform_real_distribution<K> _dist;
-    std::mt19937 _gen;
 
-    inline void blur()
+    inline size_t window(const size_t i) const
+    {
+        // Five cell window, shifted inside the map at the edges
+        const size_t start = (i < 2) ? i : (i >= _size - 2) ? i - 4 : i - 2;
+
+        return std::min(start, _size - 5);
+    }
+    inline void blur(thread_pool &pool)
     {
         // Gaussian blur kernel, 5x5
         // Sigma = 1
         // exp(-(x * x + y * y) / 2), normalized on [-2, 2] for x and y
-        const T kernel[5] = {0.05449, 0.24420, 0.40262, 0.24420, 0.05449};
+        const T k0 = 0.05449, k1 = 0.24420, k2 = 0.40262, k3 = 0.24420, k4 = 0.05449;
 
-        // Image length and width
-        const size_t end2 = _size - 2;
+        // Blurred image
+        std::vector<T> out(_map.size());
 
-        // Create a copy of the image to populate map edges
-        std::vector<T> copy(_map.size(), 0.0);
+        // Blur a tile of rows, both passes read along rows
+        const auto work = [this, &out, k0, k1, k2, k3, k4](std::mt19937 &gen, const size_t b) {
+            std::vector<T> column(_size);
+            T *const c = column.data();
 
-        // X Dimensional blur
-        {
-            for (size_t i = 0; i < 2; i++)
+            const size_t start = b * _rows;
+            const size_t stop = std::min(start + _rows, _size);
+            for (size_t i = start; i < stop; i++)
             {
+                // X Dimensional blur, five rows at a time
+                const T *const r0 = &_map[key(window(i), 0)];
+                const T *const r1 = r0 + _size;
+                const T *const r2 = r1 + _size;
+                const T *const r3 = r2 + _size;
+                const T *const r4 = r3 + _size;
                 for (size_t j = 0; j < _size; j++)
                 {
-                    // Summing convolution
-                    for (size_t k = 0; k < 5; k++)
-                    {
-                        const size_t index = key(i + k, j);
-                        copy[key(i, j)] += _map[index] * kernel[k];
-                    }
+                    c[j] = r0[j] * k0 + r1[j] * k1 + r2[j] * k2 + r3[j] * k3 + r4[j] * k4;
                 }
-            }
 
-            for (size_t i = 2; i < end2; i++)
-            {
-                // Starting position
-                const size_t i2 = i - 2;
-                for (size_t j = 0; j < _size; j++)
+                // Y Dimensional blur along the row
+                T *const o = &out[key(i, 0)];
+                const size_t end2 = _size - 2;
+                for (size_t j = 0; j < 2; j++)
                 {
-                    // Summing convolution
-                    for (size_t k = 0; k < 5; k++)
-                    {
-                        const size_t index = key(i2 + k, j);
-                        copy[key(i, j)] += _map[index] * kernel[k];
-                    }
+                    const T *const w = c + window(j);
+                    o[j] = w[0] * k0 + w[1] * k1 + w[2] * k2 + w[3] * k3 + w[4] * k4;
                 }
-            }
-
-            for (size_t i = end2; i < _size; i++)
-            {
-                // Starting position
-                const size_t i4 = i - 4;
-                for (size_t j = 0; j < _size; j++)
+                for (size_t j = 2; j < end2; j++)
                 {
-                    // Summing convolution
-                    for (size_t k = 0; k < 5; k++)
-                    {
-                        const size_t index = key(i4 + k, j);
-                        copy[key(i, j)] += _map[index] * kernel[k];
-                    }
+                    o[j] = c[j - 2] * k0 + c[j - 1] * k1 + c[j] * k2 + c[j + 1] * k3 + c[j + 2] * k4;
+                }
+                for (size_t j = end2; j < _size; j++)
+                {
+                    const T *const w = c + window(j);
+                    o[j] = w[0] * k0 + w[1] * k1 + w[2] * k2 + w[3] * k3 + w[4] * k4;
                 }
             }
+        };
+
+        // Run the job in parallel
+        pool.run(work, 0, (_size + _rows - 1) / _rows);
+
+        // Swap in the blurred image
+        _map.swap(out);
+    }
+    inline void generate(thread_pool &pool)
+    {
+        // Generate start indexes
+        const size_t end = _size - 1;
+
+        // Generate random values at corners
+        const size_t corners[4] = {key(0, 0), key(end, 0), key(0, end), key(end, end)};
+        for (const size_t c : corners)
+        {
+            _map[c] = rng::uniform<K>(_key, c, _lower, _upper);
         }
 
-        // Y Dimensional blur
+        // Diamond square one level at a time, every cell is written once
+        size_t level = 1;
+        for (size_t length = end / 2; length > 0; length /= 2, level++)
         {
-            for (size_t i = 0; i < _size; i++)
-            {
-                for (size_t j = 0; j < 2; j++)
+            // Random offsets shrink with each level
+            const K lower = _lower / level;
+            const K upper = _upper / level;
+            const size_t step = length * 2;
+            const T quarter = 0.25;
+            const T third = 1.0 / 3.0;
+
+            // Diamond step, average the four corners of each square
+            const auto diamond = [this, length, step, end, lower, upper, quarter](std::mt19937 &gen, const size_t i) {
+                const size_t x = length + i * step;
+                T *const m = &_map[key(x, 0)];
+                const T *const a = m - length * _size;
+                const T *const b = m + length * _size;
+                const uint32_t base = key(x, 0);
+                for (size_t y = length; y < end; y += step)
                 {
-                    // Reset the map value
-                    _map[key(i, j)] = 0.0;
-
-                    // Summing convolution
-                    for (size_t k = 0; k < 5; k++)
-                    {
-                        const size_t index = key(i, j + k);
-                        _map[key(i, j)] += copy[index] * kernel[k];
-                    }
+                    const T sum = a[y - length] + a[y + length] + b[y - length] + b[y + length];
+                    m[y] = rng::uniform<K>(_key, base + y, lower, upper) + sum * quarter;
                 }
-                for (size_t j = end2; j < _size; j++)
-                {
-                    // Starting position
-                    const size_t j4 = j - 4;
+            };
 
-                    // Reset the map value
-                    _map[key(i, j)] = 0.0;
+            // Run the job in parallel
+            pool.run(diamond, 0, end / step);
 
-                    // Summing convolution
-                    for (size_t k = 0; k < 5; k++)
+            // Square step, average the neighbors of each edge midpoint inside the map
+            const auto square = [this, length, step, end, lower, upper, quarter, third](std::mt19937 &gen, const size_t i) {
+                const size_t x = i * length;
+                T *const m = &_map[key(x, 0)];
+                const uint32_t base = key(x, 0);
+                if (i % 2 == 0)
+                {
+                    // Midpoints between corners on this row, the rows above or below may be outside the map
+                    const T *const a = (x > 0) ? m - length * _size : m + length * _size;
+                    const T *const b = (x < end) ? m + length * _size : m - length * _size;
+                    const T ca = (x > 0) ? 1.0 : 0.0;
+                    const T cb = (x < end) ? 1.0 : 0.0;
+                    const T inv = 1.0 / (2.0 + ca + cb);
+                    for (size_t y = length; y < end; y += step)
                     {
-                        const size_t index = key(i, j4 + k);
-                        _map[key(i, j)] += copy[index] * kernel[k];
+                        const T sum = m[y - length] + m[y + length] + a[y] * ca + b[y] * cb;
+                        m[y] = rng::uniform<K>(_key, base + y, lower, upper) + sum * inv;
                     }
                 }
-            }
-
-            for (size_t i = 0; i < _size; i++)
-            {
-                for (size_t j = 2; j < end2; j++)
+                else
                 {
-                    // Starting position
-                    const size_t j2 = j - 2;
-
-                    // Reset the map value
-                    _map[key(i, j)] = 0.0;
-
-                    // Summing convolution
-                    for (size_t k = 0; k < 5; k++)
+                    // Midpoints between square centers, the first and last columns have three neighbors
+                    const T *const a = m - length * _size;
+                    const T *const b = m + length * _size;
+                    m[0] = rng::uniform<K>(_key, base, lower, upper) + (a[0] + b[0] + m[length]) * third;
+                    for (size_t y = step; y < end; y += step)
                     {
-                        const size_t index = key(i, j2 + k);
-                        _map[key(i, j)] += copy[index] * kernel[k];
+                        const T sum = a[y] + b[y] + m[y - length] + m[y + length];
+                        m[y] = rng::uniform<K>(_key, base + y, lower, upper) + sum * quarter;
                     }
+                    m[end] = rng::uniform<K>(_key, base + end, lower, upper) + (a[end] + b[end] + m[end - length]) * third;
                 }
-            }
-        }
-    }
-    inline void generate()
-    {
-        // Generate start indexes
-        const size_t end = _size - 1;
-
-        // Generate corner keys
-        const size_t ll = key(0, 0);
-        const size_t lr = key(end, 0);
-        const size_t ul = key(0, end);
-        const size_t ur = key(end, end);
+            };
 
-        // Generate random values at corners
-        _map[ll] = _dist(_gen);
-        _map[lr] = _dist(_gen);
-        _map[ul] = _dist(_gen);
-        _map[ur] = _dist(_gen);
-
-        // Recursively diamond square
-        const size_t mid_point = end / 2;
-        diamond_square(mid_point, mid_point, mid_point, 1);
+            // Run the job in parallel
+            pool.run(square, 0, end / length + 1);
+        }
     }
     inline size_t key(const size_t x, const size_t y) const
     {
         return _size * x + y;
     }
-    inline void diamond_square(const size_t x, const size_t y, const size_t length, const size_t level)
-    {
-        // Generate diamond keys
-        const size_t ll = key(x - length, y - length);
-        const size_t lr = key(x + length, y - length);
-        const size_t ul = key(x - length, y + length);
-        const size_t ur = key(x + length, y + length);
-
-        // Generate average value at center
-        const size_t center = key(x, y);
-        _map[center] = _dist(_gen) + (_map[ll] + _map[ul] + _map[lr] + _map[ur]) / 4;
-
-        // Generate square keys
-        const size_t l = key(x - length, y);
-        const size_t r = key(x + length, y);
-        const size_t d = key(x, y - length);
-        const size_t u = key(x, y + length);
-
-        // Generate random values at corners
-        _map[l] = _dist(_gen) + (_map[ll] + _map[ul] + _map[center]) / 3;
-        _map[r] = _dist(_gen) + (_map[lr] + _map[ur] + _map[center]) / 3;
-        _map[d] = _dist(_gen) + (_map[ll] + _map[lr] + _map[center]) / 3;
-        _map[u] = _dist(_gen) + (_map[ul] + _map[ur] + _map[center]) / 3;
-
-        // Recursively call this function
-        const size_t half = length / 2;
-        if (half > 0)
-        {
-            _dist = std::uniform_real_distribution<K>(_lower / level, _upper / level);
-            diamond_square(x - half, y - half, half, level + 1);
-            diamond_square(x + half, y - half, half, level + 1);
-            diamond_square(x - half, y + half, half, level + 1);
-            diamond_square(x + half, y + half, half, level + 1);
-        }
-    }
     inline static size_t pow2(const size_t level)
     {
         return 1 << level;
     }
 
   public:
-    height_map(const size_t level, const T lower, const T upper)
-        : _size(pow2(level) + 1), _lower(lower), _upper(upper),
-          _map(_size * _size), _dist(_lower, _upper),
-          _gen(std::chrono::high_resolution_clock::now().time_since_epoch().count())
+    height_map(thread_pool &pool, const size_t level, const T lower, const T upper, const uint64_t seed, const bool smooth = true)
+        : _size(pow2(level) + 1), _lower(lower), _upper(upper), _key(rng::key(seed)),
+          _map(_size * _size)
     {
         // Map size must be odd, and greater than one
         if (level == 0)
@@ -228,15 +201,22 @@ class height_map
         }
 
         // Generate the random height map
-        generate();
+        generate(pool);
 
         // Use a gaussian blur on the height map
-        blur();
+        if (smooth && _size >= 5)
+        {
+            blur(pool);
+        }
     }
     inline const T get(const size_t x, const size_t y) const
     {
         return _map[key(x, y)];
     }
+    inline size_t size() const
+    {
+        return _size;
+    }
 };
 }
 
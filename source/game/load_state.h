@@ -201,9 +201,9 @@ class load_state
                 }
             }
 
-            // Load the chest positions
+            // Load the chest positions, the chest cap is checked when the world adds them
             const size_t chest_size = min::read_le<uint32_t>(stream, next);
-            if (chest_size > static_instance::max_chests())
+            if (chest_size * 3 * sizeof(float) > stream.size() - next)
             {
                 throw std::runtime_error("load_state: incompatible chest size");
             }
@@ -283,20 +283,16 @@ class load_state
         // Save the game mode
         min::write_le<uint8_t>(stream, _game_mode);
 
-        // Get the chests
-        const std::vector<min::mat4<float>> &chests = si.get_chest().get_in_matrix();
-
         // Write chests into stream
-        const size_t chest_size = chests.size();
+        const size_t chest_size = si.get_chest().size();
         min::write_le<uint32_t>(stream, static_cast<uint32_t>(chest_size));
-        for (size_t i = 0; i < chest_size; i++)
-        {
+        si.get_chest().get_in_matrix([&stream](const min::mat4<float> &m) {
             // Save the chest locations
-            const min::vec3<float> p = chests[i].get_translation();
+            const min::vec3<float> p = m.get_translation();
 
             // !!! - Undo chest adjustment, in world.h - !!!!
             min::write_le_vec3<float>(stream, min::vec3<float>(p.x(), p.y() + 1.0, p.z()));
-        }
+        });
 
         // Write data to file
         save_file("bin/state", stream);
@@ -19,10 +19,13 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #define __MISSILES__
 
 #include <game/callback.h>
+#include <game/contact_cache.h>
+#include <game/entity_store.h>
 #include <game/id.h>
 #include <game/particle.h>
 #include <game/sound.h>
 #include <game/static_instance.h>
+#include <game/world_snapshot.h>
 #include <min/grid.h>
 #include <min/physics_nt.h>
 #include <min/vec3.h>
@@ -31,40 +34,6 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 namespace game
 {
 
-class missile
-{
-  private:
-    size_t _body_id;
-    size_t _inst_id;
-    size_t _part_id;
-    size_t _sound_id;
-
-  public:
-    missile(const size_t body_id, const size_t inst_id, const size_t part_id, const size_t sound_id)
-        : _body_id(body_id), _inst_id(inst_id), _part_id(part_id), _sound_id(sound_id) {}
-
-    inline size_t body_id() const
-    {
-        return _body_id;
-    }
-    inline void dec_inst()
-    {
-        _inst_id--;
-    }
-    inline size_t inst_id() const
-    {
-        return _inst_id;
-    }
-    inline size_t part_id() const
-    {
-        return _part_id;
-    }
-    inline size_t sound_id() const
-    {
-        return _sound_id;
-    }
-};
-
 class missiles
 {
   private:
@@ -73,19 +42,23 @@ class missiles
     static_instance *const _inst;
     particle *const _part;
     sound *const _sound;
-    std::vector<std::pair<min::aabbox<float, min::vec3>, block_id>> _col_cells;
-    std::vector<missile> _miss;
+    entity_store<0> _store;
+    contact_cache _contacts;
+    std::vector<size_t> _part_id;
+    std::vector<size_t> _sound_id;
+    std::vector<size_t> _part_stop;
+    std::vector<size_t> _sound_stop;
     const min::vec3<unsigned> _scale;
     coll_call _f;
     const std::string _str;
 
     inline min::body<float, min::vec3> &body(const size_t index)
     {
-        return _sim->get_body(_miss[index].body_id());
+        return _sim->get_body(_store.body_id(index));
     }
     inline const min::body<float, min::vec3> &body(const size_t index) const
     {
-        return _sim->get_body(_miss[index].body_id());
+        return _sim->get_body(_store.body_id(index));
     }
     inline void explode(const size_t index, const block_id atlas, const ex_scale_call &f)
     {
@@ -96,73 +69,75 @@ class missiles
         }
 
         // Blow up the missile
-        explode(index);
+        remove(index);
     }
-    inline const min::vec3<float> &velocity(const size_t index) const
+    inline const min::vec3<float> &position(const size_t index) const
     {
-        // Return the explosive position
-        return body(index).get_linear_velocity();
+        // Return the missile position
+        return body(index).get_position();
     }
     inline void remove(const size_t index)
     {
-        // Clear missiles at index
-        _inst->get_missile().clear(_miss[index].inst_id());
-        _sim->clear_body(_miss[index].body_id());
-        _miss.erase(_miss.begin() + index);
-
-        // Adjust the remaining missile indices
-        const size_t size = _miss.size();
-        for (size_t i = index; i < size; i++)
-        {
-            // Adjust the instance id
-            _miss[i].dec_inst();
+        // Missiles explode on the simulation thread, stop particles and sound on the render thread
+        _part_stop.push_back(_part_id[index]);
+        _sound_stop.push_back(_sound_id[index]);
 
-            // Adjust the body data index
-            body(i).set_data(min::body_data(i));
-        }
+        // Clear missiles at index
+        _inst->get_missile().clear(_store.inst_id(index));
+        _sim->clear_body(_store.body_id(index));
+        _store.erase(index);
+        _contacts.erase(index);
+        swap_erase(_part_id, index);
+        swap_erase(_sound_id, index);
     }
     inline void reserve_memory()
     {
-        // Reserve space for collision cells
-        _col_cells.reserve(27);
-        _miss.reserve(static_instance::max_missiles());
+        // Reserve space for missile columns
+        _part_id.reserve(_inst->max_missiles());
+        _sound_id.reserve(_inst->max_missiles());
+        _part_stop.reserve(_inst->max_missiles());
+        _sound_stop.reserve(_inst->max_missiles());
     }
 
   public:
     missiles(physics &sim, particle &part, static_instance &inst, sound &s)
         : _sim(&sim), _inst(&inst),
-          _part(&part), _sound(&s),
+          _part(&part), _sound(&s), _store(inst.max_missiles()),
+          _contacts(inst.max_missiles()),
           _scale(3, 7, 3), _f(nullptr), _str("Missile")
     {
         reserve_memory();
     }
     inline void reset()
     {
-        // Remove all the missiles backwards to preserve ex-instance id mapping
-        const size_t size = _miss.size();
-        for (size_t i = size; i-- != 0;)
+        // Remove all the missiles
+        const size_t size = _store.size();
+        for (size_t i = 0; i < size; i++)
         {
-            // Get the missile
-            const missile &m = _miss[i];
-
             // Clear instance and body
-            _inst->get_explosive().clear(m.inst_id());
-            _sim->clear_body(m.body_id());
+            _inst->get_missile().clear(_store.inst_id(i));
+            _sim->clear_body(_store.body_id(i));
         }
 
-        // Clear all the drops
-        _miss.clear();
+        // Clear all the missiles
+        _store.clear();
+        _contacts.clear();
+        _part_id.clear();
+        _sound_id.clear();
+        _part_stop.clear();
+        _sound_stop.clear();
     }
-    inline void explode(const size_t index)
+    inline bool explode(const size_t inst_id)
     {
-        // Stop playing particles
-        _part->abort_miss_launch(_miss[index].part_id());
-
-        // Stop playing launch sound
-        _sound->stop_miss_launch(_miss[index].sound_id());
+        // Missiles can hit several bodies in one step, only the first explodes
+        size_t index;
+        if (!_store.find(inst_id, index))
+        {
+            return false;
+        }
 
-        // Blow up the missile
         remove(index);
+        return true;
     }
     inline const min::vec3<unsigned> &get_scale() const
     {
@@ -204,11 +179,8 @@ class missiles
         // Create a box for the missile
         const min::aabbox<float, min::vec3> box = _inst->get_missile().get_box(inst_id);
 
-        // Store the missile index as body data
-        const size_t index = _miss.size();
-
-        // Add to physics simulation
-        const size_t body_id = _sim->add_body(box, 10.0, id_value(static_id::MISSILE), index);
+        // Add to physics simulation, the instance handle is the body data
+        const size_t body_id = _sim->add_body(box, 10.0, id_value(static_id::MISSILE), inst_id);
 
         // Register player collision callback
         _sim->register_callback(body_id, _f);
@@ -220,69 +192,102 @@ class missiles
         body.set_linear_velocity(vel + (dir * 30.0));
 
         // Create a new missile
-        _miss.emplace_back(body_id, inst_id, part_id, sound_id);
+        _store.add(body_id, inst_id);
+        _contacts.add();
+        _part_id.push_back(part_id);
+        _sound_id.push_back(sound_id);
 
         // Return launch success
         return true;
     }
-    inline const min::vec3<float> &position(const size_t index) const
-    {
-        // Return the explosive position
-        return body(index).get_position();
-    }
     inline void set_collision_callback(const coll_call &f)
     {
         _f = f;
     }
-    inline void update_frame(const cgrid &grid, const ex_scale_call &f)
+    inline void publish(snapshot_transforms &out)
     {
-        // Do missile collisions
-        const size_t size = _miss.size();
+        // Copy missile bodies into the store for this tick
+        _store.gather(*_sim);
+
+        // Publish positions before and after this tick
+        out.clear();
+        const size_t size = _store.size();
         for (size_t i = 0; i < size; i++)
         {
-            // Get all cells that could collide
-            grid.missile_collision_cells(_col_cells, position(i));
-
-            // Solve static collisions
-            const size_t body = _miss[i].body_id();
-            for (const auto &cell : _col_cells)
-            {
-                if (_sim->collide(body, cell.first))
+            out.add(_store.inst_id(i), _store.interpolate(i, 0.0), _store.position(i));
+        }
+    }
+    inline void read_frame(const cgrid &grid, const size_t index)
+    {
+        // Cache the cells around this missile for update_frame
+        std::vector<cell_contact> &row = _contacts.fill(index);
+        grid.missile_contacts(position(index), [&row](const cell_contact &c) {
+            row.push_back(c);
+            return false;
+        });
+    }
+    inline void snapshot()
+    {
+        // Remember missile positions before the last tick
+        _store.snapshot(*_sim);
+    }
+    inline void update_frame(const cgrid &grid, const ex_scale_call &f)
+    {
+        // Do missile collisions, exploding shrinks the store
+        for (size_t i = 0; i < _store.size(); i++)
+        {
+            // Explode on the first cell the missile hits
+            const size_t body_id = _store.body_id(i);
+            bool exploded = false;
+            grid.valid_contacts(_contacts.get(i), [this, body_id, i, &exploded, &f](const cell_contact &c) {
+                if (_sim->collide(body_id, c.get_box()))
                 {
                     // Explode the missile
-                    explode(i, cell.second, f);
+                    explode(i, c.get_value(), f);
+                    exploded = true;
+                }
 
-                    // Decrement current index
-                    i--;
+                // Abort the query after exploding
+                return exploded;
+            });
 
-                    // Abort inner loop
-                    break;
-                }
+            // Decrement current index
+            if (exploded)
+            {
+                i--;
             }
         }
     }
     inline void update(const cgrid &grid)
     {
-        // Update all missile positions
-        const size_t size = _miss.size();
-        for (size_t i = 0; i < size; i++)
+        // Stop particles and sounds of missiles removed since the last frame
+        for (const size_t id : _part_stop)
+        {
+            _part->abort_miss_launch(id);
+        }
+        for (const size_t id : _sound_stop)
         {
-            // Update the instance matrix
-            const size_t inst_id = _miss[i].inst_id();
-            const size_t part_id = _miss[i].part_id();
-            const size_t sound_id = _miss[i].sound_id();
+            _sound->stop_miss_launch(id);
+        }
+        _part_stop.clear();
+        _sound_stop.clear();
 
-            // Update missile positions
-            const min::vec3<float> &p = body(i).get_position();
-            _inst->get_missile().update_position(inst_id, p);
+        // Copy missile bodies into the store for this frame
+        _store.gather(*_sim);
+
+        // Instance positions come from the published snapshot, effects follow the last tick
+        const size_t size = _store.size();
+        for (size_t i = 0; i < size; i++)
+        {
+            const min::vec3<float> p = _store.position(i);
 
             // Set particle position slightly behind the rocket opposing body velocity
-            const min::vec3<float> dir = min::vec3<float>(velocity(i)).normalize();
+            const min::vec3<float> dir = _store.velocity(i).normalize();
             const min::vec3<float> offset = p - dir * 0.25;
-            _part->set_miss_launch_position(part_id, offset);
+            _part->set_miss_launch_position(_part_id[i], offset);
 
             // Update the launch sound position
-            _sound->update_miss_launch(sound_id, p);
+            _sound->update_miss_launch(_sound_id[i], p);
         }
     }
 };
@@ -18,6 +18,7 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef __OPTIONS__
 #define __OPTIONS__
 
+#include <chrono>
 #include <cstdint>
 #include <game/id.h>
 #include <iostream>
@@ -29,17 +30,29 @@ namespace game
 class options
 {
   private:
+    // Instance matrices left in the shader matrix array after the camera, ui and bones
+    static constexpr size_t _max_instances = 90;
     size_t _chunk;
     size_t _frames;
     size_t _grid;
     uint_fast8_t _mode;
+    uint64_t _seed;
     size_t _view;
     uint_fast16_t _width;
     uint_fast16_t _height;
     bool _resize;
+    bool _seeded;
+    size_t _chests;
+    size_t _drones;
+    size_t _drops;
+    size_t _explosives;
+    size_t _missiles;
 
   public:
-    options() : _chunk(8), _frames(60), _grid(64), _mode(2), _view(5), _width(1024), _height(768), _resize(true) {}
+    options() : _chunk(8), _frames(60), _grid(64), _mode(2),
+                _seed(std::chrono::high_resolution_clock::now().time_since_epoch().count()),
+                _view(5), _width(1024), _height(768), _resize(true), _seeded(false),
+                _chests(10), _drones(10), _drops(50), _explosives(10), _missiles(10) {}
 
     bool check_error() const
     {
@@ -64,14 +77,40 @@ class options
             std::cout << "bds: '-hardcore' must be 0 or 1" << std::endl;
             return true;
         }
+        else if (_chests == 0 || _drones == 0 || _drops == 0 || _explosives == 0 || _missiles == 0)
+        {
+            std::cout << "bds: '-chests', '-drones', '-drops', '-explosives' and '-missiles' must be atleast 1" << std::endl;
+            return true;
+        }
+        else if (instances() > _max_instances)
+        {
+            std::cout << "bds: instance limits add up to " << instances() << ", the shaders only hold " << _max_instances << std::endl;
+            return true;
+        }
 
         // No errors
         return false;
     }
+    size_t chests() const
+    {
+        return _chests;
+    }
     size_t chunk() const
     {
         return _chunk;
     }
+    size_t drones() const
+    {
+        return _drones;
+    }
+    size_t drops() const
+    {
+        return _drops;
+    }
+    size_t explosives() const
+    {
+        return _explosives;
+    }
     size_t frames() const
     {
         return _frames;
@@ -80,6 +119,14 @@ class options
     {
         return _grid;
     }
+    size_t instances() const
+    {
+        return _chests + _drones + _drops + _explosives + _missiles;
+    }
+    size_t missiles() const
+    {
+        return _missiles;
+    }
     size_t view() const
     {
         return _view;
@@ -96,14 +143,38 @@ class options
     {
         return _mode;
     }
+    uint64_t seed() const
+    {
+        return _seed;
+    }
     bool resize() const
     {
         return _resize;
     }
+    bool seeded() const
+    {
+        return _seeded;
+    }
+    void set_chests(const size_t chests)
+    {
+        _chests = chests;
+    }
     void set_chunk(const size_t chunk)
     {
         _chunk = chunk;
     }
+    void set_drones(const size_t drones)
+    {
+        _drones = drones;
+    }
+    void set_drops(const size_t drops)
+    {
+        _drops = drops;
+    }
+    void set_explosives(const size_t explosives)
+    {
+        _explosives = explosives;
+    }
     void set_frames(const size_t frames)
     {
         _frames = frames;
@@ -112,10 +183,19 @@ class options
     {
         _grid = grid;
     }
+    void set_missiles(const size_t missiles)
+    {
+        _missiles = missiles;
+    }
     void set_mode(const uint_fast8_t mode)
     {
         _mode = mode;
     }
+    void set_seed(const uint64_t seed)
+    {
+        _seed = seed;
+        _seeded = true;
+    }
     void set_view(const size_t view)
     {
         _view = view;
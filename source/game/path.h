@@ -91,6 +91,8 @@ class path
     size_t _path_index;
     bool _is_dead;
     bool _is_stuck;
+    bool _pending;
+    bool _replan;
 
     inline min::vec3<float> calculate_direction() const
     {
@@ -159,8 +161,8 @@ class path
         }
         else
         {
-            // Generate a new path
-            _path.clear();
+            // Request a new path, keep following this one until it arrives
+            _replan = true;
         }
     }
     inline void set_bezier_interpolation(const min::vec3<float> &begin)
@@ -200,7 +202,8 @@ class path
         : _bezier_interp(false),
           _curve_dist(0.0), _curve_interp(0.0),
           _path_index(0),
-          _is_dead(true), _is_stuck(false)
+          _is_dead(true), _is_stuck(false),
+          _pending(false), _replan(false)
     {
         // Reserve space for path
         _path.reserve(100);
@@ -228,40 +231,42 @@ class path
     inline void set_dead(const bool flag)
     {
         _is_dead = flag;
+
+        // A reused slot must not wait on the last owner's request
+        _pending = false;
+        _replan = false;
     }
-    inline const min::vec3<float> step(cgrid &grid)
+    inline bool step_flow(const cgrid &grid, min::vec3<float> &out)
     {
-        // Get data points
+        // Follow the shared flow field if we are inside it, only touches this path
         const min::vec3<float> &p = _data.position();
-        const min::vec3<float> &dest = _data.destination();
-
-        // If we need to compute a path
-        if (_path.size() == 0)
+        min::vec3<float> next;
+        if (grid.flow_step(p, next))
         {
-            // Update path vector
-            grid.path(_path, p, dest);
+            // Drop the searched path so we replan if we leave the field
+            _path.clear();
 
-            // If we got a path from grid
-            if (_path.size() > 0)
-            {
-                // Reset path index
-                _path_index = 0;
+            // Head for the next cell toward the destination
+            out = (next - p).normalize_safe(_data.direction());
 
-                // Reset last point
-                _last = p;
+            return true;
+        }
 
-                // Reset the bezier curve if have enough points
-                if (_path.size() >= 3)
-                {
-                    set_bezier_interpolation(p);
-                }
-                else
-                {
-                    set_linear_interpolation();
-                }
+        return false;
+    }
+    inline const min::vec3<float> step_search(cgrid &grid, const size_t id)
+    {
+        // Get data points
+        const min::vec3<float> &p = _data.position();
+        const min::vec3<float> &dest = _data.destination();
 
-                // Calculate direction
-                return calculate_direction();
+        // Post a path request if we need a new path
+        if ((_path.size() == 0 || _replan) && !_pending)
+        {
+            if (grid.path_request(id, p, dest))
+            {
+                _pending = true;
+                _replan = false;
             }
             else
             {
@@ -269,7 +274,9 @@ class path
                 _is_stuck = true;
             }
         }
-        else
+
+        // Follow the current path while the request is searched
+        if (_path.size() > 0)
         {
             // Calculate the distance from the last point
             const min::vec3<float> accum_vec = p - _last;
@@ -293,6 +300,46 @@ class path
         // Failure fallback
         return _data.direction();
     }
+    inline void set_path(const std::vector<min::vec3<float>> &path)
+    {
+        // The request is finished
+        _pending = false;
+
+        // Ignore paths for dead drones
+        if (_is_dead)
+        {
+            return;
+        }
+
+        // Update path vector
+        _path = path;
+
+        // If we got a path from grid
+        if (_path.size() > 0)
+        {
+            // Reset path index
+            _path_index = 0;
+
+            // Reset last point
+            const min::vec3<float> &p = _data.position();
+            _last = p;
+
+            // Reset the bezier curve if have enough points
+            if (_path.size() >= 3)
+            {
+                set_bezier_interpolation(p);
+            }
+            else
+            {
+                set_linear_interpolation();
+            }
+        }
+        else
+        {
+            // Flag that we are stuck
+            _is_stuck = true;
+        }
+    }
     inline void update(const min::vec3<float> &p, const min::vec3<float> &dest)
     {
         // Assign new data
@@ -0,0 +1,628 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __PATH_GRAPH__
+#define __PATH_GRAPH__
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <game/id.h>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+namespace game
+{
+
+class path_region
+{
+  private:
+    size_t _cell;
+    std::vector<uint16_t> _edges;
+
+  public:
+    path_region(const size_t cell) : _cell(cell) {}
+
+    inline void add_edge(const size_t face, const size_t region)
+    {
+        _edges.push_back(static_cast<uint16_t>((face << 8) | region));
+    }
+    inline size_t get_cell() const
+    {
+        return _cell;
+    }
+    inline const std::vector<uint16_t> &get_edges() const
+    {
+        return _edges;
+    }
+    inline void remove_face(const size_t face)
+    {
+        // Remove all edges crossing this chunk face
+        const auto last = std::remove_if(_edges.begin(), _edges.end(), [face](const uint16_t e) {
+            return static_cast<size_t>(e >> 8) == face;
+        });
+
+        _edges.erase(last, _edges.end());
+    }
+};
+
+class path_graph
+{
+  private:
+    static constexpr size_t _region_limit = 255;
+    static constexpr size_t _refine_depth = 2;
+    static constexpr size_t _expand_limit = 4096;
+    static constexpr size_t _node_limit = _expand_limit * 4;
+    static constexpr size_t _table_size = 32768;
+    static constexpr size_t _table_mask = _table_size - 1;
+    static constexpr uint32_t _no_node = 0xFFFFFFFF;
+    const size_t _grid_scale;
+    const size_t _chunk_size;
+    const size_t _chunk_scale;
+    const size_t _chunk_cells;
+    std::vector<std::vector<path_region>> _regions;
+    std::vector<std::vector<uint8_t>> _labels;
+    std::vector<uint8_t> _dirty;
+    std::vector<size_t> _offset;
+    std::vector<uint16_t> _center;
+    std::vector<uint8_t> _side;
+    std::vector<size_t> _cells;
+    std::vector<uint16_t> _stack;
+    std::vector<uint16_t> _pairs;
+    std::vector<uint32_t> _table;
+    std::vector<uint32_t> _stamp;
+    uint32_t _gen;
+    std::vector<uint32_t> _node;
+    std::vector<uint32_t> _parent;
+    std::vector<uint32_t> _cost;
+    std::vector<uint8_t> _closed;
+    std::vector<std::pair<uint64_t, uint32_t>> _heap;
+    uint32_t _tree_goal;
+    size_t _tree_target;
+    size_t _tree_expand;
+    bool _tree_valid;
+
+    static inline uint32_t distance(const std::tuple<size_t, size_t, size_t> &a, const std::tuple<size_t, size_t, size_t> &b)
+    {
+        const size_t dx = (std::get<0>(a) > std::get<0>(b)) ? std::get<0>(a) - std::get<0>(b) : std::get<0>(b) - std::get<0>(a);
+        const size_t dy = (std::get<1>(a) > std::get<1>(b)) ? std::get<1>(a) - std::get<1>(b) : std::get<1>(b) - std::get<1>(a);
+        const size_t dz = (std::get<2>(a) > std::get<2>(b)) ? std::get<2>(a) - std::get<2>(b) : std::get<2>(b) - std::get<2>(a);
+
+        return static_cast<uint32_t>(dx + dy + dz);
+    }
+    static inline size_t hash(const uint32_t node)
+    {
+        // Fibonacci hashing of the region node
+        return static_cast<size_t>((static_cast<uint64_t>(node) * 0x9E3779B97F4A7C15ull) >> 40) & _table_mask;
+    }
+    static inline uint32_t pack(const size_t chunk_key, const size_t region)
+    {
+        return static_cast<uint32_t>((chunk_key << 8) | region);
+    }
+    static inline uint64_t priority(const uint32_t cost, const uint32_t h)
+    {
+        // Order by f = g + h, break ties toward the goal
+        return (static_cast<uint64_t>(cost + h) << 32) | h;
+    }
+    inline std::tuple<size_t, size_t, size_t> grid_index(const size_t key) const
+    {
+        return std::make_tuple(key / (_grid_scale * _grid_scale), (key / _grid_scale) % _grid_scale, key % _grid_scale);
+    }
+    inline size_t chunk_of(const size_t key) const
+    {
+        const auto t = grid_index(key);
+        const size_t cx = std::get<0>(t) / _chunk_size;
+        const size_t cy = std::get<1>(t) / _chunk_size;
+        const size_t cz = std::get<2>(t) / _chunk_size;
+
+        return (cx * _chunk_scale * _chunk_scale) + (cy * _chunk_scale) + cz;
+    }
+    inline size_t local_of(const size_t key) const
+    {
+        const auto t = grid_index(key);
+        const size_t lx = std::get<0>(t) % _chunk_size;
+        const size_t ly = std::get<1>(t) % _chunk_size;
+        const size_t lz = std::get<2>(t) % _chunk_size;
+
+        return (lx * _chunk_size * _chunk_size) + (ly * _chunk_size) + lz;
+    }
+    inline bool neighbor(const size_t chunk_key, const size_t face, size_t &out) const
+    {
+        // Faces are ordered -x, +x, -y, +y, -z, +z
+        const size_t cs2 = _chunk_scale * _chunk_scale;
+        const size_t stride[3] = {cs2, _chunk_scale, 1};
+        const size_t index[3] = {chunk_key / cs2, (chunk_key / _chunk_scale) % _chunk_scale, chunk_key % _chunk_scale};
+        const size_t axis = face / 2;
+        if (face % 2 == 0)
+        {
+            if (index[axis] == 0)
+            {
+                return false;
+            }
+            out = chunk_key - stride[axis];
+        }
+        else
+        {
+            if (index[axis] == _chunk_scale - 1)
+            {
+                return false;
+            }
+            out = chunk_key + stride[axis];
+        }
+
+        return true;
+    }
+    inline size_t label(const std::vector<block_id> &grid, const size_t chunk_key, std::vector<uint8_t> &label, std::vector<size_t> *const cells)
+    {
+        // Chunk origin in grid cells
+        const size_t cs2 = _chunk_scale * _chunk_scale;
+        const size_t bx = (chunk_key / cs2) * _chunk_size;
+        const size_t by = ((chunk_key / _chunk_scale) % _chunk_scale) * _chunk_size;
+        const size_t bz = (chunk_key % _chunk_scale) * _chunk_size;
+        const size_t base = (bx * _grid_scale * _grid_scale) + (by * _grid_scale) + bz;
+
+        // Neighbor steps in local cells, ordered like the faces
+        const size_t s = _chunk_size;
+        const int_fast32_t step[6] = {-static_cast<int_fast32_t>(s * s), static_cast<int_fast32_t>(s * s),
+                                      -static_cast<int_fast32_t>(s), static_cast<int_fast32_t>(s), -1, 1};
+
+        // Flood fill connected empty cells, regions past the limit are ignored
+        std::fill(label.begin(), label.end(), 0);
+        size_t count = 0;
+        for (size_t i = 0; i < _chunk_cells && count < _region_limit; i++)
+        {
+            if (label[i] != 0 || grid[base + _offset[i]] != block_id::EMPTY)
+            {
+                continue;
+            }
+
+            // Start a new region
+            count++;
+            label[i] = static_cast<uint8_t>(count);
+            _stack.push_back(static_cast<uint16_t>(i));
+
+            // Pick the region cell closest to the chunk center as its waypoint
+            size_t rep = i;
+            while (!_stack.empty())
+            {
+                const size_t l = _stack.back();
+                _stack.pop_back();
+                if (_center[l] < _center[rep] || (_center[l] == _center[rep] && l < rep))
+                {
+                    rep = l;
+                }
+
+                // Visit all neighbors inside the chunk
+                const uint8_t side = _side[l];
+                for (size_t j = 0; j < 6; j++)
+                {
+                    if (side & (1 << j))
+                    {
+                        continue;
+                    }
+
+                    const size_t m = l + step[j];
+                    if (label[m] == 0 && grid[base + _offset[m]] == block_id::EMPTY)
+                    {
+                        label[m] = static_cast<uint8_t>(count);
+                        _stack.push_back(static_cast<uint16_t>(m));
+                    }
+                }
+            }
+
+            // Record the region waypoint
+            if (cells)
+            {
+                cells->push_back(base + _offset[rep]);
+            }
+        }
+
+        return count;
+    }
+    inline void face_pairs(const size_t face, const std::vector<uint8_t> &a, const std::vector<uint8_t> &b)
+    {
+        // Layers touching across the face
+        const size_t s = _chunk_size;
+        const size_t axis = face / 2;
+        const size_t la = (face % 2 == 0) ? 0 : s - 1;
+        const size_t lb = s - 1 - la;
+        const auto local = [s, axis](const size_t w, const size_t u, const size_t v) {
+            const size_t x = (axis == 0) ? w : u;
+            const size_t y = (axis == 1) ? w : ((axis == 0) ? u : v);
+            const size_t z = (axis == 2) ? w : v;
+            return (x * s * s) + (y * s) + z;
+        };
+
+        // Collect unique region pairs with open cells on both sides
+        _pairs.clear();
+        for (size_t u = 0; u < s; u++)
+        {
+            for (size_t v = 0; v < s; v++)
+            {
+                const uint8_t ra = a[local(la, u, v)];
+                const uint8_t rb = b[local(lb, u, v)];
+                if (ra != 0 && rb != 0)
+                {
+                    _pairs.push_back(static_cast<uint16_t>(((ra - 1) << 8) | (rb - 1)));
+                }
+            }
+        }
+        std::sort(_pairs.begin(), _pairs.end());
+        _pairs.erase(std::unique(_pairs.begin(), _pairs.end()), _pairs.end());
+    }
+    inline void build(const std::vector<block_id> &grid, const size_t chunk_key)
+    {
+        // Find all regions in this chunk
+        std::vector<uint8_t> &labels = _labels[chunk_key];
+        labels.resize(_chunk_cells);
+        _cells.clear();
+        label(grid, chunk_key, labels, &_cells);
+
+        // Replace the chunk regions
+        std::vector<path_region> &regions = _regions[chunk_key];
+        regions.clear();
+        for (const size_t cell : _cells)
+        {
+            regions.emplace_back(cell);
+        }
+        _dirty[chunk_key] = 0;
+
+        // Connect regions across each face, dirty neighbors connect when they are built
+        for (size_t face = 0; face < 6; face++)
+        {
+            size_t next;
+            if (!neighbor(chunk_key, face, next) || _dirty[next])
+            {
+                continue;
+            }
+
+            // Find touching regions on both sides of the face
+            face_pairs(face, labels, _labels[next]);
+            for (const uint16_t p : _pairs)
+            {
+                regions[p >> 8].add_edge(face, p & 0xFF);
+            }
+
+            // Replace the reverse edges of the neighbor
+            const size_t opposite = face ^ 1;
+            std::vector<path_region> &next_regions = _regions[next];
+            for (path_region &r : next_regions)
+            {
+                r.remove_face(opposite);
+            }
+            for (const uint16_t p : _pairs)
+            {
+                next_regions[p & 0xFF].add_edge(opposite, p >> 8);
+            }
+        }
+    }
+    inline void ensure(const std::vector<block_id> &grid, const size_t chunk_key)
+    {
+        // Build the chunk and its neighbors so all edges are current
+        if (_dirty[chunk_key])
+        {
+            build(grid, chunk_key);
+        }
+        for (size_t face = 0; face < 6; face++)
+        {
+            size_t next;
+            if (neighbor(chunk_key, face, next) && _dirty[next])
+            {
+                build(grid, next);
+            }
+        }
+    }
+    inline bool region(const std::vector<block_id> &grid, const size_t key, uint32_t &out)
+    {
+        // Find the chunk region containing this cell
+        const size_t chunk_key = chunk_of(key);
+        ensure(grid, chunk_key);
+
+        // Is this cell in a region?
+        const uint8_t r = _labels[chunk_key][local_of(key)];
+        if (r == 0)
+        {
+            return false;
+        }
+
+        out = pack(chunk_key, r - 1);
+        return true;
+    }
+    inline const path_region &get_region(const uint32_t node) const
+    {
+        return _regions[node >> 8][node & 0xFF];
+    }
+    inline uint32_t find(const uint32_t node, size_t &slot) const
+    {
+        // Linear probe until we find the node or an unused slot
+        slot = hash(node);
+        while (_stamp[slot] == _gen)
+        {
+            const uint32_t n = _table[slot];
+            if (_node[n] == node)
+            {
+                return n;
+            }
+
+            slot = (slot + 1) & _table_mask;
+        }
+
+        return _no_node;
+    }
+    inline uint32_t insert(const size_t slot, const uint32_t node, const uint32_t parent, const uint32_t cost)
+    {
+        // Create a new search node
+        const uint32_t n = static_cast<uint32_t>(_node.size());
+        _node.push_back(node);
+        _parent.push_back(parent);
+        _cost.push_back(cost);
+        _closed.push_back(0);
+
+        // Claim the table slot for this search generation
+        _table[slot] = n;
+        _stamp[slot] = _gen;
+
+        return n;
+    }
+    inline void push(const uint64_t prio, const uint32_t n)
+    {
+        _heap.emplace_back(prio, n);
+        std::push_heap(_heap.begin(), _heap.end(), std::greater<std::pair<uint64_t, uint32_t>>());
+    }
+    inline void reset()
+    {
+        // Invalidate all table slots by bumping the generation
+        _gen++;
+        if (_gen == 0)
+        {
+            std::fill(_stamp.begin(), _stamp.end(), 0);
+            _gen = 1;
+        }
+
+        // Clear node storage, this doesn't free memory
+        _node.clear();
+        _parent.clear();
+        _cost.clear();
+        _closed.clear();
+        _heap.clear();
+    }
+    inline uint32_t target_distance(const uint32_t node) const
+    {
+        return distance(grid_index(get_region(node).get_cell()), grid_index(_tree_target));
+    }
+    inline void seed(const uint32_t goal, const size_t target)
+    {
+        // Start a new search tree growing backwards from the goal region
+        reset();
+        _tree_goal = goal;
+        _tree_target = target;
+        _tree_expand = 0;
+        _tree_valid = true;
+
+        // Add the goal region
+        size_t slot;
+        find(goal, slot);
+        push(priority(0, target_distance(goal)), insert(slot, goal, _no_node, 0));
+    }
+    inline void retarget(const size_t target)
+    {
+        // Reorder open regions toward a new start, closed regions keep their optimal cost
+        _tree_target = target;
+        size_t size = 0;
+        for (const auto &h : _heap)
+        {
+            const uint32_t n = h.second;
+            if (!_closed[n])
+            {
+                _heap[size++] = std::make_pair(priority(_cost[n], target_distance(_node[n])), n);
+            }
+        }
+        _heap.resize(size);
+        std::make_heap(_heap.begin(), _heap.end(), std::greater<std::pair<uint64_t, uint32_t>>());
+    }
+    inline uint32_t expand(const std::vector<block_id> &grid, const uint32_t start)
+    {
+        // Resume the search tree until the start region is closed
+        const std::tuple<size_t, size_t, size_t> target = grid_index(_tree_target);
+        size_t slot;
+        while (!_heap.empty() && _tree_expand < _expand_limit)
+        {
+            // Pop the best region off the heap
+            std::pop_heap(_heap.begin(), _heap.end(), std::greater<std::pair<uint64_t, uint32_t>>());
+            const uint32_t n = _heap.back().second;
+            _heap.pop_back();
+
+            // Skip stale heap entries
+            if (_closed[n])
+            {
+                continue;
+            }
+            _closed[n] = 1;
+            _tree_expand++;
+
+            // Check if we made it to the start region
+            const uint32_t node = _node[n];
+            if (node == start)
+            {
+                return n;
+            }
+
+            // Make sure edges leaving this chunk are current
+            const size_t chunk_key = node >> 8;
+            ensure(grid, chunk_key);
+
+            // Visit all adjacent regions
+            const path_region &r = get_region(node);
+            const std::tuple<size_t, size_t, size_t> comp = grid_index(r.get_cell());
+            for (const uint16_t e : r.get_edges())
+            {
+                size_t next_chunk = 0;
+                neighbor(chunk_key, e >> 8, next_chunk);
+                const uint32_t next = pack(next_chunk, e & 0xFF);
+                const std::tuple<size_t, size_t, size_t> next_comp = grid_index(get_region(next).get_cell());
+                const uint32_t cost = _cost[n] + distance(comp, next_comp);
+
+                // Check if we have seen this region before
+                const uint32_t found = find(next, slot);
+                if (found != _no_node)
+                {
+                    // Relax the region if we found a cheaper route
+                    if (!_closed[found] && cost < _cost[found])
+                    {
+                        _cost[found] = cost;
+                        _parent[found] = n;
+                        push(priority(cost, distance(next_comp, target)), found);
+                    }
+                }
+                else if (_node.size() < _node_limit)
+                {
+                    // Add a new region
+                    push(priority(cost, distance(next_comp, target)), insert(slot, next, n, cost));
+                }
+            }
+        }
+
+        return _no_node;
+    }
+
+  public:
+    path_graph(const size_t grid_scale, const size_t chunk_size)
+        : _grid_scale(grid_scale),
+          _chunk_size(chunk_size),
+          _chunk_scale(grid_scale / chunk_size),
+          _chunk_cells(chunk_size * chunk_size * chunk_size),
+          _regions(_chunk_scale * _chunk_scale * _chunk_scale),
+          _labels(_regions.size()),
+          _dirty(_regions.size(), 1),
+          _offset(_chunk_cells),
+          _center(_chunk_cells),
+          _side(_chunk_cells),
+          _table(_table_size, 0),
+          _stamp(_table_size, 0),
+          _gen(0),
+          _tree_goal(0),
+          _tree_target(0),
+          _tree_expand(0),
+          _tree_valid(false)
+    {
+        // Local cell indices are stored in 16 bits
+        if (_chunk_cells > 65536)
+        {
+            throw std::runtime_error("path_graph: chunk_size is too large for region labels");
+        }
+
+        // Precompute grid offsets, center distance and chunk sides for each local cell
+        const size_t s = chunk_size;
+        for (size_t x = 0, i = 0; x < s; x++)
+        {
+            for (size_t y = 0; y < s; y++)
+            {
+                for (size_t z = 0; z < s; z++, i++)
+                {
+                    _offset[i] = (x * _grid_scale * _grid_scale) + (y * _grid_scale) + z;
+
+                    // Squared distance to the center in doubled units
+                    const int dx = static_cast<int>(2 * x + 1) - static_cast<int>(s);
+                    const int dy = static_cast<int>(2 * y + 1) - static_cast<int>(s);
+                    const int dz = static_cast<int>(2 * z + 1) - static_cast<int>(s);
+                    _center[i] = static_cast<uint16_t>(dx * dx + dy * dy + dz * dz);
+
+                    // Flag the chunk faces this cell touches
+                    _side[i] = (x == 0) | ((x == s - 1) << 1) | ((y == 0) << 2) | ((y == s - 1) << 3) | ((z == 0) << 4) | ((z == s - 1) << 5);
+                }
+            }
+        }
+
+        // Reserve memory
+        _cells.reserve(_region_limit);
+        _stack.reserve(_chunk_cells);
+        _pairs.reserve(chunk_size * chunk_size);
+        _node.reserve(_node_limit);
+        _parent.reserve(_node_limit);
+        _cost.reserve(_node_limit);
+        _closed.reserve(_node_limit);
+        _heap.reserve(_node_limit);
+    }
+    inline void clear()
+    {
+        // Regions are rebuilt lazily when a search first touches them
+        std::fill(_dirty.begin(), _dirty.end(), 1);
+        _tree_valid = false;
+    }
+    inline void update(const size_t chunk_key)
+    {
+        _dirty[chunk_key] = 1;
+        _tree_valid = false;
+    }
+    inline size_t waypoint(const std::vector<block_id> &grid, const size_t start, const size_t stop)
+    {
+        // Find the start and goal regions, a shared region is searched directly
+        uint32_t start_region;
+        uint32_t stop_region;
+        if (!region(grid, start, start_region) || !region(grid, stop, stop_region) || start_region == stop_region)
+        {
+            return stop;
+        }
+
+        // Reuse the search tree if we are heading to the same goal
+        bool fresh = false;
+        if (!_tree_valid || _tree_goal != stop_region)
+        {
+            seed(stop_region, start);
+            fresh = true;
+        }
+
+        // Grow the tree until it reaches the start region
+        size_t slot;
+        uint32_t n = find(start_region, slot);
+        if (n == _no_node || !_closed[n])
+        {
+            if (_tree_target != start)
+            {
+                retarget(start);
+            }
+            n = expand(grid, start_region);
+
+            // If out of budget, try again with a tree aimed at this start
+            if (n == _no_node && !_heap.empty() && !fresh)
+            {
+                seed(stop_region, start);
+                n = expand(grid, start_region);
+            }
+
+            // Unreachable, search toward the goal directly
+            if (n == _no_node)
+            {
+                return stop;
+            }
+        }
+
+        // Walk toward the goal and refine only the local segment
+        for (size_t i = 0; i < _refine_depth && _parent[n] != _no_node; i++)
+        {
+            n = _parent[n];
+        }
+
+        // The goal region is searched exactly
+        return (_parent[n] == _no_node) ? stop : get_region(_node[n]).get_cell();
+    }
+};
+}
+
+#endif
@@ -0,0 +1,291 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __PATH_QUEUE__
+#define __PATH_QUEUE__
+
+#include <algorithm>
+#include <condition_variable>
+#include <game/id.h>
+#include <game/path_graph.h>
+#include <game/path_search.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace game
+{
+
+class path_request
+{
+  private:
+    size_t _id;
+    size_t _start;
+    size_t _stop;
+
+  public:
+    path_request(const size_t id, const size_t start, const size_t stop)
+        : _id(id), _start(start), _stop(stop) {}
+
+    inline size_t get_id() const
+    {
+        return _id;
+    }
+    inline size_t get_start() const
+    {
+        return _start;
+    }
+    inline size_t get_stop() const
+    {
+        return _stop;
+    }
+};
+
+class path_queue
+{
+  private:
+    const std::vector<block_id> &_grid;
+    const size_t _grid_scale;
+    const size_t _chunk_size;
+    const size_t _chunk_scale;
+    std::vector<block_id> _snap;
+    std::vector<uint8_t> _dirty;
+    std::vector<size_t> _dirty_keys;
+    path_search _search;
+    path_graph _graph;
+    std::vector<path_request> _requests;
+    std::vector<path_request> _work;
+    std::vector<size_t> _dropped;
+    std::vector<size_t> _result_id;
+    std::vector<size_t> _result_size;
+    std::vector<size_t> _result_keys;
+    std::mutex _lock;
+    std::condition_variable _cond;
+    bool _busy;
+    bool _die;
+    bool _reset;
+    bool _stale;
+    std::thread _thread;
+
+    inline const std::vector<size_t> &find(const size_t start, const size_t stop)
+    {
+        // Plan across chunk regions and only refine the first segment
+        const size_t waypoint = _graph.waypoint(_snap, start, stop);
+
+        // A* search between the cells, returns a partial path if out of budget
+        _search.search(_snap, _grid_scale, start, waypoint);
+
+        return _search.get_path();
+    }
+    inline bool is_busy()
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+        return _busy;
+    }
+    inline void copy_chunk(const size_t chunk_key)
+    {
+        // Copy the chunk cells row by row from the live grid
+        const size_t x0 = (chunk_key / (_chunk_scale * _chunk_scale)) * _chunk_size;
+        const size_t y0 = ((chunk_key / _chunk_scale) % _chunk_scale) * _chunk_size;
+        const size_t z0 = (chunk_key % _chunk_scale) * _chunk_size;
+        for (size_t i = x0; i < x0 + _chunk_size; i++)
+        {
+            for (size_t j = y0; j < y0 + _chunk_size; j++)
+            {
+                const size_t row = (i * _grid_scale + j) * _grid_scale + z0;
+                std::copy(_grid.begin() + row, _grid.begin() + row + _chunk_size, _snap.begin() + row);
+            }
+        }
+    }
+    inline void drop_results()
+    {
+        // Results searched before a clear are handed back as empty paths
+        if (_stale)
+        {
+            _result_size.assign(_result_id.size(), 0);
+            _result_keys.clear();
+            _stale = false;
+        }
+    }
+    inline void sync()
+    {
+        // Only called while the worker is idle, copies the chunks written since the last launch
+        if (_reset)
+        {
+            std::copy(_grid.begin(), _grid.end(), _snap.begin());
+            _graph.clear();
+            _reset = false;
+        }
+        else
+        {
+            for (const size_t k : _dirty_keys)
+            {
+                copy_chunk(k);
+                _graph.update(k);
+            }
+        }
+
+        // Clear the dirty chunks
+        for (const size_t k : _dirty_keys)
+        {
+            _dirty[k] = 0;
+        }
+        _dirty_keys.clear();
+    }
+    inline void work()
+    {
+        while (true)
+        {
+            // Sleep until we have requests or are killed
+            std::unique_lock<std::mutex> lock(_lock);
+            _cond.wait(lock, [this]() { return _busy || _die; });
+            if (!_busy)
+            {
+                break;
+            }
+            lock.unlock();
+
+            // Answer all requests on the snapshot, the live grid may change while we are busy
+            for (const path_request &r : _work)
+            {
+                const std::vector<size_t> &path = find(r.get_start(), r.get_stop());
+                _result_id.push_back(r.get_id());
+                _result_size.push_back(path.size());
+                _result_keys.insert(_result_keys.end(), path.begin(), path.end());
+            }
+            _work.clear();
+
+            // Signal finished
+            lock.lock();
+            _busy = false;
+            _cond.notify_all();
+        }
+    }
+
+  public:
+    path_queue(const std::vector<block_id> &grid, const size_t grid_scale, const size_t chunk_size)
+        : _grid(grid), _grid_scale(grid_scale), _chunk_size(chunk_size), _chunk_scale(grid_scale / chunk_size),
+          _snap(grid.size(), block_id::EMPTY), _dirty(_chunk_scale * _chunk_scale * _chunk_scale, 0),
+          _graph(grid_scale, chunk_size), _busy(false), _die(false), _reset(true), _stale(false)
+    {
+        // Boot the worker thread
+        _thread = std::thread(&path_queue::work, this);
+    }
+    ~path_queue()
+    {
+        // Finish any requests and kill the worker
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            _die = true;
+        }
+        _cond.notify_all();
+        _thread.join();
+    }
+    inline void clear()
+    {
+        // Copy the whole grid and invalidate all path regions on next launch
+        _reset = true;
+
+        // Hand dropped requests and the results in flight back as empty paths so callers can request again
+        for (const path_request &r : _requests)
+        {
+            _dropped.push_back(r.get_id());
+        }
+        _requests.clear();
+        _stale = true;
+    }
+    template <typename F>
+    inline void collect(const F &f)
+    {
+        // Results of the last launch once the worker is done, else next frame
+        if (!is_busy())
+        {
+            drop_results();
+
+            // Hand back each path from the last launch
+            size_t offset = 0;
+            const size_t size = _result_id.size();
+            for (size_t i = 0; i < size; i++)
+            {
+                f(_result_id[i], _result_keys.data() + offset, _result_size[i]);
+                offset += _result_size[i];
+            }
+
+            // Clear all results
+            _result_id.clear();
+            _result_size.clear();
+            _result_keys.clear();
+        }
+
+        // Requests dropped by a clear never reached the worker
+        for (const size_t id : _dropped)
+        {
+            f(id, _result_keys.data(), 0);
+        }
+        _dropped.clear();
+    }
+    inline void launch()
+    {
+        // Keep this frame's requests for the next launch if the last batch is still running
+        if (_requests.size() == 0 || is_busy())
+        {
+            return;
+        }
+
+        // Results searched before a clear can't be mixed with new ones
+        drop_results();
+
+        // Bring the snapshot up to date
+        sync();
+
+        // Hand the requests to the worker
+        std::unique_lock<std::mutex> lock(_lock);
+        _work.swap(_requests);
+        _busy = true;
+        _cond.notify_all();
+    }
+    inline void post(const size_t id, const size_t start, const size_t stop)
+    {
+        _requests.emplace_back(id, start, stop);
+    }
+    inline const std::vector<size_t> &search(const size_t start, const size_t stop)
+    {
+        // Search on this thread when the worker is idle
+        wait();
+        sync();
+
+        return find(start, stop);
+    }
+    inline void update(const size_t chunk_key)
+    {
+        // Copy this chunk and rebuild its path regions on next launch
+        if (!_dirty[chunk_key])
+        {
+            _dirty[chunk_key] = 1;
+            _dirty_keys.push_back(chunk_key);
+        }
+    }
+    inline void wait()
+    {
+        // Block until the worker is done with the last launch
+        std::unique_lock<std::mutex> lock(_lock);
+        _cond.wait(lock, [this]() { return !_busy; });
+    }
+};
+}
+
+#endif
@@ -0,0 +1,273 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __PATH_SEARCH__
+#define __PATH_SEARCH__
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <game/id.h>
+#include <tuple>
+#include <vector>
+
+namespace game
+{
+
+class path_search
+{
+  private:
+    static constexpr size_t _expand_limit = 2048;
+    static constexpr size_t _node_limit = _expand_limit * 6 + 1;
+    static constexpr size_t _table_size = 32768;
+    static constexpr size_t _table_mask = _table_size - 1;
+    static constexpr uint32_t _no_node = 0xFFFFFFFF;
+    std::vector<uint32_t> _table;
+    std::vector<uint32_t> _stamp;
+    uint32_t _gen;
+    std::vector<size_t> _key;
+    std::vector<uint32_t> _parent;
+    std::vector<uint32_t> _cost;
+    std::vector<uint8_t> _closed;
+    std::vector<std::pair<uint32_t, uint32_t>> _heap;
+    std::vector<size_t> _path;
+
+    static inline uint32_t distance(const std::tuple<size_t, size_t, size_t> &a, const std::tuple<size_t, size_t, size_t> &b)
+    {
+        // Manhattan distance is exact for 6-connected unit steps in open space
+        const size_t dx = (std::get<0>(a) > std::get<0>(b)) ? std::get<0>(a) - std::get<0>(b) : std::get<0>(b) - std::get<0>(a);
+        const size_t dy = (std::get<1>(a) > std::get<1>(b)) ? std::get<1>(a) - std::get<1>(b) : std::get<1>(b) - std::get<1>(a);
+        const size_t dz = (std::get<2>(a) > std::get<2>(b)) ? std::get<2>(a) - std::get<2>(b) : std::get<2>(b) - std::get<2>(a);
+
+        return static_cast<uint32_t>(dx + dy + dz);
+    }
+    static inline size_t hash(const size_t key)
+    {
+        // Fibonacci hashing of the grid key
+        return static_cast<size_t>((static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull) >> 40) & _table_mask;
+    }
+    static inline std::tuple<size_t, size_t, size_t> grid_index(const size_t key, const size_t scale)
+    {
+        return std::make_tuple(key / (scale * scale), (key / scale) % scale, key % scale);
+    }
+    static inline size_t grid_key(const size_t x, const size_t y, const size_t z, const size_t scale)
+    {
+        return (x * scale * scale) + (y * scale) + z;
+    }
+    static inline uint32_t priority(const uint32_t cost, const uint32_t h)
+    {
+        // Order by f = g + h, break ties toward the goal
+        return ((cost + h) << 12) | std::min<uint32_t>(h, 0xFFF);
+    }
+    inline void build_path(const uint32_t node)
+    {
+        // Walk parent links back to the start
+        _path.clear();
+        for (uint32_t n = node; n != _no_node; n = _parent[n])
+        {
+            _path.push_back(_key[n]);
+        }
+
+        // Path is stored from start to stop
+        std::reverse(_path.begin(), _path.end());
+    }
+    inline uint32_t find(const size_t key, size_t &slot) const
+    {
+        // Linear probe until we find the key or an unused slot
+        slot = hash(key);
+        while (_stamp[slot] == _gen)
+        {
+            const uint32_t node = _table[slot];
+            if (_key[node] == key)
+            {
+                return node;
+            }
+
+            slot = (slot + 1) & _table_mask;
+        }
+
+        return _no_node;
+    }
+    inline uint32_t insert(const size_t slot, const size_t key, const uint32_t parent, const uint32_t cost)
+    {
+        // Create a new node
+        const uint32_t node = static_cast<uint32_t>(_key.size());
+        _key.push_back(key);
+        _parent.push_back(parent);
+        _cost.push_back(cost);
+        _closed.push_back(0);
+
+        // Claim the table slot for this search generation
+        _table[slot] = node;
+        _stamp[slot] = _gen;
+
+        return node;
+    }
+    inline void push(const uint32_t prio, const uint32_t node)
+    {
+        _heap.emplace_back(prio, node);
+        std::push_heap(_heap.begin(), _heap.end(), std::greater<std::pair<uint32_t, uint32_t>>());
+    }
+    inline void reset()
+    {
+        // Invalidate all table slots by bumping the generation
+        _gen++;
+        if (_gen == 0)
+        {
+            // On wrap around we must clear the stamps once
+            std::fill(_stamp.begin(), _stamp.end(), 0);
+            _gen = 1;
+        }
+
+        // Clear node storage, this doesn't free memory
+        _key.clear();
+        _parent.clear();
+        _cost.clear();
+        _closed.clear();
+        _heap.clear();
+        _path.clear();
+    }
+
+  public:
+    path_search()
+        : _table(_table_size, 0), _stamp(_table_size, 0), _gen(0)
+    {
+        // Reserve memory for nodes
+        _key.reserve(_node_limit);
+        _parent.reserve(_node_limit);
+        _cost.reserve(_node_limit);
+        _closed.reserve(_node_limit);
+        _heap.reserve(_node_limit);
+        _path.reserve(_expand_limit);
+    }
+    inline const std::vector<size_t> &get_path() const
+    {
+        return _path;
+    }
+    inline bool search(const std::vector<block_id> &grid, const size_t scale, const size_t start, const size_t stop)
+    {
+        // Reset the search in constant time
+        reset();
+
+        // Only search between different empty cells
+        if (start == stop || grid[start] != block_id::EMPTY)
+        {
+            return false;
+        }
+
+        // Add the start node
+        const std::tuple<size_t, size_t, size_t> goal = grid_index(stop, scale);
+        const uint32_t start_h = distance(grid_index(start, scale), goal);
+        size_t slot;
+        find(start, slot);
+        push(priority(0, start_h), insert(slot, start, _no_node, 0));
+
+        // Track the node closest to the goal for partial paths
+        uint32_t best = 0;
+        uint32_t best_h = start_h;
+
+        // Expand nodes in best first order
+        const size_t edge = scale - 1;
+        size_t expanded = 0;
+        while (!_heap.empty() && expanded < _expand_limit)
+        {
+            // Pop the best node off the heap
+            std::pop_heap(_heap.begin(), _heap.end(), std::greater<std::pair<uint32_t, uint32_t>>());
+            const uint32_t node = _heap.back().second;
+            _heap.pop_back();
+
+            // Skip stale heap entries
+            if (_closed[node])
+            {
+                continue;
+            }
+            _closed[node] = 1;
+            expanded++;
+
+            // Check if we made it to the destination
+            const size_t key = _key[node];
+            if (key == stop)
+            {
+                build_path(node);
+                return true;
+            }
+
+            // Remember the closest node to the goal
+            const std::tuple<size_t, size_t, size_t> comp = grid_index(key, scale);
+            const uint32_t h = distance(comp, goal);
+            if (h < best_h)
+            {
+                best = node;
+                best_h = h;
+            }
+
+            // Unpack the node components
+            const size_t x = std::get<0>(comp);
+            const size_t y = std::get<1>(comp);
+            const size_t z = std::get<2>(comp);
+            const uint32_t cost = _cost[node] + 1;
+
+            // Visit all neighbors inside the grid
+            const size_t neighbors[6] = {
+                (x != 0) ? grid_key(x - 1, y, z, scale) : key,
+                (x != edge) ? grid_key(x + 1, y, z, scale) : key,
+                (y != 0) ? grid_key(x, y - 1, z, scale) : key,
+                (y != edge) ? grid_key(x, y + 1, z, scale) : key,
+                (z != 0) ? grid_key(x, y, z - 1, scale) : key,
+                (z != edge) ? grid_key(x, y, z + 1, scale) : key};
+
+            for (size_t i = 0; i < 6; i++)
+            {
+                // Skip the grid boundary and walls
+                const size_t n = neighbors[i];
+                if (n == key || grid[n] != block_id::EMPTY)
+                {
+                    continue;
+                }
+
+                // Check if we have seen this cell before
+                const uint32_t found = find(n, slot);
+                if (found != _no_node)
+                {
+                    // Relax the node if we found a cheaper route
+                    if (!_closed[found] && cost < _cost[found])
+                    {
+                        _cost[found] = cost;
+                        _parent[found] = node;
+                        push(priority(cost, distance(grid_index(n, scale), goal)), found);
+                    }
+                }
+                else if (_key.size() < _node_limit)
+                {
+                    // Add a new node
+                    push(priority(cost, distance(grid_index(n, scale), goal)), insert(slot, n, node, cost));
+                }
+            }
+        }
+
+        // Return a partial path to the closest node we found
+        if (best != 0)
+        {
+            build_path(best);
+        }
+
+        return false;
+    }
+};
+}
+
+#endif
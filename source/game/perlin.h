@@ -20,9 +20,14 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <array>
 #include <chrono>
+#include <cstdint>
 #include <min/vec3.h>
 #include <random>
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 namespace kernel
 {
 
@@ -30,11 +35,17 @@ class perlin_noise
 {
   private:
     std::array<uint_fast8_t, 512> _p;
+#ifdef __AVX2__
+    std::array<int32_t, 512> _pi;
+    std::array<float, 16> _gx;
+    std::array<float, 16> _gy;
+    std::array<float, 16> _gz;
+#endif
 
-    void calc_random_hash_table()
+    void calc_random_hash_table(const uint64_t seed)
     {
         std::uniform_int_distribution<uint_fast8_t> idist(0, 255);
-        std::mt19937 gen(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+        std::mt19937 gen(seed);
 
         const size_t size = _p.size();
         for (size_t i = 0; i < size; i++)
@@ -42,6 +53,25 @@ class perlin_noise
             _p[i] = idist(gen);
         }
     }
+#ifdef __AVX2__
+    void calc_gather_tables()
+    {
+        // Widen the hash table for 32 bit gathers
+        const size_t size = _p.size();
+        for (size_t i = 0; i < size; i++)
+        {
+            _pi[i] = _p[i];
+        }
+
+        // Gradient coefficients of each hash, read back from g()
+        for (uint_fast8_t i = 0; i < 16; i++)
+        {
+            _gx[i] = g(i, 1.0, 0.0, 0.0);
+            _gy[i] = g(i, 0.0, 1.0, 0.0);
+            _gz[i] = g(i, 0.0, 0.0, 1.0);
+        }
+    }
+#endif
     inline float fade(float t) const
     {
         return t * t * t * (t * (t * 6 - 15) + 10);
@@ -91,12 +121,50 @@ class perlin_noise
             return 0;
         }
     }
+#ifdef __AVX2__
+    inline __m256 fade8(const __m256 t) const
+    {
+        const __m256 a = _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0)), _mm256_set1_ps(15.0));
+        const __m256 b = _mm256_add_ps(_mm256_mul_ps(t, a), _mm256_set1_ps(10.0));
+        return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(t, t), t), b);
+    }
+    inline __m256 lerp8(const __m256 a, const __m256 b, const __m256 x) const
+    {
+        return _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(b, a), x), a);
+    }
+    inline __m256 grad8(const std::array<float, 16> &table, const __m256i index, const __m256 high) const
+    {
+        // Permute both halves of the table and pick by bit 3 of the hash
+        const __m256 lo = _mm256_permutevar8x32_ps(_mm256_loadu_ps(table.data()), index);
+        const __m256 hi = _mm256_permutevar8x32_ps(_mm256_loadu_ps(table.data() + 8), index);
+        return _mm256_blendv_ps(lo, hi, high);
+    }
+    inline __m256 g8(const __m256i index, const float x, const float y, const __m256 z) const
+    {
+        // Look up gradient coefficients, each is -1, 0 or 1 so the dot product is exact
+        const __m256 high = _mm256_castsi256_ps(_mm256_slli_epi32(index, 28));
+        const __m256 gx = grad8(_gx, index, high);
+        const __m256 gy = grad8(_gy, index, high);
+        const __m256 gz = grad8(_gz, index, high);
+        const __m256 xy = _mm256_add_ps(_mm256_mul_ps(gx, _mm256_set1_ps(x)), _mm256_mul_ps(gy, _mm256_set1_ps(y)));
+        return _mm256_add_ps(xy, _mm256_mul_ps(gz, z));
+    }
+    inline __m256i hash8(const int32_t base, const __m256i zi) const
+    {
+        return _mm256_i32gather_epi32(_pi.data(), _mm256_add_epi32(_mm256_set1_epi32(base), zi), 4);
+    }
+#endif
 
   public:
     perlin_noise()
+        : perlin_noise(std::chrono::high_resolution_clock::now().time_since_epoch().count()) {}
+    perlin_noise(const uint64_t seed)
     {
-        // Calculate random numbers
-        calc_random_hash_table();
+        // Calculate random numbers, the same seed gives the same noise
+        calc_random_hash_table(seed);
+#ifdef __AVX2__
+        calc_gather_tables();
+#endif
     }
     inline float perlin(const float x, const float y, const float z) const
     {
@@ -148,6 +216,77 @@ class perlin_noise
         // Interpolate along Z, map [-2, 2] to [0, 1]
         return lerp(y_zm, y_zp, v) * 0.25 + 0.5;
     }
+    inline void perlin8(const float x, const float y, const float *z, float *out) const
+    {
+#ifdef __AVX2__
+        // Calculate hash table indices shared by all lanes
+        const uint_fast8_t xim = static_cast<uint_fast8_t>(x) & 255;
+        const uint_fast8_t yim = static_cast<uint_fast8_t>(y) & 255;
+        const uint_fast8_t xip = xim + 1;
+        const uint_fast8_t yip = yim + 1;
+
+        // Hash the four XY columns of the local unit cube
+        const int32_t mm = _p[_p[xim] + yim];
+        const int32_t mp = _p[_p[xim] + yip];
+        const int32_t pm = _p[_p[xip] + yim];
+        const int32_t pp = _p[_p[xip] + yip];
+
+        // Calculate Z hash table indices per lane
+        const __m256 vz = _mm256_loadu_ps(z);
+        const __m256i zim = _mm256_and_si256(_mm256_cvttps_epi32(vz), _mm256_set1_epi32(255));
+        const __m256i zip = _mm256_and_si256(_mm256_add_epi32(zim, _mm256_set1_epi32(1)), _mm256_set1_epi32(255));
+
+        // Hash 8 corners on local unit cube
+        const __m256i mmm = hash8(mm, zim);
+        const __m256i mpm = hash8(mp, zim);
+        const __m256i mmp = hash8(mm, zip);
+        const __m256i mpp = hash8(mp, zip);
+        const __m256i pmm = hash8(pm, zim);
+        const __m256i ppm = hash8(pp, zim);
+        const __m256i pmp = hash8(pm, zip);
+        const __m256i ppp = hash8(pp, zip);
+
+        // Calculate distance vector within local unit cube
+        const float xp = x - static_cast<uint_fast8_t>(x);
+        const float yp = y - static_cast<uint_fast8_t>(y);
+        const __m256 zp = _mm256_sub_ps(vz, _mm256_cvtepi32_ps(zim));
+
+        // Calculate the inverse distance vector
+        const float xm = xp - 1.0;
+        const float ym = yp - 1.0;
+        const __m256 zm = _mm256_sub_ps(zp, _mm256_set1_ps(1.0));
+
+        // Calculate interpolation constants
+        const __m256 t = _mm256_set1_ps(fade(xp));
+        const __m256 u = _mm256_set1_ps(fade(yp));
+        const __m256 v = fade8(zp);
+
+        // Interpolate along X
+        const __m256 x_ym_zm = lerp8(g8(mmm, xm, ym, zm), g8(pmm, xp, ym, zm), t);
+        const __m256 x_yp_zm = lerp8(g8(mpm, xm, yp, zm), g8(ppm, xp, yp, zm), t);
+        const __m256 x_ym_zp = lerp8(g8(mmp, xm, ym, zp), g8(pmp, xp, ym, zp), t);
+        const __m256 x_yp_zp = lerp8(g8(mpp, xm, yp, zp), g8(ppp, xp, yp, zp), t);
+
+        // Interpolate along Y
+        const __m256 y_zm = lerp8(x_ym_zm, x_yp_zm, u);
+        const __m256 y_zp = lerp8(x_ym_zp, x_yp_zp, u);
+
+        // Interpolate along Z, map [-2, 2] to [0, 1] in double precision like perlin()
+        const __m256 n = lerp8(y_zm, y_zp, v);
+        const __m256d scale = _mm256_set1_pd(0.25);
+        const __m256d offset = _mm256_set1_pd(0.5);
+        const __m256d lo = _mm256_add_pd(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(n)), scale), offset);
+        const __m256d hi = _mm256_add_pd(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(n, 1)), scale), offset);
+        _mm_storeu_ps(out, _mm256_cvtpd_ps(lo));
+        _mm_storeu_ps(out + 4, _mm256_cvtpd_ps(hi));
+#else
+        // Scalar fallback
+        for (size_t i = 0; i < 8; i++)
+        {
+            out[i] = perlin(x, y, z[i]);
+        }
+#endif
+    }
 };
 }
 
@@ -18,6 +18,7 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef __PLAYER__
 #define __PLAYER__
 
+#include <algorithm>
 #include <game/callback.h>
 #include <game/cgrid.h>
 #include <game/id.h>
@@ -111,6 +112,112 @@ class target
     }
 };
 
+class ray_packet
+{
+  private:
+    std::vector<float> _ox;
+    std::vector<float> _oy;
+    std::vector<float> _oz;
+    std::vector<float> _ix;
+    std::vector<float> _iy;
+    std::vector<float> _iz;
+    std::vector<float> _dist;
+    std::vector<int32_t> _body;
+
+    static inline float inverse(const float d)
+    {
+        // Avoid infinities for axis aligned rays
+        if (std::abs(d) < 1E-7)
+        {
+            return (d < 0.0) ? -1E7 : 1E7;
+        }
+
+        return 1.0 / d;
+    }
+
+  public:
+    ray_packet() {}
+
+    inline int32_t get_body(const size_t index) const
+    {
+        return _body[index];
+    }
+    inline min::aabbox<float, min::vec3> load(const std::vector<min::ray<float, min::vec3>> &rays, const std::vector<trace_hit> &hits)
+    {
+        // Resize lanes for all rays
+        const size_t size = rays.size();
+        _ox.resize(size);
+        _oy.resize(size);
+        _oz.resize(size);
+        _ix.resize(size);
+        _iy.resize(size);
+        _iz.resize(size);
+        _dist.resize(size);
+        _body.resize(size);
+
+        // Bounding box of all ray segments
+        min::vec3<float> lower = rays[0].get_origin();
+        min::vec3<float> upper = lower;
+        for (size_t i = 0; i < size; i++)
+        {
+            // Store ray origin and inverse direction in lanes
+            const min::vec3<float> &o = rays[i].get_origin();
+            const min::vec3<float> &d = rays[i].get_direction();
+            _ox[i] = o.x();
+            _oy[i] = o.y();
+            _oz[i] = o.z();
+            _ix[i] = inverse(d.x());
+            _iy[i] = inverse(d.y());
+            _iz[i] = inverse(d.z());
+            _body[i] = -1;
+
+            // Square distance to the block that stopped the ray
+            const min::vec3<float> diff = hits[i].get_point() - o;
+            _dist[i] = diff.dot(diff);
+
+            // Grow box around ray segment
+            const min::vec3<float> &p = (hits[i].is_valid()) ? hits[i].get_point() : o;
+            lower = min::vec3<float>(std::min({lower.x(), o.x(), p.x()}), std::min({lower.y(), o.y(), p.y()}), std::min({lower.z(), o.z(), p.z()}));
+            upper = min::vec3<float>(std::max({upper.x(), o.x(), p.x()}), std::max({upper.y(), o.y(), p.y()}), std::max({upper.z(), o.z(), p.z()}));
+        }
+
+        // Pad the box so bodies near the segment ends are included
+        const min::vec3<float> pad(1.0, 1.0, 1.0);
+        return min::aabbox<float, min::vec3>(lower - pad, upper + pad);
+    }
+    inline void hit(const min::aabbox<float, min::vec3> &box, const min::vec3<float> &p, const int32_t body_index)
+    {
+        const min::vec3<float> &min = box.get_min();
+        const min::vec3<float> &max = box.get_max();
+
+        // Slab test this box against all rays, written over lanes so it vectorizes
+        const size_t size = _ox.size();
+        for (size_t i = 0; i < size; i++)
+        {
+            // Intersect ray with each slab
+            const float t1x = (min.x() - _ox[i]) * _ix[i];
+            const float t2x = (max.x() - _ox[i]) * _ix[i];
+            const float t1y = (min.y() - _oy[i]) * _iy[i];
+            const float t2y = (max.y() - _oy[i]) * _iy[i];
+            const float t1z = (min.z() - _oz[i]) * _iz[i];
+            const float t2z = (max.z() - _oz[i]) * _iz[i];
+            const float t_near = std::max(std::max(std::min(t1x, t2x), std::min(t1y, t2y)), std::min(t1z, t2z));
+            const float t_far = std::min(std::min(std::max(t1x, t2x), std::max(t1y, t2y)), std::max(t1z, t2z));
+
+            // Calculate square distance between body and ray origin
+            const float dx = p.x() - _ox[i];
+            const float dy = p.y() - _oy[i];
+            const float dz = p.z() - _oz[i];
+            const float dist = dx * dx + dy * dy + dz * dz;
+
+            // If the ray hits the box before anything else
+            const bool closer = (t_far >= std::max(t_near, 0.0f)) && (dist < _dist[i]);
+            _dist[i] = (closer) ? dist : _dist[i];
+            _body[i] = (closer) ? body_index : _body[i];
+        }
+    }
+};
+
 class player
 {
   private:
@@ -121,7 +228,8 @@ class player
 
     min::physics<float, uint_fast16_t, uint_fast32_t, min::vec3, min::aabbox, min::aabbox, min::grid> *_sim;
     size_t _body_id;
-    std::vector<std::pair<min::aabbox<float, min::vec3>, block_id>> _col_cells;
+    std::vector<trace_hit> _hits;
+    ray_packet _packet;
     inventory _inv;
     unsigned _damage_cd;
     unsigned _explode_cd;
@@ -147,10 +255,6 @@ class player
     skills _skills;
     stats _stats;
 
-    inline void reserve_memory()
-    {
-        _col_cells.reserve(36);
-    }
     inline void swing()
     {
         // Get player position
@@ -332,9 +436,6 @@ class player
           _land_count(0), _jump_count(0), _landed(false), _jet(false),
           _mode(play_mode::none)
     {
-        // Reserve space for collision cells
-        reserve_memory();
-
         // If resuming game
         if (!state.is_new_game())
         {
@@ -704,6 +805,64 @@ class player
         // Return this target
         return out;
     }
+    inline void target_packet(const cgrid &grid, const std::vector<min::ray<float, min::vec3>> &rays, const size_t max_dist,
+                              const box_call &box, std::vector<target> &out)
+    {
+        // Clear the output targets
+        out.clear();
+        if (rays.empty())
+        {
+            return;
+        }
+
+        // Trace all rays to find the blocks they hit
+        grid.ray_trace_packet(rays, max_dist, _hits);
+
+        // Load rays into lanes and get bounds of all ray segments
+        const min::aabbox<float, min::vec3> bounds = _packet.load(rays, _hits);
+
+        // Find all physics bodies along the packet with one query
+        const std::vector<uint_fast16_t> &map = _sim->get_index_map();
+        const std::vector<std::pair<uint_fast16_t, uint_fast16_t>> &over = _sim->get_overlap(bounds);
+
+        // Test each body against every ray in the packet
+        const size_t size = over.size();
+        for (size_t i = 0; i < size; i++)
+        {
+            const uint_fast16_t body_index = map[over[i].first];
+            const min::body<float, min::vec3> &b = _sim->get_body(body_index);
+            if (!b.is_dead() && body_index != _body_id)
+            {
+                _packet.hit(box(b), b.get_position(), body_index);
+            }
+        }
+
+        // Create targets for all rays
+        const size_t rays_size = rays.size();
+        for (size_t i = 0; i < rays_size; i++)
+        {
+            target t;
+            const trace_hit &h = _hits[i];
+            t.position() = h.get_point();
+            t.key() = h.get_key();
+            t.atlas() = h.get_value();
+
+            // If ray is invalid or doesn't hit any blocks
+            t.set_id((h.is_valid() && not_empty(h.get_value())) ? target_id::BLOCK : target_id::INVALID);
+
+            // If a body was hit before the block
+            const int32_t body_index = _packet.get_body(i);
+            if (body_index >= 0)
+            {
+                t.set_id(target_id::BODY);
+                t.set_position(_sim->get_body(body_index).get_position());
+                t.set_body_index(body_index);
+            }
+
+            // Store this target
+            out.push_back(t);
+        }
+    }
     inline const min::vec3<float> &velocity() const
     {
         // Return the character position
@@ -724,21 +883,17 @@ class player
         // Check if player is still in the grid
         const min::vec3<float> &p = position();
 
-        // Get all cells that could collide
-        grid.player_collision_cells(_col_cells, p);
-
-        // Solve static collisions
+        // Solve static collisions against all cells touching the player
         bool landed = false;
-        for (const auto &cell : _col_cells)
-        {
+        grid.player_contacts(p, [this, &p, &landed, &ex](const cell_contact &c) {
             // Did we collide with block?
-            const bool collide = _sim->collide(_body_id, cell.first);
+            const bool collide = _sim->collide(_body_id, c.get_box());
 
             // Detect if player has landed
             if (collide)
             {
                 // Check if we landed
-                const min::vec3<float> center = cell.first.get_center();
+                const min::vec3<float> center = c.get_center();
 
                 // Calculate minimum gap between player
                 constexpr float min_dist = cgrid::_player_dy + 0.475;
@@ -750,13 +905,15 @@ class player
                 }
 
                 // If we collided with a sodium cell and we haven't exploded yet
-                if (!is_exploded() && cell.second == block_id::SODIUM)
+                if (!is_exploded() && c.get_value() == block_id::SODIUM)
                 {
                     // Call explosion callback
-                    ex(cell.first.get_center(), cell.second);
+                    ex(center, c.get_value());
                 }
             }
-        }
+
+            return false;
+        });
 
         // Cast a ray to see hovering over a cell
         if (!landed)
@@ -0,0 +1,135 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __PORTAL_TABLE__
+#define __PORTAL_TABLE__
+
+#include <cstdint>
+#include <game/rng.h>
+#include <min/serial.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace game
+{
+
+// Packed portal parameters, a row count and column count followed by int32 rows, all little endian
+class portal_table
+{
+  private:
+    static constexpr size_t _header = 2 * sizeof(uint32_t);
+    const uint8_t *_data;
+    size_t _rows;
+    size_t _cols;
+
+    inline static uint32_t read(const uint8_t *p)
+    {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+  public:
+    portal_table(const uint8_t *data, const size_t size, const size_t cols)
+        : _data(data), _rows(0), _cols(cols)
+    {
+        // Check the header fits
+        if (size < _header)
+        {
+            throw std::runtime_error("portal_table: missing header");
+        }
+
+        // Check the table has rows of this kernel
+        _rows = read(_data);
+        if (_rows == 0 || read(_data + 4) != _cols)
+        {
+            throw std::runtime_error("portal_table: expected rows of " + std::to_string(_cols) + " parameters");
+        }
+
+        // Check the rows fit in the buffer
+        if (size != _header + _rows * _cols * sizeof(int32_t))
+        {
+            throw std::runtime_error("portal_table: size does not match header");
+        }
+    }
+    inline static std::vector<uint8_t> pack(const std::string &text, const size_t cols)
+    {
+        // Parse all rows of the text file
+        std::vector<int32_t> values;
+        std::istringstream lines(text);
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            // Skip blank lines
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+            {
+                continue;
+            }
+
+            // Parse the line into cols ints
+            std::istringstream ss(line);
+            for (size_t i = 0; i < cols; i++)
+            {
+                int32_t value;
+                ss >> value;
+                values.push_back(value);
+            }
+
+            // Check for errors
+            if (ss.fail())
+            {
+                throw std::runtime_error("portal_table: Invalid line '" + line + "'");
+            }
+        }
+
+        // Write the header and rows
+        std::vector<uint8_t> stream;
+        stream.reserve(_header + values.size() * sizeof(int32_t));
+        min::write_le<uint32_t>(stream, values.size() / cols);
+        min::write_le<uint32_t>(stream, cols);
+        for (const int32_t v : values)
+        {
+            min::write_le<int32_t>(stream, v);
+        }
+
+        return stream;
+    }
+    inline int get(const size_t index, const size_t col) const
+    {
+        // Read the value in place
+        const uint8_t *p = _data + _header + (index * _cols + col) * sizeof(int32_t);
+        return static_cast<int32_t>(read(p));
+    }
+    inline uint32_t hash(const size_t index) const
+    {
+        // Fold the row's parameters, cached portals change when the table does
+        uint32_t out = rng::key(index);
+        for (size_t i = 0; i < _cols; i++)
+        {
+            out = rng::hash(out, static_cast<uint32_t>(get(index, i)));
+        }
+
+        return out;
+    }
+    inline size_t size() const
+    {
+        return _rows;
+    }
+};
+}
+
+#endif
@@ -0,0 +1,65 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __RNG__
+#define __RNG__
+
+#include <cstdint>
+
+namespace game
+{
+
+// Counter based random numbers, the same key and counter always give the same value on any thread
+class rng
+{
+  private:
+    inline static uint32_t mix(uint32_t x)
+    {
+        // Low bias 32 bit integer hash
+        x ^= x >> 16;
+        x *= 0x7FEB352Du;
+        x ^= x >> 15;
+        x *= 0x846CA68Bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+  public:
+    inline static uint32_t key(const uint64_t seed, const uint32_t stream = 0)
+    {
+        // Fold a seed and stream into a key
+        return mix(static_cast<uint32_t>(seed) ^ mix(static_cast<uint32_t>(seed >> 32) ^ mix(stream + 0x9E3779B9u)));
+    }
+    inline static uint32_t hash(const uint32_t key, const uint32_t counter)
+    {
+        return mix(mix(counter) ^ key);
+    }
+    template <typename T>
+    inline static T unit(const uint32_t key, const uint32_t counter)
+    {
+        // Top 24 bits give an exact float on [0, 1)
+        return static_cast<T>(hash(key, counter) >> 8) * static_cast<T>(1.0 / 16777216.0);
+    }
+    template <typename T>
+    inline static T uniform(const uint32_t key, const uint32_t counter, const T lower, const T upper)
+    {
+        return lower + (upper - lower) * unit<T>(key, counter);
+    }
+};
+}
+
+#endif
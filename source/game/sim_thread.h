@@ -0,0 +1,160 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __SIM_THREAD__
+#define __SIM_THREAD__
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <game/tick_clock.h>
+#include <mutex>
+#include <thread>
+
+namespace game
+{
+
+// Runs fixed ticks on its own thread, each tick is published into a front snapshot the render thread reads
+template <typename S>
+class sim_thread
+{
+  private:
+    typedef std::chrono::steady_clock clock;
+    std::mutex &_state;
+    const std::function<void(S &)> _tick;
+    const double _step;
+    tick_clock _clock;
+    S _back;
+    S _front;
+    clock::time_point _stamp;
+    size_t _ticks;
+    std::mutex _lock;
+    std::condition_variable _cond;
+    bool _run;
+    bool _idle;
+    bool _die;
+    std::thread _thread;
+
+    inline void publish()
+    {
+        // Transforms are replaced, queued side effects pile up until read
+        std::lock_guard<std::mutex> lock(_lock);
+        _front.merge(_back);
+        _stamp = clock::now();
+        _ticks++;
+    }
+    inline void work()
+    {
+        clock::time_point last = clock::now();
+        while (true)
+        {
+            // Sleep while stopped, the clock restarts on resume so no backlog builds up
+            {
+                std::unique_lock<std::mutex> lock(_lock);
+                if (!_run && !_die)
+                {
+                    _idle = true;
+                    _cond.notify_all();
+                    _cond.wait(lock, [this]() { return _run || _die; });
+                    _idle = false;
+                    _clock.reset();
+                    last = clock::now();
+                }
+                if (_die)
+                {
+                    break;
+                }
+            }
+
+            // Run all ticks that are due, the state is only locked for one tick at a time
+            const clock::time_point now = clock::now();
+            const size_t ticks = _clock.advance(std::chrono::duration<double>(now - last).count());
+            last = now;
+            for (size_t i = 0; i < ticks; i++)
+            {
+                std::lock_guard<std::mutex> state(_state);
+                _tick(_back);
+                publish();
+            }
+
+            // Sleep until the next tick is due or we are stopped
+            const double wait = (1.0 - _clock.alpha()) * _step;
+            std::unique_lock<std::mutex> lock(_lock);
+            _cond.wait_for(lock, std::chrono::duration<double>(wait), [this]() { return !_run || _die; });
+        }
+
+        // Signal the last tick has finished
+        std::lock_guard<std::mutex> lock(_lock);
+        _idle = true;
+        _cond.notify_all();
+    }
+
+  public:
+    sim_thread(std::mutex &state, const double step, const size_t max_ticks, const std::function<void(S &)> &tick)
+        : _state(state), _tick(tick), _step(step), _clock(step, max_ticks), _stamp(clock::now()),
+          _ticks(0), _run(false), _idle(false), _die(false)
+    {
+        // Boot the simulation thread, it waits until started
+        _thread = std::thread(&sim_thread::work, this);
+    }
+    ~sim_thread()
+    {
+        // Finish the current tick and kill the thread
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _die = true;
+        }
+        _cond.notify_all();
+        _thread.join();
+    }
+    template <typename F>
+    inline void read(const F &f)
+    {
+        // Blend between the last two ticks by the time since the last publish, never extrapolate
+        std::lock_guard<std::mutex> lock(_lock);
+        const double since = std::chrono::duration<double>(clock::now() - _stamp).count();
+        const float alpha = std::min(static_cast<float>(since / _step), 1.0f);
+        f(_front, alpha);
+    }
+    inline void start()
+    {
+        // Cheap to call every frame, only wakes the thread if stopped
+        std::lock_guard<std::mutex> lock(_lock);
+        if (!_run)
+        {
+            _run = true;
+            _cond.notify_all();
+        }
+    }
+    inline void stop()
+    {
+        // Don't call with the state locked, blocks until the current tick has finished
+        std::unique_lock<std::mutex> lock(_lock);
+        _run = false;
+        _cond.notify_all();
+        _cond.wait(lock, [this]() { return _idle; });
+    }
+    inline size_t ticks()
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        return _ticks;
+    }
+};
+}
+
+#endif
@@ -0,0 +1,125 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __SLOT_MAP__
+#define __SLOT_MAP__
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace game
+{
+
+// Fixed capacity slot allocator with a free list, handles pack a slot and a generation
+// Freeing a slot bumps its generation so old handles to it stop being valid
+class slot_map
+{
+  private:
+    static constexpr size_t _slot_bits = 16;
+    static constexpr size_t _slot_mask = (1 << _slot_bits) - 1;
+    std::vector<uint16_t> _gen;
+    std::vector<uint8_t> _live;
+    std::vector<uint16_t> _free;
+
+  public:
+    slot_map(const size_t limit) : _gen(limit, 0), _live(limit, 0)
+    {
+        // Slots are packed into the handle
+        if (limit > _slot_mask + 1)
+        {
+            throw std::runtime_error("slot_map: limit too large");
+        }
+
+        // Hand out the lowest slots first
+        _free.reserve(limit);
+        clear();
+    }
+    inline static size_t slot(const size_t handle)
+    {
+        return handle & _slot_mask;
+    }
+    inline size_t alloc()
+    {
+        // Check for overflow
+        if (_free.empty())
+        {
+            throw std::runtime_error("slot_map: out of slots");
+        }
+
+        // Pop the next free slot
+        const size_t s = _free.back();
+        _free.pop_back();
+        _live[s] = 1;
+
+        return handle(s);
+    }
+    inline void clear()
+    {
+        // Free all slots, live slots move to the next generation
+        const size_t size = _gen.size();
+        _free.clear();
+        for (size_t i = size; i-- != 0;)
+        {
+            _gen[i] += _live[i];
+            _live[i] = 0;
+            _free.push_back(static_cast<uint16_t>(i));
+        }
+    }
+    inline void free(const size_t h)
+    {
+        // Ignore stale handles so a slot is never freed twice
+        if (!is_valid(h))
+        {
+            return;
+        }
+
+        // Retire this generation and push the slot
+        const size_t s = slot(h);
+        _gen[s]++;
+        _live[s] = 0;
+        _free.push_back(static_cast<uint16_t>(s));
+    }
+    inline size_t handle(const size_t s) const
+    {
+        return (static_cast<size_t>(_gen[s]) << _slot_bits) | s;
+    }
+    inline bool is_full() const
+    {
+        return _free.empty();
+    }
+    inline bool is_live(const size_t s) const
+    {
+        return _live[s];
+    }
+    inline bool is_valid(const size_t h) const
+    {
+        const size_t s = slot(h);
+        return s < _gen.size() && _live[s] && handle(s) == h;
+    }
+    inline size_t max() const
+    {
+        return _gen.size();
+    }
+    inline size_t size() const
+    {
+        return _gen.size() - _free.size();
+    }
+};
+}
+
+#endif
@@ -19,9 +19,11 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #define __STATIC_INSTANCE__
 
 #include <game/cgrid.h>
+#include <game/chunk_bucket.h>
 #include <game/geometry.h>
 #include <game/id.h>
 #include <game/memory_map.h>
+#include <game/slot_map.h>
 #include <game/uniforms.h>
 #include <min/aabbox.h>
 #include <min/camera.h>
@@ -64,8 +66,8 @@ class static_asset
     const size_t _iid;
     const GLuint _tid;
     const size_t _start_index;
-    const size_t _limit;
     const min::aabbox<float, min::vec3> _box;
+    slot_map _slots;
     std::vector<size_t> _index;
     std::vector<min::mat4<float>> _mat;
     std::vector<min::mat4<float>> _mat_out;
@@ -73,7 +75,6 @@ class static_asset
     inline void reserve_memory(const size_t limit)
     {
         _index.reserve(limit);
-        _mat.reserve(limit);
         _mat_out.reserve(limit);
     }
 
@@ -82,7 +83,7 @@ class static_asset
         const GLuint iid, const size_t tid,
         const size_t index, const size_t limit,
         const min::aabbox<float, min::vec3> &box)
-        : _iid(iid), _tid(tid), _start_index(index), _limit(limit), _box(box)
+        : _iid(iid), _tid(tid), _start_index(index), _box(box), _slots(limit), _mat(limit)
     {
         // Reserve memory
         reserve_memory(limit);
@@ -95,43 +96,37 @@ class static_asset
     inline size_t add(const min::vec3<float> &p)
     {
         // Check for buffer overflow
-        if (_mat.size() == _limit)
+        if (_slots.is_full())
         {
             throw std::runtime_error("static_instance: must change default count");
         }
 
-        // Push back location
-        _mat.push_back(p);
+        // Take a free slot for the location
+        const size_t id = _slots.alloc();
+        _mat[slot_map::slot(id)] = min::mat4<float>(p);
 
-        // Return chest id
-        return _mat.size() - 1;
+        // Return the instance handle
+        return id;
     }
     inline size_t add(const min::vec3<float> &p, const block_id atlas)
     {
-        // Check for buffer overflow
-        if (_mat.size() == _limit)
-        {
-            throw std::runtime_error("static_instance: must change default count");
-        }
-
-        // Push back location
-        _mat.push_back(p);
+        // Take a free slot for the location
+        const size_t id = add(p);
 
         // Pack the matrix with the atlas id
-        const float float_atlas = static_cast<float>(atlas);
-        const float w = float_atlas + 2.1;
-        _mat.back().w(w);
+        update_atlas(id, atlas);
 
-        // Return chest id
-        return _mat.size() - 1;
+        // Return the instance handle
+        return id;
     }
-    inline void clear(const size_t index)
+    inline void clear(const size_t id)
     {
-        _mat.erase(_mat.begin() + index);
+        // Other instances keep their slots
+        _slots.free(id);
     }
     inline void clear()
     {
-        _mat.clear();
+        _slots.clear();
     }
     inline void clear_index()
     {
@@ -157,44 +152,49 @@ class static_asset
             _mat_out.clear();
         }
     }
-    inline void cull_frustum(const cgrid &grid, const min::camera<float> &cam)
+    inline bool is_full() const
     {
-        // Cull chests
-        const size_t size = _mat.size();
-        for (size_t i = 0; i < size; i++)
-        {
-            // Create chest bounding box from matrix position
-            const min::aabbox<float, min::vec3> box = get_box(i);
-
-            // If the box is within the frustum
-            if (grid.is_viewable(cam, box))
-            {
-                _index.push_back(i);
-            }
-        }
+        return _slots.is_full();
     }
-    inline bool is_full() const
+    inline bool is_live(const size_t s) const
+    {
+        return _slots.is_live(s);
+    }
+    inline bool is_valid(const size_t id) const
     {
-        return _mat.size() == _limit;
+        return _slots.is_valid(id);
     }
-    inline min::aabbox<float, min::vec3> get_box(const size_t index) const
+    inline min::aabbox<float, min::vec3> get_box(const size_t id) const
     {
         // Create box for this mob
         min::aabbox<float, min::vec3> box(_box);
 
         // Move box to mob position
-        box.set_position(_mat[index].get_translation());
+        box.set_position(_mat[slot_map::slot(id)].get_translation());
 
         // Return this box for collisions
         return box;
     }
+    inline min::vec3<float> get_position(const size_t id) const
+    {
+        return _mat[slot_map::slot(id)].get_translation();
+    }
     inline size_t get_iid() const
     {
         return _iid;
     }
-    inline const std::vector<min::mat4<float>> &get_in_matrix() const
+    template <typename F>
+    inline void get_in_matrix(const F &f) const
     {
-        return _mat;
+        // Visit the matrix of every live instance
+        const size_t size = _mat.size();
+        for (size_t i = 0; i < size; i++)
+        {
+            if (_slots.is_live(i))
+            {
+                f(_mat[i]);
+            }
+        }
     }
     inline const std::vector<min::mat4<float>> &get_out_matrix() const
     {
@@ -210,55 +210,35 @@ class static_asset
     }
     inline size_t max() const
     {
-        return _limit;
+        return _slots.max();
     }
-    inline size_t view_size() const
+    inline size_t size() const
     {
-        return _mat_out.size();
+        return _slots.size();
     }
-    inline void sort_prune_index(std::vector<size_t> &sort)
+    inline size_t view_size() const
     {
-        // Cull empty index buffer
-        if (_index.size() > 0)
-        {
-            // Sort index keys using a radix sort
-            min::uint_sort<size_t>(_index, sort, [](const size_t i) {
-                return i;
-            });
-
-            // Make keys unique
-            const auto last = std::unique(_index.begin(), _index.end());
-
-            // Erase empty spaces in vector
-            _index.erase(last, _index.end());
-        }
+        return _mat_out.size();
     }
-    inline void update_position(const size_t index, const min::vec3<float> &p)
+    inline void update_position(const size_t id, const min::vec3<float> &p)
     {
-        _mat[index].set_translation(p);
+        _mat[slot_map::slot(id)].set_translation(p);
     }
-    inline void update_rotation(const size_t index, const min::quat<float> &r)
+    inline void update_rotation(const size_t id, const min::quat<float> &r)
     {
-        _mat[index].set_rotation(r);
+        _mat[slot_map::slot(id)].set_rotation(r);
     }
-    inline void update_atlas(const size_t index, const block_id atlas)
+    inline void update_atlas(const size_t id, const block_id atlas)
     {
         const float float_atlas = static_cast<float>(atlas);
         const float w = float_atlas + 2.1;
-        _mat[index].w(w);
+        _mat[slot_map::slot(id)].w(w);
     }
 };
 
 class static_instance
 {
   private:
-    typedef min::physics<float, uint_fast16_t, uint_fast32_t, min::vec3, min::aabbox, min::aabbox, min::grid> physics;
-    static constexpr size_t _CHEST_LIMIT = 10;
-    static constexpr size_t _DRONE_LIMIT = 10;
-    static constexpr size_t _DROP_LIMIT = 50;
-    static constexpr size_t _EXPLODE_LIMIT = 10;
-    static constexpr size_t _MISS_LIMIT = 10;
-
     min::shader _vertex;
     min::shader _fragment;
     min::program _prog;
@@ -268,49 +248,27 @@ class static_instance
     min::vertex_buffer<float, uint16_t, min::static_vertex, GL_FLOAT, GL_UNSIGNED_SHORT> _buffer;
     min::texture_buffer _texture_buffer;
     std::vector<static_asset> _assets;
-    std::vector<size_t> _sort_index;
+    chunk_bucket _bucket;
+    std::vector<size_t> _offset;
+    std::vector<uint8_t> _owner;
 
-    inline void cull_frustum(const cgrid &grid, const min::camera<float> &cam)
-    {
-        const size_t size = _assets.size();
-        for (size_t i = 0; i < size; i++)
-        {
-            _assets[i].cull_frustum(grid, cam);
-        }
-    }
-    inline void cull_physics(const physics &sim, const cgrid &grid)
+    inline void cull_buckets(const cgrid &grid)
     {
         // Get the view chunks from grid
         const std::vector<view_chunk> &view_chunks = grid.get_view_chunks();
 
-        // Get the index map
-        const std::vector<uint_fast16_t> &map = sim.get_index_map();
-
-        // For each view chunk
+        // Every instance is in one bucket, so no instance is added twice
         for (const view_chunk &vc : view_chunks)
         {
-            // Perform overlapping of physics bodies
-            const std::vector<std::pair<uint_fast16_t, uint_fast16_t>> &over = sim.get_overlap(vc.get_box());
-
-            // For each body in view chunk
-            const size_t size = over.size();
-            for (size_t i = 0; i < size; i++)
+            const std::vector<uint16_t> &bucket = _bucket.get(vc.get_key());
+            for (const uint16_t item : bucket)
             {
-                // Get the body from the simulation
-                const min::body<float, min::vec3> &b = sim.get_body(map[over[i].first]);
-
-                // Get the type of body
-                const size_t id = b.get_id();
-
-                // If the body is not dead
-                if (!b.is_dead() && id != id_value(static_id::PLAYER))
-                {
-                    _assets[id - 1].add_index(b.get_data().index);
-                }
+                const size_t asset = _owner[item];
+                _assets[asset].add_index(item - _offset[asset]);
             }
         }
     }
-    inline void load_chest_model()
+    inline void load_chest_model(const game::uniforms &uniforms)
     {
         // Load chest data from binary mesh file
         min::mesh<float, uint16_t> mesh("chest");
@@ -331,11 +289,11 @@ class static_instance
         const min::aabbox<float, min::vec4> box(mesh.vertex);
         const min::aabbox<float, min::vec3> box3(box.get_min(), box.get_max());
 
-        // Add to asset buffer
-        const size_t limit = _CHEST_LIMIT;
-        _assets.emplace_back(iid, tid, 245, limit, box3);
+        // Add to asset buffer, sized by the uniform buffer layout
+        const std::vector<size_t> &id = uniforms.get_chest_id();
+        _assets.emplace_back(iid, tid, id.front(), id.size(), box3);
     }
-    inline void load_drone_model()
+    inline void load_drone_model(const game::uniforms &uniforms)
     {
         // Load drone data from binary mesh file
         min::mesh<float, uint16_t> mesh("drone");
@@ -356,11 +314,11 @@ class static_instance
         const min::aabbox<float, min::vec4> box(mesh.vertex);
         const min::aabbox<float, min::vec3> box3(box.get_min(), box.get_max());
 
-        // Add to asset buffer
-        const size_t limit = _DRONE_LIMIT;
-        _assets.emplace_back(iid, tid, 255, limit, box3);
+        // Add to asset buffer, sized by the uniform buffer layout
+        const std::vector<size_t> &id = uniforms.get_drone_id();
+        _assets.emplace_back(iid, tid, id.front(), id.size(), box3);
     }
-    inline void load_drop_explode_model()
+    inline void load_drop_explode_model(const game::uniforms &uniforms)
     {
         // Load drop data from geometry functions
         min::mesh<float, uint16_t> mesh("drop");
@@ -403,13 +361,13 @@ class static_instance
         // Create bounding box from box dimensions
         const min::aabbox<float, min::vec3> box(min, max);
 
-        // Add to asset buffer
-        const size_t drop_limit = _DROP_LIMIT;
-        _assets.emplace_back(iid, tid, 265, drop_limit, box);
-        const size_t explode_limit = _EXPLODE_LIMIT;
-        _assets.emplace_back(iid, tid, 315, explode_limit, box);
+        // Add to asset buffer, sized by the uniform buffer layout
+        const std::vector<size_t> &drop_id = uniforms.get_drop_id();
+        _assets.emplace_back(iid, tid, drop_id.front(), drop_id.size(), box);
+        const std::vector<size_t> &explode_id = uniforms.get_explode_id();
+        _assets.emplace_back(iid, tid, explode_id.front(), explode_id.size(), box);
     }
-    inline void load_missile_model()
+    inline void load_missile_model(const game::uniforms &uniforms)
     {
         // Load missile data from binary mesh file
         min::mesh<float, uint16_t> mesh("missile");
@@ -430,23 +388,23 @@ class static_instance
         const min::aabbox<float, min::vec4> box(mesh.vertex);
         const min::aabbox<float, min::vec3> box3(box.get_min(), box.get_max());
 
-        // Add to asset buffer
-        const size_t limit = _MISS_LIMIT;
-        _assets.emplace_back(iid, tid, 325, limit, box3);
+        // Add to asset buffer, sized by the uniform buffer layout
+        const std::vector<size_t> &id = uniforms.get_missile_id();
+        _assets.emplace_back(iid, tid, id.front(), id.size(), box3);
     }
-    inline void load_models()
+    inline void load_models(const game::uniforms &uniforms)
     {
         // Load chest data
-        load_chest_model();
+        load_chest_model(uniforms);
 
         // Load drone data
-        load_drone_model();
+        load_drone_model(uniforms);
 
         // Load drop and explode data
-        load_drop_explode_model();
+        load_drop_explode_model(uniforms);
 
         // Load missile data
-        load_missile_model();
+        load_missile_model(uniforms);
 
         // Unbind the last VAO to prevent scrambling buffers
         _buffer.unbind();
@@ -472,9 +430,18 @@ class static_instance
     }
     inline void reserve_memory()
     {
-        _sort_index.reserve(_DROP_LIMIT);
         _assets.reserve(id_value(static_id::ASSET_SIZE));
     }
+    inline void load_owners()
+    {
+        // Number all instance slots across assets for the chunk buckets
+        const size_t size = _assets.size();
+        for (size_t i = 0; i < size; i++)
+        {
+            _offset.push_back(_owner.size());
+            _owner.resize(_owner.size() + _assets[i].max(), static_cast<uint8_t>(i));
+        }
+    }
     inline void set_start_index(const GLint start_index) const
     {
         // Set the sampler active texture
@@ -495,7 +462,10 @@ class static_instance
         reserve_memory();
 
         // Load instance model
-        load_models();
+        load_models(uniforms);
+
+        // Map bucket items back to assets
+        load_owners();
     }
     void draw(const game::uniforms &uniforms) const
     {
@@ -589,56 +559,77 @@ class static_instance
         // Number of assets in view
         return count;
     }
-    inline static constexpr size_t max_alloc()
+    inline size_t max_alloc() const
     {
-        return _CHEST_LIMIT + _DRONE_LIMIT + _DROP_LIMIT + _EXPLODE_LIMIT + _MISS_LIMIT;
+        return max_chests() + max_drones() + max_drops() + max_explosives() + max_missiles();
     }
-    inline static constexpr size_t max_chests()
+    inline size_t max_chests() const
     {
-        return _CHEST_LIMIT;
+        return get_chest().max();
     }
-    inline static constexpr size_t max_drones()
+    inline size_t max_drones() const
     {
-        return _DRONE_LIMIT;
+        return get_drone().max();
     }
-    inline static constexpr size_t max_drops()
+    inline size_t max_drops() const
     {
-        return _DROP_LIMIT;
+        return get_drop().max();
     }
-    inline static constexpr size_t max_explosives()
+    inline size_t max_explosives() const
     {
-        return _EXPLODE_LIMIT;
+        return get_explosive().max();
     }
-    inline static constexpr size_t max_missiles()
+    inline size_t max_missiles() const
     {
-        return _MISS_LIMIT;
+        return get_missile().max();
     }
-    void update(const physics &sim, const cgrid &grid, const min::camera<float> &cam)
+    inline void update_buckets(const cgrid &grid)
     {
-        // Clear out the asset index buffer
-        const size_t size = _assets.size();
-        for (size_t i = 0; i < size; i++)
+        // Chunk layout is known once the grid is loaded
+        if (_bucket.chunks() != grid.get_chunks())
         {
-            _assets[i].clear_index();
+            _bucket.resize(grid.get_chunks(), _owner.size());
         }
 
-        // Decide culling strategy
-        if (sim.get_scale() >= grid.get_chunk_scale())
+        // Move instances that crossed a chunk boundary, drop free slots
+        const size_t size = _assets.size();
+        for (size_t i = 0; i < size; i++)
         {
-            cull_physics(sim, grid);
+            const static_asset &asset = _assets[i];
+            const size_t offset = _offset[i];
+            const size_t limit = asset.max();
+            for (size_t j = 0; j < limit; j++)
+            {
+                // Free slots and instances outside the grid are in no bucket
+                bool valid = false;
+                const size_t key = (asset.is_live(j)) ? grid.chunk_key_safe(asset.get_position(j), valid) : 0;
+                if (valid)
+                {
+                    _bucket.insert(offset + j, key);
+                }
+                else
+                {
+                    _bucket.remove(offset + j);
+                }
+            }
         }
-        else
+    }
+    void update(const cgrid &grid)
+    {
+        // Clear out the asset index buffer
+        const size_t size = _assets.size();
+        for (size_t i = 0; i < size; i++)
         {
-            cull_frustum(grid, cam);
+            _assets[i].clear_index();
         }
 
-        // Sort all assets and copy matrix output buffers
+        // Bucket instances by chunk and gather the visible chunks
+        update_buckets(grid);
+        cull_buckets(grid);
+
+        // Copy matrix output buffers
         for (size_t i = 0; i < size; i++)
         {
-            // Sort and remove duplicates
-            _assets[i].sort_prune_index(_sort_index);
-
-            // Copy to output buffer
             _assets[i].copy_mat_index();
         }
     }
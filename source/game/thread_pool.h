@@ -226,11 +226,13 @@ class thread_pool
     }
 
   public:
-    thread_pool() : _thread_count(std::thread::hardware_concurrency()),
-                    _threads(_thread_count - 1), _die(false), _turbo(false),
-                    _gen(std::chrono::high_resolution_clock::now().time_since_epoch().count())
+    thread_pool() : thread_pool(std::thread::hardware_concurrency()) {}
+    thread_pool(const unsigned threads)
+        : _thread_count(threads),
+          _threads((threads > 0) ? threads - 1 : 0), _die(false), _turbo(false),
+          _gen(std::chrono::high_resolution_clock::now().time_since_epoch().count())
     {
-        // Error out if can't determine core count
+        // Error out if can't determine core count, the calling thread counts as one
         if (_thread_count < 1)
         {
             throw std::runtime_error("thread_pool: can't determine number of CPU cores");
@@ -254,6 +256,10 @@ class thread_pool
             _threads[i].join();
         }
     }
+    inline unsigned get_threads() const
+    {
+        return _thread_count;
+    }
     inline void kill()
     {
         // Wait for threads to finish work
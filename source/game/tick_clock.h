@@ -0,0 +1,70 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TICK_CLOCK__
+#define __TICK_CLOCK__
+
+#include <algorithm>
+#include <cstddef>
+
+namespace game
+{
+
+// Fixed rate simulation clock, frame time left over from a frame carries to the next
+class tick_clock
+{
+  private:
+    const double _step;
+    const size_t _max_ticks;
+    double _accum;
+
+  public:
+    tick_clock(const double step, const size_t max_ticks)
+        : _step(step), _max_ticks(max_ticks), _accum(0.0) {}
+
+    inline size_t advance(const double dt)
+    {
+        // Take all whole ticks that fit in the accumulated time, a frame of exactly N ticks shouldn't round down
+        _accum += dt;
+        size_t ticks = static_cast<size_t>(_accum / _step + 1E-6);
+
+        // After a long stall drop the backlog instead of trying to catch up
+        if (ticks > _max_ticks)
+        {
+            ticks = _max_ticks;
+            _accum = static_cast<double>(_max_ticks) * _step;
+        }
+
+        // Keep the remainder for the next frame
+        _accum -= static_cast<double>(ticks) * _step;
+
+        return ticks;
+    }
+    inline float alpha() const
+    {
+        // How far we are between the last two ticks, rounding can leave it a hair outside
+        const float a = static_cast<float>(_accum / _step);
+        return std::min(std::max(a, 0.0f), 1.0f);
+    }
+    inline void reset()
+    {
+        _accum = 0.0;
+    }
+};
+}
+
+#endif
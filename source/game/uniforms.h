@@ -18,9 +18,11 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef __UNIFORMS__
 #define __UNIFORMS__
 
+#include <game/options.h>
 #include <min/camera.h>
 #include <min/uniform_buffer.h>
 #include <min/vec4.h>
+#include <stdexcept>
 
 namespace game
 {
@@ -28,6 +30,10 @@ namespace game
 class uniforms
 {
   private:
+    // Sizes of the shader arrays, the instance limits share what the other matrices leave
+    static constexpr size_t _max_matrix = 435;
+    static constexpr size_t _ui = 120;
+    static constexpr size_t _bones = 100;
     min::uniform_buffer<float> _ub;
     min::light<float> _light1;
 
@@ -126,15 +132,42 @@ class uniforms
     }
 
   public:
-    uniforms() : _ub(1, 435, 0)
+    uniforms(const options &opt) : _ub(1, _max_matrix, 0)
     {
+        // Instances must fit in the shader matrix array next to the fixed matrices
+        const size_t fixed = 5 + 2 * _ui + _bones;
+        if (fixed + opt.instances() > _max_matrix)
+        {
+            throw std::runtime_error("uniforms: instance limits exceed the shader matrix array");
+        }
+
         // Load the number of used uniforms into the buffer
-        load_uniforms(120, 10, 10, 50, 10, 10, 100);
+        load_uniforms(_ui, opt.chests(), opt.drones(), opt.drops(), opt.explosives(), opt.missiles(), _bones);
     }
     inline void bind() const
     {
         _ub.bind();
     }
+    inline const std::vector<size_t> &get_chest_id() const
+    {
+        return _chest_id;
+    }
+    inline const std::vector<size_t> &get_drone_id() const
+    {
+        return _drone_id;
+    }
+    inline const std::vector<size_t> &get_drop_id() const
+    {
+        return _drop_id;
+    }
+    inline const std::vector<size_t> &get_explode_id() const
+    {
+        return _explode_id;
+    }
+    inline const std::vector<size_t> &get_missile_id() const
+    {
+        return _missile_id;
+    }
     inline void set_program_lights(const min::program &p) const
     {
         _ub.set_program_lights(p);
@@ -0,0 +1,187 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __VOXEL_CONTACT__
+#define __VOXEL_CONTACT__
+
+#include <algorithm>
+#include <cmath>
+#include <game/id.h>
+#include <min/aabbox.h>
+#include <min/vec3.h>
+#include <vector>
+
+namespace game
+{
+
+class cell_contact
+{
+  private:
+    size_t _key;
+    block_id _value;
+    min::vec3<float> _cell;
+    min::vec3<float> _min;
+    min::vec3<float> _max;
+
+    inline size_t axis(float &depth) const
+    {
+        // Overlap of the query box with this unit cell on each axis
+        const min::vec3<float> lo = _min - _cell;
+        const min::vec3<float> hi = _max - _cell;
+        const float ox = std::min(hi.x(), 1.0f) - std::max(lo.x(), 0.0f);
+        const float oy = std::min(hi.y(), 1.0f) - std::max(lo.y(), 0.0f);
+        const float oz = std::min(hi.z(), 1.0f) - std::max(lo.z(), 0.0f);
+
+        // Axis of least overlap
+        if (ox <= oy && ox <= oz)
+        {
+            depth = ox;
+            return 0;
+        }
+        else if (oy <= oz)
+        {
+            depth = oy;
+            return 1;
+        }
+
+        depth = oz;
+        return 2;
+    }
+
+  public:
+    cell_contact(const size_t key, const block_id value, const min::vec3<float> &cell, const min::aabbox<float, min::vec3> &box)
+        : _key(key), _value(value), _cell(cell), _min(box.get_min()), _max(box.get_max()) {}
+
+    min::aabbox<float, min::vec3> get_box() const
+    {
+        return min::aabbox<float, min::vec3>(_cell, _cell + 1.0);
+    }
+    min::vec3<float> get_center() const
+    {
+        return _cell + 0.5;
+    }
+    float get_depth() const
+    {
+        // Push out distance along the normal, only computed when asked for
+        float depth;
+        axis(depth);
+
+        return depth;
+    }
+    size_t get_key() const
+    {
+        return _key;
+    }
+    min::vec3<float> get_normal() const
+    {
+        // Push out along the axis of least overlap, away from the cell center
+        float depth;
+        const size_t a = axis(depth);
+        const min::vec3<float> center = (_min + _max) * 0.5 - _cell;
+        min::vec3<float> normal(0.0, 0.0, 0.0);
+        if (a == 0)
+        {
+            normal.x((center.x() >= 0.5f) ? 1.0 : -1.0);
+        }
+        else if (a == 1)
+        {
+            normal.y((center.y() >= 0.5f) ? 1.0 : -1.0);
+        }
+        else
+        {
+            normal.z((center.z() >= 0.5f) ? 1.0 : -1.0);
+        }
+
+        return normal;
+    }
+    block_id get_value() const
+    {
+        return _value;
+    }
+};
+
+// Finds solid unit cells touching a box straight from the grid, nothing is allocated
+class voxel_contact
+{
+  private:
+    const std::vector<block_id> &_grid;
+    const size_t _grid_scale;
+    const min::vec3<float> _world_min;
+
+    inline bool range(const float lo, const float hi, size_t &begin, size_t &end) const
+    {
+        // Is the box outside the grid on this axis?
+        const float scale = static_cast<float>(_grid_scale);
+        if (hi < 0.0f || lo >= scale)
+        {
+            return false;
+        }
+
+        // Cells overlapping [lo, hi] on one axis, clamped to the grid
+        begin = static_cast<size_t>(std::max(std::floor(lo), 0.0f));
+        end = static_cast<size_t>(std::min(std::floor(hi), scale - 1.0f)) + 1;
+
+        return true;
+    }
+
+  public:
+    voxel_contact(const std::vector<block_id> &grid, const size_t grid_scale, const min::vec3<float> &world_min)
+        : _grid(grid), _grid_scale(grid_scale), _world_min(world_min) {}
+
+    template <typename F>
+    inline void query(const min::aabbox<float, min::vec3> &box, const F &f) const
+    {
+        // Box in grid space
+        const min::vec3<float> lo = box.get_min() - _world_min;
+        const min::vec3<float> hi = box.get_max() - _world_min;
+
+        size_t x0, x1, y0, y1, z0, z1;
+        if (!range(lo.x(), hi.x(), x0, x1) || !range(lo.y(), hi.y(), y0, y1) || !range(lo.z(), hi.z(), z0, z1))
+        {
+            return;
+        }
+
+        // Visit solid cells in key order, stop when the callback returns true
+        const size_t gs = _grid_scale;
+        for (size_t x = x0; x < x1; x++)
+        {
+            for (size_t y = y0; y < y1; y++)
+            {
+                const size_t row = (x * gs + y) * gs;
+                for (size_t z = z0; z < z1; z++)
+                {
+                    const size_t key = row + z;
+                    const block_id value = _grid[key];
+                    if (value == block_id::EMPTY)
+                    {
+                        continue;
+                    }
+
+                    // Cell corner back in world space, normal and depth are left to the caller
+                    const min::vec3<float> cell = _world_min + min::vec3<float>(x, y, z);
+                    if (f(cell_contact(key, value, cell, box)))
+                    {
+                        return;
+                    }
+                }
+            }
+        }
+    }
+};
+}
+
+#endif
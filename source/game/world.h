@@ -21,6 +21,7 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #include <chrono>
 #include <cmath>
 #include <cstdint>
+#include <functional>
 #include <game/callback.h>
 #include <game/cgrid.h>
 #include <game/chests.h>
@@ -32,15 +33,20 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #include <game/missiles.h>
 #include <game/particle.h>
 #include <game/player.h>
+#include <game/sim_thread.h>
 #include <game/sky.h>
 #include <game/sound.h>
 #include <game/static_instance.h>
 #include <game/swatch.h>
 #include <game/terrain.h>
 #include <game/uniforms.h>
+#include <game/work_queue.h>
+#include <game/world_snapshot.h>
+#include <iterator>
 #include <min/camera.h>
 #include <min/grid.h>
 #include <min/physics_nt.h>
+#include <mutex>
 #include <random>
 #include <stdexcept>
 #include <utility>
@@ -60,11 +66,14 @@ class world
     static constexpr float _explode_size = 100.0;
     static constexpr float _explode_speed = 5.0;
     static constexpr float _explode_time = 5.0;
+    static constexpr float _friction = -10.0 * 60.0 / _physics_frames;
     static constexpr float _spawn_limit = 5.0;
     static constexpr float _time_step = 1.0 / _physics_frames;
+    static constexpr size_t _parallel_bodies = 64;
     static constexpr size_t _pre_max_scale = 5;
     static constexpr size_t _pre_max_vol = _pre_max_scale * _pre_max_scale * _pre_max_scale;
     static constexpr size_t _ray_max_dist = 100;
+    static constexpr size_t _scatter_size = 4;
     static constexpr float _explode_scale = 0.9;
 
     // Terrain stuff
@@ -73,6 +82,11 @@ class world
     particle *const _particles;
     sound *const _sound;
     std::vector<size_t> _view_chunk_index;
+    std::vector<size_t> _chunk_keys;
+    std::vector<uint8_t> _upload;
+    min::vec3<float> _portal_top;
+    std::vector<min::ray<float, min::vec3>> _scatter_rays;
+    std::vector<target> _scatter_targets;
 
     // Physics stuff
     const min::vec3<unsigned> _ex_radius;
@@ -80,6 +94,8 @@ class world
     const min::vec3<float> _gravity;
     min::physics<float, uint_fast16_t, uint_fast32_t, min::vec3, min::aabbox, min::aabbox, min::grid> _simulation;
     size_t _char_id;
+    min::vec3<float> _player_view;
+    std::vector<std::function<void()>> _effects;
 
     // Terrain control stuff
     min::mesh<float, uint32_t> _terr_mesh;
@@ -120,13 +136,28 @@ class world
     std::uniform_real_distribution<float> _scat_dist;
     std::mt19937 _gen;
 
+    // Simulation thread, declared last so it stops before anything it ticks is destroyed
+    std::mutex _lock;
+    sim_thread<world_snapshot> _sim;
+
     // Private methods
     inline unsigned block_remove(const min::vec3<float> &p, const min::vec3<unsigned> &scale)
     {
         const min::vec3<int> offset(1, 1, 1);
 
         // Offset remove radius for geometry removal
-        return _grid.set_geometry(_grid.snap(center_radius(p, scale)), scale, offset, block_id::EMPTY, nullptr);
+        const unsigned out = _grid.set_geometry(_grid.snap(center_radius(p, scale)), scale, offset, block_id::EMPTY, nullptr);
+
+        // Drops resting here lost their ground
+        wake_drops(p, scale);
+
+        return out;
+    }
+    inline void wake_drops(const min::vec3<float> &p, const min::vec3<unsigned> &scale)
+    {
+        // Cover the edited cells from any corner, plus the drop size
+        const unsigned length = std::max(scale.x(), std::max(scale.y(), scale.z()));
+        _drops.wake(p, length + 1.0);
     }
     static inline min::vec3<float> center_radius(const min::vec3<float> &p, const min::vec3<unsigned> &scale)
     {
@@ -162,6 +193,28 @@ class world
         // Return the character body id
         return _char_id;
     }
+    inline box_call body_box_call() const
+    {
+        // Return the bounding box of a physics body
+        return [this](const min::body<float, min::vec3> &b) -> min::aabbox<float, min::vec3> {
+            const size_t index = b.get_data().index;
+            switch (b.get_id())
+            {
+            case id_value(static_id::CHEST):
+                return this->_instance.get_chest().get_box(index);
+            case id_value(static_id::DRONE):
+                return this->_instance.get_drone().get_box(index);
+            case id_value(static_id::DROP):
+                return this->_instance.get_drop().get_box(index);
+            case id_value(static_id::EXPLOSIVE):
+                return this->_instance.get_explosive().get_box(index);
+            case id_value(static_id::MISSILE):
+                return this->_instance.get_missile().get_box(index);
+            default:
+                return cgrid::player_box(b.get_position());
+            }
+        };
+    }
     inline dmg_call dmg_default_call()
     {
         // On explode callback, return default damage
@@ -219,6 +272,12 @@ class world
     }
     inline void drone_damage(const size_t drone_index, const min::vec3<unsigned> &scale, const min::vec3<float> &dir, const float size, const float damage)
     {
+        // The drone may already be dead this step
+        if (!_drones.is_live(drone_index))
+        {
+            return;
+        }
+
         // Cache the drone position, no reference here
         const min::vec3<float> p = _drones.position(drone_index);
 
@@ -330,20 +389,27 @@ class world
         const min::vec3<int> offset(1, 1, 1);
         _grid.set_geometry(center, scale, offset, block_id::EMPTY, f);
 
+        // Wake drops resting in the blast
+        wake_drops(p, scale);
+
         // Calculate explosion speed
         const min::vec3<float> speed = dir * _explode_speed;
 
-        // Add particle effects
-        _particles->load_static_explode(p, speed, _explode_time, size);
+        // Queue particle effects for the render thread
+        _effects.push_back([this, p, speed, size]() {
+            this->_particles->load_static_explode(p, speed, this->_explode_time, size);
+        });
 
         // Check if character is too close to the explosion
         const auto pack = in_range_explode(_player.position(), p, scale);
         const bool in_range = std::get<0>(pack);
 
-        // Play the sound call
+        // Queue the sound call
         if (s)
         {
-            s(p, in_range, atlas);
+            _effects.push_back([s, p, in_range, atlas]() {
+                s(p, in_range, atlas);
+            });
         }
 
         // If explode hasn't been flagged yet
@@ -377,7 +443,7 @@ class world
                 break;
             case id_value(static_id::DRONE):
             {
-                // Get the drone index from the body
+                // Get the drone handle from the body
                 const size_t index = b.get_data().index;
 
                 // Choose damage type and add the damage multiplier to it
@@ -616,6 +682,9 @@ class world
     }
     inline min::vec3<float> ray_spawn(const min::vec3<float> &p)
     {
+        // Make sure the terrain under the spawn point exists
+        _grid.generate_near(p);
+
         // Create a ray point down
         const min::ray<float, min::vec3> r(p, p - min::vec3<float>::up());
 
@@ -625,7 +694,7 @@ class world
     inline void reserve_memory(const size_t view_chunk_size)
     {
         // Reserve space in the simulation for static instances and player
-        _simulation.reserve(static_instance::max_alloc() + 1);
+        _simulation.reserve(_instance.max_alloc() + 1);
 
         // Reserve space in the preview mesh
         _terr_mesh.vertex.reserve(_pre_max_vol);
@@ -633,6 +702,10 @@ class world
 
         // Reserve space for view chunks
         _view_chunk_index.reserve(view_chunk_size * view_chunk_size * view_chunk_size);
+
+        // Reserve space for scatter rays
+        _scatter_rays.reserve(_scatter_size);
+        _scatter_targets.reserve(_scatter_size);
     }
     inline sound_call sound_default_call()
     {
@@ -681,14 +754,20 @@ class world
                     // Player collided with a drone
                     this->_player.drone_collide(b2.get_position());
 
-                    // Play the zap sound
-                    this->_sound->play_zap();
+                    // Queue the zap sound
+                    this->_effects.push_back([this]() {
+                        this->_sound->play_zap();
+                    });
                 }
             }
             else if (id == id_value(static_id::DROP))
             {
-                // Get the drop index from the body
+                // Get the drop handle from the body, skip drops already picked up
                 const size_t index = b2.get_data().index;
+                if (!this->_drops.is_live(index))
+                {
+                    return;
+                }
 
                 // Get the player inventory
                 inventory &inv = this->_player.get_inventory();
@@ -712,8 +791,10 @@ class world
                         this->item_extra(inv, atlas);
                     }
 
-                    // Play the pickup sound
-                    this->_sound->play_pickup();
+                    // Queue the pickup sound
+                    this->_effects.push_back([this]() {
+                        this->_sound->play_pickup();
+                    });
 
                     // Remove drop from drop buffer
                     this->_drops.remove(index);
@@ -735,27 +816,28 @@ class world
 
         // Explosive collision callback
         const auto h = [this](min::body<float, min::vec3> &b1, min::body<float, min::vec3> &b2) {
-            // Get the explode index from the body
+            // Get the explode handle from the body
             const size_t exp_index = b1.get_data().index;
 
             // Get other body id, b1 is explosive
             if (b2.get_id() == id_value(static_id::PLAYER))
             {
-                if (this->_player.is_explodeable())
+                // Remove this explosive, if it didn't already explode this step
+                if (this->_player.is_explodeable() && this->_explosives.explode(exp_index))
                 {
-                    // Remove this explosive
-                    this->_explosives.explode(exp_index);
-
                     // Explode player
-                    this->explode_call(this->dmg_drone_call(), this->sound_ex_call())(this->_explosives.position(exp_index), this->_explosives.get_scale(), block_id::EMPTY);
+                    this->explode_call(this->dmg_drone_call(), this->sound_ex_call())(b1.get_position(), this->_explosives.get_scale(), block_id::EMPTY);
                 }
             }
             else if (b2.get_id() == id_value(static_id::DRONE))
             {
-                // Remove this explosive
-                this->_explosives.explode(exp_index);
+                // Remove this explosive, if it didn't already explode this step
+                if (!this->_explosives.explode(exp_index))
+                {
+                    return;
+                }
 
-                // Get the drone index from the body
+                // Get the drone handle from the body
                 const size_t drone_index = b2.get_data().index;
 
                 // Get the explosion direction
@@ -773,27 +855,28 @@ class world
 
         // Missile collision callback
         const auto j = [this](min::body<float, min::vec3> &b1, min::body<float, min::vec3> &b2) {
-            // Get the missile index from the body
+            // Get the missile handle from the body
             const size_t miss_index = b1.get_data().index;
 
             // Get other body id, b1 is missile
             if (b2.get_id() == id_value(static_id::PLAYER))
             {
-                if (this->_player.is_explodeable())
+                // Remove this missile, if it didn't already explode this step
+                if (this->_player.is_explodeable() && this->_missiles.explode(miss_index))
                 {
-                    // Remove this missile
-                    this->_missiles.explode(miss_index);
-
                     // Explode player
-                    this->explode_call(this->dmg_drone_call(), this->sound_ex_call())(this->_missiles.position(miss_index), this->_missiles.get_scale(), block_id::EMPTY);
+                    this->explode_call(this->dmg_drone_call(), this->sound_ex_call())(b1.get_position(), this->_missiles.get_scale(), block_id::EMPTY);
                 }
             }
             else if (b2.get_id() == id_value(static_id::DRONE))
             {
-                // Remove this missile
-                this->_missiles.explode(miss_index);
+                // Remove this missile, if it didn't already explode this step
+                if (!this->_missiles.explode(miss_index))
+                {
+                    return;
+                }
 
-                // Get the drone index from the body
+                // Get the drone handle from the body
                 const size_t drone_index = b2.get_data().index;
 
                 // Get the explosion direction
@@ -825,85 +908,184 @@ class world
 
         return min::vec3<float>(x, y, z);
     }
+    inline void flag_uploads(std::vector<size_t> &keys)
+    {
+        // Remeshed chunks are uploaded once they come into view
+        for (const size_t k : keys)
+        {
+            _upload[k] = 1;
+        }
+        keys.clear();
+    }
     inline void update_all_chunks()
     {
+        // The simulation isn't running, take chunk changes directly
+        _grid.take_chunk_changes(_chunk_keys);
+        flag_uploads(_chunk_keys);
+
         // For all chunk meshes
         const size_t size = _grid.get_chunks();
         for (size_t i = 0; i < size; i++)
         {
             // If the chunk needs updating
-            if (_grid.is_update_chunk(i))
+            if (_upload[i])
             {
                 // Upload contents to the vertex buffer
                 _terrain.upload_geometry(i, _grid.get_chunk(i));
 
                 // Flag that we updated the chunk
-                _grid.update_chunk(i);
+                _upload[i] = 0;
             }
         }
     }
-    inline void update_world_physics(const float dt)
+    inline void read_world_body(const size_t index)
+    {
+        // Indices run through drones, drops, explosives then missiles
+        size_t i = index;
+        if (i < _drones.size())
+        {
+            _drones.read_frame(_grid, i);
+            return;
+        }
+        i -= _drones.size();
+        if (i < _drops.size())
+        {
+            _drops.read_frame(_grid, i);
+            return;
+        }
+        i -= _drops.size();
+        if (i < _explosives.size())
+        {
+            _explosives.read_frame(_grid, i);
+            return;
+        }
+        i -= _explosives.size();
+        _missiles.read_frame(_grid, i);
+    }
+    inline void read_world_physics()
     {
-        // Friction Coefficient
-        const size_t steps = std::round(dt / _time_step);
-        const float friction = -10.0 / steps;
+        // Shared drone state is updated before any reads
+        _drones.prepare_frame(_grid);
+
+        // Grid contacts and flow steps only write per entity rows
+        const size_t size = _drones.size() + _drops.size() + _explosives.size() + _missiles.size();
+        if (size < _parallel_bodies)
+        {
+            // Not worth waking the workers
+            for (size_t i = 0; i < size; i++)
+            {
+                read_world_body(i);
+            }
+        }
+        else
+        {
+            // Split the bodies across the worker threads
+            const auto work = [this](std::mt19937 &gen, const size_t i) {
+                this->read_world_body(i);
+            };
+            work_queue::worker.run(work, 0, size);
+        }
+    }
+    inline void snap_player_view()
+    {
+        // Player moved without simulating, don't blend across the jump
+        const min::vec3<float> p = _player.position();
+        _player_view = p;
+        _sim.read([p](world_snapshot &s, const float alpha) {
+            s.set_player(p, p);
+        });
+    }
+    inline void tick(world_snapshot &out)
+    {
+        // Runs on the simulation thread with the world locked
+        const float friction = _friction;
         const float drop_friction = friction * 2.0;
 
         // Get player position and player level
-        const min::vec3<float> &p = _player.position();
+        const min::vec3<float> prev = _player.position();
         const uint_fast16_t player_level = _player.get_stats().level();
 
         // Send drones after the player
-        _drones.set_destination(p);
+        _drones.set_destination(prev);
 
-        // Solve all physics timesteps
-        for (size_t i = 0; i < steps; i++)
-        {
-            // Update the player on this frame
-            _player.update_frame(_grid, friction, explode_default_call());
+        // Collect drone paths searched since the last tick
+        _drones.update_paths(_grid);
 
-            // Update chests on this frame
-            _chests.update_frame();
+        // Keep positions from before this tick for interpolation
+        _drones.snapshot();
+        _drops.snapshot();
+        _explosives.snapshot();
+        _missiles.snapshot();
 
-            // Update drones on this frame
-            _drones.update_frame(_grid, player_level, drone_respawn_call(), explode_call(dmg_default_call(), sound_choose_call()));
+        // Update the player on this frame
+        _player.update_frame(_grid, friction, explode_default_call());
 
-            // Update drops on this frame
-            _drops.update_frame(_grid, drop_friction, explode_drop_call());
+        // Update chests on this frame
+        _chests.update_frame();
 
-            // Update explosives on this frame
-            _explosives.update_frame(_grid, explode_call(dmg_default_call(), sound_choose_call()));
+        // Find contacts for all bodies in parallel, nothing below runs until done
+        read_world_physics();
 
-            // Update missiles on this frame
-            _missiles.update_frame(_grid, explode_call(dmg_default_call(), sound_choose_call()));
+        // Update drones on this frame, collisions and explosions apply in order from here
+        _drones.update_frame(_grid, player_level, drone_respawn_call(), explode_call(dmg_default_call(), sound_choose_call()));
 
-            // Solve all collisions
-            _simulation.solve(_time_step, _damping);
-        }
+        // Update drops on this frame
+        _drops.update_frame(_grid, drop_friction, explode_drop_call());
 
-        // Update the chest positions
-        _chests.update();
+        // Update explosives on this frame
+        _explosives.update_frame(_grid, explode_call(dmg_default_call(), sound_choose_call()));
 
-        // Update the drones positions
-        _drones.update(_grid, p, player_level, launch_missile_call());
+        // Update missiles on this frame
+        _missiles.update_frame(_grid, explode_call(dmg_default_call(), sound_choose_call()));
 
-        // Update the drop positions
-        _drops.update(_grid, dt);
+        // Solve all collisions
+        _simulation.solve(_time_step, _damping);
 
-        // Update the explosive positions
-        _explosives.update(_grid, dt);
+        // Detect if we crossed a chunk boundary
+        const min::vec3<float> &p = _player.position();
+        _grid.update_current_chunk(p);
 
-        // Update any missiles
-        _missiles.update(_grid);
+        // Remesh edited chunks
+        _grid.flush_chunk_updates();
+
+        // Search drone paths in the background between ticks
+        _grid.path_launch();
+
+        // Publish the transforms before and after this tick
+        out.set_player(prev, p);
+        _drones.publish(out.get_drones());
+        _drops.publish(out.get_drops());
+        _explosives.publish(out.get_explosives());
+        _missiles.publish(out.get_missiles());
+
+        // Hand side effects and remeshed chunks to the render thread
+        std::vector<std::function<void()>> &effects = out.get_effects();
+        effects.insert(effects.end(), std::make_move_iterator(_effects.begin()), std::make_move_iterator(_effects.end()));
+        _effects.clear();
+        _grid.take_chunk_changes(out.get_chunks());
+    }
+    inline void update_positions(static_asset &asset, const snapshot_transforms &t, const float alpha)
+    {
+        // Skip instances removed since the tick was published
+        const size_t size = t.size();
+        for (size_t i = 0; i < size; i++)
+        {
+            const size_t inst_id = t.inst_id(i);
+            if (asset.is_valid(inst_id))
+            {
+                asset.update_position(inst_id, t.interpolate(i, alpha));
+            }
+        }
     }
 
   public:
     world(const load_state &state, particle &particles, sound &s, const uniforms &uniforms,
-          const size_t chunk_size, const size_t grid_size, const size_t view_chunk_size)
-        : _grid(chunk_size, grid_size, view_chunk_size),
+          const size_t chunk_size, const size_t grid_size, const size_t view_chunk_size, const uint64_t seed, const bool seeded)
+        : _grid(chunk_size, grid_size, view_chunk_size, seed, seeded),
           _terrain(uniforms, _grid.get_chunks(), chunk_size),
           _particles(&particles),
           _sound(&s),
+          _upload(_grid.get_chunks(), 0),
           _ex_radius(3, 3, 3),
           _top(state.get_top().y()),
           _gravity(0.0, -_grav_mag, 0.0),
@@ -932,7 +1114,8 @@ class world
           _health_dist(0.75, 1.5),
           _miss_dist(-0.5, 0.5),
           _scat_dist(-0.1, 0.1),
-          _gen(std::chrono::high_resolution_clock::now().time_since_epoch().count())
+          _gen(std::chrono::high_resolution_clock::now().time_since_epoch().count()),
+          _sim(_lock, _time_step, _physics_frames / 4, [this](world_snapshot &s) { this->tick(s); })
     {
         // Set the collision elasticity of the physics simulation
         _simulation.set_elasticity(0.1);
@@ -948,6 +1131,9 @@ class world
 
         // Load chests
         load_chests(state);
+
+        // Nothing to interpolate from yet
+        snap_player_view();
     }
     inline void reset(const load_state &state, const size_t chunk_size, const size_t grid_size, const size_t view_chunk_size)
     {
@@ -985,6 +1171,15 @@ class world
 
         // Load chests
         load_chests(state);
+
+        // Drop side effects and transforms of the old world
+        _effects.clear();
+        _sim.read([](world_snapshot &s, const float alpha) {
+            s.clear();
+        });
+
+        // Nothing to interpolate from yet
+        snap_player_view();
     }
     inline void add_block(const min::ray<float, min::vec3> &r)
     {
@@ -992,10 +1187,12 @@ class world
         if (_swatch_mode)
         {
             _grid.set_geometry(_swatch, _preview);
+            wake_drops(_preview, _swatch.get_length());
         }
         else
         {
             _grid.set_geometry(_preview, _scale, _preview_offset, _atlas_id, nullptr);
+            wake_drops(_preview, _scale);
         }
     }
     inline bool can_add_block() const
@@ -1057,6 +1254,11 @@ class world
     {
         return _grid;
     }
+    inline std::mutex &get_lock()
+    {
+        // Held by the simulation thread for each tick, hold it to touch the world
+        return _lock;
+    }
     inline const static_instance &get_instance() const
     {
         return _instance;
@@ -1065,6 +1267,10 @@ class world
     {
         return _instance.get_inst_in_view();
     }
+    inline const min::vec3<float> &get_player_view() const
+    {
+        return _player_view;
+    }
     inline player &get_player()
     {
         return _player;
@@ -1155,6 +1361,14 @@ class world
     {
         return _edit_mode;
     }
+    inline bool is_portal_pending() const
+    {
+        return _grid.is_portal_pending();
+    }
+    inline float get_portal_progress() const
+    {
+        return _grid.portal_progress();
+    }
     inline void kill_drones()
     {
         // Kill all the drones
@@ -1194,19 +1408,28 @@ class world
         // Generate new preview
         generate_preview();
     }
-    inline void portal(const load_state &state)
+    inline bool portal(const load_state &state)
+    {
+        // Remember default spawn point for the swap
+        _portal_top = state.get_top();
+
+        // Generate a new world in the background
+        return _grid.portal();
+    }
+    inline void portal_swap()
     {
         // Get default spawn point
-        const min::vec3<float> &p = state.get_top();
+        const min::vec3<float> &p = _portal_top;
 
-        // Generate a new world in grid
-        _grid.portal();
+        // Swap the generated world into grid
+        _grid.portal_swap();
 
         // Spawn character position
         const min::vec3<float> spawn = ray_spawn(p);
 
         // Warp player
         _player.warp(spawn);
+        snap_player_view();
 
         // Remove geometry around player
         block_remove(spawn, _ex_radius);
@@ -1216,9 +1439,6 @@ class world
         while (spawn_chest(spawn_random()))
         {
         }
-
-        // Update chunks
-        update_all_chunks();
     }
     inline void random_item()
     {
@@ -1231,6 +1451,7 @@ class world
 
         // Spawn character position
         _player.warp(ray_spawn(state.get_default_spawn()));
+        snap_player_view();
 
         // Zero out character velocity
         _player.velocity(min::vec3<float>());
@@ -1260,8 +1481,9 @@ class world
     {
         size_t count = 0;
 
-        // Launch N explode rays
-        for (size_t i = 0; i < 4; i++)
+        // Generate N random rays from the projection
+        _scatter_rays.clear();
+        for (size_t i = 0; i < _scatter_size; i++)
         {
             // Generate a random scatter offset
             const float x = _scat_dist(_gen);
@@ -1271,13 +1493,16 @@ class world
 
             // Generate a random ray from the projection
             const min::vec3<float> dest = _player.projection() + offset;
-            const min::ray<float, min::vec3> r(_player.ray().get_origin(), dest);
+            _scatter_rays.emplace_back(_player.ray().get_origin(), dest);
+        }
 
-            // Launch a target ray
-            const target t = _player.target_ray(_grid, r, _ray_max_dist);
+        // Launch all target rays as a packet
+        _player.target_packet(_grid, _scatter_rays, _ray_max_dist, body_box_call(), _scatter_targets);
 
-            // Cast an explode ray on this random ray
-            if (explode_ray(r, t, scale, size, false, f) != block_id::EMPTY)
+        // Cast an explode ray on each random ray
+        for (size_t i = 0; i < _scatter_size; i++)
+        {
+            if (explode_ray(_scatter_rays[i], _scatter_targets[i], scale, size, false, f) != block_id::EMPTY)
             {
                 count++;
             }
@@ -1307,7 +1532,7 @@ class world
                 uint_fast8_t count = 1;
                 if (_player.get_inventory().consume(item_id::CONS_KEY, count))
                 {
-                    // Get the index from the body
+                    // Get the chest handle from the body
                     const size_t index = b.get_data().index;
                     _chests.remove(index);
 
@@ -1422,6 +1647,7 @@ class world
     {
         // This point is snapped to the grid
         const min::vec3<float> p = _grid.set_geometry_box_3x3(position, block_id::STONE3);
+        wake_drops(p, min::vec3<unsigned>(3, 3, 3));
 
         // Add the chest
         return _chests.add(min::vec3<float>(p.x(), p.y() - 1.0, p.z()));
@@ -1434,17 +1660,40 @@ class world
         // Spawn one drone
         _drones.spawn(spawn_event(), drone_health);
     }
+    inline void start()
+    {
+        // Run the simulation at a fixed tick on its own thread
+        _sim.start();
+    }
+    inline void stop()
+    {
+        // Don't call with the world locked, waits for the current tick
+        _sim.stop();
+    }
     inline void toggle_swatch_copy_place()
     {
         _swatch_copy_place = !_swatch_copy_place;
     }
     void update(min::camera<float> &cam, const bool track_target, const float dt)
     {
-        // Update the physics and AI in world
-        update_world_physics(dt);
+        // Draw everything between the last two published ticks so uneven tick counts don't stutter
+        _sim.read([this](world_snapshot &s, const float alpha) {
+            this->_player_view = s.player(alpha);
+            this->update_positions(this->_instance.get_drone(), s.get_drones(), alpha);
+            this->update_positions(this->_instance.get_drop(), s.get_drops(), alpha);
+            this->update_positions(this->_instance.get_explosive(), s.get_explosives(), alpha);
+            this->update_positions(this->_instance.get_missile(), s.get_missiles(), alpha);
+
+            // Play sounds and particles queued by the simulation
+            s.apply_effects();
 
-        // Get player position
+            // Remember chunks remeshed by the simulation
+            this->flag_uploads(s.get_chunks());
+        });
+
+        // Get player position and player level
         const min::vec3<float> &p = _player.position();
+        const uint_fast16_t player_level = _player.get_stats().level();
 
         // Reset explosion state
         _player.reset_explode();
@@ -1453,14 +1702,18 @@ class world
         _player.update(cam);
         _player.update_target(_grid, track_target, _ray_max_dist);
 
-        // Detect if we crossed a chunk boundary
-        _grid.update_current_chunk(p);
-
         // Get surrounding chunks for drawing
         _grid.update_view_chunk_index(cam, _view_chunk_index);
 
-        // Flush out the update chunks
-        _grid.flush_chunk_updates();
+        // Swap in a finished portal at the frame boundary
+        if (_grid.is_portal_ready())
+        {
+            portal_swap();
+
+            // The swap remeshed the view chunks on this thread, upload them now
+            _grid.take_chunk_changes(_chunk_keys);
+            flag_uploads(_chunk_keys);
+        }
 
 // Only used for instance rendering
 #ifdef USE_INST_RENDER
@@ -1471,18 +1724,33 @@ class world
         for (const auto &i : _view_chunk_index)
         {
             // If the chunk needs updating
-            if (_grid.is_update_chunk(i))
+            if (_upload[i])
             {
                 // Upload contents to the vertex buffer
                 _terrain.upload_geometry(i, _grid.get_chunk(i));
 
                 // Flag that we updated the chunk
-                _grid.update_chunk(i);
+                _upload[i] = 0;
             }
         }
 
+        // Update the chest positions
+        _chests.update();
+
+        // Update drone rotations, missile launches and sounds
+        _drones.update(_grid, p, player_level, launch_missile_call());
+
+        // Update the drop rotations
+        _drops.update(_grid, dt);
+
+        // Update the explosive rotations
+        _explosives.update(_grid, dt);
+
+        // Update missile particles and sounds
+        _missiles.update(_grid);
+
         // Update the static instance frustum culling
-        _instance.update(_simulation, _grid, cam);
+        _instance.update(_grid);
 
         // Get ray from camera to destination
         const min::ray<float, min::vec3> &r = _player.ray();
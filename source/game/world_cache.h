@@ -0,0 +1,118 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __WORLD_CACHE__
+#define __WORLD_CACHE__
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <game/file.h>
+#include <game/id.h>
+#include <min/serial.h>
+#include <string>
+#include <vector>
+
+namespace game
+{
+
+// Generated grids on disk, keyed by the seed and parameters that made them
+class world_cache
+{
+  private:
+    // Bump the generator when any kernel or stage changes its output
+    static constexpr uint32_t _version = 2;
+    static constexpr uint32_t _generator = 1;
+    const std::string _prefix;
+
+    inline std::string file(const std::string &key) const
+    {
+        return _prefix + key + ".bgrid";
+    }
+
+  public:
+    world_cache(const std::string &prefix) : _prefix(prefix) {}
+
+    inline static std::string key(const std::string &kind, const std::vector<uint64_t> &params)
+    {
+        // Readable key, the generator and all parameters are part of the file name
+        std::string out = kind + "_g" + std::to_string(_generator);
+        for (const uint64_t p : params)
+        {
+            out += "_" + std::to_string(p);
+        }
+
+        return out;
+    }
+    inline bool exists(const std::string &key) const
+    {
+        return std::ifstream(file(key)).good();
+    }
+    inline bool load(const std::string &key, std::vector<block_id> &grid) const
+    {
+        // A missing entry is not an error
+        if (!exists(key))
+        {
+            return false;
+        }
+
+        // Load data into stream from file
+        std::vector<uint8_t> stream;
+        load_file(file(key), stream);
+
+        // Check the versions and size before touching the grid
+        const size_t header = sizeof(uint32_t) * 3;
+        if (stream.size() != header + grid.size() * sizeof(block_id))
+        {
+            return false;
+        }
+        size_t next = 0;
+        const uint32_t version = min::read_le<uint32_t>(stream, next);
+        const uint32_t generator = min::read_le<uint32_t>(stream, next);
+        if (version != _version || generator != _generator)
+        {
+            return false;
+        }
+
+        // Copy the cells into the grid
+        const std::vector<block_id> cells = min::read_le_vector<block_id>(stream, next);
+        if (cells.size() != grid.size())
+        {
+            return false;
+        }
+        std::copy(cells.begin(), cells.end(), grid.begin());
+
+        return true;
+    }
+    inline void save(const std::string &key, const std::vector<block_id> &grid) const
+    {
+        // Create output stream for saving grid
+        std::vector<uint8_t> stream;
+        stream.reserve(sizeof(uint32_t) * 3 + grid.size() * sizeof(block_id));
+
+        // Write versions and data into stream
+        min::write_le<uint32_t>(stream, _version);
+        min::write_le<uint32_t>(stream, _generator);
+        min::write_le_vector<block_id>(stream, grid);
+
+        // Write data to file
+        save_file(file(key), stream);
+    }
+};
+}
+
+#endif
@@ -0,0 +1,157 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __WORLD_SNAPSHOT__
+#define __WORLD_SNAPSHOT__
+
+#include <functional>
+#include <min/vec3.h>
+#include <utility>
+#include <vector>
+
+namespace game
+{
+
+// Instance positions before and after the last tick
+class snapshot_transforms
+{
+  private:
+    std::vector<size_t> _inst;
+    std::vector<min::vec3<float>> _from;
+    std::vector<min::vec3<float>> _to;
+
+  public:
+    snapshot_transforms() {}
+    inline void add(const size_t inst_id, const min::vec3<float> &from, const min::vec3<float> &to)
+    {
+        _inst.push_back(inst_id);
+        _from.push_back(from);
+        _to.push_back(to);
+    }
+    inline void clear()
+    {
+        _inst.clear();
+        _from.clear();
+        _to.clear();
+    }
+    inline size_t inst_id(const size_t index) const
+    {
+        return _inst[index];
+    }
+    inline min::vec3<float> interpolate(const size_t index, const float alpha) const
+    {
+        return _from[index] + (_to[index] - _from[index]) * alpha;
+    }
+    inline size_t size() const
+    {
+        return _inst.size();
+    }
+    inline void swap(snapshot_transforms &other)
+    {
+        _inst.swap(other._inst);
+        _from.swap(other._from);
+        _to.swap(other._to);
+    }
+};
+
+// Everything the render thread needs from one simulation tick
+class world_snapshot
+{
+  private:
+    snapshot_transforms _drones;
+    snapshot_transforms _drops;
+    snapshot_transforms _explosives;
+    snapshot_transforms _missiles;
+    min::vec3<float> _player_from;
+    min::vec3<float> _player_to;
+    std::vector<std::function<void()>> _effects;
+    std::vector<size_t> _chunks;
+
+  public:
+    world_snapshot() {}
+    inline void apply_effects()
+    {
+        // Play queued sounds and particles in tick order, only once
+        for (const std::function<void()> &f : _effects)
+        {
+            f();
+        }
+        _effects.clear();
+    }
+    inline void clear()
+    {
+        // Forget everything published, used when the world is reloaded
+        _drones.clear();
+        _drops.clear();
+        _explosives.clear();
+        _missiles.clear();
+        _effects.clear();
+        _chunks.clear();
+    }
+    inline std::vector<size_t> &get_chunks()
+    {
+        return _chunks;
+    }
+    inline snapshot_transforms &get_drones()
+    {
+        return _drones;
+    }
+    inline snapshot_transforms &get_drops()
+    {
+        return _drops;
+    }
+    inline std::vector<std::function<void()>> &get_effects()
+    {
+        return _effects;
+    }
+    inline snapshot_transforms &get_explosives()
+    {
+        return _explosives;
+    }
+    inline snapshot_transforms &get_missiles()
+    {
+        return _missiles;
+    }
+    inline void merge(world_snapshot &next)
+    {
+        // Take the newer transforms, the old ones are overwritten by the next tick
+        _drones.swap(next._drones);
+        _drops.swap(next._drops);
+        _explosives.swap(next._explosives);
+        _missiles.swap(next._missiles);
+        _player_from = next._player_from;
+        _player_to = next._player_to;
+
+        // Queue side effects and chunk changes behind any not read yet
+        _effects.insert(_effects.end(), std::make_move_iterator(next._effects.begin()), std::make_move_iterator(next._effects.end()));
+        next._effects.clear();
+        _chunks.insert(_chunks.end(), next._chunks.begin(), next._chunks.end());
+        next._chunks.clear();
+    }
+    inline min::vec3<float> player(const float alpha) const
+    {
+        return _player_from + (_player_to - _player_from) * alpha;
+    }
+    inline void set_player(const min::vec3<float> &from, const min::vec3<float> &to)
+    {
+        _player_from = from;
+        _player_to = to;
+    }
+};
+}
+
+#endif
@@ -18,207 +18,253 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef __BROWNIAN_GROW__
 #define __BROWNIAN_GROW__
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <game/id.h>
+#include <game/rng.h>
 #include <game/thread_pool.h>
 #include <min/vec3.h>
+#include <random>
+#include <stdexcept>
 #include <tuple>
 #include <vector>
 
 namespace kernel
 {
 
-class brownian_grow
+// Occupied cell counts for cubic bricks of the grid, and occupied bricks in each brick's 3x3x3 neighborhood
+class brownian_bricks
 {
   private:
+    const size_t _size;
     const size_t _scale;
-    const size_t _seed;
-    const size_t _radius;
-    std::vector<std::tuple<size_t, size_t, size_t>> _points;
+    std::vector<uint16_t> _fill;
+    std::vector<uint8_t> _near;
 
-    inline static size_t add(const size_t x, const int dx)
+    inline size_t key(const size_t x, const size_t y, const size_t z) const
     {
-        return static_cast<size_t>(static_cast<int>(x) + dx);
+        return (x * _scale * _scale) + (y * _scale) + z;
     }
-    inline size_t key(const std::tuple<size_t, size_t, size_t> &index) const
+
+  public:
+    brownian_bricks(const size_t size, const size_t grid_scale)
+        : _size(size), _scale((grid_scale + size - 1) / size),
+          _fill(_scale * _scale * _scale, 0), _near(_fill.size(), 0) {}
+
+    inline bool empty(const std::array<size_t, 3> &p) const
     {
-        return min::vec3<float>::grid_key(index, _scale);
+        // Are all bricks around this cell empty?
+        return _near[key(p[0] / _size, p[1] / _size, p[2] / _size)] == 0;
     }
-    inline bool on_edge(size_t &x) const
+    inline void occupy(const std::array<size_t, 3> &p)
     {
-        // Reflect walkers if hit a wall
-        if (x == 0)
+        // Count cells, the neighborhood only changes when a brick is first occupied
+        const size_t bx = p[0] / _size;
+        const size_t by = p[1] / _size;
+        const size_t bz = p[2] / _size;
+        if (_fill[key(bx, by, bz)]++ > 0)
         {
-            x++;
-            return true;
+            return;
         }
-        else if (x == _scale - 1)
+
+        // Flag all bricks in the neighborhood
+        const size_t end = _scale - 1;
+        for (size_t x = (bx > 0) ? bx - 1 : 0; x <= std::min(bx + 1, end); x++)
         {
-            x--;
-            return true;
+            for (size_t y = (by > 0) ? by - 1 : 0; y <= std::min(by + 1, end); y++)
+            {
+                for (size_t z = (bz > 0) ? bz - 1 : 0; z <= std::min(bz + 1, end); z++)
+                {
+                    _near[key(x, y, z)]++;
+                }
+            }
         }
+    }
+};
 
-        return false;
+class brownian_grow
+{
+  private:
+    static constexpr size_t _round = 256;
+    static constexpr size_t _brick = 4;
+    static constexpr size_t _super = 16;
+    static constexpr size_t _none = static_cast<size_t>(-1);
+    const size_t _scale;
+    const size_t _seed;
+    const size_t _radius;
+    const uint64_t _key;
+    std::vector<std::tuple<size_t, size_t, size_t>> _points;
+    std::vector<game::block_id> _grid;
+    brownian_bricks _bricks;
+    brownian_bricks _supers;
+    std::vector<std::array<size_t, 3>> _walkers;
+    std::vector<uint32_t> _counter;
+    std::vector<size_t> _stick;
+    std::vector<game::block_id> _stick_value;
+
+    inline size_t key(const std::tuple<size_t, size_t, size_t> &index) const
+    {
+        return min::vec3<float>::grid_key(index, _scale);
+    }
+    inline size_t key(const std::array<size_t, 3> &p) const
+    {
+        return (p[0] * _scale * _scale) + (p[1] * _scale) + p[2];
     }
     inline static game::block_id color_table(const game::block_id value)
     {
         // This needs to be updated!
-        switch (value)
+        switch (game::id_value(value))
         {
         // Group 1
         case 0:
         case 2:
         case 3:
         case 8:
-            return 9;
+            return static_cast<game::block_id>(9);
         case 9:
-            return 10;
+            return static_cast<game::block_id>(10);
         case 10:
-            return 11;
+            return static_cast<game::block_id>(11);
         case 11:
-            return 12;
+            return static_cast<game::block_id>(12);
         case 12:
-            return 13;
+            return static_cast<game::block_id>(13);
         case 13:
-            return 8;
+            return static_cast<game::block_id>(8);
 
         // Group 2
         case 1:
         case 4:
         case 5:
         case 16:
-            return 17;
+            return static_cast<game::block_id>(17);
         case 17:
-            return 18;
+            return static_cast<game::block_id>(18);
         case 18:
-            return 19;
+            return static_cast<game::block_id>(19);
         case 19:
-            return 20;
+            return static_cast<game::block_id>(20);
         case 20:
-            return 21;
+            return static_cast<game::block_id>(21);
         case 21:
-            return 16;
+            return static_cast<game::block_id>(16);
 
         default:
-            return 8;
+            return static_cast<game::block_id>(8);
         }
     }
-    inline bool random_walk(const std::vector<game::block_id> &read, std::tuple<size_t, size_t, size_t> &walker, const uint_fast8_t dir, game::block_id &value) const
+    inline void load(const std::vector<game::block_id> &read)
     {
-        // Copy walker position
-        std::tuple<size_t, size_t, size_t> next = walker;
+        // Snapshot the grid, walkers only see growth from earlier rounds
+        _grid = read;
 
-        // Reflect walker if on edge
-        bool edge = false;
-        if (on_edge(std::get<0>(next)))
-        {
-            edge = true;
-        }
-        else if (on_edge(std::get<1>(next)))
-        {
-            edge = true;
-        }
-        else if (on_edge(std::get<2>(next)))
+        // Count occupied cells in each brick
+        const size_t size = _grid.size();
+        for (size_t i = 0; i < size; i++)
         {
-            edge = true;
+            if (_grid[i] != game::block_id::EMPTY)
+            {
+                const std::array<size_t, 3> p = {i / (_scale * _scale), (i / _scale) % _scale, i % _scale};
+                _bricks.occupy(p);
+                _supers.occupy(p);
+            }
         }
-
-        // Calculate random walk direction if not on edge
-        if (!edge)
+    }
+    inline void merge(std::vector<game::block_id> &write)
+    {
+        // Apply sticks in walker order, the first walker to reach a cell keeps it
+        const size_t size = _walkers.size();
+        for (size_t i = 0; i < size; i++)
         {
-            switch (dir)
+            const size_t cell = _stick[i];
+            if (cell != _none && _grid[cell] == game::block_id::EMPTY)
             {
-            case 0:
-                std::get<0>(next)--;
-                break;
-            case 1:
-                std::get<0>(next)++;
-                break;
-            case 2:
-                std::get<1>(next)--;
-                break;
-            case 3:
-                std::get<1>(next)++;
-                break;
-            case 4:
-                std::get<2>(next)--;
-                break;
-            case 5:
-                std::get<2>(next)++;
-                break;
+                _grid[cell] = _stick_value[i];
+                write[cell] = _stick_value[i];
+
+                // Update empty space for jumps
+                const std::array<size_t, 3> p = {cell / (_scale * _scale), (cell / _scale) % _scale, cell % _scale};
+                _bricks.occupy(p);
+                _supers.occupy(p);
             }
         }
+    }
+    inline size_t offset(const size_t x, const uint32_t h) const
+    {
+        // Random offset within radius of x, inside the walls
+        const size_t lo = x - _radius;
+        const size_t p = lo + (h % (2 * _radius + 1));
 
-        // Is the move point a wall?
-        value = read[key(next)];
-        if (value == game::block_id::EMPTY)
+        return std::min(std::max(p, static_cast<size_t>(1)), _scale - 2);
+    }
+    inline void spawn(const size_t i, const uint32_t stream)
+    {
+        // Spawn walker at random offset from its seed location
+        const auto &s = _points[i % _seed];
+        uint32_t &n = _counter[i];
+        _walkers[i][0] = offset(std::get<0>(s), game::rng::hash(stream, n++));
+        _walkers[i][1] = offset(std::get<1>(s), game::rng::hash(stream, n++));
+        _walkers[i][2] = offset(std::get<2>(s), game::rng::hash(stream, n++));
+    }
+    inline size_t stride(const std::array<size_t, 3> &p) const
+    {
+        // Jump across bricks proven empty, one step near the aggregate
+        if (_supers.empty(p))
         {
-            // Move the walker
-            walker = next;
-
-            // Didn't hit a wall
-            return false;
+            return _super;
+        }
+        else if (_bricks.empty(p))
+        {
+            return _brick;
         }
 
-        // We hit a wall
-        return true;
+        return 1;
     }
-    inline void do_brownian(game::thread_pool &pool, const std::vector<game::block_id> &read, std::vector<game::block_id> &write, const size_t years) const
+    inline void walk(const size_t i)
     {
-        // Create working function
-        const auto work = [this, &read, &write, years](std::mt19937 &gen, const size_t i) {
-            // Create random number generator for this thread
-            std::uniform_int_distribution<int> gdist(-_radius, _radius);
-            std::uniform_int_distribution<uint_fast8_t> idist(0, 5);
+        // Each walker draws from its own counter stream
+        const uint32_t stream = game::rng::key(_key, i);
+        std::array<size_t, 3> &p = _walkers[i];
+        uint32_t &n = _counter[i];
+        _stick[i] = _none;
 
-            // Spawn a walker at each seed location
-            for (size_t j = 0; j < _seed; j++)
+        // A walk of r steps covers r * r time
+        for (size_t time = 0; time < _round;)
+        {
+            // Calculate random direction
+            const size_t r = stride(p);
+            const uint32_t dir = game::rng::hash(stream, n++) % 6;
+            const size_t axis = dir / 2;
+
+            // Clamp the move inside the walls
+            std::array<size_t, 3> next = p;
+            next[axis] = (dir & 1) ? std::min(p[axis] + r, _scale - 2) : std::max(p[axis], r + 1) - r;
+
+            // Single steps may hit the aggregate
+            if (r == 1)
             {
-                // Spawn walker at random offset from seed location
-                const size_t x = add(std::get<0>(_points[j]), gdist(gen));
-                const size_t y = add(std::get<1>(_points[j]), gdist(gen));
-                const size_t z = add(std::get<2>(_points[j]), gdist(gen));
-                auto walker = std::make_tuple(x, y, z);
-
-                // Evolve simulation for years
-                for (size_t k = 0; k < years; k++)
+                const game::block_id value = _grid[key(next)];
+                if (value != game::block_id::EMPTY)
                 {
-                    // Calculate random direction
-                    const uint_fast8_t dir = idist(gen);
-
-                    // If walker hits something in write buffer
-                    game::block_id value;
-                    if (random_walk(read, walker, dir, value))
-                    {
-                        // Calculate grid cell
-                        const size_t cell = key(walker);
-
-                        // Seed the write buffer
-                        write[cell] = color_table(value);
-
-                        // Respawn walker
-                        const size_t x1 = add(std::get<0>(_points[j]), gdist(gen));
-                        const size_t y1 = add(std::get<1>(_points[j]), gdist(gen));
-                        const size_t z1 = add(std::get<2>(_points[j]), gdist(gen));
-                        walker = std::make_tuple(x1, y1, z1);
-                    }
+                    // Stick here and respawn next round
+                    _stick[i] = key(p);
+                    _stick_value[i] = color_table(value);
+                    spawn(i, stream);
+                    return;
                 }
             }
-        };
 
-        // Get number of cpu cores
-        const size_t size = std::thread::hardware_concurrency();
-        if (size < 1)
-        {
-            throw std::runtime_error("brownian_grow: can't determine number of CPU cores");
+            // Move the walker
+            p = next;
+            time += r * r;
         }
-
-        // Run the job in parallel
-        pool.run(work, 0, size);
     }
 
   public:
     brownian_grow(std::mt19937 &gen, std::vector<game::block_id> &write, const size_t scale, const size_t radius, const size_t seed)
-        : _scale(scale), _seed(seed), _radius(radius)
+        : _scale(scale), _seed(seed), _radius(radius), _key(gen()),
+          _bricks(_brick, scale), _supers(_super, scale)
     {
         // Check if radius is valid
         if (_radius >= _scale / 2)
@@ -240,14 +286,38 @@ class brownian_grow
             const size_t cell = key(_points[i]);
 
             // Write pixel into grid
-            write[cell] = color_table(i % 24);
+            write[cell] = color_table(static_cast<game::block_id>(i % 24));
         }
     }
 
-    inline void generate(game::thread_pool &pool, const std::vector<game::block_id> &read, std::vector<game::block_id> &write, const size_t years)
+    inline void generate(game::thread_pool &pool, const std::vector<game::block_id> &read, std::vector<game::block_id> &write, const size_t years, const size_t walkers = 8)
     {
-        // Generate brownian tree
-        do_brownian(pool, read, write, years);
+        // Snapshot the grid and count occupied bricks
+        load(read);
+
+        // Spawn walkers for each seed, walker i belongs to seed i % seeds
+        const size_t size = _seed * walkers;
+        _walkers.resize(size);
+        _counter.assign(size, 0);
+        _stick.assign(size, static_cast<size_t>(_none));
+        _stick_value.assign(size, game::block_id::EMPTY);
+        for (size_t i = 0; i < size; i++)
+        {
+            spawn(i, game::rng::key(_key, i));
+        }
+
+        // Create working function
+        const auto work = [this](std::mt19937 &gen, const size_t i) {
+            walk(i);
+        };
+
+        // Walk all walkers on the snapshot in parallel, then grow between rounds
+        const size_t rounds = (years + _round - 1) / _round;
+        for (size_t r = 0; r < rounds; r++)
+        {
+            pool.run(work, 0, size);
+            merge(write);
+        }
     }
 };
 }
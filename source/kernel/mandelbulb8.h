@@ -0,0 +1,587 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __MANDELBULB8__
+#define __MANDELBULB8__
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <game/id.h>
+#include <game/thread_pool.h>
+#include <min/vec3.h>
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+namespace kernel
+{
+
+class mandelbulb8_block
+{
+  private:
+    size_t _lo[3];
+    size_t _hi[3];
+    std::vector<int8_t> _cache;
+    std::vector<uint8_t> _empty;
+    std::vector<std::array<size_t, 3>> _pending;
+    std::vector<std::array<size_t, 6>> _octants;
+    std::vector<std::array<size_t, 6>> _next;
+    size_t _size;
+
+    inline size_t local(const size_t x, const size_t y, const size_t z) const
+    {
+        return ((x - _lo[0]) * _size + (y - _lo[1])) * _size + (z - _lo[2]);
+    }
+
+  public:
+    mandelbulb8_block(const size_t size) : _lo{0, 0, 0}, _hi{0, 0, 0}, _cache(size * size * size), _empty(_cache.size()), _size(size) {}
+
+    inline int8_t &cache(const size_t x, const size_t y, const size_t z)
+    {
+        return _cache[local(x, y, z)];
+    }
+    inline bool empty(const size_t x, const size_t y, const size_t z) const
+    {
+        return _empty[local(x, y, z)];
+    }
+    inline std::vector<std::array<size_t, 6>> &next()
+    {
+        return _next;
+    }
+    inline std::vector<std::array<size_t, 6>> &octants()
+    {
+        return _octants;
+    }
+    inline std::vector<std::array<size_t, 3>> &pending()
+    {
+        return _pending;
+    }
+    inline void reset(const std::vector<game::block_id> &grid, const size_t scale, const size_t (&lo)[3], const int8_t unknown)
+    {
+        // Clamp the block to the grid
+        for (size_t i = 0; i < 3; i++)
+        {
+            _lo[i] = lo[i];
+            _hi[i] = std::min(lo[i] + _size, scale) - 1;
+        }
+
+        // Forget samples and remember which cells may be written
+        std::fill(_cache.begin(), _cache.end(), unknown);
+        for (size_t x = _lo[0]; x <= _hi[0]; x++)
+        {
+            for (size_t y = _lo[1]; y <= _hi[1]; y++)
+            {
+                for (size_t z = _lo[2]; z <= _hi[2]; z++)
+                {
+                    const size_t key = (x * scale * scale) + (y * scale) + z;
+                    _empty[local(x, y, z)] = (grid[key] == game::block_id::EMPTY);
+                }
+            }
+        }
+
+        // Start from the whole block
+        _octants.clear();
+        _octants.push_back({_lo[0], _lo[1], _lo[2], _hi[0], _hi[1], _hi[2]});
+    }
+};
+
+class mandelbulb8
+{
+  private:
+    static constexpr int8_t _unknown = -2;
+    static constexpr int8_t _queued = -3;
+    float _coeff[3][4];
+    bool _wide;
+    bool _exp;
+
+    inline static float delta(const float a, const float b, const bool e)
+    {
+        // Squared distance from the axis, optionally damped
+        const float r = (a * a + b * b);
+        if (e)
+        {
+            return std::exp(r * -1.0);
+        }
+
+        return r;
+    }
+    template <typename T>
+    inline static float axis(const float v, const float d, const float *c)
+    {
+        // Powers of the coordinate and delta, in the same order as the scalar kernels
+        const float v3 = v * v * v;
+        const float v5 = v3 * v * v;
+        const float v7 = v5 * v * v;
+        const float v9 = v7 * v * v;
+        const float d2 = d * d;
+        const float d3 = d2 * d;
+        const float d4 = d3 * d;
+
+        // T is double for the kernels with double constants
+        return v9 - static_cast<T>(c[0]) * v7 * d + static_cast<T>(c[1]) * v5 * d2 - static_cast<T>(c[2]) * v3 * d3 + static_cast<T>(c[3]) * v * d4 + v;
+    }
+    template <typename T>
+    inline int8_t iterate1(float x0, float y0, float z0) const
+    {
+        for (size_t i = 0; i < 32; i++)
+        {
+            // Iterate each coordinate
+            const float x1 = axis<T>(x0, delta(y0, z0, _exp), _coeff[0]);
+            const float y1 = axis<T>(y0, delta(z0, x0, _exp), _coeff[1]);
+            const float z1 = axis<T>(z0, delta(x0, y0, _exp), _coeff[2]);
+
+            // If we converged return iterations
+            if (std::abs(x1 - x0) < 1E-3 && std::abs(y1 - y0) < 1E-3 && std::abs(z1 - z0) < 1E-3)
+            {
+                return i;
+            }
+
+            // Prime next loop
+            x0 = x1;
+            y0 = y1;
+            z0 = z1;
+        }
+
+        return -1;
+    }
+    inline void sample(mandelbulb8_block &b, const size_t scale, const size_t d, const std::function<min::vec3<float>(const size_t)> &f) const
+    {
+        // Do mandelbulb on all pending corners, 8 at a time
+        const std::vector<std::array<size_t, 3>> &pending = b.pending();
+        const size_t size = pending.size();
+        for (size_t i = 0; i < size; i += 8)
+        {
+            float x[8] = {};
+            float y[8] = {};
+            float z[8] = {};
+            int8_t out[8];
+
+            // Load start points of this batch
+            const size_t lanes = std::min(size - i, static_cast<size_t>(8));
+            for (size_t j = 0; j < lanes; j++)
+            {
+                const std::array<size_t, 3> &c = pending[i + j];
+                const min::vec3<float> p = f((c[0] * scale * scale) + (c[1] * scale) + c[2]);
+                x[j] = p.x() / d;
+                y[j] = p.y() / d;
+                z[j] = p.z() / d;
+            }
+
+            // Cache the iterations of each corner
+            count(x, y, z, (1 << lanes) - 1, out);
+            for (size_t j = 0; j < lanes; j++)
+            {
+                const std::array<size_t, 3> &c = pending[i + j];
+                b.cache(c[0], c[1], c[2]) = out[j];
+            }
+        }
+    }
+    inline void fill(mandelbulb8_block &b, std::vector<game::block_id> &grid, const size_t scale,
+                     const std::array<size_t, 6> &o, const int8_t (&n)[8]) const
+    {
+        // Interpolation weights along each axis
+        const float sx = (o[3] > o[0]) ? 1.0 / (o[3] - o[0]) : 0.0;
+        const float sy = (o[4] > o[1]) ? 1.0 / (o[4] - o[1]) : 0.0;
+        const float sz = (o[5] > o[2]) ? 1.0 / (o[5] - o[2]) : 0.0;
+        for (size_t x = o[0]; x <= o[3]; x++)
+        {
+            const float tx = (x - o[0]) * sx;
+            for (size_t y = o[1]; y <= o[4]; y++)
+            {
+                const float ty = (y - o[1]) * sy;
+                for (size_t z = o[2]; z <= o[5]; z++)
+                {
+                    if (!b.empty(x, y, z))
+                    {
+                        continue;
+                    }
+
+                    // Use the sample if we have one, else blend the corners
+                    int8_t c = b.cache(x, y, z);
+                    if (c == _unknown)
+                    {
+                        const float tz = (z - o[2]) * sz;
+                        const float x00 = n[0] + (n[4] - n[0]) * tx;
+                        const float x01 = n[1] + (n[5] - n[1]) * tx;
+                        const float x10 = n[2] + (n[6] - n[2]) * tx;
+                        const float x11 = n[3] + (n[7] - n[3]) * tx;
+                        const float y0 = x00 + (x10 - x00) * ty;
+                        const float y1 = x01 + (x11 - x01) * ty;
+                        c = static_cast<int8_t>(y0 + (y1 - y0) * tz + 0.5);
+                    }
+
+                    grid[(x * scale * scale) + (y * scale) + z] = atlas(c);
+                }
+            }
+        }
+    }
+    inline void divide(mandelbulb8_block &b, std::vector<game::block_id> &grid, const size_t scale, const size_t tolerance, const std::array<size_t, 6> &o) const
+    {
+        // Read the sampled corners of this octant
+        int8_t n[8];
+        for (size_t i = 0; i < 8; i++)
+        {
+            n[i] = b.cache((i & 4) ? o[3] : o[0], (i & 2) ? o[4] : o[1], (i & 1) ? o[5] : o[2]);
+        }
+
+        // Do the corners agree?
+        const int8_t low = *std::min_element(n, n + 8);
+        const int8_t high = *std::max_element(n, n + 8);
+        if (high < 0)
+        {
+            // Outside the set, leave empty
+            return;
+        }
+
+        // Fill octants that can not be divided or are uniform within tolerance
+        const bool leaf = (o[3] - o[0] <= 1) && (o[4] - o[1] <= 1) && (o[5] - o[2] <= 1);
+        if (leaf || (low >= 0 && static_cast<size_t>(high - low) <= tolerance))
+        {
+            fill(b, grid, scale, o, n);
+            return;
+        }
+
+        // Split each axis that is longer than one cell, children share the middle plane
+        size_t split[3][2][2];
+        size_t parts[3];
+        for (size_t i = 0; i < 3; i++)
+        {
+            const size_t lo = o[i];
+            const size_t hi = o[i + 3];
+            const size_t mid = (lo + hi) / 2;
+            split[i][0][0] = lo;
+            split[i][0][1] = (hi - lo > 1) ? mid : hi;
+            split[i][1][0] = mid;
+            split[i][1][1] = hi;
+            parts[i] = (hi - lo > 1) ? 2 : 1;
+        }
+
+        // Queue the child octants for the next level
+        for (size_t i = 0; i < parts[0]; i++)
+        {
+            for (size_t j = 0; j < parts[1]; j++)
+            {
+                for (size_t k = 0; k < parts[2]; k++)
+                {
+                    b.next().push_back({split[0][i][0], split[1][j][0], split[2][k][0], split[0][i][1], split[1][j][1], split[2][k][1]});
+                }
+            }
+        }
+    }
+#ifdef __AVX__
+    inline __m256 delta8(const __m256 a, const __m256 b) const
+    {
+        // Squared distance from the axis
+        const __m256 r = _mm256_add_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(b, b));
+        if (!_exp)
+        {
+            return r;
+        }
+
+        // Damp in double precision, rounding to float hides the last bits of error
+        const __m128 lo = _mm256_cvtpd_ps(exp4(_mm256_mul_pd(wide(r, 0), _mm256_set1_pd(-1.0))));
+        const __m128 hi = _mm256_cvtpd_ps(exp4(_mm256_mul_pd(wide(r, 1), _mm256_set1_pd(-1.0))));
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+    }
+    inline static __m256d exp4(const __m256d x)
+    {
+        // Clamp to the range where the double result is normal
+        const __m256d c = _mm256_max_pd(_mm256_min_pd(x, _mm256_set1_pd(708.0)), _mm256_set1_pd(-708.0));
+
+        // Split into 2^k * e^r, with |r| <= ln(2) / 2
+        const __m256d k = _mm256_round_pd(_mm256_mul_pd(c, _mm256_set1_pd(1.4426950408889634)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256d r = _mm256_sub_pd(c, _mm256_mul_pd(k, _mm256_set1_pd(6.93147180369123816490e-01)));
+        r = _mm256_sub_pd(r, _mm256_mul_pd(k, _mm256_set1_pd(1.90821492927058770002e-10)));
+
+        // Taylor series of e^r to 13th order
+        __m256d p = _mm256_set1_pd(1.0 / 6227020800.0);
+        const double coeff[13] = {1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0, 1.0 / 362880.0, 1.0 / 40320.0,
+                                  1.0 / 5040.0, 1.0 / 720.0, 1.0 / 120.0, 1.0 / 24.0, 1.0 / 6.0, 0.5, 1.0, 1.0};
+        for (size_t i = 0; i < 13; i++)
+        {
+            p = _mm256_add_pd(_mm256_mul_pd(p, r), _mm256_set1_pd(coeff[i]));
+        }
+
+        // Scale by 2^k through the exponent bits
+        const __m128i ki = _mm256_cvtpd_epi32(k);
+        const __m128i bias = _mm_set1_epi64x(1023);
+        const __m128i e0 = _mm_slli_epi64(_mm_add_epi64(_mm_cvtepi32_epi64(ki), bias), 52);
+        const __m128i e1 = _mm_slli_epi64(_mm_add_epi64(_mm_cvtepi32_epi64(_mm_unpackhi_epi64(ki, ki)), bias), 52);
+        const __m256d scale = _mm256_castsi256_pd(_mm256_insertf128_si256(_mm256_castsi128_si256(e0), e1, 1));
+        const __m256d out = _mm256_mul_pd(p, scale);
+
+        // Pass NaN through and flush below the clamp to zero like exp
+        const __m256d under = _mm256_cmp_pd(x, _mm256_set1_pd(-708.0), _CMP_LT_OQ);
+        const __m256d nan = _mm256_cmp_pd(x, x, _CMP_UNORD_Q);
+        return _mm256_blendv_pd(_mm256_andnot_pd(under, out), x, nan);
+    }
+    inline static __m256d wide(const __m256 v, const int half)
+    {
+        return _mm256_cvtps_pd((half == 0) ? _mm256_castps256_ps128(v) : _mm256_extractf128_ps(v, 1));
+    }
+    inline __m256 axis8(const __m256 v, const __m256 d, const float *c) const
+    {
+        // Powers of the coordinate and delta, in the same order as the scalar kernels
+        const __m256 v3 = _mm256_mul_ps(_mm256_mul_ps(v, v), v);
+        const __m256 v5 = _mm256_mul_ps(_mm256_mul_ps(v3, v), v);
+        const __m256 v7 = _mm256_mul_ps(_mm256_mul_ps(v5, v), v);
+        const __m256 v9 = _mm256_mul_ps(_mm256_mul_ps(v7, v), v);
+        const __m256 d2 = _mm256_mul_ps(d, d);
+        const __m256 d3 = _mm256_mul_ps(d2, d);
+        const __m256 d4 = _mm256_mul_ps(d3, d);
+        if (!_wide)
+        {
+            __m256 out = _mm256_sub_ps(v9, _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(c[0]), v7), d));
+            out = _mm256_add_ps(out, _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(c[1]), v5), d2));
+            out = _mm256_sub_ps(out, _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(c[2]), v3), d3));
+            out = _mm256_add_ps(out, _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(c[3]), v), d4));
+            return _mm256_add_ps(out, v);
+        }
+
+        // Evaluate the polynomial in double precision, four lanes at a time
+        __m128 half[2];
+        for (int i = 0; i < 2; i++)
+        {
+            __m256d out = _mm256_sub_pd(wide(v9, i), _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(c[0]), wide(v7, i)), wide(d, i)));
+            out = _mm256_add_pd(out, _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(c[1]), wide(v5, i)), wide(d2, i)));
+            out = _mm256_sub_pd(out, _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(c[2]), wide(v3, i)), wide(d3, i)));
+            out = _mm256_add_pd(out, _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(c[3]), wide(v, i)), wide(d4, i)));
+            half[i] = _mm256_cvtpd_ps(_mm256_add_pd(out, wide(v, i)));
+        }
+
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(half[0]), half[1], 1);
+    }
+    inline void iterate8(const float *x, const float *y, const float *z, const uint8_t mask, int8_t *out) const
+    {
+        // Load start points and the lanes to iterate
+        __m256 x0 = _mm256_loadu_ps(x);
+        __m256 y0 = _mm256_loadu_ps(y);
+        __m256 z0 = _mm256_loadu_ps(z);
+        int32_t lane[8];
+        for (size_t i = 0; i < 8; i++)
+        {
+            lane[i] = (mask & (1 << i)) ? -1 : 0;
+        }
+        __m256 active = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(lane)));
+
+        // Iteration each lane converged on, -1 if not converged
+        __m256 iterations = _mm256_set1_ps(-1.0);
+        const __m256 sign = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+        const __m256 eps = _mm256_set1_ps(1E-3);
+        for (size_t i = 0; i < 32; i++)
+        {
+            // Iterate each coordinate
+            const __m256 x1 = axis8(x0, delta8(y0, z0), _coeff[0]);
+            const __m256 y1 = axis8(y0, delta8(z0, x0), _coeff[1]);
+            const __m256 z1 = axis8(z0, delta8(x0, y0), _coeff[2]);
+
+            // Test convergence of the active lanes
+            const __m256 cx = _mm256_cmp_ps(_mm256_and_ps(_mm256_sub_ps(x1, x0), sign), eps, _CMP_LT_OQ);
+            const __m256 cy = _mm256_cmp_ps(_mm256_and_ps(_mm256_sub_ps(y1, y0), sign), eps, _CMP_LT_OQ);
+            const __m256 cz = _mm256_cmp_ps(_mm256_and_ps(_mm256_sub_ps(z1, z0), sign), eps, _CMP_LT_OQ);
+            const __m256 converged = _mm256_and_ps(_mm256_and_ps(_mm256_and_ps(cx, cy), cz), active);
+
+            // Retire converged lanes, stop when all lanes are done
+            iterations = _mm256_blendv_ps(iterations, _mm256_set1_ps(i), converged);
+            active = _mm256_andnot_ps(converged, active);
+            if (_mm256_movemask_ps(active) == 0)
+            {
+                break;
+            }
+
+            // Prime next loop
+            x0 = x1;
+            y0 = y1;
+            z0 = z1;
+        }
+
+        // Store iterations of each lane
+        float lanes[8];
+        _mm256_storeu_ps(lanes, iterations);
+        for (size_t i = 0; i < 8; i++)
+        {
+            out[i] = static_cast<int8_t>(lanes[i]);
+        }
+    }
+#endif
+
+  public:
+    mandelbulb8(const int (&x)[4], const int (&y)[4], const int (&z)[4], const bool wide, const bool exp)
+        : _wide(wide), _exp(exp)
+    {
+        // Integer coefficients are exact as floats
+        const int *c[3] = {x, y, z};
+        for (size_t i = 0; i < 3; i++)
+        {
+            for (size_t j = 0; j < 4; j++)
+            {
+                _coeff[i][j] = c[i][j];
+            }
+        }
+    }
+
+    inline static game::block_id atlas(const int8_t iterations)
+    {
+        // If we converged return atlas
+        if (iterations >= 0)
+        {
+            return static_cast<game::block_id>(iterations % 21);
+        }
+
+        return game::block_id::EMPTY;
+    }
+    inline void count(const float *x, const float *y, const float *z, const uint8_t mask, int8_t *out) const
+    {
+#ifdef __AVX__
+        iterate8(x, y, z, mask, out);
+#else
+        // Scalar fallback
+        for (size_t i = 0; i < 8; i++)
+        {
+            if (mask & (1 << i))
+            {
+                out[i] = (_wide) ? iterate1<double>(x[i], y[i], z[i]) : iterate1<float>(x[i], y[i], z[i]);
+            }
+        }
+#endif
+    }
+    inline void iterate(const float *x, const float *y, const float *z, const uint8_t mask, game::block_id *out) const
+    {
+        // Count iterations and convert to atlas
+        int8_t n[8] = {-1, -1, -1, -1, -1, -1, -1, -1};
+        count(x, y, z, mask, n);
+        for (size_t i = 0; i < 8; i++)
+        {
+            out[i] = atlas(n[i]);
+        }
+    }
+    inline void generate(game::thread_pool &pool, std::vector<game::block_id> &grid, const size_t d, const std::function<min::vec3<float>(const size_t)> &f) const
+    {
+        // Create working function over batches of 8 cells
+        const auto work = [this, &grid, d, &f](std::mt19937 &gen, const size_t i) {
+            float x[8] = {};
+            float y[8] = {};
+            float z[8] = {};
+            game::block_id out[8];
+
+            // Load start points of the empty cells in this batch
+            const size_t start = i * 8;
+            const size_t stop = std::min(start + 8, grid.size());
+            uint8_t mask = 0;
+            for (size_t j = start; j < stop; j++)
+            {
+                if (grid[j] == game::block_id::EMPTY)
+                {
+                    const min::vec3<float> p = f(j);
+                    x[j - start] = p.x() / d;
+                    y[j - start] = p.y() / d;
+                    z[j - start] = p.z() / d;
+                    mask |= 1 << (j - start);
+                }
+            }
+
+            // Skip batches without empty cells
+            if (mask == 0)
+            {
+                return;
+            }
+
+            // Do mandelbulb on the empty cells
+            iterate(x, y, z, mask, out);
+            for (size_t j = start; j < stop; j++)
+            {
+                if (mask & (1 << (j - start)))
+                {
+                    grid[j] = out[j - start];
+                }
+            }
+        };
+
+        // Run the job in parallel
+        pool.run(work, 0, (grid.size() + 7) / 8);
+    }
+    inline static size_t blocks(const size_t scale, const size_t lattice)
+    {
+        // Number of lattice blocks in the grid
+        const size_t width = (scale + lattice - 1) / lattice;
+
+        return width * width * width;
+    }
+    inline void generate_adaptive(game::thread_pool &pool, std::vector<game::block_id> &grid, const size_t scale, const size_t d,
+                                  const std::function<min::vec3<float>(const size_t)> &f, const size_t tolerance, const size_t lattice,
+                                  std::atomic<size_t> *progress = nullptr) const
+    {
+        // Number of lattice blocks on each axis
+        const size_t blocks = (scale + lattice - 1) / lattice;
+
+        // Create working function over lattice blocks
+        const auto work = [this, &grid, scale, d, &f, tolerance, lattice, blocks, progress](std::mt19937 &gen, const size_t i) {
+            // Scratch samples for this block
+            mandelbulb8_block b(lattice);
+            const size_t lo[3] = {(i / (blocks * blocks)) * lattice, ((i / blocks) % blocks) * lattice, (i % blocks) * lattice};
+            b.reset(grid, scale, lo, _unknown);
+
+            // Refine one level of octants at a time so corner samples fill all lanes
+            while (b.octants().size() > 0)
+            {
+                // Queue corners not sampled yet
+                b.pending().clear();
+                for (const std::array<size_t, 6> &o : b.octants())
+                {
+                    for (size_t j = 0; j < 8; j++)
+                    {
+                        const size_t x = (j & 4) ? o[3] : o[0];
+                        const size_t y = (j & 2) ? o[4] : o[1];
+                        const size_t z = (j & 1) ? o[5] : o[2];
+                        int8_t &c = b.cache(x, y, z);
+                        if (c == _unknown)
+                        {
+                            c = _queued;
+                            b.pending().push_back({x, y, z});
+                        }
+                    }
+                }
+                sample(b, scale, d, f);
+
+                // Fill uniform octants and subdivide the rest
+                b.next().clear();
+                for (const std::array<size_t, 6> &o : b.octants())
+                {
+                    divide(b, grid, scale, tolerance, o);
+                }
+                b.octants().swap(b.next());
+            }
+
+            // Count finished blocks for progress
+            if (progress)
+            {
+                progress->fetch_add(1, std::memory_order_relaxed);
+            }
+        };
+
+        // Run the job in parallel
+        pool.run(work, 0, blocks * blocks * blocks);
+    }
+};
+}
+
+#endif
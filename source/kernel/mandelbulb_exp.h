@@ -21,6 +21,7 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #include <functional>
 #include <game/id.h>
 #include <game/thread_pool.h>
+#include <kernel/mandelbulb8.h>
 #include <min/vec3.h>
 
 namespace kernel
@@ -49,6 +50,17 @@ class mandelbulb_exp
     {
         return x * x * x;
     }
+    inline static size_t divisor(const size_t size)
+    {
+        return static_cast<size_t>(size * 0.6667);
+    }
+    inline mandelbulb8 lanes() const
+    {
+        // Coefficients are shared by all axes
+        const int c[4] = {_a, _b, _c, _d};
+
+        return mandelbulb8(c, c, c, false, true);
+    }
     inline game::block_id do_mandelbulb(const min::vec3<float> &p, const size_t size)
     {
         // Copy point
@@ -57,7 +69,7 @@ class mandelbulb_exp
         float z0, z1;
 
         // Set start point
-        const size_t d = static_cast<size_t>(size * 0.6667);
+        const size_t d = divisor(size);
         x0 = p.x() / d;
         y0 = p.y() / d;
         z0 = p.z() / d;
@@ -134,7 +146,18 @@ class mandelbulb_exp
         std::cout << "C: " << _c << std::endl;
         std::cout << "D: " << _d << std::endl;
     }
-    inline void generate(game::thread_pool &pool, std::vector<game::block_id> &grid, const size_t gsize, const std::function<min::vec3<float>(const size_t)> &f)
+    inline void generate(game::thread_pool &pool, std::vector<game::block_id> &grid, const size_t gsize, const std::function<min::vec3<float>(const size_t)> &f, const size_t tolerance = 0, const size_t lattice = 8,
+                         std::atomic<size_t> *progress = nullptr)
+    {
+        // Sample a lattice, subdivide where the fractal changes and fill octants within tolerance iterations
+        lanes().generate_adaptive(pool, grid, gsize, divisor(gsize), f, tolerance, lattice, progress);
+    }
+    inline void generate_exhaustive(game::thread_pool &pool, std::vector<game::block_id> &grid, const size_t gsize, const std::function<min::vec3<float>(const size_t)> &f)
+    {
+        // Iterate 8 cells at a time
+        lanes().generate(pool, grid, divisor(gsize), f);
+    }
+    inline void generate_scalar(game::thread_pool &pool, std::vector<game::block_id> &grid, const size_t gsize, const std::function<min::vec3<float>(const size_t)> &f)
     {
         // Create working function
         const auto work = [this, &grid, gsize, &f](std::mt19937 &gen, const size_t i) {
@@ -0,0 +1,218 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __POISSON_DISK__
+#define __POISSON_DISK__
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <game/rng.h>
+#include <game/thread_pool.h>
+#include <stdexcept>
+#include <vector>
+
+namespace kernel
+{
+
+// Blue noise points on an integer square, no two points closer than radius
+class poisson_disk
+{
+  private:
+    static constexpr size_t _tile_cells = 8;
+    static constexpr size_t _tries = 16;
+    static constexpr int _empty = -1;
+    const size_t _lo;
+    const size_t _hi;
+    const size_t _radius;
+    const size_t _cell;
+    const size_t _reach;
+    const size_t _cells;
+    const size_t _tiles;
+    const uint32_t _key;
+    std::vector<std::array<int, 2>> _grid;
+    std::vector<std::vector<std::array<size_t, 2>>> _points;
+
+    inline size_t cell_key(const size_t x, const size_t z) const
+    {
+        return x * _cells + z;
+    }
+    inline bool valid(const int x, const int z, const size_t cx, const size_t cz) const
+    {
+        // Check all cells that could hold a point within radius
+        const size_t r2 = _radius * _radius;
+        const size_t x0 = (cx > _reach) ? cx - _reach : 0;
+        const size_t z0 = (cz > _reach) ? cz - _reach : 0;
+        const size_t x1 = std::min(cx + _reach, _cells - 1);
+        const size_t z1 = std::min(cz + _reach, _cells - 1);
+        for (size_t i = x0; i <= x1; i++)
+        {
+            for (size_t j = z0; j <= z1; j++)
+            {
+                const std::array<int, 2> &p = _grid[cell_key(i, j)];
+                if (p[0] != _empty)
+                {
+                    const int dx = p[0] - x;
+                    const int dz = p[1] - z;
+                    if (static_cast<size_t>(dx * dx + dz * dz) < r2)
+                    {
+                        return false;
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+    inline void throw_darts(const size_t tile)
+    {
+        // Tile cell bounds
+        const size_t tx = tile / _tiles;
+        const size_t tz = tile % _tiles;
+        const size_t x_end = std::min((tx + 1) * _tile_cells, _cells);
+        const size_t z_end = std::min((tz + 1) * _tile_cells, _cells);
+
+        // Try a few darts in each cell, the counter only depends on the cell
+        std::vector<std::array<size_t, 2>> &out = _points[tile];
+        for (size_t cx = tx * _tile_cells; cx < x_end; cx++)
+        {
+            for (size_t cz = tz * _tile_cells; cz < z_end; cz++)
+            {
+                const size_t key = cell_key(cx, cz);
+                for (size_t t = 0; t < _tries; t++)
+                {
+                    // Random point in this cell
+                    const uint32_t h = game::rng::hash(_key, key * _tries + t);
+                    const size_t x = _lo + cx * _cell + (h & 0xFFFF) % _cell;
+                    const size_t z = _lo + cz * _cell + (h >> 16) % _cell;
+                    if (x > _hi || z > _hi)
+                    {
+                        continue;
+                    }
+
+                    // Keep the first dart far enough from all others
+                    if (valid(x, z, cx, cz))
+                    {
+                        _grid[key] = {static_cast<int>(x), static_cast<int>(z)};
+                        out.push_back({x, z});
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+  public:
+    poisson_disk(const size_t lo, const size_t hi, const size_t radius, const uint64_t seed)
+        : _lo(lo), _hi(hi), _radius(radius),
+          _cell(std::max(static_cast<size_t>(radius / std::sqrt(2.0)), static_cast<size_t>(1))),
+          _reach((radius + _cell - 1) / _cell),
+          _cells((hi > lo) ? (hi - lo) / _cell + 1 : 1),
+          _tiles((_cells + _tile_cells - 1) / _tile_cells),
+          _key(game::rng::key(seed)),
+          _grid(_cells * _cells, {_empty, _empty}),
+          _points(_tiles * _tiles)
+    {
+        // Check the domain
+        if (lo > hi || radius == 0)
+        {
+            throw std::runtime_error("poisson_disk: invalid domain or radius");
+        }
+
+        // Same phase tiles must not see each other
+        if (_reach >= _tile_cells)
+        {
+            throw std::runtime_error("poisson_disk: radius too large for tile size");
+        }
+    }
+    inline void generate(game::thread_pool &pool)
+    {
+        // Tiles with the same x and z parity are a tile apart and never conflict
+        const size_t half = (_tiles + 1) / 2;
+        for (size_t phase = 0; phase < 4; phase++)
+        {
+            const size_t px = phase / 2;
+            const size_t pz = phase % 2;
+
+            // Create working function over tiles of this phase
+            const auto work = [this, half, px, pz](std::mt19937 &gen, const size_t i) {
+                const size_t tx = (i / half) * 2 + px;
+                const size_t tz = (i % half) * 2 + pz;
+                if (tx < _tiles && tz < _tiles)
+                {
+                    throw_darts(tx * _tiles + tz);
+                }
+            };
+
+            // Run the job in parallel
+            pool.run(work, 0, half * half);
+        }
+    }
+    inline const std::vector<std::array<size_t, 2>> &get_tile(const size_t tile) const
+    {
+        return _points[tile];
+    }
+    template <typename F>
+    inline void query(const size_t x0, const size_t x1, const size_t z0, const size_t z1, const F &f) const
+    {
+        // Nothing before the start of the domain
+        if (x1 <= _lo || z1 <= _lo || x0 >= x1 || z0 >= z1)
+        {
+            return;
+        }
+
+        // Tiles overlapping the range [x0, x1) x [z0, z1)
+        const size_t span = _tile_cells * _cell;
+        const size_t tx0 = (std::max(x0, _lo) - _lo) / span;
+        const size_t tz0 = (std::max(z0, _lo) - _lo) / span;
+        const size_t tx1 = std::min((x1 - 1 - _lo) / span + 1, _tiles);
+        const size_t tz1 = std::min((z1 - 1 - _lo) / span + 1, _tiles);
+        for (size_t tx = tx0; tx < tx1; tx++)
+        {
+            for (size_t tz = tz0; tz < tz1; tz++)
+            {
+                // Visit points inside the range
+                for (const std::array<size_t, 2> &p : _points[tx * _tiles + tz])
+                {
+                    if (p[0] >= x0 && p[0] < x1 && p[1] >= z0 && p[1] < z1)
+                    {
+                        f(p);
+                    }
+                }
+            }
+        }
+    }
+    inline size_t size() const
+    {
+        // Count all points
+        size_t count = 0;
+        for (const auto &p : _points)
+        {
+            count += p.size();
+        }
+
+        return count;
+    }
+    inline size_t tiles() const
+    {
+        return _points.size();
+    }
+};
+}
+
+#endif
@@ -18,8 +18,11 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef __TERRAIN_BASE__
 #define __TERRAIN_BASE__
 
+#include <algorithm>
+#include <game/gen_pipeline.h>
 #include <game/id.h>
 #include <game/perlin.h>
+#include <game/rng.h>
 #include <game/thread_pool.h>
 #include <min/vec3.h>
 
@@ -33,7 +36,8 @@ class terrain_base
     const size_t _chunk_size;
     const size_t _start;
     const size_t _stop;
-    perlin_noise _noise;
+    const perlin_noise _noise;
+    const uint32_t _key;
 
     inline size_t key(const std::tuple<size_t, size_t, size_t> &index) const
     {
@@ -48,142 +52,185 @@ class terrain_base
 
         return false;
     }
-    inline float do_perlin(const size_t x, const size_t y, const size_t z) const
+    inline void do_perlin8(const size_t x, const size_t y, const size_t z, float *out) const
     {
         // Relative grid components in chunk
         const float inv_cs = 1.0 / _chunk_size;
         const float rx = x * inv_cs;
         const float ry = y * inv_cs;
-        const float rz = z * inv_cs;
+        float rz[8];
+        for (size_t i = 0; i < 8; i++)
+        {
+            rz[i] = (z + i) * inv_cs;
+        }
 
-        // Calculate noise for this grid cell
-        return _noise.perlin(rx, ry, rz);
+        // Calculate noise for the next 8 grid cells along Z
+        _noise.perlin8(rx, ry, rz, out);
+    }
+    inline void dope(const size_t key, game::block_id &write, const float value) const
+    {
+        // Random draw between 0 and 110 for this cell
+        const uint32_t draw = game::rng::hash(_key, key) % 111;
+
+        if (value >= 0.0 && value < 0.10)
+        {
+            if (draw <= 2)
+            {
+                write = game::block_id::GOLD;
+            }
+            else
+            {
+                write = game::block_id::STONE1;
+            }
+        }
+        else if (value >= 0.10 && value < 0.15)
+        {
+            if (draw <= 4)
+            {
+                write = game::block_id::SILVER;
+            }
+            else
+            {
+                write = game::block_id::STONE2;
+            }
+        }
+        else if (value >= 0.15 && value < 0.20)
+        {
+            if (draw <= 6)
+            {
+                write = game::block_id::IRON;
+            }
+            else
+            {
+                write = game::block_id::IRIDIUM;
+            }
+        }
+        else if (value >= 0.20 && value < 0.25)
+        {
+            if (draw <= 6)
+            {
+                write = game::block_id::COPPER;
+            }
+            else
+            {
+                write = game::block_id::DIRT1;
+            }
+        }
+        else if (value >= 0.35 && value < 0.40)
+        {
+            if (draw <= 8)
+            {
+                write = game::block_id::CALCIUM;
+            }
+            else
+            {
+                write = game::block_id::DIRT2;
+            }
+        }
+        else if (value >= 0.40 && value < 0.45)
+        {
+            if (draw <= 10)
+            {
+                write = game::block_id::SODIUM;
+            }
+            else
+            {
+                write = game::block_id::CLAY1;
+            }
+        }
+        else if (value >= 0.45 && value < 0.50)
+        {
+            if (draw <= 8)
+            {
+                write = game::block_id::MAGNESIUM;
+            }
+            else
+            {
+                write = game::block_id::CLAY2;
+            }
+        }
+        else if (value >= 0.51 && value < 0.515)
+        {
+            if (draw <= 10)
+            {
+                write = game::block_id::POTASSIUM;
+            }
+            else
+            {
+                write = game::block_id::SODIUM;
+            }
+        }
+    }
+    inline void dope_row(std::vector<game::block_id> &write, const size_t i, const size_t j, const size_t z0, const size_t z1) const
+    {
+        // If row is on edge, write as STONE2
+        const size_t row = key(std::make_tuple(i, j, 0));
+        if (on_edge(i) || on_edge(j))
+        {
+            std::fill(write.begin() + row + z0, write.begin() + row + z1, game::block_id::STONE2);
+            return;
+        }
+
+        // Write edge cells at both ends of the row as STONE2
+        const size_t last = _scale - 1;
+        if (z0 == 0)
+        {
+            write[row] = game::block_id::STONE2;
+        }
+        if (z1 > last)
+        {
+            write[row + last] = game::block_id::STONE2;
+        }
+
+        // Calculate 3d perlin in batches of 8 along Z, batches stay aligned to the row
+        float value[8];
+        const size_t first = std::max(z0, static_cast<size_t>(1));
+        const size_t end = std::min(z1, last);
+        for (size_t k = first - (first - 1) % 8; k < end; k += 8)
+        {
+            do_perlin8(i, j, k, value);
+
+            // Dope the cells in this batch in order
+            const size_t stop = std::min(k + 8, end);
+            for (size_t l = std::max(k, first); l < stop; l++)
+            {
+                dope(row + l, write[row + l], value[l - k]);
+            }
+        }
     }
 
   public:
-    terrain_base(const size_t scale, const size_t chunk_size, const size_t start, const size_t stop)
-        : _scale(scale), _chunk_size(chunk_size), _start(start), _stop(stop) {}
+    terrain_base(const size_t scale, const size_t chunk_size, const size_t start, const size_t stop, const uint64_t seed)
+        : _scale(scale), _chunk_size(chunk_size), _start(start), _stop(stop),
+          _noise(game::rng::key(seed, 1)), _key(game::rng::key(seed, 0)) {}
 
     inline void generate(game::thread_pool &pool, std::vector<game::block_id> &write) const
     {
         // Create working function
         const auto work = [this, &write](std::mt19937 &gen, const size_t i) {
-            // Dope minerals in base
-            std::uniform_int_distribution<uint_fast8_t> dope(0, 110);
-
             // Fill out this section
             for (size_t j = _start; j < _stop; j++)
             {
-                for (size_t k = 0; k < _scale; k++)
-                {
-                    // Calculate key index
-                    const size_t index = key(std::make_tuple(i, j, k));
-
-                    // If on edge, write as STONE2
-                    if (on_edge(i) || on_edge(j) || on_edge(k))
-                    {
-                        write[index] = game::block_id::STONE2;
-                    }
-                    else
-                    {
-                        // Calculate 3d perlin
-                        const float value = do_perlin(i, j, k);
-                        if (value >= 0.0 && value < 0.10)
-                        {
-                            if (dope(gen) <= 2)
-                            {
-                                write[index] = game::block_id::GOLD;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::STONE1;
-                            }
-                        }
-                        else if (value >= 0.10 && value < 0.15)
-                        {
-                            if (dope(gen) <= 4)
-                            {
-                                write[index] = game::block_id::SILVER;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::STONE2;
-                            }
-                        }
-                        else if (value >= 0.15 && value < 0.20)
-                        {
-                            if (dope(gen) <= 6)
-                            {
-                                write[index] = game::block_id::IRON;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::IRIDIUM;
-                            }
-                        }
-                        else if (value >= 0.20 && value < 0.25)
-                        {
-                            if (dope(gen) <= 6)
-                            {
-                                write[index] = game::block_id::COPPER;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::DIRT1;
-                            }
-                        }
-                        else if (value >= 0.35 && value < 0.40)
-                        {
-                            if (dope(gen) <= 8)
-                            {
-                                write[index] = game::block_id::CALCIUM;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::DIRT2;
-                            }
-                        }
-                        else if (value >= 0.40 && value < 0.45)
-                        {
-                            if (dope(gen) <= 10)
-                            {
-                                write[index] = game::block_id::SODIUM;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::CLAY1;
-                            }
-                        }
-                        else if (value >= 0.45 && value < 0.50)
-                        {
-                            if (dope(gen) <= 8)
-                            {
-                                write[index] = game::block_id::MAGNESIUM;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::CLAY2;
-                            }
-                        }
-                        else if (value >= 0.51 && value < 0.515)
-                        {
-                            if (dope(gen) <= 10)
-                            {
-                                write[index] = game::block_id::POTASSIUM;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::SODIUM;
-                            }
-                        }
-                    }
-                }
+                dope_row(write, i, j, 0, _scale);
             }
         };
 
         // Parallelize on X axis
         pool.run(work, 0, _scale);
     }
+    inline void tile(std::vector<game::block_id> &write, const game::gen_tile &t) const
+    {
+        // Fill out the rows of this box inside the base layer, every cell only depends on its position
+        const size_t y0 = std::max(t.y_begin(), _start);
+        const size_t y1 = std::min(t.y_end(), _stop);
+        for (size_t i = t.x_begin(); i < t.x_end(); i++)
+        {
+            for (size_t j = y0; j < y1; j++)
+            {
+                dope_row(write, i, j, t.z_begin(), t.z_end());
+            }
+        }
+    }
 };
 }
 
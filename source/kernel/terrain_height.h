@@ -18,10 +18,16 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef __TERRAIN_HEIGHT__
 #define __TERRAIN_HEIGHT__
 
+#include <algorithm>
+#include <game/gen_pipeline.h>
 #include <game/height_map.h>
 #include <game/id.h>
+#include <game/rng.h>
 #include <game/thread_pool.h>
+#include <kernel/poisson_disk.h>
+#include <limits>
 #include <min/vec3.h>
+#include <vector>
 
 namespace kernel
 {
@@ -29,176 +35,281 @@ namespace kernel
 class terrain_height
 {
   private:
+    static constexpr size_t _spacing = 6;
+    static constexpr size_t _reach = 2;
+    static constexpr size_t _lo = 3;
     const size_t _scale;
     const size_t _start;
     const size_t _stop;
+    const game::height_map<float, float> _map;
+    const uint32_t _cell_key;
+    const uint32_t _site_key;
+    const size_t _tree_draw;
+    const size_t _plant_draw;
+    size_t _trees;
+    size_t _plants;
+    poisson_disk _disk;
+    uint64_t _keep_below;
+    uint64_t _plant_below;
 
     inline size_t key(const std::tuple<size_t, size_t, size_t> &index) const
     {
         return min::vec3<float>::grid_key(index, _scale);
     }
-    inline bool on_edge(const size_t x) const
+    inline static bool inside(const game::gen_tile &t, const size_t x, const size_t y, const size_t z)
     {
-        if (x == 0 || x == _scale - 1)
-        {
-            return true;
-        }
-
-        return false;
+        return x >= t.x_begin() && x < t.x_end() && y >= t.y_begin() && y < t.y_end() && z >= t.z_begin() && z < t.z_end();
     }
-    inline void terrain(game::thread_pool &pool, std::vector<game::block_id> &write, const game::height_map<float, float> &map) const
+    inline static size_t draw(const uint64_t seed, const uint32_t stream, const size_t lower, const size_t upper)
     {
-        // Parallelize on X axis
-        const auto work = [this, &map, &write](std::mt19937 &gen, const size_t i) {
-            const int_fast8_t grass_start = game::id_value(game::block_id::GRASS1);
-            const int_fast8_t grass_end = game::id_value(game::block_id::GRASS2);
-            const int_fast8_t dirt_start = game::id_value(game::block_id::DIRT1);
-            const int_fast8_t dirt_end = game::id_value(game::block_id::DIRT2);
-            const int_fast8_t sand_start = game::id_value(game::block_id::SAND1);
-            const int_fast8_t sand_end = game::id_value(game::block_id::SAND2);
-            std::uniform_int_distribution<int_fast8_t> grass(grass_start, grass_end);
-            std::uniform_int_distribution<int_fast8_t> soil(dirt_start, dirt_end);
-            std::uniform_int_distribution<int_fast8_t> sand(sand_start, sand_end);
-
-            // Z axis
-            for (size_t k = 0; k < _scale; k++)
-            {
-                // Get the height
-                const size_t level = static_cast<size_t>(std::round(map.get(i, k)));
-                const size_t height = (level > _stop) ? _stop : level;
-                const size_t mid = _start + (height / 2);
-                const size_t end = _start + (height - 1);
-
-                // Sand section
-                for (size_t j = _start; j < mid; j++)
-                {
-                    const size_t write_key = key(std::make_tuple(i, j, k));
-                    write[write_key] = static_cast<game::block_id>(sand(gen));
-                }
-
-                // Soil section
-                for (size_t j = mid; j < end; j++)
-                {
-                    const size_t write_key = key(std::make_tuple(i, j, k));
-                    write[write_key] = static_cast<game::block_id>(soil(gen));
-                }
-
-                // Grass surface
-                const size_t write_key = key(std::make_tuple(i, end, k));
-                write[write_key] = static_cast<game::block_id>(grass(gen));
-            }
-        };
+        return lower + game::rng::hash(game::rng::key(seed, stream), 0) % (upper - lower + 1);
+    }
+    inline static size_t spacing(const size_t scale, const size_t count)
+    {
+        // Dart throwing fills about one site per 1.2 * r^2 cells, spread sites to the count
+        const size_t side = scale - 2 * _lo - 1;
+        const size_t radius = static_cast<size_t>(std::sqrt((side * side) / (1.2 * count)));
 
-        // Run height map in parallel
-        pool.run(work, 0, _scale);
+        // Integer sites closer than 6 could share leaf cells, 5x5 blocks need a gap of 5 on one axis
+        return (radius > _spacing) ? radius : _spacing;
+    }
+    inline uint64_t rank(const std::array<size_t, 2> &p) const
+    {
+        // Random order of sites, the site key breaks ties
+        const uint32_t cell = p[0] * _scale + p[1];
+        const uint32_t stream = game::rng::hash(_site_key, cell);
+        return (static_cast<uint64_t>(game::rng::hash(stream, 0)) << 32) | cell;
+    }
+    inline game::block_id pick(const size_t write_key, const game::block_id first, const game::block_id last) const
+    {
+        // Random block variant for this cell
+        const int_fast8_t start = game::id_value(first);
+        const int_fast8_t end = game::id_value(last);
+        return static_cast<game::block_id>(start + game::rng::hash(_cell_key, write_key) % (end - start + 1));
     }
-    inline void plants(game::thread_pool &pool, std::vector<game::block_id> &write, const game::height_map<float, float> &map, const size_t size) const
+    inline void column(std::vector<game::block_id> &write, const size_t i, const size_t k, const size_t y0, const size_t y1) const
     {
-        // Parallelize on X axis
-        const auto work = [this, &map, &write](std::mt19937 &gen, const size_t i) {
-            const int_fast8_t plant_start = game::id_value(game::block_id::TOMATO);
-            const int_fast8_t plant_end = game::id_value(game::block_id::GREEN_PEPPER);
-            std::uniform_int_distribution<int_fast8_t> plant(plant_start, plant_end);
+        // Get the height
+        const size_t level = static_cast<size_t>(std::round(_map.get(i, k)));
+        const size_t height = (level > _stop) ? _stop : level;
+        const size_t mid = _start + (height / 2);
+        const size_t end = _start + (height - 1);
 
-            // Get random X/Z coord, Y from height map
-            std::uniform_int_distribution<size_t> p(3, _scale - 4);
-            const size_t x = p(gen);
-            const size_t z = p(gen);
-            const size_t y = _start + static_cast<size_t>(std::round(map.get(x, z)));
+        // Sand section, clipped to the rows asked for
+        const size_t sand_end = std::min(mid, y1);
+        for (size_t j = std::max(_start, y0); j < sand_end; j++)
+        {
+            const size_t write_key = key(std::make_tuple(i, j, k));
+            write[write_key] = pick(write_key, game::block_id::SAND1, game::block_id::SAND2);
+        }
 
-            // Create plants in empty cells on top of height map
-            const size_t write_key = key(std::make_tuple(x, y, z));
-            if (write[write_key] == game::block_id::EMPTY)
-            {
-                write[write_key] = static_cast<game::block_id>(plant(gen));
-            }
-        };
+        // Soil section
+        const size_t soil_end = std::min(end, y1);
+        for (size_t j = std::max(mid, y0); j < soil_end; j++)
+        {
+            const size_t write_key = key(std::make_tuple(i, j, k));
+            write[write_key] = pick(write_key, game::block_id::DIRT1, game::block_id::DIRT2);
+        }
 
-        // Run height map in parallel
-        pool.run(work, 0, size);
+        // Grass surface
+        if (end >= y0 && end < y1)
+        {
+            const size_t write_key = key(std::make_tuple(i, end, k));
+            write[write_key] = pick(write_key, game::block_id::GRASS1, game::block_id::GRASS2);
+        }
     }
-    inline void trees(game::thread_pool &pool, std::vector<game::block_id> &write, const game::height_map<float, float> &map, const size_t size) const
+    inline void plant(std::vector<game::block_id> &write, const game::gen_tile &t, const size_t x, const size_t z, const uint32_t stream) const
     {
-        // Parallelize on X axis
-        const auto work = [this, &map, &write](std::mt19937 &gen, const size_t i) {
-            const int_fast8_t leaf_start = game::id_value(game::block_id::LEAF1);
-            const int_fast8_t leaf_end = game::id_value(game::block_id::LEAF4);
-            const int_fast8_t wood_start = game::id_value(game::block_id::WOOD1);
-            const int_fast8_t wood_end = game::id_value(game::block_id::WOOD2);
+        const int_fast8_t plant_start = game::id_value(game::block_id::TOMATO);
+        const int_fast8_t plant_end = game::id_value(game::block_id::GREEN_PEPPER);
 
-            // Random numbers between 5 and 13, including both
-            std::uniform_int_distribution<uint_fast8_t> tree_size(4, 18);
-            std::uniform_int_distribution<int_fast8_t> wood(wood_start, wood_end);
-            std::uniform_int_distribution<int_fast8_t> leaf(leaf_start, leaf_end);
+        // Y from height map
+        const size_t y = _start + static_cast<size_t>(std::round(_map.get(x, z)));
 
-            // Get random X/Z coord
-            std::uniform_int_distribution<size_t> p(3, _scale - 4);
-            const size_t x = p(gen);
-            const size_t z = p(gen);
+        // Create plants in empty cells on top of height map
+        const size_t write_key = key(std::make_tuple(x, y, z));
+        if (inside(t, x, y, z) && write[write_key] == game::block_id::EMPTY)
+        {
+            write[write_key] = static_cast<game::block_id>(plant_start + game::rng::hash(stream, 2) % (plant_end - plant_start + 1));
+        }
+    }
+    inline void tree(std::vector<game::block_id> &write, const game::gen_tile &t, const size_t x, const size_t z, const uint32_t stream) const
+    {
+        const int_fast8_t leaf_start = game::id_value(game::block_id::LEAF1);
+        const int_fast8_t leaf_end = game::id_value(game::block_id::LEAF4);
+        const int_fast8_t wood_start = game::id_value(game::block_id::WOOD1);
+        const int_fast8_t wood_end = game::id_value(game::block_id::WOOD2);
 
-            // Get the top of trees at X/Z coord
-            const size_t tree_base = _start + static_cast<size_t>(std::round(map.get(x, z)));
-            const size_t tree_height = tree_base + tree_size(gen);
-            const size_t tree_top = (tree_height > _stop) ? _stop : tree_height;
+        // Get the top of trees at X/Z coord, random height between 4 and 18
+        const size_t tree_base = _start + static_cast<size_t>(std::round(_map.get(x, z)));
+        const size_t tree_height = tree_base + 4 + game::rng::hash(stream, 2) % 15;
+        const size_t tree_top = (tree_height > _stop) ? _stop : tree_height;
 
-            // Create tree wood
-            const int_fast8_t wood_type = wood(gen);
-            for (size_t y = tree_base; y < tree_top; y++)
+        // Create tree wood, only the cells inside the box
+        const int_fast8_t wood_type = wood_start + game::rng::hash(stream, 3) % (wood_end - wood_start + 1);
+        for (size_t y = tree_base; y < tree_top; y++)
+        {
+            if (inside(t, x, y, z))
             {
                 const size_t write_key = key(std::make_tuple(x, y, z));
                 write[write_key] = static_cast<game::block_id>(wood_type);
             }
+        }
+
+        // Leaf start position and leaf type
+        const size_t x_start = x - _reach;
+        const size_t y_start = tree_top - 2;
+        const size_t z_start = z - _reach;
+        const int_fast8_t leaf_type = leaf_start + game::rng::hash(stream, 4) % (leaf_end - leaf_start + 1);
 
-            // Leaf start position and leaf type
-            const size_t x_start = x - 2;
-            const size_t y_start = tree_top - 2;
-            const size_t z_start = z - 2;
-            const int_fast8_t leaf_type = leaf(gen);
-
-            // Generate cubic leaves
-            std::uniform_int_distribution<uint_fast8_t> leaf_offset(0, 1);
-            const size_t dx = leaf_offset(gen);
-            const size_t x_end = x_start + (5 - dx);
-            for (size_t x = x_start + dx; x < x_end; x++)
+        // Generate cubic leaves, trim one random edge per layer
+        const uint32_t bits = game::rng::hash(stream, 5);
+        const size_t dx = bits & 1;
+        const size_t x_end = x_start + (5 - dx);
+        for (size_t x = x_start + dx, i = 1; x < x_end; x++)
+        {
+            const size_t y_end = y_start + 3;
+            for (size_t y = y_start; y < y_end; y++, i++)
             {
-                const size_t y_end = y_start + 3;
-                for (size_t y = y_start; y < y_end; y++)
+                const size_t dz = (bits >> i) & 1;
+                const size_t z_end = z_start + (5 - dz);
+                for (size_t z = z_start + dz; z < z_end; z++)
                 {
-                    const size_t dz = leaf_offset(gen);
-                    const size_t z_end = z_start + (5 - dz);
-                    for (size_t z = z_start + dz; z < z_end; z++)
+                    if (inside(t, x, y, z))
                     {
                         const size_t write_key = key(std::make_tuple(x, y, z));
                         write[write_key] = static_cast<game::block_id>(leaf_type);
                     }
                 }
             }
-        };
+        }
+    }
+    inline void site(std::vector<game::block_id> &write, const game::gen_tile &t, const std::array<size_t, 2> &p) const
+    {
+        // Keep the lowest ranked sites, each site draws from its own stream
+        const uint64_t r = rank(p);
+        if (r >= _keep_below)
+        {
+            return;
+        }
 
-        // Run height map in parallel
-        pool.run(work, 0, size);
+        // Place a plant or a tree
+        const uint32_t stream = game::rng::hash(_site_key, p[0] * _scale + p[1]);
+        if (r < _plant_below)
+        {
+            plant(write, t, p[0], p[1], stream);
+        }
+        else
+        {
+            tree(write, t, p[0], p[1], stream);
+        }
     }
 
   public:
-    terrain_height(const size_t scale, const size_t start, const size_t stop)
-        : _scale(scale), _start(start), _stop(stop) {}
+    terrain_height(game::thread_pool &pool, const size_t scale, const size_t start, const size_t stop, const uint64_t seed)
+        : _scale(scale), _start(start), _stop(stop),
+          _map(pool, std::ceil(std::log2(scale)), 4.0, 8.0, game::rng::key(seed, 2)),
+          _cell_key(game::rng::key(seed, 3)),
+          _site_key(game::rng::key(seed, 4)),
+          _tree_draw(draw(seed, 6, 250, 1000)),
+          _plant_draw(draw(seed, 7, 50, 150)),
+          _trees(_tree_draw), _plants(_plant_draw),
+          _disk(_lo, scale - _lo - 1, spacing(scale, _tree_draw + _plant_draw), game::rng::key(seed, 5)),
+          _keep_below(0), _plant_below(0)
+    {
+        // Blue noise sites, spaced so no two leaf blocks can touch the same cell
+        _disk.generate(pool);
 
-    inline void generate(game::thread_pool &pool, std::mt19937 &gen, std::vector<game::block_id> &write) const
+        // Small worlds can't fit the drawn counts without overlap, shrink both and keep the mix
+        const size_t sites = _disk.size();
+        const size_t count = _trees + _plants;
+        if (count > sites)
+        {
+            _plants = (_plants * sites) / count;
+            _trees = sites - _plants;
+        }
+
+        // Rank all sites, the first ones are plants and the next ones trees
+        std::vector<uint64_t> order;
+        order.reserve(sites);
+        for (size_t i = 0; i < _disk.tiles(); i++)
+        {
+            for (const std::array<size_t, 2> &p : _disk.get_tile(i))
+            {
+                order.push_back(rank(p));
+            }
+        }
+        std::sort(order.begin(), order.end());
+        order.push_back(std::numeric_limits<uint64_t>::max());
+        _plant_below = order[_plants];
+        _keep_below = order[_trees + _plants];
+    }
+
+    inline void generate(game::thread_pool &pool, std::vector<game::block_id> &write) const
     {
-        // Generate height map
-        const size_t level = std::ceil(std::log2(_scale));
-        const game::height_map<float, float> map(level, 4.0, 8.0);
+        // Parallelize terrain on X axis
+        const auto work = [this, &write](std::mt19937 &gen, const size_t i) {
+            for (size_t k = 0; k < _scale; k++)
+            {
+                column(write, i, k, 0, _scale);
+            }
+        };
 
         // Generate terrain
-        terrain(pool, write, map);
+        pool.run(work, 0, _scale);
 
-        // Generate trees
-        std::uniform_int_distribution<size_t> tree_dist(250, 1000);
-        trees(pool, write, map, tree_dist(gen));
+        // Generate trees and plants
+        vegetation(pool, write);
+    }
+    inline size_t get_plant_draw() const
+    {
+        return _plant_draw;
+    }
+    inline size_t get_plants() const
+    {
+        return _plants;
+    }
+    inline size_t get_tree_draw() const
+    {
+        return _tree_draw;
+    }
+    inline size_t get_trees() const
+    {
+        return _trees;
+    }
+    inline void tile(std::vector<game::block_id> &write, const game::gen_tile &t) const
+    {
+        // Terrain columns of this box, clipped to its rows
+        for (size_t i = t.x_begin(); i < t.x_end(); i++)
+        {
+            for (size_t k = t.z_begin(); k < t.z_end(); k++)
+            {
+                column(write, i, k, t.y_begin(), t.y_end());
+            }
+        }
+    }
+    inline void tile_vegetation(std::vector<game::block_id> &write, const game::gen_tile &t) const
+    {
+        // Sites whose structures reach into this box, clipped to the box
+        const size_t x0 = (t.x_begin() > _reach) ? t.x_begin() - _reach : 0;
+        const size_t z0 = (t.z_begin() > _reach) ? t.z_begin() - _reach : 0;
+        _disk.query(x0, t.x_end() + _reach, z0, t.z_end() + _reach, [this, &write, &t](const std::array<size_t, 2> &p) {
+            site(write, t, p);
+        });
+    }
+    inline void vegetation(game::thread_pool &pool, std::vector<game::block_id> &write) const
+    {
+        // Stamp each disk tile in parallel, structures never share a cell
+        const game::gen_tile all(0, _scale, 0, _scale, 0, _scale);
+        const auto work = [this, &write, &all](std::mt19937 &gen, const size_t i) {
+            for (const auto &p : _disk.get_tile(i))
+            {
+                site(write, all, p);
+            }
+        };
 
-        // Generate plants
-        std::uniform_int_distribution<size_t> plant_dist(50, 150);
-        plants(pool, write, map, plant_dist(gen));
+        // Run stamping in parallel
+        pool.run(work, 0, _disk.tiles());
     }
 };
 }
@@ -0,0 +1,59 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <game/file.h>
+#include <game/portal_table.h>
+#include <iostream>
+#include <string>
+
+// Converts a text .portal file into a packed .bportal table for data.sky
+int main(int argc, char *argv[])
+{
+    // Check arguments
+    if (argc != 4)
+    {
+        std::cout << "usage: portal <in.portal> <out.bportal> <parameters per line>" << std::endl;
+        return -1;
+    }
+
+    try
+    {
+        // Load the text file
+        std::vector<uint8_t> text;
+        game::load_file(argv[1], text);
+        if (text.size() == 0)
+        {
+            return -1;
+        }
+
+        // Pack the rows and check they load
+        const size_t cols = std::stoul(argv[3]);
+        const std::vector<uint8_t> stream = game::portal_table::pack(std::string(text.begin(), text.end()), cols);
+        const game::portal_table table(stream.data(), stream.size(), cols);
+
+        // Write the binary table
+        game::save_file(argv[2], stream);
+        std::cout << "portal: packed " << table.size() << " rows into '" << argv[2] << "'" << std::endl;
+    }
+    catch (std::exception &ex)
+    {
+        std::cout << ex.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_BROWNIAN__
+#define __TEST_BROWNIAN__
+
+#include <chrono>
+#include <game/id.h>
+#include <game/thread_pool.h>
+#include <iostream>
+#include <kernel/brownian_grow.h>
+#include <random>
+#include <stdexcept>
+#include <test.h>
+#include <vector>
+
+std::vector<game::block_id> brownian_run(game::thread_pool &pool, const size_t scale, const size_t years)
+{
+    // Grow from a fixed seed
+    std::mt19937 gen(7);
+    std::vector<game::block_id> grid(scale * scale * scale, game::block_id::EMPTY);
+    kernel::brownian_grow grow(gen, grid, scale, 8, 4);
+    grow.generate(pool, grid, grid, years, 32);
+
+    return grid;
+}
+bool test_brownian()
+{
+    bool out = true;
+
+    // Create a threadpool for doing work in parallel
+    game::thread_pool pool;
+
+    // Test the same seed grows the same aggregate
+    const size_t scale = 64;
+    const auto begin = std::chrono::high_resolution_clock::now();
+    const std::vector<game::block_id> grid = brownian_run(pool, scale, 1 << 16);
+    const auto end = std::chrono::high_resolution_clock::now();
+    const std::vector<game::block_id> same = brownian_run(pool, scale, 1 << 16);
+    out = out && (grid == same);
+    if (!out)
+    {
+        throw std::runtime_error("Failed brownian deterministic growth");
+    }
+
+    // Test the aggregate grew and every cell touches another cell
+    size_t count = 0;
+    for (size_t x = 1; x < scale - 1; x++)
+    {
+        for (size_t y = 1; y < scale - 1; y++)
+        {
+            for (size_t z = 1; z < scale - 1; z++)
+            {
+                const size_t i = (x * scale * scale) + (y * scale) + z;
+                if (grid[i] != game::block_id::EMPTY)
+                {
+                    const size_t n[6] = {i - scale * scale, i + scale * scale, i - scale, i + scale, i - 1, i + 1};
+                    bool touch = false;
+                    for (size_t j = 0; j < 6; j++)
+                    {
+                        touch = touch || (grid[n[j]] != game::block_id::EMPTY);
+                    }
+                    out = out && touch;
+                    count++;
+                }
+            }
+        }
+    }
+    std::cout << "brownian_grow: grid " << scale << ": " << count << " cells in "
+              << std::chrono::duration<double, std::milli>(end - begin).count() << " ms" << std::endl;
+    if (!out || count < 100)
+    {
+        throw std::runtime_error("Failed brownian aggregate growth");
+    }
+
+    return out;
+}
+
+#endif
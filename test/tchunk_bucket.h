@@ -0,0 +1,76 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_CHUNK_BUCKET__
+#define __TEST_CHUNK_BUCKET__
+
+#include <game/chunk_bucket.h>
+#include <stdexcept>
+#include <test.h>
+
+bool test_chunk_bucket()
+{
+    bool out = true;
+
+    // Test items land in the bucket of their chunk
+    game::chunk_bucket bucket;
+    bucket.resize(8, 4);
+    out = out && (bucket.chunks() == 8);
+    bucket.insert(0, 3);
+    bucket.insert(1, 3);
+    bucket.insert(2, 5);
+    out = out && (bucket.get(3).size() == 2) && (bucket.get(5).size() == 1);
+    out = out && (bucket.get(3)[0] == 0) && (bucket.get(3)[1] == 1);
+    out = out && (bucket.key(3) == game::chunk_bucket::none());
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk bucket insert");
+    }
+
+    // Test staying in a chunk doesn't reorder, crossing a boundary moves the item
+    bucket.insert(0, 3);
+    out = out && (bucket.get(3)[0] == 0);
+    bucket.insert(0, 5);
+    out = out && (bucket.get(3).size() == 1) && (bucket.get(3)[0] == 1);
+    out = out && (bucket.get(5).size() == 2) && (bucket.key(0) == 5);
+
+    // Test removing the first item patches the moved item
+    bucket.remove(2);
+    out = out && (bucket.get(5).size() == 1) && (bucket.get(5)[0] == 0);
+    bucket.remove(0);
+    bucket.remove(0);
+    out = out && bucket.get(5).empty() && (bucket.key(0) == game::chunk_bucket::none());
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk bucket move");
+    }
+
+    // Test clear empties every bucket
+    bucket.insert(3, 7);
+    bucket.clear();
+    out = out && bucket.get(3).empty() && bucket.get(7).empty();
+    bucket.insert(3, 7);
+    out = out && (bucket.get(7).size() == 1);
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk bucket clear");
+    }
+
+    return out;
+}
+
+#endif
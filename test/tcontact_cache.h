@@ -0,0 +1,122 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_CONTACT_CACHE__
+#define __TEST_CONTACT_CACHE__
+
+#include <game/contact_cache.h>
+#include <game/id.h>
+#include <game/thread_pool.h>
+#include <game/voxel_contact.h>
+#include <min/aabbox.h>
+#include <min/vec3.h>
+#include <random>
+#include <stdexcept>
+#include <test.h>
+#include <vector>
+
+bool test_contact_cache()
+{
+    bool out = true;
+
+    // Random solid cells in a small world centered on the origin
+    const size_t scale = 16;
+    const min::vec3<float> world_min(-8.0, -8.0, -8.0);
+    std::vector<game::block_id> grid(scale * scale * scale, game::block_id::EMPTY);
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<size_t> cell(0, grid.size() - 1);
+    for (size_t i = 0; i < grid.size() / 4; i++)
+    {
+        grid[cell(gen)] = game::block_id::STONE1;
+    }
+    const game::voxel_contact contact(grid, scale, world_min);
+
+    // Random entity boxes
+    const size_t size = 500;
+    std::uniform_real_distribution<float> pos(-8.0, 7.0);
+    std::vector<min::aabbox<float, min::vec3>> boxes;
+    for (size_t i = 0; i < size; i++)
+    {
+        const min::vec3<float> lo(pos(gen), pos(gen), pos(gen));
+        boxes.emplace_back(lo, lo + min::vec3<float>(0.8, 1.5, 0.8));
+    }
+
+    // Find contacts for all entities in parallel
+    game::contact_cache cache(size / 2);
+    for (size_t i = 0; i < size; i++)
+    {
+        cache.add();
+    }
+    out = out && (cache.size() == size);
+    game::thread_pool pool(4);
+    const auto work = [&cache, &contact, &boxes](std::mt19937 &gen, const size_t i) {
+        std::vector<game::cell_contact> &row = cache.fill(i);
+        contact.query(boxes[i], [&row](const game::cell_contact &c) {
+            row.push_back(c);
+            return false;
+        });
+    };
+    pool.run(work, 0, size);
+
+    // Test each row matches a serial query
+    for (size_t i = 0; i < size; i++)
+    {
+        std::vector<size_t> keys;
+        contact.query(boxes[i], [&keys](const game::cell_contact &c) {
+            keys.push_back(c.get_key());
+            return false;
+        });
+
+        const std::vector<game::cell_contact> &row = cache.get(i);
+        out = out && (row.size() == keys.size());
+        for (size_t j = 0; out && j < keys.size(); j++)
+        {
+            out = out && (row[j].get_key() == keys[j]);
+        }
+    }
+    if (!out)
+    {
+        throw std::runtime_error("Failed contact cache parallel fill");
+    }
+
+    // Test erase moves the last row into the hole
+    const size_t next = cache.get(11).size();
+    const size_t last = cache.get(size - 1).size();
+    cache.erase(10);
+    out = out && (cache.size() == size - 1);
+    out = out && (cache.get(10).size() == last);
+    out = out && (cache.get(11).size() == next);
+
+    // Test added rows start empty even if recycled
+    cache.add();
+    out = out && (cache.size() == size);
+    out = out && cache.get(size - 1).empty();
+
+    // Test clear
+    cache.clear();
+    out = out && (cache.size() == 0);
+    cache.add();
+    out = out && (cache.size() == 1) && cache.get(0).empty();
+    if (!out)
+    {
+        throw std::runtime_error("Failed contact cache rows");
+    }
+
+    return out;
+}
+
+#endif
@@ -0,0 +1,192 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_ENTITY_STORE__
+#define __TEST_ENTITY_STORE__
+
+#include <game/entity_store.h>
+#include <min/vec3.h>
+#include <stdexcept>
+#include <test.h>
+#include <vector>
+
+class entity_store_body
+{
+  private:
+    min::vec3<float> _p;
+    min::vec3<float> _v;
+
+  public:
+    entity_store_body(const min::vec3<float> &p, const min::vec3<float> &v) : _p(p), _v(v) {}
+    inline const min::vec3<float> &get_position() const
+    {
+        return _p;
+    }
+    inline const min::vec3<float> &get_linear_velocity() const
+    {
+        return _v;
+    }
+    inline void set_position(const min::vec3<float> &p)
+    {
+        _p = p;
+    }
+};
+
+class entity_store_sim
+{
+  private:
+    std::vector<entity_store_body> _bodies;
+
+  public:
+    inline size_t add_body(const min::vec3<float> &p, const min::vec3<float> &v)
+    {
+        _bodies.emplace_back(p, v);
+        return _bodies.size() - 1;
+    }
+    inline entity_store_body &get_body(const size_t id)
+    {
+        return _bodies[id];
+    }
+    inline const entity_store_body &get_body(const size_t id) const
+    {
+        return _bodies[id];
+    }
+};
+
+bool test_entity_store()
+{
+    bool out = true;
+
+    // Bodies live in the simulation out of store order
+    entity_store_sim sim;
+    game::entity_store<2> store(4);
+    for (size_t i = 0; i < 4; i++)
+    {
+        const float f = static_cast<float>(i);
+        const size_t body = sim.add_body(min::vec3<float>(f, 0.0, 0.0), min::vec3<float>(0.0, f, 0.0));
+        store.add(body, i);
+    }
+
+    // Test gather copies the body state into the columns
+    store.gather(sim);
+    out = out && (store.size() == 4);
+    out = out && compare(store.position(2).x(), 2.0, 1E-4);
+    out = out && compare(store.velocity(3).y(), 3.0, 1E-4);
+    if (!out)
+    {
+        throw std::runtime_error("Failed entity store gather");
+    }
+
+    // Test timers count down to zero and stop
+    store.set_timer(0, 1, 2);
+    store.set_timer(1, 1, 5);
+    store.tick(0);
+    store.tick(0);
+    store.tick(0);
+    store.tick(1);
+    out = out && (store.timer(0, 1) == 0);
+    out = out && (store.timer(1, 1) == 4);
+    out = out && (store.timer(0, 0) == 0);
+    if (!out)
+    {
+        throw std::runtime_error("Failed entity store timers");
+    }
+
+    // Test direction and distance to a target
+    store.look_at(min::vec3<float>(0.0, 0.0, 3.0));
+    out = out && compare(store.distance(0), 3.0, 1E-4);
+    out = out && compare(store.direction(0).z(), 1.0, 1E-4);
+    out = out && compare(store.distance(1), std::sqrt(10.0), 1E-4);
+    out = out && compare(store.direction(1).x(), -1.0 / std::sqrt(10.0), 1E-4);
+    if (!out)
+    {
+        throw std::runtime_error("Failed entity store look at");
+    }
+
+    // Test interpolation between the snapshot and the gathered positions
+    store.snapshot(sim);
+    sim.get_body(2).set_position(min::vec3<float>(2.0, 4.0, 0.0));
+    store.gather(sim);
+    out = out && compare(store.interpolate(2, 0.25).y(), 1.0, 1E-4);
+    out = out && compare(store.interpolate(2, 1.0).y(), 4.0, 1E-4);
+    out = out && compare(store.interpolate(0, 0.5).x(), 0.0, 1E-4);
+    store.set_previous(3, min::vec3<float>(3.0, -8.0, 0.0));
+    out = out && compare(store.interpolate(3, 0.5).y(), -4.0, 1E-4);
+    if (!out)
+    {
+        throw std::runtime_error("Failed entity store interpolate");
+    }
+
+    // Test erase moves the last row into the hole
+    store.erase(1);
+    out = out && (store.size() == 3);
+    out = out && (store.body_id(1) == 3);
+    out = out && (store.inst_id(0) == 0);
+    out = out && (store.inst_id(1) == 3);
+    out = out && (store.inst_id(2) == 2);
+    out = out && compare(store.position(1).x(), 3.0, 1E-4);
+    out = out && compare(store.interpolate(1, 0.5).y(), -4.0, 1E-4);
+    out = out && compare(store.interpolate(2, 0.5).y(), 2.0, 1E-4);
+
+    // Test rows added after the snapshot don't blend
+    const size_t body = sim.add_body(min::vec3<float>(9.0, 0.0, 0.0), min::vec3<float>());
+    store.add(body, 1);
+    store.gather(sim);
+    out = out && compare(store.interpolate(3, 0.5).x(), 9.0, 1E-4);
+    if (!out)
+    {
+        throw std::runtime_error("Failed entity store erase");
+    }
+
+    // Test handles find their moved rows and stale handles miss
+    game::slot_map slots(4);
+    const size_t a = slots.alloc();
+    const size_t b = slots.alloc();
+    slots.free(a);
+    const size_t c = slots.alloc();
+    game::entity_store<0> handles(4);
+    handles.add(0, b);
+    handles.add(1, c);
+    size_t row = 0;
+    out = out && !handles.find(a, row);
+    out = out && handles.find(c, row) && (row == 1);
+    handles.erase(0);
+    out = out && !handles.find(b, row);
+    out = out && handles.find(c, row) && (row == 0);
+    handles.set_inst(0, b);
+    out = out && !handles.find(c, row);
+    out = out && handles.find(b, row) && (row == 0);
+    if (!out)
+    {
+        throw std::runtime_error("Failed entity store handles");
+    }
+
+    // Test clear empties every column
+    store.clear();
+    out = out && (store.size() == 0);
+    store.add(0, 0);
+    store.gather(sim);
+    out = out && (store.size() == 1) && (store.timer(0, 0) == 0);
+    if (!out)
+    {
+        throw std::runtime_error("Failed entity store clear");
+    }
+
+    return out;
+}
+
+#endif
@@ -16,7 +16,23 @@ You should have received a copy of the GNU General Public License
 along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include <iostream>
+#include <tbrownian.h>
+#include <tchunk_bucket.h>
+#include <tcontact_cache.h>
+#include <tentity_store.h>
+#include <tgen_pipeline.h>
+#include <theight_map.h>
+#include <tmandelbulb.h>
+#include <tpath.h>
+#include <tperlin.h>
+#include <tpoisson.h>
+#include <tportal.h>
+#include <tsim_thread.h>
+#include <tslot_map.h>
 #include <tthread_pool.h>
+#include <ttick_clock.h>
+#include <tvoxel_contact.h>
+#include <tworld_cache.h>
 
 int main()
 {
@@ -24,6 +40,22 @@ int main()
     {
         bool out = true;
         out = out && test_thread_pool();
+        out = out && test_path();
+        out = out && test_perlin();
+        out = out && test_mandelbulb();
+        out = out && test_portal();
+        out = out && test_height_map();
+        out = out && test_brownian();
+        out = out && test_poisson();
+        out = out && test_gen_pipeline();
+        out = out && test_world_cache();
+        out = out && test_entity_store();
+        out = out && test_voxel_contact();
+        out = out && test_contact_cache();
+        out = out && test_tick_clock();
+        out = out && test_slot_map();
+        out = out && test_chunk_bucket();
+        out = out && test_sim_thread();
         if (out)
         {
             std::cout << "Game tests passed!" << std::endl;
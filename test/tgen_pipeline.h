@@ -0,0 +1,173 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_GEN_PIPELINE__
+#define __TEST_GEN_PIPELINE__
+
+#include <game/gen_pipeline.h>
+#include <game/id.h>
+#include <game/thread_pool.h>
+#include <kernel/terrain_base.h>
+#include <kernel/terrain_height.h>
+#include <random>
+#include <stdexcept>
+#include <test.h>
+#include <vector>
+
+bool test_gen_pipeline()
+{
+    bool out = true;
+
+    // Two fused stages and a scatter pass on a small grid
+    game::thread_pool pool;
+    const size_t scale = 20;
+    std::vector<game::block_id> grid(scale * scale * scale, game::block_id::EMPTY);
+    game::gen_pipeline pipeline(scale, 8);
+    pipeline.add_tile("first", [scale](std::mt19937 &gen, std::vector<game::block_id> &write, const game::gen_tile &t) {
+        for (size_t i = t.x_begin(); i < t.x_end(); i++)
+        {
+            for (size_t j = t.y_begin(); j < t.y_end(); j++)
+            {
+                for (size_t k = 0; k < scale; k++)
+                {
+                    write[(i * scale + j) * scale + k] = game::block_id::STONE1;
+                }
+            }
+        }
+    });
+    pipeline.add_tile("second", [scale](std::mt19937 &gen, std::vector<game::block_id> &write, const game::gen_tile &t) {
+        for (size_t i = t.x_begin(); i < t.x_end(); i++)
+        {
+            for (size_t j = t.y_begin(); j < t.y_end(); j++)
+            {
+                // Only valid if the first stage already ran on this tile
+                const size_t row = (i * scale + j) * scale;
+                if (write[row] == game::block_id::STONE1)
+                {
+                    write[row] = game::block_id::STONE2;
+                }
+            }
+        }
+    });
+    pipeline.add_scatter("scatter", [](game::thread_pool &pool, std::vector<game::block_id> &write) {
+        write[0] = game::block_id::GOLD;
+    });
+    pipeline.run(pool, grid);
+
+    // Test every cell was written by the stages in order
+    for (size_t i = 0; i < scale * scale; i++)
+    {
+        const game::block_id expect = (i == 0) ? game::block_id::GOLD : game::block_id::STONE2;
+        out = out && (grid[i * scale] == expect);
+        out = out && (grid[i * scale + 1] == game::block_id::STONE1);
+    }
+    if (!out)
+    {
+        throw std::runtime_error("Failed gen pipeline stage order");
+    }
+
+    // Test stage names, access and timing
+    out = out && compare(3, pipeline.get_stages());
+    out = out && (pipeline.get_name(1) == "second");
+    out = out && (pipeline.get_access(0) == game::gen_access::tile);
+    out = out && (pipeline.get_access(2) == game::gen_access::scatter);
+    for (size_t i = 0; i < pipeline.get_stages(); i++)
+    {
+        out = out && pipeline.get_time(i) >= 0.0;
+    }
+    if (!out)
+    {
+        throw std::runtime_error("Failed gen pipeline stage info");
+    }
+
+    // Test tile stages can't follow a scatter stage
+    bool thrown = false;
+    try
+    {
+        pipeline.add_tile("late", [](std::mt19937 &gen, std::vector<game::block_id> &write, const game::gen_tile &t) {});
+    }
+    catch (std::exception &ex)
+    {
+        thrown = true;
+    }
+    out = out && thrown;
+    if (!out)
+    {
+        throw std::runtime_error("Failed gen pipeline access order");
+    }
+
+    // Full terrain pass with every stage fused per tile
+    const size_t size = 64;
+    const size_t chunk = 8;
+    const kernel::terrain_base base(size, chunk, 0, size / 2, 11);
+    const kernel::terrain_height height(pool, size, size / 2, size - 1, 11);
+    const auto stages = [&base, &height](game::gen_pipeline &p) {
+        p.add_tile("base", [&base](std::mt19937 &gen, std::vector<game::block_id> &write, const game::gen_tile &t) {
+            base.tile(write, t);
+        });
+        p.add_tile("height", [&height](std::mt19937 &gen, std::vector<game::block_id> &write, const game::gen_tile &t) {
+            height.tile(write, t);
+        });
+        p.add_tile("vegetation", [&height](std::mt19937 &gen, std::vector<game::block_id> &write, const game::gen_tile &t) {
+            height.tile_vegetation(write, t);
+        });
+    };
+    std::vector<game::block_id> full(size * size * size, game::block_id::EMPTY);
+    game::gen_pipeline full_pipeline(size, chunk);
+    stages(full_pipeline);
+    full_pipeline.run(pool, full);
+
+    // Test the separate passes give the same world
+    std::vector<game::block_id> passes(full.size(), game::block_id::EMPTY);
+    base.generate(pool, passes);
+    height.generate(pool, passes);
+    out = out && (full == passes);
+    if (!out)
+    {
+        throw std::runtime_error("Failed gen pipeline fused terrain");
+    }
+
+    // Generate the same world chunk by chunk in a scrambled order
+    const size_t chunks = size / chunk;
+    std::vector<game::gen_tile> tiles;
+    for (size_t i = 0; i < chunks * chunks * chunks; i++)
+    {
+        const size_t c = (i * 37) % (chunks * chunks * chunks);
+        const size_t x = (c / (chunks * chunks)) * chunk;
+        const size_t y = ((c / chunks) % chunks) * chunk;
+        const size_t z = (c % chunks) * chunk;
+        tiles.emplace_back(x, x + chunk, y, y + chunk, z, z + chunk);
+    }
+    std::vector<game::block_id> lazy(full.size(), game::block_id::EMPTY);
+    game::gen_pipeline lazy_pipeline(size, chunk);
+    stages(lazy_pipeline);
+    const std::vector<game::gen_tile> first(tiles.begin(), tiles.begin() + tiles.size() / 3);
+    const std::vector<game::gen_tile> rest(tiles.begin() + tiles.size() / 3, tiles.end());
+    lazy_pipeline.run(pool, lazy, first);
+    lazy_pipeline.run(pool, lazy, rest);
+
+    // Test chunks match the full pass
+    out = out && (full == lazy);
+    if (!out)
+    {
+        throw std::runtime_error("Failed gen pipeline chunk generation");
+    }
+
+    return out;
+}
+
+#endif
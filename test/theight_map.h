@@ -0,0 +1,132 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_HEIGHT_MAP__
+#define __TEST_HEIGHT_MAP__
+
+#include <chrono>
+#include <game/height_map.h>
+#include <game/thread_pool.h>
+#include <iostream>
+#include <stdexcept>
+#include <test.h>
+#include <vector>
+
+std::vector<float> height_map_blur(const game::height_map<float, float> &map)
+{
+    // Reference gaussian blur, x pass then y pass with windows shifted inside the map
+    const float kernel[5] = {0.05449, 0.24420, 0.40262, 0.24420, 0.05449};
+    const size_t size = map.size();
+    const auto start = [size](const size_t i) -> size_t {
+        return (i < 2) ? i : (i >= size - 2) ? i - 4 : i - 2;
+    };
+
+    std::vector<float> copy(size * size, 0.0);
+    for (size_t i = 0; i < size; i++)
+    {
+        for (size_t j = 0; j < size; j++)
+        {
+            for (size_t k = 0; k < 5; k++)
+            {
+                copy[size * i + j] += map.get(start(i) + k, j) * kernel[k];
+            }
+        }
+    }
+
+    std::vector<float> out(size * size, 0.0);
+    for (size_t i = 0; i < size; i++)
+    {
+        for (size_t j = 0; j < size; j++)
+        {
+            for (size_t k = 0; k < 5; k++)
+            {
+                out[size * i + j] += copy[size * i + start(j) + k] * kernel[k];
+            }
+        }
+    }
+
+    return out;
+}
+bool test_height_map()
+{
+    bool out = true;
+
+    // Create a threadpool for doing work in parallel
+    game::thread_pool pool;
+
+    // Test the same seed gives the same map
+    const size_t level = 7;
+    const game::height_map<float, float> map(pool, level, 4.0, 8.0, 42);
+    const game::height_map<float, float> same(pool, level, 4.0, 8.0, 42);
+    const game::height_map<float, float> other(pool, level, 4.0, 8.0, 43);
+    const size_t size = map.size();
+    size_t diff = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        for (size_t j = 0; j < size; j++)
+        {
+            out = out && (map.get(i, j) == same.get(i, j));
+            diff += (map.get(i, j) != other.get(i, j));
+        }
+    }
+    if (!out || diff == 0)
+    {
+        throw std::runtime_error("Failed height map seed");
+    }
+
+    // Test every cell was generated within the summed offsets
+    const game::height_map<float, float> raw(pool, level, 4.0, 8.0, 42, false);
+    for (size_t i = 0; i < size; i++)
+    {
+        for (size_t j = 0; j < size; j++)
+        {
+            out = out && (raw.get(i, j) >= 4.0) && (raw.get(i, j) < 8.0 * (level + 1));
+        }
+    }
+    if (!out)
+    {
+        throw std::runtime_error("Failed height map range");
+    }
+
+    // Test the blur matches the reference blur
+    const std::vector<float> ref = height_map_blur(raw);
+    for (size_t i = 0; i < size; i++)
+    {
+        for (size_t j = 0; j < size; j++)
+        {
+#if defined(__FAST_MATH__) || defined(__FMA__)
+            out = out && compare(ref[size * i + j], map.get(i, j), 1E-4);
+#else
+            out = out && (ref[size * i + j] == map.get(i, j));
+#endif
+        }
+    }
+    if (!out)
+    {
+        throw std::runtime_error("Failed height map blur");
+    }
+
+    // Time a large map
+    const auto begin = std::chrono::high_resolution_clock::now();
+    const game::height_map<float, float> large(pool, 11, 4.0, 8.0, 42);
+    const auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "height_map: " << large.size() << "^2: " << std::chrono::duration<double, std::milli>(end - begin).count() << " ms" << std::endl;
+
+    return out;
+}
+
+#endif
@@ -0,0 +1,221 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_MANDELBULB__
+#define __TEST_MANDELBULB__
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <game/id.h>
+#include <game/thread_pool.h>
+#include <iostream>
+#include <kernel/mandelbulb.h>
+#include <kernel/mandelbulb_asym.h>
+#include <kernel/mandelbulb_exp.h>
+#include <kernel/mandelbulb_sym.h>
+#include <min/vec3.h>
+#include <stdexcept>
+#include <string>
+#include <test.h>
+
+std::function<min::vec3<float>(const size_t)> mandelbulb_cell_center(const size_t scale)
+{
+    const float half = scale / 2;
+    return [scale, half](const size_t i) {
+        const float x = i / (scale * scale);
+        const float y = (i / scale) % scale;
+        const float z = i % scale;
+        return min::vec3<float>(x - half + 0.5, y - half + 0.5, z - half + 0.5);
+    };
+}
+template <typename K>
+bool test_mandelbulb_kernel(game::thread_pool &pool, K &kernel, const std::string &name)
+{
+    // Cell centers of a grid centered on the origin
+    const size_t scale = 64;
+    const auto f = mandelbulb_cell_center(scale);
+
+    // Fill every third cell so batches are partially masked
+    std::vector<game::block_id> scalar(scale * scale * scale, game::block_id::EMPTY);
+    for (size_t i = 0; i < scalar.size(); i += 3)
+    {
+        scalar[i] = game::block_id::STONE1;
+    }
+    std::vector<game::block_id> batch = scalar;
+
+    // Run the scalar and batched kernels
+    auto begin = std::chrono::high_resolution_clock::now();
+    kernel.generate_scalar(pool, scalar, scale, f);
+    auto end = std::chrono::high_resolution_clock::now();
+    const double scalar_ms = std::chrono::duration<double, std::milli>(end - begin).count();
+
+    begin = std::chrono::high_resolution_clock::now();
+    kernel.generate_exhaustive(pool, batch, scale, f);
+    end = std::chrono::high_resolution_clock::now();
+    const double batch_ms = std::chrono::duration<double, std::milli>(end - begin).count();
+
+    std::cout << name << ": grid 64: " << scalar_ms << " ms scalar, " << batch_ms << " ms batched" << std::endl;
+
+    // Count cells that differ between kernels
+    size_t diff = 0;
+    const size_t size = scalar.size();
+    for (size_t i = 0; i < size; i++)
+    {
+        if (scalar[i] != batch[i])
+        {
+            diff++;
+        }
+    }
+
+    // Fast math and FMA contraction let the compiler round each kernel differently
+#if defined(__FAST_MATH__) || defined(__FMA__)
+    const size_t tolerance = size / 1000;
+#else
+    const size_t tolerance = 0;
+#endif
+    if (diff > tolerance)
+    {
+        throw std::runtime_error("Failed " + name + " batched kernel matches scalar kernel");
+    }
+
+    return true;
+}
+template <typename K>
+bool test_mandelbulb_adaptive(game::thread_pool &pool, K &kernel, const std::string &name)
+{
+    const size_t scale = 128;
+    const auto f = mandelbulb_cell_center(scale);
+
+    // Run the exhaustive reference
+    std::vector<game::block_id> exhaustive(scale * scale * scale, game::block_id::EMPTY);
+    auto begin = std::chrono::high_resolution_clock::now();
+    kernel.generate_exhaustive(pool, exhaustive, scale, f);
+    auto end = std::chrono::high_resolution_clock::now();
+    const double exhaustive_ms = std::chrono::duration<double, std::milli>(end - begin).count();
+    std::cout << name << ": grid " << scale << ": " << exhaustive_ms << " ms exhaustive" << std::endl;
+
+    // Adaptive settings from fine to coarse
+    const size_t tolerance[3] = {0, 0, 2};
+    const size_t lattice[3] = {4, 8, 16};
+    const double max_error[3] = {0.005, 0.02, 0.04};
+    for (size_t i = 0; i < 3; i++)
+    {
+        // Run the adaptive kernel
+        std::vector<game::block_id> adaptive(exhaustive.size(), game::block_id::EMPTY);
+        begin = std::chrono::high_resolution_clock::now();
+        kernel.generate(pool, adaptive, scale, f, tolerance[i], lattice[i]);
+        end = std::chrono::high_resolution_clock::now();
+        const double adaptive_ms = std::chrono::duration<double, std::milli>(end - begin).count();
+
+        // Count cells that differ from the reference, and solid cells lost or gained
+        size_t diff = 0;
+        size_t solid = 0;
+        const size_t size = exhaustive.size();
+        for (size_t j = 0; j < size; j++)
+        {
+            if (exhaustive[j] != adaptive[j])
+            {
+                diff++;
+                if ((exhaustive[j] == game::block_id::EMPTY) != (adaptive[j] == game::block_id::EMPTY))
+                {
+                    solid++;
+                }
+            }
+        }
+
+        const double error = static_cast<double>(diff) / size;
+        std::cout << name << ": grid " << scale << ": tolerance " << tolerance[i] << ", lattice " << lattice[i] << ": "
+                  << adaptive_ms << " ms adaptive, " << error * 100.0 << "% cells differ, " << solid << " solid cells differ" << std::endl;
+
+        // Test the adaptive kernel stays close to the reference
+        if (error > max_error[i])
+        {
+            throw std::runtime_error("Failed " + name + " adaptive kernel matches exhaustive kernel");
+        }
+    }
+
+    return true;
+}
+template <typename K>
+bool test_mandelbulb_adaptive_filled(game::thread_pool &pool, K &kernel, const std::string &name)
+{
+    const size_t scale = 32;
+    const auto f = mandelbulb_cell_center(scale);
+
+    // Fill every third cell, these must survive
+    std::vector<game::block_id> grid(scale * scale * scale, game::block_id::EMPTY);
+    for (size_t i = 0; i < grid.size(); i += 3)
+    {
+        grid[i] = game::block_id::STONE1;
+    }
+
+    // Run the adaptive kernel
+    std::atomic<size_t> progress(0);
+    kernel.generate(pool, grid, scale, f, 2, 8, &progress);
+
+    // Test progress counted every lattice block
+    if (progress != kernel::mandelbulb8::blocks(scale, 8))
+    {
+        throw std::runtime_error("Failed " + name + " adaptive kernel progress");
+    }
+
+    // Test filled cells were not written
+    for (size_t i = 0; i < grid.size(); i += 3)
+    {
+        if (grid[i] != game::block_id::STONE1)
+        {
+            throw std::runtime_error("Failed " + name + " adaptive kernel keeps filled cells");
+        }
+    }
+
+    return true;
+}
+bool test_mandelbulb()
+{
+    bool out = true;
+
+    // Create a threadpool for doing work in parallel
+    game::thread_pool pool;
+
+    // Test each mandelbulb variant
+    kernel::mandelbulb base;
+    out = out && test_mandelbulb_kernel(pool, base, "mandelbulb");
+
+    kernel::mandelbulb_sym sym(36, 126, 84, 9);
+    out = out && test_mandelbulb_kernel(pool, sym, "mandelbulb_sym");
+
+    kernel::mandelbulb_asym asym(36, 126, 84, 9, 20, 60, 50, 4, 12, 40, 30, 6);
+    out = out && test_mandelbulb_kernel(pool, asym, "mandelbulb_asym");
+
+    kernel::mandelbulb_exp exp(8, 6, 15, 5);
+    out = out && test_mandelbulb_kernel(pool, exp, "mandelbulb_exp");
+
+    // Test adaptive subdivision against the exhaustive kernels
+    out = out && test_mandelbulb_adaptive(pool, base, "mandelbulb");
+    out = out && test_mandelbulb_adaptive(pool, sym, "mandelbulb_sym");
+    out = out && test_mandelbulb_adaptive(pool, asym, "mandelbulb_asym");
+    out = out && test_mandelbulb_adaptive(pool, exp, "mandelbulb_exp");
+    out = out && test_mandelbulb_adaptive_filled(pool, sym, "mandelbulb_sym");
+
+    // Kill the pool
+    pool.kill();
+
+    return out;
+}
+
+#endif
@@ -0,0 +1,632 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_PATH__
+#define __TEST_PATH__
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <game/flow_field.h>
+#include <game/path_graph.h>
+#include <game/path_queue.h>
+#include <game/path_search.h>
+#include <random>
+#include <stdexcept>
+#include <test.h>
+#include <vector>
+
+std::vector<game::block_id> test_path_grid(const size_t scale, std::mt19937 &gen)
+{
+    // Create a world with solid ground and scattered blocks above it
+    std::vector<game::block_id> grid(scale * scale * scale, game::block_id::EMPTY);
+    std::uniform_int_distribution<int> dist(0, 9);
+    for (size_t x = 0; x < scale; x++)
+    {
+        for (size_t y = 0; y < scale; y++)
+        {
+            for (size_t z = 0; z < scale; z++)
+            {
+                const size_t key = (x * scale * scale) + (y * scale) + z;
+                if (y < scale / 2 || dist(gen) < 2)
+                {
+                    grid[key] = game::block_id::STONE1;
+                }
+            }
+        }
+    }
+
+    return grid;
+}
+size_t test_path_bfs(const std::vector<game::block_id> &grid, const size_t scale, const size_t start, const size_t stop)
+{
+    // Breadth first search for the optimal path length
+    std::vector<size_t> dist(grid.size(), 0);
+    std::deque<size_t> queue = {start};
+    dist[start] = 1;
+    while (!queue.empty())
+    {
+        const size_t key = queue.front();
+        queue.pop_front();
+        if (key == stop)
+        {
+            return dist[key];
+        }
+
+        // Visit all neighbors
+        const size_t x = key / (scale * scale);
+        const size_t y = (key / scale) % scale;
+        const size_t z = key % scale;
+        const size_t s2 = scale * scale;
+        const size_t n[6] = {(x > 0) ? key - s2 : key, (x < scale - 1) ? key + s2 : key,
+                             (y > 0) ? key - scale : key, (y < scale - 1) ? key + scale : key,
+                             (z > 0) ? key - 1 : key, (z < scale - 1) ? key + 1 : key};
+        for (size_t i = 0; i < 6; i++)
+        {
+            if (dist[n[i]] == 0 && grid[n[i]] == game::block_id::EMPTY)
+            {
+                dist[n[i]] = dist[key] + 1;
+                queue.push_back(n[i]);
+            }
+        }
+    }
+
+    return 0;
+}
+bool test_path_scale(const size_t grid_size, const bool check_optimal)
+{
+    // Same layout as cgrid, world is 2 * grid cells wide
+    const size_t scale = grid_size * 2;
+    std::mt19937 gen(1234);
+    const std::vector<game::block_id> grid = test_path_grid(scale, gen);
+
+    // Pick random empty start points above ground and targets near them
+    const size_t queries = 200;
+    std::uniform_int_distribution<size_t> axis(1, scale - 2);
+    std::uniform_int_distribution<size_t> height(scale / 2, scale - 2);
+    std::uniform_int_distribution<int> offset(-16, 16);
+    std::vector<std::pair<size_t, size_t>> pairs;
+    while (pairs.size() < queries)
+    {
+        const size_t x = axis(gen);
+        const size_t y = height(gen);
+        const size_t z = axis(gen);
+        const size_t tx = std::min(std::max<int>(static_cast<int>(x) + offset(gen), 1), static_cast<int>(scale - 2));
+        const size_t ty = std::min(std::max<int>(static_cast<int>(y) + offset(gen), scale / 2), static_cast<int>(scale - 2));
+        const size_t tz = std::min(std::max<int>(static_cast<int>(z) + offset(gen), 1), static_cast<int>(scale - 2));
+        const size_t start = (x * scale * scale) + (y * scale) + z;
+        const size_t stop = (tx * scale * scale) + (ty * scale) + tz;
+        if (start != stop && grid[start] == game::block_id::EMPTY && grid[stop] == game::block_id::EMPTY)
+        {
+            pairs.emplace_back(start, stop);
+        }
+    }
+
+    // Time all path searches
+    game::path_search search;
+    size_t found = 0;
+    const auto begin = std::chrono::high_resolution_clock::now();
+    for (const auto &p : pairs)
+    {
+        found += search.search(grid, scale, p.first, p.second);
+    }
+    const auto end = std::chrono::high_resolution_clock::now();
+    const double us = std::chrono::duration<double, std::micro>(end - begin).count() / queries;
+    std::cout << "path_search: grid " << grid_size << ": " << us << " us per path, " << found << "/" << queries << " found" << std::endl;
+
+    // Check that every path is connected and empty
+    for (const auto &p : pairs)
+    {
+        const bool is_found = search.search(grid, scale, p.first, p.second);
+        const std::vector<size_t> &path = search.get_path();
+        if (is_found && (path.front() != p.first || path.back() != p.second))
+        {
+            throw std::runtime_error("Failed path search endpoints");
+        }
+        for (size_t i = 0; i < path.size(); i++)
+        {
+            if (grid[path[i]] != game::block_id::EMPTY)
+            {
+                throw std::runtime_error("Failed path search through wall");
+            }
+            if (i > 0)
+            {
+                const size_t d = (path[i] > path[i - 1]) ? path[i] - path[i - 1] : path[i - 1] - path[i];
+                if (d != 1 && d != scale && d != scale * scale)
+                {
+                    throw std::runtime_error("Failed path search connectivity");
+                }
+            }
+        }
+
+        // Check the path is as short as breadth first search
+        if (is_found && check_optimal && test_path_bfs(grid, scale, p.first, p.second) != path.size())
+        {
+            throw std::runtime_error("Failed path search optimal length");
+        }
+    }
+
+    // Require that most searches reach the target
+    if (found < queries * 9 / 10)
+    {
+        throw std::runtime_error("Failed path search reachability");
+    }
+
+    return true;
+}
+size_t test_path_follow(game::path_graph &graph, game::path_search &search, const std::vector<game::block_id> &grid,
+                        const size_t scale, const size_t start, const size_t stop, size_t &requests)
+{
+    // Follow local path segments like a drone until we arrive
+    size_t p = start;
+    for (requests = 0; requests < scale * 8 && p != stop; requests++)
+    {
+        const size_t waypoint = graph.waypoint(grid, p, stop);
+        search.search(grid, scale, p, waypoint);
+        const std::vector<size_t> &path = search.get_path();
+        if (path.empty() || path.front() != p)
+        {
+            break;
+        }
+        p = path.back();
+    }
+
+    return p;
+}
+std::vector<game::block_id> test_path_maze(const size_t scale)
+{
+    // Walls across x with a hole at alternating ends of z
+    std::vector<game::block_id> grid(scale * scale * scale, game::block_id::EMPTY);
+    for (size_t x = 4, i = 0; x < scale - 1; x += 8, i++)
+    {
+        const size_t hz = (i % 2 == 0) ? 1 : scale - 3;
+        for (size_t y = 0; y < scale; y++)
+        {
+            for (size_t z = 0; z < scale; z++)
+            {
+                const bool hole = (y == scale / 2 || y == scale / 2 + 1) && (z == hz || z == hz + 1);
+                if (!hole)
+                {
+                    grid[(x * scale * scale) + (y * scale) + z] = game::block_id::STONE1;
+                }
+            }
+        }
+    }
+
+    return grid;
+}
+bool test_path_graph_maze()
+{
+    // Long routes through a maze are out of reach for one cell search
+    const size_t scale = 64;
+    const size_t chunk_size = 8;
+    std::vector<game::block_id> grid = test_path_maze(scale);
+    game::path_graph graph(scale, chunk_size);
+    game::path_search search;
+    const size_t start = (1 * scale * scale) + (32 * scale) + 60;
+    const size_t stop = ((scale - 2) * scale * scale) + (32 * scale) + 3;
+    if (search.search(grid, scale, start, stop))
+    {
+        throw std::runtime_error("Failed path graph maze is too simple");
+    }
+
+    // Route through all the holes
+    size_t requests = 0;
+    if (test_path_follow(graph, search, grid, scale, start, stop, requests) != stop)
+    {
+        throw std::runtime_error("Failed path graph maze route");
+    }
+
+    // Move the first hole to the other end of the wall
+    std::vector<size_t> changed;
+    for (size_t y = 0; y < scale; y++)
+    {
+        for (size_t z = 0; z < scale; z++)
+        {
+            const size_t key = (4 * scale * scale) + (y * scale) + z;
+            const bool hole = (y == scale / 2 || y == scale / 2 + 1) && (z == scale - 3 || z == scale - 2);
+            const game::block_id value = hole ? game::block_id::EMPTY : game::block_id::STONE1;
+            if (grid[key] != value)
+            {
+                grid[key] = value;
+                changed.push_back(key);
+            }
+        }
+    }
+
+    // Update the chunks we changed
+    for (const size_t key : changed)
+    {
+        const size_t x = key / (scale * scale) / chunk_size;
+        const size_t y = (key / scale) % scale / chunk_size;
+        const size_t z = key % scale / chunk_size;
+        const size_t cs = scale / chunk_size;
+        graph.update((x * cs * cs) + (y * cs) + z);
+    }
+
+    // Route through the new hole
+    if (test_path_follow(graph, search, grid, scale, start, stop, requests) != stop)
+    {
+        throw std::runtime_error("Failed path graph incremental update");
+    }
+
+    // Seal the maze and check that we stop at a wall
+    for (const size_t key : changed)
+    {
+        grid[key] = game::block_id::STONE1;
+        const size_t x = key / (scale * scale) / chunk_size;
+        const size_t y = (key / scale) % scale / chunk_size;
+        const size_t z = key % scale / chunk_size;
+        const size_t cs = scale / chunk_size;
+        graph.update((x * cs * cs) + (y * cs) + z);
+    }
+    const size_t end = test_path_follow(graph, search, grid, scale, start, stop, requests);
+    if (end / (scale * scale) >= 4)
+    {
+        throw std::runtime_error("Failed path graph sealed maze");
+    }
+
+    return true;
+}
+bool test_path_graph_scale(const size_t grid_size)
+{
+    // Same layout as cgrid, world is 2 * grid cells wide
+    const size_t scale = grid_size * 2;
+    const size_t chunk_size = 8;
+    std::mt19937 gen(4321);
+    const std::vector<game::block_id> grid = test_path_grid(scale, gen);
+    game::path_graph graph(scale, chunk_size);
+    game::path_search search;
+
+    // Pick routes across the world above the ground
+    std::vector<std::pair<size_t, size_t>> pairs;
+    std::uniform_int_distribution<size_t> height(scale / 2, scale - 2);
+    while (pairs.size() < 8)
+    {
+        const size_t start = (1 * scale * scale) + (height(gen) * scale) + 1;
+        const size_t stop = ((scale - 2) * scale * scale) + (height(gen) * scale) + (scale - 2);
+        if (grid[start] == game::block_id::EMPTY && grid[stop] == game::block_id::EMPTY)
+        {
+            pairs.emplace_back(start, stop);
+        }
+    }
+
+    // Build the regions along each route once before timing
+    size_t requests = 0;
+    for (const auto &p : pairs)
+    {
+        test_path_follow(graph, search, grid, scale, p.first, p.second, requests);
+    }
+
+    // Time all path requests along each route
+    size_t total = 0;
+    size_t arrived = 0;
+    const auto begin = std::chrono::high_resolution_clock::now();
+    for (const auto &p : pairs)
+    {
+        arrived += test_path_follow(graph, search, grid, scale, p.first, p.second, requests) == p.second;
+        total += requests;
+    }
+    const auto end = std::chrono::high_resolution_clock::now();
+    const double us = std::chrono::duration<double, std::micro>(end - begin).count() / total;
+    std::cout << "path_graph: grid " << grid_size << ": " << us << " us per path, " << total << " paths, " << arrived << "/" << pairs.size() << " arrived" << std::endl;
+
+    // All routes should arrive
+    if (arrived != pairs.size())
+    {
+        throw std::runtime_error("Failed path graph world route");
+    }
+
+    return true;
+}
+size_t test_path_flow_settle(game::flow_field &flow, const std::vector<game::block_id> &grid, const size_t goal, double &slice_us)
+{
+    // Grow the field one slice per call until it is published
+    size_t slices = 0;
+    slice_us = 0.0;
+    do
+    {
+        const auto begin = std::chrono::high_resolution_clock::now();
+        flow.update_goal(grid, goal);
+        const auto end = std::chrono::high_resolution_clock::now();
+        slice_us = std::max(slice_us, std::chrono::duration<double, std::micro>(end - begin).count());
+        slices++;
+    } while (!flow.is_ready() && slices < 1000);
+
+    return slices;
+}
+size_t test_path_flow_walk(const game::flow_field &flow, const std::vector<game::block_id> &grid, const size_t scale, const size_t goal, std::mt19937 &gen)
+{
+    // Every reachable cell in the box should step down the shortest path to the goal
+    std::uniform_int_distribution<size_t> axis(64 - 16, 64 + 16);
+    std::uniform_int_distribution<size_t> height(66, 80 + 16);
+    size_t reached = 0;
+    for (size_t i = 0; i < 200; i++)
+    {
+        const size_t start = (axis(gen) * scale * scale) + (height(gen) * scale) + axis(gen);
+        size_t key = start;
+        size_t next;
+        size_t steps = 0;
+        while (flow.step(key, next) && next != key && steps < 1000)
+        {
+            if (grid[next] != game::block_id::EMPTY)
+            {
+                throw std::runtime_error("Failed flow field through wall");
+            }
+            key = next;
+            steps++;
+        }
+
+        // If we reached the goal the walk must be a shortest path
+        if (key == goal)
+        {
+            reached++;
+            if (steps > 0 && test_path_bfs(grid, scale, start, goal) != steps + 1)
+            {
+                throw std::runtime_error("Failed flow field shortest path");
+            }
+        }
+    }
+
+    return reached;
+}
+bool test_path_flow()
+{
+    // Same layout as cgrid, world is 2 * grid cells wide
+    const size_t scale = 128;
+    const size_t chunk_size = 8;
+    const size_t budget = 8192;
+    std::mt19937 gen(5678);
+    std::vector<game::block_id> grid = test_path_grid(scale, gen);
+    game::flow_field flow(scale, chunk_size, 2, budget);
+
+    // Place the goal above the ground, seal a pocket next to it in the same chunk
+    const size_t s2 = scale * scale;
+    const size_t goal = (64 * s2) + (80 * scale) + 64;
+    const size_t pocket = goal + 3;
+    grid[goal] = game::block_id::EMPTY;
+    grid[pocket] = game::block_id::EMPTY;
+    for (const size_t n : {pocket - s2, pocket + s2, pocket - scale, pocket + scale, pocket - 1, pocket + 1})
+    {
+        grid[n] = game::block_id::STONE1;
+    }
+
+    // Time building the field, it is spread over several slices
+    double slice_us = 0.0;
+    const auto begin = std::chrono::high_resolution_clock::now();
+    const size_t slices = test_path_flow_settle(flow, grid, goal, slice_us);
+    const auto end = std::chrono::high_resolution_clock::now();
+    const double us = std::chrono::duration<double, std::micro>(end - begin).count();
+    std::cout << "flow_field: grid 64: " << us << " us per build, " << slices << " slices, " << slice_us << " us worst slice" << std::endl;
+    if (slices < 2 || slices >= 1000)
+    {
+        throw std::runtime_error("Failed flow field slicing");
+    }
+
+    // Walks follow shortest paths to the goal cell itself
+    if (test_path_flow_walk(flow, grid, scale, goal, gen) < 100)
+    {
+        throw std::runtime_error("Failed flow field reachability");
+    }
+
+    // Sealed cells next to the goal are not steered into
+    size_t next;
+    if (flow.step(pocket, next) || !flow.step(goal, next) || next != goal)
+    {
+        throw std::runtime_error("Failed flow field goal cell");
+    }
+
+    // A moved goal keeps the old field steering until the new one is published
+    const size_t moved = goal + scale;
+    grid[moved] = game::block_id::EMPTY;
+    flow.update_goal(grid, moved);
+    if (flow.is_ready() || !flow.step(goal, next) || next != goal)
+    {
+        throw std::runtime_error("Failed flow field goal move front");
+    }
+    test_path_flow_settle(flow, grid, moved, slice_us);
+    if (test_path_flow_walk(flow, grid, scale, moved, gen) < 100)
+    {
+        throw std::runtime_error("Failed flow field goal move");
+    }
+
+    // Cells outside the box fall back to path searching
+    if (flow.step((2 * scale * scale) + (100 * scale) + 2, next))
+    {
+        throw std::runtime_error("Failed flow field bounds");
+    }
+
+    // Terrain changes inside the box rebuild the field, the old one steers meanwhile
+    const size_t cs = scale / chunk_size;
+    const size_t wall = goal + 2 * scale;
+    grid[wall] = game::block_id::STONE1;
+    flow.update((8 * cs * cs) + (10 * cs) + 8, cs);
+    flow.update_goal(grid, moved);
+    if (!flow.step(wall, next))
+    {
+        throw std::runtime_error("Failed flow field front during rebuild");
+    }
+    test_path_flow_settle(flow, grid, moved, slice_us);
+    if (flow.step(wall, next))
+    {
+        throw std::runtime_error("Failed flow field invalidate");
+    }
+
+    // Clearing drops the field
+    flow.clear();
+    if (flow.step(moved, next))
+    {
+        throw std::runtime_error("Failed flow field clear");
+    }
+
+    return true;
+}
+bool test_path_queue()
+{
+    // Same layout as cgrid, world is 2 * grid cells wide
+    const size_t scale = 128;
+    const size_t chunk_size = 8;
+    std::mt19937 gen(2468);
+    const std::vector<game::block_id> grid = test_path_grid(scale, gen);
+    std::vector<game::block_id> live = grid;
+    game::path_queue queue(live, scale, chunk_size);
+    game::path_graph graph(scale, chunk_size);
+    game::path_search search;
+
+    // Pick random empty start and stop points above ground
+    std::uniform_int_distribution<size_t> axis(1, scale - 2);
+    std::uniform_int_distribution<size_t> height(scale / 2, scale - 2);
+    std::vector<std::pair<size_t, size_t>> pairs;
+    while (pairs.size() < 64)
+    {
+        const size_t start = (axis(gen) * scale * scale) + (height(gen) * scale) + axis(gen);
+        const size_t stop = (axis(gen) * scale * scale) + (height(gen) * scale) + axis(gen);
+        if (grid[start] == game::block_id::EMPTY && grid[stop] == game::block_id::EMPTY)
+        {
+            pairs.emplace_back(start, stop);
+        }
+    }
+
+    // Post all requests and search them on the worker
+    for (size_t i = 0; i < pairs.size(); i++)
+    {
+        queue.post(i, pairs[i].first, pairs[i].second);
+    }
+    queue.launch();
+
+    // The worker searches a snapshot, writing the live grid doesn't change its paths
+    std::fill(live.begin(), live.end(), game::block_id::STONE1);
+    queue.wait();
+
+    // Results must match searching on this thread
+    size_t count = 0;
+    queue.collect([&pairs, &graph, &search, &grid, &count, scale](const size_t id, const size_t *const keys, const size_t size) {
+        const std::pair<size_t, size_t> &p = pairs[id];
+        search.search(grid, scale, p.first, graph.waypoint(grid, p.first, p.second));
+        const std::vector<size_t> &path = search.get_path();
+        if (path.size() != size || !std::equal(path.begin(), path.end(), keys))
+        {
+            throw std::runtime_error("Failed path queue result");
+        }
+        count++;
+    });
+    if (count != pairs.size())
+    {
+        throw std::runtime_error("Failed path queue result count");
+    }
+
+    // Results are only handed back once
+    live = grid;
+    queue.launch();
+    queue.wait();
+    queue.collect([](const size_t, const size_t *const, const size_t) {
+        throw std::runtime_error("Failed path queue empty launch");
+    });
+
+    // Clearing hands back launched and unlaunched requests as empty paths
+    queue.post(0, pairs[0].first, pairs[0].second);
+    queue.launch();
+    queue.post(1, pairs[1].first, pairs[1].second);
+    queue.clear();
+    queue.wait();
+    std::vector<size_t> dropped;
+    queue.collect([&dropped](const size_t id, const size_t *const, const size_t size) {
+        if (size != 0)
+        {
+            throw std::runtime_error("Failed path queue clear result");
+        }
+        dropped.push_back(id);
+    });
+    if (dropped != std::vector<size_t>{0, 1})
+    {
+        throw std::runtime_error("Failed path queue clear dropped");
+    }
+
+    // A new request after clear must be answered
+    count = 0;
+    queue.post(2, pairs[2].first, pairs[2].second);
+    queue.launch();
+    queue.wait();
+    queue.collect([&count](const size_t id, const size_t *const, const size_t size) {
+        if (id != 2 || size == 0)
+        {
+            throw std::runtime_error("Failed path queue request after clear");
+        }
+        count++;
+    });
+    if (count != 1)
+    {
+        throw std::runtime_error("Failed path queue request after clear count");
+    }
+
+    // A chunk is only copied to the snapshot once updated, searches then start inside the wall
+    const size_t start = pairs[3].first;
+    const size_t chunk_scale = scale / chunk_size;
+    const size_t cx = (start / (scale * scale)) / chunk_size;
+    const size_t cy = ((start / scale) % scale) / chunk_size;
+    const size_t cz = (start % scale) / chunk_size;
+    live[start] = game::block_id::STONE1;
+    size_t before = 0;
+    queue.post(3, start, pairs[3].second);
+    queue.launch();
+    queue.wait();
+    queue.collect([&before](const size_t, const size_t *const, const size_t size) {
+        before = size;
+    });
+    queue.update((cx * chunk_scale * chunk_scale) + (cy * chunk_scale) + cz);
+    size_t after = 1;
+    queue.post(3, start, pairs[3].second);
+    queue.launch();
+    queue.wait();
+    queue.collect([&after](const size_t, const size_t *const, const size_t size) {
+        after = size;
+    });
+    if (before == 0 || after != 0)
+    {
+        throw std::runtime_error("Failed path queue snapshot update");
+    }
+
+    return true;
+}
+bool test_path()
+{
+    bool out = true;
+
+    // Benchmark path searches at default and large world sizes
+    out = out && test_path_scale(64, true);
+    out = out && test_path_scale(256, false);
+
+    // Test long routes over chunk regions
+    out = out && test_path_graph_maze();
+    out = out && test_path_graph_scale(64);
+    out = out && test_path_graph_scale(256);
+
+    // Test the shared flow field
+    out = out && test_path_flow();
+
+    // Test background path requests
+    out = out && test_path_queue();
+    if (!out)
+    {
+        throw std::runtime_error("Failed path search test");
+    }
+
+    // return status
+    return out;
+}
+
+#endif
@@ -0,0 +1,137 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_PERLIN__
+#define __TEST_PERLIN__
+
+#include <chrono>
+#include <cmath>
+#include <game/perlin.h>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <test.h>
+
+bool test_perlin_batch()
+{
+    kernel::perlin_noise noise;
+
+    // Fast math lets the compiler reassociate each path differently
+#ifdef __FAST_MATH__
+    const float tolerance = 1E-5;
+#else
+    const float tolerance = 0.0;
+#endif
+
+    // Random points and chunk relative grid cells, like terrain_base
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> pos(0.0, 64.0);
+    std::uniform_real_distribution<float> step(0.0, 1.0);
+    float z[8];
+    float out[8];
+    for (size_t i = 0; i < 20000; i++)
+    {
+        const float x = pos(gen);
+        const float y = pos(gen);
+        const float z0 = pos(gen);
+        const float dz = (i % 2 == 0) ? step(gen) : 1.0 / 8;
+        for (size_t j = 0; j < 8; j++)
+        {
+            z[j] = z0 + j * dz;
+        }
+
+        // Batched noise must match the scalar noise
+        noise.perlin8(x, y, z, out);
+        for (size_t j = 0; j < 8; j++)
+        {
+            if (std::abs(out[j] - noise.perlin(x, y, z[j])) > tolerance)
+            {
+                throw std::runtime_error("Failed perlin8 matches perlin");
+            }
+        }
+    }
+
+    return true;
+}
+bool test_perlin_speed()
+{
+    kernel::perlin_noise noise;
+
+    // Sample a 256 cube of cells with chunk size 8
+    const size_t scale = 256;
+    const float inv_cs = 1.0 / 8;
+    double sum = 0.0;
+    auto begin = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < scale; i++)
+    {
+        for (size_t j = 0; j < scale; j++)
+        {
+            for (size_t k = 0; k < scale; k++)
+            {
+                sum += noise.perlin(i * inv_cs, j * inv_cs, k * inv_cs);
+            }
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    const double scalar_ms = std::chrono::duration<double, std::milli>(end - begin).count();
+
+    // Sample the same cells 8 at a time along Z
+    double sum8 = 0.0;
+    float z[8];
+    float out[8];
+    begin = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < scale; i++)
+    {
+        for (size_t j = 0; j < scale; j++)
+        {
+            for (size_t k = 0; k < scale; k += 8)
+            {
+                for (size_t l = 0; l < 8; l++)
+                {
+                    z[l] = (k + l) * inv_cs;
+                }
+                noise.perlin8(i * inv_cs, j * inv_cs, z, out);
+                for (size_t l = 0; l < 8; l++)
+                {
+                    sum8 += out[l];
+                }
+            }
+        }
+    }
+    end = std::chrono::high_resolution_clock::now();
+    const double batch_ms = std::chrono::duration<double, std::milli>(end - begin).count();
+
+    std::cout << "perlin: grid 256: " << scalar_ms << " ms scalar, " << batch_ms << " ms perlin8" << std::endl;
+
+    // Test the same cells were summed
+    if (std::abs(sum - sum8) > 1E-6 * sum)
+    {
+        throw std::runtime_error("Failed perlin8 sum matches perlin");
+    }
+
+    return true;
+}
+bool test_perlin()
+{
+    bool out = true;
+    out = out && test_perlin_batch();
+    out = out && test_perlin_speed();
+
+    return out;
+}
+
+#endif
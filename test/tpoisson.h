@@ -0,0 +1,164 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_POISSON__
+#define __TEST_POISSON__
+
+#include <algorithm>
+#include <game/id.h>
+#include <game/thread_pool.h>
+#include <kernel/poisson_disk.h>
+#include <kernel/terrain_height.h>
+#include <stdexcept>
+#include <test.h>
+#include <vector>
+
+std::vector<std::array<size_t, 2>> poisson_points(const kernel::poisson_disk &disk)
+{
+    // Gather all points tile by tile
+    std::vector<std::array<size_t, 2>> out;
+    for (size_t i = 0; i < disk.tiles(); i++)
+    {
+        const auto &tile = disk.get_tile(i);
+        out.insert(out.end(), tile.begin(), tile.end());
+    }
+
+    return out;
+}
+std::vector<game::block_id> poisson_vegetation(game::thread_pool &pool, const size_t scale)
+{
+    // Generate terrain from a fixed seed and keep only vegetation
+    std::vector<game::block_id> write(scale * scale * scale, game::block_id::EMPTY);
+    const kernel::terrain_height terrain(pool, scale, 0, scale / 2, 7);
+    terrain.generate(pool, write);
+    for (game::block_id &b : write)
+    {
+        const int_fast8_t v = game::id_value(b);
+        const bool plant = v >= game::id_value(game::block_id::TOMATO) && v <= game::id_value(game::block_id::GREEN_PEPPER);
+        const bool tree = v >= game::id_value(game::block_id::WOOD1) && v <= game::id_value(game::block_id::LEAF4);
+        if (!plant && !tree)
+        {
+            b = game::block_id::EMPTY;
+        }
+    }
+
+    return write;
+}
+void poisson_counts(game::thread_pool &pool, const size_t scale, const uint64_t seed, const bool fits)
+{
+    // Generate terrain and count tree trunks and plants
+    std::vector<game::block_id> write(scale * scale * scale, game::block_id::EMPTY);
+    const kernel::terrain_height terrain(pool, scale, scale / 2, scale - 1, seed);
+    terrain.generate(pool, write);
+    std::vector<bool> trunk(scale * scale, false);
+    size_t plants = 0;
+    for (size_t i = 0; i < write.size(); i++)
+    {
+        const int_fast8_t v = game::id_value(write[i]);
+        plants += (v >= game::id_value(game::block_id::TOMATO) && v <= game::id_value(game::block_id::GREEN_PEPPER));
+        if (v >= game::id_value(game::block_id::WOOD1) && v <= game::id_value(game::block_id::WOOD2))
+        {
+            trunk[(i / (scale * scale)) * scale + (i % scale)] = true;
+        }
+    }
+    const size_t trees = std::count(trunk.begin(), trunk.end(), true);
+
+    // Every kept site must be placed
+    if (trees != terrain.get_trees() || plants != terrain.get_plants())
+    {
+        throw std::runtime_error("Failed poisson vegetation placed count");
+    }
+
+    // Large worlds must place the drawn counts, small ones keep the mix
+    const size_t drawn = terrain.get_tree_draw() + terrain.get_plant_draw();
+    const bool same = trees == terrain.get_tree_draw() && plants == terrain.get_plant_draw();
+    const bool mix = (plants * drawn) / (trees + plants) <= terrain.get_plant_draw() + 1;
+    if ((fits && !same) || (!fits && (same || !mix)))
+    {
+        throw std::runtime_error("Failed poisson vegetation drawn count");
+    }
+}
+bool test_poisson()
+{
+    bool out = true;
+
+    // Generate points on a square
+    game::thread_pool pool;
+    const size_t lo = 3;
+    const size_t hi = 252;
+    const size_t radius = 8;
+    kernel::poisson_disk disk(lo, hi, radius, 42);
+    disk.generate(pool);
+    const std::vector<std::array<size_t, 2>> points = poisson_points(disk);
+
+    // Test all points are inside and far enough apart
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        out = out && points[i][0] >= lo && points[i][0] <= hi;
+        out = out && points[i][1] >= lo && points[i][1] <= hi;
+        for (size_t j = i + 1; j < points.size(); j++)
+        {
+            const int dx = static_cast<int>(points[i][0]) - static_cast<int>(points[j][0]);
+            const int dz = static_cast<int>(points[i][1]) - static_cast<int>(points[j][1]);
+            out = out && static_cast<size_t>(dx * dx + dz * dz) >= radius * radius;
+        }
+    }
+    if (!out)
+    {
+        throw std::runtime_error("Failed poisson disk spacing");
+    }
+
+    // Test the square is well covered
+    out = out && compare(points.size(), disk.size());
+    out = out && points.size() > 500;
+    if (!out)
+    {
+        throw std::runtime_error("Failed poisson disk coverage");
+    }
+
+    // Test the same seed gives the same points
+    kernel::poisson_disk same(lo, hi, radius, 42);
+    same.generate(pool);
+    out = out && (points == poisson_points(same));
+    if (!out)
+    {
+        throw std::runtime_error("Failed poisson disk determinism");
+    }
+
+    // Test vegetation is reproducible
+    const std::vector<game::block_id> first = poisson_vegetation(pool, 64);
+    const std::vector<game::block_id> second = poisson_vegetation(pool, 64);
+    size_t count = 0;
+    for (const game::block_id b : first)
+    {
+        count += (b != game::block_id::EMPTY);
+    }
+    out = out && count > 0;
+    out = out && (first == second);
+    if (!out)
+    {
+        throw std::runtime_error("Failed poisson vegetation determinism");
+    }
+
+    // Test placed counts match the drawn counts
+    poisson_counts(pool, 128, 11, false);
+    poisson_counts(pool, 256, 11, true);
+
+    return out;
+}
+
+#endif
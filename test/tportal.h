@@ -0,0 +1,82 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_PORTAL__
+#define __TEST_PORTAL__
+
+#include <game/portal_table.h>
+#include <stdexcept>
+#include <string>
+#include <test.h>
+#include <vector>
+
+template <typename F>
+bool portal_throws(const F &f)
+{
+    // Test that loading fails
+    try
+    {
+        f();
+    }
+    catch (std::exception &ex)
+    {
+        return true;
+    }
+
+    return false;
+}
+bool test_portal()
+{
+    bool out = true;
+
+    // Pack a text table with a blank line and negative values
+    const std::string text = "36 126 84 9\n20 -60 50 4\n\n8 6 15 5\n";
+    const std::vector<uint8_t> stream = game::portal_table::pack(text, 4);
+
+    // Test the packed size
+    out = out && compare(8 + 3 * 4 * 4, stream.size());
+    if (!out)
+    {
+        throw std::runtime_error("Failed portal pack size");
+    }
+
+    // Test the rows load in place
+    const game::portal_table table(stream.data(), stream.size(), 4);
+    out = out && compare(3, table.size());
+    out = out && compare(36, table.get(0, 0));
+    out = out && compare(9, table.get(0, 3));
+    out = out && compare(-60, table.get(1, 1));
+    out = out && compare(15, table.get(2, 2));
+    if (!out)
+    {
+        throw std::runtime_error("Failed portal table values");
+    }
+
+    // Test bad tables are rejected
+    out = out && portal_throws([&stream]() { game::portal_table(stream.data(), stream.size(), 12); });
+    out = out && portal_throws([&stream]() { game::portal_table(stream.data(), stream.size() - 1, 4); });
+    out = out && portal_throws([&stream]() { game::portal_table(stream.data(), 4, 4); });
+    out = out && portal_throws([]() { game::portal_table::pack("36 126 84\n", 4); });
+    if (!out)
+    {
+        throw std::runtime_error("Failed portal table errors");
+    }
+
+    return out;
+}
+
+#endif
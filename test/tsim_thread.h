@@ -0,0 +1,147 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_SIM_THREAD__
+#define __TEST_SIM_THREAD__
+
+#include <chrono>
+#include <game/sim_thread.h>
+#include <game/world_snapshot.h>
+#include <mutex>
+#include <stdexcept>
+#include <test.h>
+#include <thread>
+
+bool test_sim_thread()
+{
+    bool out = true;
+
+    // Test merge keeps the newest transforms and queues every side effect
+    {
+        game::world_snapshot front;
+        game::world_snapshot back;
+        size_t played = 0;
+        back.get_drones().add(7, min::vec3<float>(0.0, 0.0, 0.0), min::vec3<float>(2.0, 4.0, 6.0));
+        back.get_effects().push_back([&played]() { played++; });
+        back.get_chunks().push_back(3);
+        front.merge(back);
+        back.get_drones().clear();
+        back.get_effects().push_back([&played]() { played++; });
+        back.get_chunks().push_back(5);
+        front.merge(back);
+        out = out && (front.get_drones().size() == 0);
+        out = out && (back.get_drones().size() == 1);
+        out = out && (front.get_chunks().size() == 2);
+        out = out && (back.get_effects().size() == 0);
+        front.apply_effects();
+        out = out && (played == 2);
+        out = out && (front.get_effects().size() == 0);
+        const min::vec3<float> p = back.get_drones().interpolate(0, 0.5);
+        out = out && compare(1.0, p.x(), 1E-4);
+        out = out && compare(2.0, p.y(), 1E-4);
+        out = out && compare(3.0, p.z(), 1E-4);
+        if (!out)
+        {
+            throw std::runtime_error("Failed sim thread snapshot merge");
+        }
+    }
+
+    // Run 200 ticks per second on the simulation thread
+    std::mutex state;
+    size_t count = 0;
+    size_t played = 0;
+    game::sim_thread<game::world_snapshot> sim(state, 1.0 / 200.0, 4, [&count, &played](game::world_snapshot &s) {
+        count++;
+        s.set_player(min::vec3<float>(count - 1, 0.0, 0.0), min::vec3<float>(count, 0.0, 0.0));
+        s.get_effects().push_back([&played]() { played++; });
+    });
+
+    // Test nothing ticks before start
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    out = out && (sim.ticks() == 0);
+    if (!out)
+    {
+        throw std::runtime_error("Failed sim thread idle");
+    }
+
+    // Test ticks are published while the render thread reads
+    sim.start();
+    float max_alpha = 0.0;
+    float min_alpha = 1.0;
+    for (size_t i = 0; i < 50; i++)
+    {
+        sim.read([&max_alpha, &min_alpha](game::world_snapshot &s, const float alpha) {
+            max_alpha = std::max(max_alpha, alpha);
+            min_alpha = std::min(min_alpha, alpha);
+            s.apply_effects();
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    sim.stop();
+    out = out && (sim.ticks() > 0);
+    out = out && (min_alpha >= 0.0 && max_alpha <= 1.0);
+    if (!out)
+    {
+        throw std::runtime_error("Failed sim thread publish");
+    }
+
+    // Test every tick's side effect is applied exactly once
+    sim.read([](game::world_snapshot &s, const float) {
+        s.apply_effects();
+    });
+    {
+        std::lock_guard<std::mutex> lock(state);
+        out = out && (played == sim.ticks());
+        out = out && (count == sim.ticks());
+    }
+    if (!out)
+    {
+        throw std::runtime_error("Failed sim thread side effects");
+    }
+
+    // Test the player interpolates between the last two ticks
+    sim.read([&out, &count](game::world_snapshot &s, const float) {
+        out = out && compare(count - 0.5, s.player(0.5).x(), 1E-4);
+    });
+    if (!out)
+    {
+        throw std::runtime_error("Failed sim thread interpolate");
+    }
+
+    // Test nothing ticks after stop
+    const size_t ticks = sim.ticks();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    out = out && (sim.ticks() == ticks);
+    if (!out)
+    {
+        throw std::runtime_error("Failed sim thread stop");
+    }
+
+    // Test the simulation resumes
+    sim.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    sim.stop();
+    out = out && (sim.ticks() > ticks);
+    if (!out)
+    {
+        throw std::runtime_error("Failed sim thread resume");
+    }
+
+    return out;
+}
+
+#endif
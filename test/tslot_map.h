@@ -0,0 +1,89 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_SLOT_MAP__
+#define __TEST_SLOT_MAP__
+
+#include <game/slot_map.h>
+#include <stdexcept>
+#include <test.h>
+
+bool test_slot_map()
+{
+    bool out = true;
+
+    // Test slots are handed out lowest first
+    game::slot_map slots(3);
+    const size_t a = slots.alloc();
+    const size_t b = slots.alloc();
+    out = out && (game::slot_map::slot(a) == 0);
+    out = out && (game::slot_map::slot(b) == 1);
+    out = out && (slots.size() == 2) && (slots.max() == 3);
+    out = out && slots.is_valid(a) && slots.is_valid(b);
+    if (!out)
+    {
+        throw std::runtime_error("Failed slot map alloc");
+    }
+
+    // Test a freed slot is reused under a new generation
+    slots.free(a);
+    out = out && !slots.is_valid(a) && !slots.is_live(0);
+    const size_t c = slots.alloc();
+    out = out && (game::slot_map::slot(c) == 0);
+    out = out && (c != a) && slots.is_valid(c) && !slots.is_valid(a);
+
+    // Test freeing a stale handle doesn't free the new owner
+    slots.free(a);
+    out = out && slots.is_valid(c) && (slots.size() == 2);
+    if (!out)
+    {
+        throw std::runtime_error("Failed slot map free");
+    }
+
+    // Test running out of slots throws
+    const size_t d = slots.alloc();
+    out = out && slots.is_full();
+    bool thrown = false;
+    try
+    {
+        slots.alloc();
+    }
+    catch (const std::runtime_error &e)
+    {
+        thrown = true;
+    }
+    out = out && thrown;
+    if (!out)
+    {
+        throw std::runtime_error("Failed slot map full");
+    }
+
+    // Test clear invalidates every live handle
+    slots.clear();
+    out = out && (slots.size() == 0);
+    out = out && !slots.is_valid(b) && !slots.is_valid(c) && !slots.is_valid(d);
+    const size_t e = slots.alloc();
+    out = out && (game::slot_map::slot(e) == 0) && (e != c);
+    if (!out)
+    {
+        throw std::runtime_error("Failed slot map clear");
+    }
+
+    return out;
+}
+
+#endif
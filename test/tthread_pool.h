@@ -18,9 +18,11 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef __TEST_THREAD_POOL__
 #define __TEST_THREAD_POOL__
 
+#include <algorithm>
 #include <game/thread_pool.h>
 #include <stdexcept>
 #include <test.h>
+#include <vector>
 
 bool test_thread_pool()
 {
@@ -66,6 +68,23 @@ bool test_thread_pool()
         throw std::runtime_error("Failed thread pool test");
     }
 
+    // Test pools of any size do the same work
+    std::vector<int> counts(100, 0);
+    const auto count = [&counts](std::mt19937 &gen, const size_t i) {
+        counts[i]++;
+    };
+    for (unsigned threads = 1; threads <= 4; threads++)
+    {
+        game::thread_pool sized(threads);
+        sized.run(count, 0, counts.size());
+        out = out && (sized.get_threads() == threads);
+    }
+    out = out && std::all_of(counts.begin(), counts.end(), [](const int c) { return c == 4; });
+    if (!out)
+    {
+        throw std::runtime_error("Failed thread pool thread count test");
+    }
+
     // return status
     return out;
 }
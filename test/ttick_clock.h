@@ -0,0 +1,77 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_TICK_CLOCK__
+#define __TEST_TICK_CLOCK__
+
+#include <game/tick_clock.h>
+#include <stdexcept>
+#include <test.h>
+
+bool test_tick_clock()
+{
+    bool out = true;
+
+    // 180 ticks per second, at most 45 ticks per frame
+    const double step = 1.0 / 180.0;
+    game::tick_clock clock(step, 45);
+
+    // Test a 60 fps frame is three ticks with nothing left over
+    out = out && (clock.advance(1.0 / 60.0) == 3);
+    out = out && compare(clock.alpha(), 0.0, 1E-3);
+
+    // Test a 144 fps frame carries the remainder
+    size_t ticks = clock.advance(1.0 / 144.0);
+    out = out && (ticks == 1);
+    out = out && compare(clock.alpha(), 0.25, 1E-3);
+    ticks += clock.advance(1.0 / 144.0);
+    ticks += clock.advance(1.0 / 144.0);
+    ticks += clock.advance(1.0 / 144.0);
+    out = out && (ticks == 5);
+    out = out && compare(clock.alpha(), 0.0, 1E-3);
+    if (!out)
+    {
+        throw std::runtime_error("Failed tick clock remainder");
+    }
+
+    // Test a long frame runs every tick over many frames
+    clock.reset();
+    size_t total = 0;
+    for (size_t i = 0; i < 1000; i++)
+    {
+        total += clock.advance((i % 3 == 0) ? 0.009 : 0.003);
+    }
+    out = out && (total == 899 || total == 900);
+    if (!out)
+    {
+        throw std::runtime_error("Failed tick clock total");
+    }
+
+    // Test a stall is capped and the backlog dropped
+    clock.reset();
+    out = out && (clock.advance(2.0) == 45);
+    out = out && compare(clock.alpha(), 0.0, 1E-3);
+    out = out && (clock.advance(1.0 / 60.0) == 3);
+    if (!out)
+    {
+        throw std::runtime_error("Failed tick clock stall");
+    }
+
+    return out;
+}
+
+#endif
@@ -0,0 +1,141 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_VOXEL_CONTACT__
+#define __TEST_VOXEL_CONTACT__
+
+#include <game/id.h>
+#include <game/voxel_contact.h>
+#include <min/aabbox.h>
+#include <min/vec3.h>
+#include <random>
+#include <stdexcept>
+#include <test.h>
+#include <vector>
+
+bool test_voxel_contact()
+{
+    bool out = true;
+
+    // Floor of solid cells with one pillar, world is centered on the origin
+    const size_t scale = 16;
+    const min::vec3<float> world_min(-8.0, -8.0, -8.0);
+    std::vector<game::block_id> grid(scale * scale * scale, game::block_id::EMPTY);
+    for (size_t x = 0; x < scale; x++)
+    {
+        for (size_t z = 0; z < scale; z++)
+        {
+            grid[(x * scale + 4) * scale + z] = game::block_id::STONE1;
+        }
+    }
+    grid[(8 * scale + 5) * scale + 8] = game::block_id::SODIUM;
+    const game::voxel_contact contact(grid, scale, world_min);
+
+    // Test a box sinking into the floor is pushed up by its penetration
+    const min::aabbox<float, min::vec3> sink(min::vec3<float>(-1.75, -3.25, -1.75), min::vec3<float>(-1.25, -2.25, -1.25));
+    size_t count = 0;
+    contact.query(sink, [&out, &count](const game::cell_contact &c) {
+        out = out && compare(c.get_normal().y(), 1.0, 1E-4);
+        out = out && compare(c.get_depth(), 0.25, 1E-4);
+        out = out && compare(c.get_center().y(), -3.5, 1E-4);
+        out = out && (c.get_value() == game::block_id::STONE1);
+        count++;
+        return false;
+    });
+    out = out && (count == 1);
+    if (!out)
+    {
+        throw std::runtime_error("Failed voxel contact floor");
+    }
+
+    // Test a box beside the pillar is pushed out sideways
+    const min::aabbox<float, min::vec3> side(min::vec3<float>(0.8, -2.9, 0.2), min::vec3<float>(1.3, -2.1, 0.8));
+    count = 0;
+    contact.query(side, [&out, &count](const game::cell_contact &c) {
+        out = out && compare(c.get_normal().x(), 1.0, 1E-4);
+        out = out && compare(c.get_depth(), 0.2, 1E-4);
+        out = out && (c.get_value() == game::block_id::SODIUM);
+        count++;
+        return false;
+    });
+    out = out && (count == 1);
+    if (!out)
+    {
+        throw std::runtime_error("Failed voxel contact pillar");
+    }
+
+    // Test the callback can stop the query
+    const min::aabbox<float, min::vec3> wide(min::vec3<float>(-4.0, -3.5, -4.0), min::vec3<float>(4.0, -2.5, 4.0));
+    count = 0;
+    contact.query(wide, [&count](const game::cell_contact &c) {
+        count++;
+        return count == 3;
+    });
+    out = out && (count == 3);
+
+    // Test boxes outside the world find nothing
+    const min::aabbox<float, min::vec3> outside(min::vec3<float>(9.0, -4.0, 0.0), min::vec3<float>(10.0, -3.0, 1.0));
+    count = 0;
+    contact.query(outside, [&count](const game::cell_contact &c) {
+        count++;
+        return false;
+    });
+    out = out && (count == 0);
+    if (!out)
+    {
+        throw std::runtime_error("Failed voxel contact early out");
+    }
+
+    // Test random boxes find the same cells as a brute force overlap
+    std::mt19937 gen(11);
+    std::uniform_real_distribution<float> pos(-9.0, 9.0);
+    std::uniform_real_distribution<float> ext(0.1, 2.0);
+    for (size_t i = 0; i < 1000; i++)
+    {
+        const min::vec3<float> lo(pos(gen), pos(gen) * 0.25 - 3.0, pos(gen));
+        const min::vec3<float> hi = lo + min::vec3<float>(ext(gen), ext(gen), ext(gen));
+        const min::aabbox<float, min::vec3> box(lo, hi);
+
+        // All solid cells overlapping or touching the box
+        size_t expect = 0;
+        for (size_t key = 0; key < grid.size(); key++)
+        {
+            const min::vec3<float> cell = world_min + min::vec3<float>(key / (scale * scale), (key / scale) % scale, key % scale);
+            const bool overlap = lo.x() <= cell.x() + 1.0f && hi.x() >= cell.x() && lo.y() <= cell.y() + 1.0f && hi.y() >= cell.y() && lo.z() <= cell.z() + 1.0f && hi.z() >= cell.z();
+            if (overlap && grid[key] != game::block_id::EMPTY)
+            {
+                expect++;
+            }
+        }
+
+        count = 0;
+        contact.query(box, [&out, &count](const game::cell_contact &c) {
+            out = out && (c.get_depth() >= 0.0);
+            count++;
+            return false;
+        });
+        out = out && (count == expect);
+    }
+    if (!out)
+    {
+        throw std::runtime_error("Failed voxel contact brute force");
+    }
+
+    return out;
+}
+
+#endif
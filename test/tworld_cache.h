@@ -0,0 +1,99 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_WORLD_CACHE__
+#define __TEST_WORLD_CACHE__
+
+#include <cstdio>
+#include <game/id.h>
+#include <game/thread_pool.h>
+#include <game/world_cache.h>
+#include <kernel/terrain_base.h>
+#include <kernel/terrain_height.h>
+#include <stdexcept>
+#include <test.h>
+#include <vector>
+
+std::vector<game::block_id> world_cache_terrain(game::thread_pool &pool, const size_t scale, const uint64_t seed)
+{
+    // Generate a whole world from a seed
+    std::vector<game::block_id> grid(scale * scale * scale, game::block_id::EMPTY);
+    const kernel::terrain_base base(scale, 8, 0, scale / 2, seed);
+    const kernel::terrain_height height(pool, scale, scale / 2, scale - 1, seed);
+    base.generate(pool, grid);
+    height.generate(pool, grid);
+
+    return grid;
+}
+bool test_world_cache()
+{
+    bool out = true;
+
+    // Test the same seed gives the same world
+    game::thread_pool pool;
+    const size_t scale = 32;
+    const std::vector<game::block_id> world = world_cache_terrain(pool, scale, 1234);
+    out = out && (world == world_cache_terrain(pool, scale, 1234));
+    out = out && (world != world_cache_terrain(pool, scale, 4321));
+    if (!out)
+    {
+        throw std::runtime_error("Failed world cache seeded terrain");
+    }
+
+    // Test keys hold the generator version and all parameters
+    const std::string key = game::world_cache::key("world", {1234, scale, 8});
+    out = out && (key == "world_g1_1234_32_8");
+    if (!out)
+    {
+        throw std::runtime_error("Failed world cache key");
+    }
+
+    // Test a missing entry doesn't touch the grid
+    const game::world_cache cache("bin/test_cache_");
+    std::vector<game::block_id> grid(world.size(), game::block_id::EMPTY);
+    std::remove("bin/test_cache_world_g1_1234_32_8.bgrid");
+    out = out && !cache.exists(key);
+    out = out && !cache.load(key, grid);
+    out = out && (grid[0] == game::block_id::EMPTY);
+    if (!out)
+    {
+        throw std::runtime_error("Failed world cache missing entry");
+    }
+
+    // Test a saved world loads back exactly
+    cache.save(key, world);
+    out = out && cache.exists(key);
+    out = out && cache.load(key, grid);
+    out = out && (grid == world);
+    if (!out)
+    {
+        throw std::runtime_error("Failed world cache round trip");
+    }
+
+    // Test an entry of the wrong size is rejected
+    std::vector<game::block_id> small(8, game::block_id::EMPTY);
+    out = out && !cache.load(key, small);
+    std::remove("bin/test_cache_world_g1_1234_32_8.bgrid");
+    if (!out)
+    {
+        throw std::runtime_error("Failed world cache size check");
+    }
+
+    return out;
+}
+
+#endif